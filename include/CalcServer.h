@@ -37,25 +37,9 @@
 #include <Variable.h>
 #include <Singleton.h>
 #include <CalcServer/Tool.h>
-
-#ifndef _ITEMS
-    /** @def _ITEMS
-     * @brief Number of items in a group
-     * @note Must be power of 2, and in some devices greather than 32.
-     * @see Aqua::CalcServer::RadixSort
-     */
-    #define _ITEMS  128
-#endif
-
-#ifndef _GROUPS
-    /** @def _GROUPS
-     * @brief Number of groups
-     * @note Must be power of 2, and the amount of data should be divisible by
-     * _ITEMS*_GROUPS
-     * @see Aqua::CalcServer::RadixSort
-     */
-    #define _GROUPS 32
-#endif
+#include <CalcServer/Transport.h>
+#include <CalcServer/ProgramCache.h>
+#include <CalcServer/MemoryPool.h>
 
 
 namespace Aqua{
@@ -147,11 +131,60 @@ public:
      */
     cl_device_id device() const{return _device;}
 
-    /** Get the command queue
+    /** @brief Get the command queue
+     *
+     * If several command queues are considered (see
+     * Aqua::InputOutput::ProblemSetup::sphSettings::n_queues), the command
+     * queue assigned to the tool currently executed is returned.
      * @return OpenCL command queue
      */
     cl_command_queue command_queue() const{return _command_queue;}
 
+    /** @brief Get the number of devices where the particles are distributed.
+     * @return Number of domains (see
+     * Aqua::InputOutput::ProblemSetup::sphSettings::n_domains)
+     */
+    unsigned int nDomains() const{return _domain_devices.size();}
+
+    /** @brief Get a device where the particles are distributed.
+     *
+     * If several domains are requested, they are sub-devices of the selected
+     * device, which is still executing the tools which are not split in
+     * domains. Otherwise the only domain is the selected device.
+     * @param i Domain index.
+     * @return OpenCL device
+     */
+    cl_device_id domainDevice(unsigned int i) const{
+        return _domain_devices.at(i);
+    }
+
+    /** @brief Get the command queue of a device where the particles are
+     * distributed.
+     * @param i Domain index.
+     * @return OpenCL command queue
+     */
+    cl_command_queue domainQueue(unsigned int i) const{
+        return _domain_queues.at(i);
+    }
+
+    /** @brief Get the communication with the other processes of a
+     * multi-process run.
+     * @return Transport, NULL if this is the only process.
+     */
+    Transport* transport() const{return _transport;}
+
+    /** @brief Get the compiled programs cache, which should be used to
+     * create and build all the OpenCL programs.
+     * @return Programs cache.
+     */
+    ProgramCache* programCache() const{return _program_cache;}
+
+    /** @brief Get the device memory pool, which should be used to allocate
+     * all the device memory.
+     * @return Memory pool.
+     */
+    MemoryPool* memoryPool() const{return _memory_pool;}
+
     /** Download a unsorted variable from the device.
      * @param var_name Variable to unsort and download.
      * @param offset The offset in bytes in the memory object to read from.
@@ -172,6 +205,13 @@ public:
      * @return AQUAgpusph root path
      */
     const std::string base_path() const{return _base_path.c_str();}
+
+    /** @brief Get the simulation settings.
+     * @return Simulation settings
+     */
+    const InputOutput::ProblemSetup::sphSettings& settings() const{
+        return _sim_data.settings;
+    }
 private:
     /** Setup the OpenCL stuff.
      */
@@ -185,6 +225,72 @@ private:
     /** Get the available devices in the selected platform.
      */
     void setupDevices();
+    /** @brief Partition a device in as many sub-devices as domains.
+     *
+     * The sub-devices are stored as the domains devices, while the list of
+     * devices is kept.
+     * @param device Device to be partitioned.
+     */
+    void partitionDevice(cl_device_id device);
+    /** @brief Prepare the tools in parallel (see
+     * Aqua::CalcServer::Tool::prepare()).
+     *
+     * A pool of as many threads as online processors is used.
+     */
+    void prepareTools();
+    /** @brief Execute the runs of consecutive element-wise tools as fused
+     * ones.
+     * @see Aqua::CalcServer::ElementWise
+     */
+    void fuseTools();
+    /** @brief Share the device memory between the arrays which are never
+     * alive at the same time.
+     *
+     * An array is considered transient if, at each time step, it is
+     * completely overwritten (by a Set or Copy tool executed every time
+     * step) before being accessed. Its liveness interval spans from such
+     * tool to the last one accessing it, according to the tools
+     * dependencies. The transient arrays whose intervals are not overlapping
+     * are then allocated in the same device memory, by means of
+     * sub-buffers. The particles sets fields loaded or saved are never
+     * shared, and the tools which are not reporting their dependencies are
+     * considered to access all the arrays.
+     */
+    void aliasArrays();
+    /** @brief Get the variable representing the memory of a variable for the
+     * scheduler, i.e. the first variable sharing its memory.
+     * @param var Variable.
+     * @return Variable sharing the memory, var if it is not shared.
+     * @see aliasArrays()
+     */
+    InputOutput::Variable* alias(InputOutput::Variable *var);
+    /** @brief Build the tools dependency graph, assigning a command queue to
+     * each tool.
+     *
+     * Each tool is waiting for the tools which are writing the variables that
+     * it reads, or reading/writing the variables that it writes. The tools
+     * are placed in the same command queue than one of their dependencies
+     * whenever it is possible, such that the number of synchronization events
+     * is minimized.
+     * @note The tools which are not reporting their dependencies (see
+     * Aqua::CalcServer::Tool::hasDependencies()) are considered
+     * synchronization points, i.e. they are waiting for all the previous
+     * tools, and all the subsequent tools are waiting for them.
+     */
+    void setupScheduler();
+    /** @brief Join all the command queues, such that the next commands
+     * enqueued in any of them will wait for all the previous ones.
+     */
+    void joinQueues();
+    /** @brief Make the command queue of a tool wait for its dependencies.
+     * @param tool_id Index of the tool.
+     */
+    void waitTools(unsigned int tool_id);
+    /** @brief Register the completion event of a tool, if any other tool is
+     * waiting for it.
+     * @param tool_id Index of the tool.
+     */
+    void signalTool(unsigned int tool_id);
 
     /// Number of available OpenCL platforms
     cl_uint _num_platforms;
@@ -204,6 +310,24 @@ private:
     cl_device_id _device;
     /// Selected command queue
     cl_command_queue _command_queue;
+    /** @brief Command queues in the selected device to execute the tools.
+     *
+     * The first one is the command queue of the selected device.
+     */
+    std::vector<cl_command_queue> _queues;
+    /// Devices where the particles are distributed
+    std::vector<cl_device_id> _domain_devices;
+    /// Command queues of the devices where the particles are distributed
+    std::vector<cl_command_queue> _domain_queues;
+
+    /// Communication with the other processes, NULL if there are not
+    Transport *_transport;
+
+    /// Compiled programs cache
+    ProgramCache *_program_cache;
+
+    /// Device memory pool
+    MemoryPool *_memory_pool;
 
     /// User registered variables
     InputOutput::Variables _vars;
@@ -214,6 +338,21 @@ private:
     /// User registered tools
     std::vector<Tool*> _tools;
 
+    /// Variables sharing the memory of other ones (see aliasArrays())
+    std::map<InputOutput::Variable*, InputOutput::Variable*> _aliases;
+
+    /// Command queue where each tool is executed
+    std::vector<cl_command_queue> _tools_queue;
+
+    /// Tools that each tool should wait for (just from other command queues)
+    std::vector<std::vector<unsigned int> > _tools_wait;
+
+    /// Flags to know whether any other tool is waiting for each tool
+    std::vector<bool> _tools_signal;
+
+    /// Completion events of the tools
+    std::vector<cl_event> _tools_event;
+
     /** @brief AQUAgpusph root path.
      *
      * This path is added to the OpenCL include paths.
@@ -25,6 +25,7 @@
 #define ASSERT_H_INCLUDED
 
 #include <CalcServer/Tool.h>
+#include <CalcServer/ScalarExpression.h>
 
 namespace Aqua{ namespace CalcServer{
 
@@ -35,6 +36,13 @@ namespace Aqua{ namespace CalcServer{
  * result will be considered false, and therefore a fatal error will be raised.
  * Any other value will be considered as true, letting the simulation to
  * normally continue.
+ *
+ * The condition can be evaluated in the computational device as well (see
+ * Aqua::CalcServer::ScalarExpression). In that case the result is downloaded
+ * without waiting for it, and checked at the end of the time step, when the
+ * device has already finished (see synchronize()). Hence the simulation is
+ * not synchronized with the device, at the cost of raising the error after
+ * the rest of the time step tools.
  */
 class Assert : public Aqua::CalcServer::Tool
 {
@@ -45,10 +53,14 @@ public:
      * considered, and fatal error will be raised, otherwise the simulation will
      * continue.
      * @param once Run this tool just once. Useful to make initializations.
+     * @param device true if the condition should be evaluated in the
+     * computational device, false otherwise. It is ignored if @p once is
+     * true.
      */
     Assert(const std::string name,
            const std::string condition,
-           bool once=false);
+           bool once=false,
+           bool device=false);
 
     /// Destructor.
     ~Assert();
@@ -57,6 +69,11 @@ public:
      */
     void setup();
 
+    /** @brief Check the result of the device side evaluation, once the time
+     * step has finished.
+     */
+    void synchronize();
+
 protected:
     /** @brief Perform the work.
      * @return false if all gone right, true otherwise.
@@ -64,8 +81,25 @@ protected:
     void _execute();
 
 private:
+    /** @brief Evaluate the condition in the computational device.
+     */
+    void executeDevice();
+
+    /** @brief Check the result of the previous device side evaluation.
+     */
+    void check();
+
     /// Condition expression to evaluate
     std::string _condition;
+
+    /// Device side condition evaluator, NULL if the host is evaluating it
+    ScalarExpression *_expr;
+
+    /// Device side evaluation result
+    int _result;
+
+    /// Device side evaluation result download event
+    cl_event _event;
 };
 
 }}  // namespace
@@ -53,6 +53,16 @@ public:
      */
     void setup();
 
+    /** Get the variable to copy.
+     * @return Array variable, NULL if the tool has not been setup yet.
+     */
+    InputOutput::ArrayVariable* getInputVariable() const {return _input_var.get();}
+
+    /** Get the variable to set.
+     * @return Array variable, NULL if the tool has not been setup yet.
+     */
+    InputOutput::ArrayVariable* getOutputVariable() const {return _output_var.get();}
+
 protected:
     /** Copy the data.
      */
@@ -69,9 +79,9 @@ private:
     std::string _output_name;
 
     /// Input variable
-    InputOutput::ArrayVariable *_input_var;
+    InputOutput::ArrayVariableRef _input_var;
     /// Output variable
-    InputOutput::ArrayVariable *_output_var;
+    InputOutput::ArrayVariableRef _output_var;
 };
 
 }}  // namespace
@@ -0,0 +1,177 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Fused element-wise tools.
+ * (See Aqua::CalcServer::ElementWise for details)
+ * @note Hardcoded versions of the files CalcServer/ElementWise.cl.in and
+ * CalcServer/ElementWise.hcl.in are internally included as a text array.
+ */
+
+#ifndef ELEMENTWISE_H_INCLUDED
+#define ELEMENTWISE_H_INCLUDED
+
+#include <CalcServer.h>
+#include <CalcServer/Tool.h>
+#include <CalcServer/Kernel.h>
+#include <CalcServer/ExecutionPlan.h>
+
+namespace Aqua{ namespace CalcServer{
+
+/** @class ElementWise ElementWise.h CalcServer/ElementWise.h
+ * @brief Fused element-wise tools.
+ *
+ * Several consecutive element-wise tools (see Aqua::CalcServer::Set and
+ * Aqua::CalcServer::Copy) working over arrays of the same length are
+ * replaced by a single kernel, which applies all the operations to each
+ * element in just one pass. Hence, both the number of kernel launches and
+ * the memory traffic are reduced.
+ *
+ * Consecutive kernels (see Aqua::CalcServer::Kernel) with the same number of
+ * threads expression can be fused as well, if they are flagged with the XML
+ * attribute `fuse="true"`. The flagged kernels should be element-wise ones,
+ * i.e. each thread should be just accessing the array elements of its own
+ * index, and should not use local memory or work group synchronizations.
+ * Their source codes are concatenated in a single program, renaming the
+ * entry points, such that they should not define conflicting symbols. If the
+ * fused program cannot be built, the kernels are executed separately.
+ *
+ * This tool is automatically generated by Aqua::CalcServer::CalcServer after
+ * setting up the tools. The fused tools are kept in the tools list, such that
+ * they are still reported by their names, but the first one is executing this
+ * tool, and the rest are doing nothing (see
+ * Aqua::CalcServer::Tool::fused()). The tools can be excluded from the fusion
+ * with the XML attribute `fuse="false"`.
+ */
+class ElementWise : public Aqua::CalcServer::Tool
+{
+public:
+    /** @brief Constructor.
+     * @param name Tool name.
+     * @param tools Element-wise tools to fuse, already set up.
+     * @param once Run this tool just once. Useful to make initializations.
+     */
+    ElementWise(const std::string name,
+                std::vector<Tool*> tools,
+                bool once=false);
+
+    /// Destructor.
+    ~ElementWise();
+
+    /** @brief Initialize the tool.
+     */
+    void setup();
+
+    /** @brief Check whether a tool can be fused.
+     * @param tool Already set up tool.
+     * @param n Number of elements processed by the tool.
+     * @return true if the tool is an element-wise one, which has not been
+     * excluded from the fusion, false otherwise.
+     */
+    static bool isFusable(Tool *tool, unsigned int &n);
+
+    /** @brief Check whether two tools can be fused together.
+     *
+     * The Set and Copy tools are fused among them when they are working over
+     * arrays of the same length, while the kernels are fused among them
+     * when they have the same number of threads expression.
+     * @param tool First tool of the fused ones, already set up.
+     * @param next Next tool, already set up.
+     * @return true if both tools can be fused, false otherwise.
+     */
+    static bool isFusable(Tool *tool, Tool *next);
+
+protected:
+    /** @brief Perform the work.
+     */
+    void _execute();
+
+private:
+    /** @brief Get the kernel argument name of a variable, registering it
+     * if it has not been already used.
+     * @param var Array variable.
+     * @return Argument name in the fused kernel.
+     */
+    std::string argument(InputOutput::ArrayVariable *var);
+
+    /** @brief Get the kernel argument name of a variable used by a fused
+     * kernel, registering it if it has not been already used.
+     * @param kernel Fused kernel.
+     * @param i Kernel argument index.
+     * @return Argument name in the fused kernel.
+     */
+    std::string argument(Kernel *kernel, unsigned int i);
+
+    /** @brief Generate the source code fusing Set and Copy tools.
+     * @param flags Filled with the compilation flags.
+     * @return Source code.
+     */
+    std::string elementsSource(std::string &flags);
+
+    /** @brief Generate the source code fusing kernels.
+     * @param flags Filled with the compilation flags.
+     * @return Source code.
+     */
+    std::string kernelsSource(std::string &flags);
+
+    /** @brief Setup the OpenCL stuff
+     */
+    void setupOpenCL();
+
+    /** @brief Set the number of elements, and the global work size
+     * accordingly.
+     * @param n Number of elements.
+     */
+    void setNumberOfElements(unsigned int n);
+
+    /** @brief Compile the source code and generate the corresponding kernel
+     * @param source Source code to be compiled.
+     * @param flags Compilation flags.
+     * @return Kernel instance.
+     */
+    cl_kernel compile(const std::string source, const std::string flags);
+
+    /// Fused tools
+    std::vector<Tool*> _tools;
+
+    /// Variables used by the fused tools
+    std::vector<InputOutput::Variable*> _vars;
+    /// Argument declarations of the variables
+    std::vector<std::string> _var_decls;
+    /// Variables which should be read from the device, i.e. the scalars
+    /// declared as pointers by the fused kernels
+    std::vector<bool> _var_devices;
+
+
+    /// OpenCL kernel
+    cl_kernel _kernel;
+
+    /// Global work size
+    size_t _global_work_size;
+    /// Local work size
+    size_t _local_work_size;
+    /// Number of elements
+    unsigned int _n;
+
+    /// Kernel arguments execution plan
+    ExecutionPlan _plan;
+};
+
+}}  // namespace
+
+#endif // ELEMENTWISE_H_INCLUDED
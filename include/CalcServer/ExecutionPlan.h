@@ -0,0 +1,123 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Pre-bound kernel arguments.
+ * (See Aqua::CalcServer::ExecutionPlan for details)
+ */
+
+#ifndef EXECUTIONPLAN_H_INCLUDED
+#define EXECUTIONPLAN_H_INCLUDED
+
+#include <CL/cl.h>
+#include <vector>
+
+#include <sphPrerequisites.h>
+#include <Variable.h>
+#include <CalcServer/Tool.h>
+
+namespace Aqua{ namespace CalcServer{
+
+/** @class ExecutionPlan ExecutionPlan.h CalcServer/ExecutionPlan.h
+ * @brief Pre-bound kernel arguments.
+ *
+ * The variables are bound to the kernel arguments just once, after setting
+ * up the tool. Then, before each execution, just the arguments whose
+ * variables have been modified since the last time are sent again, which is
+ * cheaply detected by means of the variables version counters (see
+ * Aqua::InputOutput::Variable::version()). The redeclared variables are
+ * detected as well, since they are increasing the version too.
+ *
+ * The scalar variables can be also bound to pointer arguments, such that the
+ * kernels read them from the computational device. In that case the buffer
+ * where the variable value is already stored (see
+ * Aqua::InputOutput::Variable::getDeviceMem()) is bound, without waiting for
+ * the host value, which is just uploaded when such buffer is not available.
+ */
+class ExecutionPlan
+{
+public:
+    /** @brief Constructor.
+     * @param tool Tool owning the plan, used to report errors.
+     */
+    ExecutionPlan(Tool *tool);
+
+    /// Destructor.
+    ~ExecutionPlan();
+
+    /** @brief Bind a variable to a kernel argument.
+     *
+     * The argument is immediately set.
+     * @param kernel OpenCL kernel.
+     * @param index Argument index.
+     * @param var Variable handle, such that the redeclared variables are
+     * also detected.
+     * @param device true if a scalar variable should be bound to a pointer
+     * argument, false otherwise.
+     */
+    void bind(cl_kernel kernel,
+              cl_uint index,
+              InputOutput::VariableRef var,
+              bool device=false);
+
+    /** @brief Send the arguments whose variables have been modified.
+     */
+    void update();
+
+    /** @brief Remove all the bound arguments.
+     */
+    void clear();
+
+private:
+    /** @brief Send a bound argument to the kernel.
+     * @param i Bound argument index.
+     */
+    void set(unsigned int i);
+
+    /// Bound argument
+    typedef struct {
+        /// OpenCL kernel
+        cl_kernel kernel;
+        /// Argument index
+        cl_uint index;
+        /// Variable
+        InputOutput::VariableRef var;
+        /// Variable version when the argument was sent
+        unsigned int version;
+        /// true if the scalar variable is bound to a pointer argument
+        bool device;
+        /// Buffer where the host value is uploaded, if it is required
+        cl_mem mem;
+    } boundArg;
+
+    /** @brief Send the computational device buffer of a scalar variable to
+     * the kernel.
+     * @param arg Bound argument.
+     */
+    void setDevice(boundArg &arg);
+
+    /// Tool owning the plan
+    Tool *_tool;
+
+    /// Bound arguments
+    std::vector<boundArg> _args;
+};
+
+}}  // namespace
+
+#endif // EXECUTIONPLAN_H_INCLUDED
@@ -0,0 +1,238 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Particles exchange between the processes of a multi-process run.
+ * (See Aqua::CalcServer::Halo for details)
+ */
+
+#ifndef HALO_H_INCLUDED
+#define HALO_H_INCLUDED
+
+#include <CalcServer.h>
+#include <CalcServer/Tool.h>
+#include <CalcServer/ExecutionPlan.h>
+
+namespace Aqua{ namespace CalcServer{
+
+/** @class Halo Halo.h CalcServer/Halo.h
+ * @brief Particles exchange between the processes of a multi-process run.
+ *
+ * The domain is split in slabs along the x direction, such that each process
+ * is computing the particles within its own slab (see
+ * Aqua::CalcServer::Transport). This tool is:
+ *   - Sending the particles which have abandoned the slab to the neighbour
+ *     process, which is storing them in its buffer particles
+ *     (imove = -255 or imove = -256).
+ *   - Sending the particles closer than a cell length (the kernel support
+ *     times h) to the slab border, which are stored by the neighbour process
+ *     as halo particles. The halo particles are the ones of a dedicated
+ *     particles set, which should have enough particles to store all the
+ *     received ones. The unused ones are set as buffer particles.
+ *
+ * The particles to send are looked for in the computational device, just
+ * traversing the link-list cells around the slab borders. This tool should
+ * be executed before the link-list (e.g. just after the predictor), such
+ * that the received particles are linked and sorted in the same time step.
+ * Hence, the link-list computed in the previous time step is traversed,
+ * which is still matching the particles order, widening the bands by a cell
+ * to consider the particles motion since then. Since the particles are
+ * looked for just one cell length away from the slab, the tool should be
+ * executed every time step. Then, just the fields of the particles to send
+ * and receive are transferred between the computational device and the
+ * host.
+ *
+ * All the processes are loading the same particles files, such that the
+ * first time this tool is executed, each process is removing the particles
+ * out of its slab, checking all the particles, since the link-list is not
+ * computed yet.
+ *
+ * The tool does nothing if just one process is running.
+ */
+class Halo : public Aqua::CalcServer::Tool
+{
+public:
+    /** @brief Constructor.
+     * @param name Tool name.
+     * @param fields Comma separated list of the fields to be exchanged. "r",
+     * "imove" and "iset" are always exchanged.
+     * @param set Particles set where the halo particles are stored.
+     * @param bounds Expression of the domain x bounds, which are split in as
+     * many slabs as processes.
+     * @param once Run this tool just once. Useful to make initializations.
+     */
+    Halo(const std::string name,
+         const std::string fields,
+         unsigned int set,
+         const std::string bounds,
+         bool once=false);
+
+    /// Destructor.
+    ~Halo();
+
+    /** @brief Initialize the tool.
+     */
+    void setup();
+
+protected:
+    /** @brief Perform the work.
+     */
+    void _execute();
+
+private:
+    /** @brief Get the fields variables.
+     */
+    void variables();
+
+    /** @brief Create the OpenCL kernels.
+     */
+    void setupOpenCL();
+
+    /** @brief Allocate the memory object where the fields of the particles
+     * to send or receive are stored.
+     * @param data_size Size of the memory object, in bytes.
+     */
+    void allocate(size_t data_size);
+
+    /** @brief Look for the particles to send, and the slots where the
+     * received ones can be stored.
+     * @param neigh 1 if there is a neighbour process at the left and right
+     * sides, 0 otherwise.
+     * @param n_ids Number of particles to send to the left and right
+     * processes, followed by the number of buffer and halo slots.
+     */
+    void findParticles(const uivec2 neigh, unsigned int *n_ids);
+
+    /** @brief Gather or scatter the fields of a list of particles.
+     *
+     * The particles are read from the ids memory object, and the fields are
+     * consecutively stored in the data memory object.
+     * @param kernel Either the gathering or the scattering kernel.
+     * @param n Number of particles.
+     */
+    void transfer(cl_kernel kernel, unsigned int n);
+
+    /** @brief Set a kernel argument.
+     * @param kernel Kernel.
+     * @param index Argument index.
+     * @param size Argument size.
+     * @param value Argument value.
+     */
+    void setArg(cl_kernel kernel,
+                cl_uint index,
+                size_t size,
+                const void *value);
+
+    /** @brief Launch a kernel.
+     * @param kernel Kernel.
+     * @param n Number of threads.
+     */
+    void launch(cl_kernel kernel, size_t n);
+
+    /** @brief Copy data between the host and the computational device.
+     * @param mem Memory object.
+     * @param write true to upload the data, false to download it.
+     * @param blocking true if the host should wait for the transfer to be
+     * completed, false otherwise.
+     * @param offset Offset in the memory object, in bytes.
+     * @param size Size of the data, in bytes.
+     * @param ptr Host data.
+     */
+    void copy(cl_mem mem,
+              bool write,
+              bool blocking,
+              size_t offset,
+              size_t size,
+              void *ptr);
+
+    /// Fields to exchange names
+    std::vector<std::string> _fields_names;
+
+    /// Fields to exchange
+    std::vector<InputOutput::VariableRef> _fields;
+
+    /// Size of each field value in the computational device
+    std::vector<unsigned int> _typesizes;
+
+    /// Size of a particle record, i.e. the sum of the fields type sizes
+    size_t _record_size;
+
+    /// Position of "iset" in the list of fields
+    unsigned int _iset_field;
+
+    /// Halo particles set
+    unsigned int _set;
+
+    /// Domain bounds expression
+    std::string _bounds;
+
+    /// Domain x bounds
+    vec2 _x;
+
+    /// Number of particles
+    unsigned int _n;
+
+    /// true if the particles out of the slab have been already removed
+    bool _decomposed;
+
+    /// Border cells kernel
+    cl_kernel _border;
+
+    /// Free slots kernel
+    cl_kernel _slots;
+
+    /// Particles removal kernel
+    cl_kernel _remove;
+
+    /// Fields gathering kernel
+    cl_kernel _gather;
+
+    /// Fields scattering kernel
+    cl_kernel _scatter;
+
+    /// Local work size of the kernels
+    size_t _lws;
+
+    /// Variables bound to the kernels
+    ExecutionPlan _plan;
+
+    /// Particles to send, or where the received ones are stored
+    cl_mem _ids_mem;
+
+    /// Slots where the received particles can be stored
+    cl_mem _slots_mem;
+
+    /// Number of particles to send, and number of slots
+    cl_mem _n_ids_mem;
+
+    /// Fields of the particles to send or receive
+    cl_mem _data_mem;
+
+    /// Size of the fields data memory object, in bytes
+    size_t _data_size;
+
+    /// Host copy of the particles where the received ones are stored
+    std::vector<unsigned int> _ids;
+
+    /// Host copy of the fields of the particles to send or receive
+    std::vector<char> _data;
+};
+
+}}  // namespace
+
+#endif // HALO_H_INCLUDED
@@ -29,12 +29,21 @@
 #include <vector>
 #include <CL/cl.h>
 #include <CalcServer/Tool.h>
+#include <CalcServer/ExecutionPlan.h>
 
 namespace Aqua{ namespace CalcServer{
 
 /** @class Kernel Kernel.h CalcServer/Kernel.h
  * @brief A tool consisting in an OpenCL kernel execution. The variables used
  * in the OpenCL kernel are automatically detected.
+ *
+ * If autotuning is enabled (see
+ * Aqua::InputOutput::ProblemSetup::sphSettings::autotune), the first
+ * executions are timing the kernel with several work group sizes, both with
+ * and without local memory, locking the fastest combination afterwards. The
+ * result is stored in a tuning database, keyed by the device, the source
+ * code and the number of threads, such that the following runs are not
+ * repeating the process.
  */
 class Kernel : public Aqua::CalcServer::Tool
 {
@@ -75,7 +84,64 @@ public:
      */
     size_t globalWorkSize() const {return _global_work_size;}
 
+    /** Get the kernel entry point.
+     * @return Program entry point method.
+     */
+    const std::string entryPoint() const {return _entry_point;}
+
+    /** Get the number of threads expression.
+     * @return Number of threads expression.
+     */
+    const std::string n() const {return _n;}
+
+    /** @brief Get the number of threads.
+     *
+     * The expression is evaluated again just if its variables have changed
+     * (see nChanged()).
+     * @return Number of threads.
+     */
+    unsigned int nThreads();
+
+    /** Get the source code.
+     * @return Source code, including the header.
+     */
+    const std::string source() const {return _source;}
+
+    /** Get the compilation flags.
+     * @return Compilation flags, without local memory.
+     */
+    const std::string flags() const {return _flags;}
+
+    /** Get the variables required by the program.
+     * @return Kernel arguments names.
+     */
+    const std::vector<std::string> varNames() const {return _var_names;}
+
+    /** Get the constant (read only) flags of the required variables.
+     * @return Kernel arguments constant flags.
+     */
+    const std::vector<bool> varConsts() const {return _var_consts;}
+
+    /** Get the address space qualifiers of the required variables.
+     * @return Kernel arguments address space qualifiers.
+     */
+    const std::vector<cl_kernel_arg_address_qualifier> varAddresses() const
+    {
+        return _var_addresses;
+    }
+
+    /** Get the argument type names of the required variables.
+     * @return Kernel arguments type names, empty strings if they cannot be
+     * known.
+     */
+    const std::vector<std::string> varTypes() const {return _var_types;}
+
 protected:
+    /** @brief Compile the kernel and parse its arguments, which can be done
+     * in parallel with the other tools.
+     */
+    void _prepare();
+
     /** Execute the tool.
      * @return false if all gone right, true otherwise.
      */
@@ -92,22 +158,124 @@ protected:
                  const std::string flags="",
                  const std::string header="");
 
-    /** Compute the variables required by the program
+    /** @brief Compute the variables required by the program.
+     *
+     * The arguments are queried to the OpenCL implementation (see
+     * argsInfo()). If the information is not available, e.g. the program
+     * has been loaded from binaries, the source code file is parsed, just
+     * once for all the entry points.
      * @param entry_point Program entry point method.
-     * @return false if all gone right, true otherwise.
      */
     void variables(const std::string entry_point="main");
 
-    /** @brief Set the variables to the OpenCL kernel.
-     * 
-     * The method detects if a variable should be updated or if it already set either.
+    /** @brief Get the kernel arguments names and qualifiers from the OpenCL
+     * implementation.
+     * @return true if the arguments have been got, false if the information
+     * is not available.
+     */
+    bool argsInfo();
+
+    /** @brief Bind the variables to the OpenCL kernel arguments.
+     *
+     * The arguments are afterwards updated by the execution plan, just when
+     * the variables are modified.
      */
     void setVariables();
 
+    /** @brief Check that an array argument is declared with the storage of
+     * its variable, i.e. native, half precision or packed.
+     *
+     * The check is just carried out if the argument type is reported by the
+     * OpenCL implementation.
+     * @param i Argument index.
+     */
+    void checkStorage(unsigned int i);
+
+    /** @brief Report the variables read and written by the kernel.
+     *
+     * The arrays which are not declared as constant in the kernel arguments
+     * are considered outputs.
+     */
+    void computeDependencies();
+
     /** Compute the global work size
+     *
+     * The variables used in the number of threads expression are stored,
+     * such that the global work size is computed again just when they
+     * change (see nChanged()).
      */
     void computeGlobalWorkSize();
 
+    /** @brief Check whether the variables used in the number of threads
+     * expression have changed since the last global work size computation.
+     * @return true if the global work size should be computed again, false
+     * otherwise.
+     */
+    bool nChanged();
+
+    /** @brief Enqueue the kernel.
+     */
+    void enqueue();
+
+    /** @brief Execute the kernel distributing the work groups in the devices
+     * (see Aqua::CalcServer::CalcServer::nDomains()).
+     *
+     * Each device is executing a slab of consecutive work groups. The
+     * devices are waiting for the commands previously enqueued in the
+     * selected device, which will wait for all of them in return.
+     *
+     * The global work offset is just applied to get_global_id(), so the
+     * kernels calling get_group_id(), get_num_groups(), get_global_size() or
+     * get_global_offset() are not split, but executed by the selected device.
+     */
+    void executeDomains();
+
+    /** @brief Build the source code with additional flags.
+     * @param flags Compiling flags.
+     * @param work_group_size Work group size which should be supported by
+     * the kernel.
+     * @return The kernel, NULL if it cannot be built, or it is not
+     * supporting the requested work group size.
+     */
+    cl_kernel build(const std::string flags, size_t work_group_size);
+
+    /** @brief Setup the autotuning.
+     *
+     * If the tuning database already has a result, it is directly applied.
+     * Otherwise the candidates are built to be tested along the first
+     * executions.
+     */
+    void setupAutotune();
+
+    /** @brief Execute and time the current autotuning candidate.
+     */
+    void autotune();
+
+    /** @brief Select a work group size and local memory usage combination.
+     * @param kernel OpenCL kernel.
+     * @param work_group_size Work group size.
+     */
+    void select(cl_kernel kernel, size_t work_group_size);
+
+    /** @brief Release the kernels of the autotuning candidates.
+     * @param keep Kernel which should not be released.
+     */
+    void releaseCandidates(cl_kernel keep);
+
+    /** @brief Look for the autotuning result in the tuning database.
+     * @param local Filled with true if the local memory should be used,
+     * false otherwise.
+     * @param work_group_size Filled with the work group size.
+     * @return true if the result has been found, false otherwise.
+     */
+    bool loadTuning(bool &local, size_t &work_group_size);
+
+    /** @brief Store the autotuning result in the tuning database.
+     * @param local true if the local memory should be used, false otherwise.
+     * @param work_group_size Work group size.
+     */
+    void saveTuning(bool local, size_t work_group_size);
+
 private:
     /// Kernel path
     std::string _path;
@@ -127,10 +295,57 @@ private:
     /// global work size
     size_t _global_work_size;
 
+    /// Number of threads, i.e. the evaluated number of threads expression
+    unsigned int _n_threads;
+
+    /// Variables used in the number of threads expression
+    std::vector<InputOutput::VariableRef> _n_vars;
+
+    /// Versions of the variables when the global work size was computed
+    std::vector<unsigned int> _n_versions;
+
+    /// Source code, including the header
+    std::string _source;
+
+    /// Compilation flags, without local memory
+    std::string _flags;
+
+    /// true if the kernel can be split in slabs (see executeDomains())
+    bool _domains;
+
+    /// Autotuning candidate
+    typedef struct {
+        /// OpenCL kernel
+        cl_kernel kernel;
+        /// true if the kernel is using local memory
+        bool local;
+        /// Work group size
+        size_t work_group_size;
+        /// Accumulated elapsed time
+        float time;
+        /// Number of executions
+        unsigned int samples;
+    } tuneCandidate;
+
+    /// Autotuning candidates, empty if the autotuning is not running
+    std::vector<tuneCandidate> _candidates;
+
+    /// Autotuning candidate being tested
+    unsigned int _candidate;
+
+    /// Tuning database key
+    std::string _tuning_key;
+
     /// List of required variables
     std::vector<std::string> _var_names;
-    /// List of variable values
-    std::vector<void*> _var_values;
+    /// List of constant (read only) flags for the required variables
+    std::vector<bool> _var_consts;
+    /// List of address space qualifiers for the required variables
+    std::vector<cl_kernel_arg_address_qualifier> _var_addresses;
+    /// List of argument type names, empty if they cannot be known
+    std::vector<std::string> _var_types;
+    /// Kernel arguments execution plan
+    ExecutionPlan _plan;
 };
 
 }}  // namespace
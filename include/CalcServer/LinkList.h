@@ -31,6 +31,7 @@
 #include <CalcServer/Tool.h>
 #include <CalcServer/Reduction.h>
 #include <CalcServer/RadixSort.h>
+#include <CalcServer/ExecutionPlan.h>
 
 namespace Aqua{ namespace CalcServer{
 
@@ -42,6 +43,30 @@ namespace Aqua{ namespace CalcServer{
  *   -# "ihoc" array allocation
  *   -# "ihoc" and "icell" calculations
  *   -# Radix sort of "icell", computing permutation array "id_sorted" and "id_unsorted" as well.
+ *
+ * If the "imove" array is declared, the inactive particles (imove <= -255,
+ * i.e. the buffer and removed ones) are sorted after the active ones, and the
+ * number of active particles is stored in the variable "N_active". Such
+ * value is downloaded without blocking, and is available from the next time
+ * step, so the tools can launch just the active particles by means of their
+ * number of threads expression (e.g. n="N_active") if the particles are not
+ * activated between the link-list and their execution.
+ *
+ * If HAVE_MORTON_CELLS is defined (see
+ * resources/Presets/basic/mortonCells.xml), the cells are grouped in tiles of
+ * 8x8x8 cells (16x16 in 2D), which are numbered along a Morton (Z-order)
+ * curve, such that the particles of neighbour cells are closer in memory
+ * after the sort.
+ *
+ * If the variable "incremental_sort_max" is declared (see
+ * resources/Presets/basic/incrementalSort.xml), the full radix sort is just
+ * carried out if the number of cells has changed, or if more than
+ * incremental_sort_max particles have changed of cell since the last time
+ * step. Otherwise, since the rest of particles are already sorted, just the
+ * particles which have changed of cell are sorted, and merged with the rest,
+ * resulting in the same permutations provided by the radix sort. Hence, the
+ * particles should be sorted after each link-list execution (see
+ * resources/Scripts/basic/Sort.cl).
  * @note Hardcoded versions of the files CalcServer/LinkList.cl.in and
  * CalcServer/LinkList.hcl.in are internally included as a text array.
  */
@@ -65,6 +90,11 @@ public:
      */
     void setup();
 
+    /** @brief Update the number of active particles, if it has been already
+     * downloaded.
+     */
+    void synchronize();
+
 protected:
     /** Execute the tool.
      */
@@ -88,9 +118,22 @@ private:
      */
     void allocate();
 
-    /** Update the input and output looking for changed values.
+    /** Allocate the memory objects of the incremental sort, and send the
+     * fixed arguments to its kernels.
      */
-    void setVariables();
+    void setupIncremental();
+
+    /** Look for the particles which have changed of cell since the last time
+     * step.
+     * @return true if the incremental sort can be applied, false if a full
+     * radix sort is required.
+     */
+    bool changedCells();
+
+    /** Sort the particles which have changed of cell, and merge them with the
+     * rest of particles, which are already sorted.
+     */
+    void incrementalSort();
 
     /// Input variable name
     std::string _input_name;
@@ -101,6 +144,56 @@ private:
     /// Number of cells
     uivec4 _n_cells;
 
+    /// Minimum position variable
+    InputOutput::VariableRef _r_min_var;
+    /// Maximum position variable
+    InputOutput::VariableRef _r_max_var;
+    /// Number of cells variable
+    InputOutput::VariableRef _n_cells_var;
+    /// Head of chains variable
+    InputOutput::VariableRef _ihoc_var;
+    /// Number of active particles variable
+    InputOutput::VariableRef _n_active_var;
+
+    /// true if the inactive particles can be detected with "imove"
+    bool _has_imove;
+
+    /// true if the cells are numbered along a tiled Morton curve
+    bool _morton;
+
+    /// Maximum number of particles changing of cell to apply the incremental
+    /// sort, 0 if it is disabled
+    unsigned int _incremental_max;
+    /// Number of keys to sort
+    unsigned int _n_radix;
+    /// Cells variable
+    InputOutput::VariableRef _icell_var;
+    /// Sorted cells of the last time step
+    cl_mem _icell_prev;
+    /// true if _icell_prev is holding the sorted cells of the last time step
+    bool _icell_prev_valid;
+    /// Number of cells of the last time step
+    uivec4 _n_cells_prev;
+    /// Sorted cells, before being copied to "icell"
+    cl_mem _icell_sorted;
+    /// Particles which have changed of cell
+    cl_mem _moved;
+    /// Particles which have changed of cell, sorted by cell
+    cl_mem _moved_ids;
+    /// Cells of the particles which have changed of cell, sorted by cell
+    cl_mem _moved_keys;
+    /// Particles which have changed of cell, sorted by index
+    cl_mem _moved_idx;
+    /// Number of particles which have changed of cell
+    cl_mem _n_moved_mem;
+    /// Downloaded number of particles which have changed of cell
+    unsigned int _n_moved;
+
+    /// Downloaded number of active particles
+    unsigned int _n_active;
+    /// Number of active particles download event
+    cl_event _n_active_event;
+
     /// Minimum position computation tool
     Reduction *_min_pos;
 
@@ -116,8 +209,6 @@ private:
     size_t _ihoc_lws;
     /// "ihoc" array initialization global work size
     size_t _ihoc_gws;
-    /// "ihoc" array initialization sent arguments
-    std::vector<void*> _ihoc_args;
 
     /// "icell" array computation
     cl_kernel _icell;
@@ -125,8 +216,6 @@ private:
     size_t _icell_lws;
     /// "icell" array computation global work size
     size_t _icell_gws;
-    /// "icell" array computation sent arguments
-    std::vector<void*> _icell_args;
 
     /// "ihoc" array computation
     cl_kernel _ll;
@@ -134,8 +223,33 @@ private:
     size_t _ll_lws;
     /// "ihoc" array computation global work size
     size_t _ll_gws;
-    /// "ihoc" array computation sent arguments
-    std::vector<void*> _ll_args;
+
+    /// Changed cells detection
+    cl_kernel _changed;
+    /// Changed cells detection local work size
+    size_t _changed_lws;
+    /// Changed cells detection global work size
+    size_t _changed_gws;
+
+    /// Changed particles sorting
+    cl_kernel _rank;
+    /// Changed particles sorting local work size
+    size_t _rank_lws;
+
+    /// Unchanged particles merging
+    cl_kernel _merge;
+    /// Unchanged particles merging local work size
+    size_t _merge_lws;
+    /// Unchanged particles merging global work size
+    size_t _merge_gws;
+
+    /// Changed particles merging
+    cl_kernel _merge_moved;
+    /// Changed particles merging local work size
+    size_t _merge_moved_lws;
+
+    /// Kernels arguments execution plan
+    ExecutionPlan _plan;
 };
 
 }}  // namespace
@@ -0,0 +1,202 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Device memory pool.
+ * (See Aqua::CalcServer::MemoryPool for details)
+ */
+
+#ifndef MEMORYPOOL_H_INCLUDED
+#define MEMORYPOOL_H_INCLUDED
+
+#include <CL/cl.h>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <sphPrerequisites.h>
+
+namespace Aqua{ namespace CalcServer{
+
+/** @class MemoryPool MemoryPool.h CalcServer/MemoryPool.h
+ * @brief Central allocator of the device memory.
+ *
+ * The persistent memory objects (see allocate()) are sub-buffers carved from
+ * large chunks, which are geometrically grown when they become exhausted, so
+ * the number of actual device allocations remains low along the simulation.
+ * The memory is given back to the pool when the sub-buffer is released with
+ * clReleaseMemObject(), as usual.
+ *
+ * The scratch memory objects (see scratch()) are just used by the tools
+ * within their execution, so the ones requested by different tools are
+ * sharing the same device memory. That is just possible if all the tools are
+ * executed in a single command queue, otherwise the scratch memory objects
+ * are persistent ones.
+ *
+ * All the memory allocated by the pool is reported by allocatedMemory().
+ */
+class MemoryPool
+{
+public:
+    /** @brief Constructor.
+     * @param context OpenCL context.
+     * @param share_scratch true if the scratch memory can be shared between
+     * the tools, i.e. they are never executed at the same time, false
+     * otherwise.
+     */
+    MemoryPool(cl_context context, bool share_scratch=true);
+
+    /// Destructor.
+    ~MemoryPool();
+
+    /** @brief Allocate a persistent memory object.
+     * @param size Memory object size, in bytes.
+     * @param err_code Returning error code.
+     * @return The memory object, NULL if it cannot be allocated.
+     */
+    cl_mem allocate(size_t size, cl_int *err_code);
+
+    /** @brief Allocate a memory object which is not carved from the chunks,
+     * so it can be split in sub-buffers.
+     * @param size Memory object size, in bytes.
+     * @param err_code Returning error code.
+     * @return The memory object, NULL if it cannot be allocated.
+     */
+    cl_mem dedicated(size_t size, cl_int *err_code);
+
+    /** @brief Allocate a scratch memory object.
+     *
+     * The scratch memory objects of the same owner are never overlapping,
+     * while the ones of different owners may share the memory.
+     * @param owner Owner of the memory object, usually the tool.
+     * @param size Memory object size, in bytes.
+     * @param err_code Returning error code.
+     * @return The memory object, NULL if it cannot be allocated.
+     */
+    cl_mem scratch(const void *owner, size_t size, cl_int *err_code);
+
+    /** @brief Forget the scratch memory objects of an owner.
+     *
+     * It should be called after releasing them, before asking new ones.
+     * @param owner Owner of the memory objects.
+     */
+    void releaseScratch(const void *owner);
+
+    /** @brief Get the capacity to allocate when a memory object should grow.
+     *
+     * The capacity grows geometrically, so the memory objects which are
+     * slowly growing (e.g. "ihoc" when the domain grows) are not reallocated
+     * every time step.
+     * @param required Required size.
+     * @param current Current capacity.
+     * @return New capacity.
+     */
+    static size_t capacity(size_t required, size_t current);
+
+    /** @brief Get the device memory allocated by the pool.
+     * @return Allocated memory, in bytes.
+     */
+    size_t allocatedMemory() const {return _allocated;}
+
+    /// Memory object allocated by the pool
+    typedef struct {
+        /// Pool, NULL if it has been already destroyed
+        MemoryPool *pool;
+        /// Chunk index, -1 for the actual device memory objects
+        int chunk;
+        /// Offset in the chunk
+        size_t offset;
+        /// Size
+        size_t size;
+    } poolRegion;
+
+    /** @brief Give back the memory of a released memory object.
+     *
+     * It is called from the memory objects destructor callback, with the
+     * pools mutex already locked.
+     * @param region Released region.
+     */
+    void released(poolRegion *region);
+
+private:
+    /** @brief Create an actual device memory object.
+     * @param size Memory object size, in bytes.
+     * @param err_code Returning error code.
+     * @return The memory object, NULL if it cannot be allocated.
+     */
+    cl_mem create(size_t size, cl_int *err_code);
+
+    /** @brief Carve a sub-buffer from a chunk.
+     * @param chunk Chunk index.
+     * @param size Sub-buffer size, in bytes.
+     * @param err_code Returning error code.
+     * @return The sub-buffer, NULL if the chunk has not enough room.
+     */
+    cl_mem carve(unsigned int chunk, size_t size, cl_int *err_code);
+
+    /** @brief Create a sub-buffer.
+     * @param parent Parent memory object.
+     * @param offset Sub-buffer offset.
+     * @param size Sub-buffer size.
+     * @param err_code Returning error code.
+     * @return The sub-buffer, NULL if it cannot be created.
+     */
+    cl_mem sub(cl_mem parent, size_t offset, size_t size, cl_int *err_code);
+
+    /// OpenCL context
+    cl_context _context;
+
+    /// true if the scratch memory can be shared between the tools
+    bool _share_scratch;
+
+    /// Sub-buffers alignment, in bytes
+    size_t _align;
+
+    /// Maximum size of a single device allocation
+    size_t _max_alloc;
+
+    /// Allocated memory
+    size_t _allocated;
+
+    /// Memory chunk
+    typedef struct {
+        /// Memory object
+        cl_mem mem;
+        /// Free regions, by offset
+        std::map<size_t, size_t> free;
+    } memChunk;
+
+    /// Chunks
+    std::vector<memChunk> _chunks;
+
+    /// Scratch memory
+    cl_mem _scratch;
+
+    /// Scratch memory size
+    size_t _scratch_size;
+
+    /// Scratch memory used by each owner
+    std::map<const void*, size_t> _scratch_used;
+
+    /// Memory objects which have not been released yet
+    std::set<poolRegion*> _regions;
+};
+
+}}  // namespace
+
+#endif // MEMORYPOOL_H_INCLUDED
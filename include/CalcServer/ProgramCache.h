@@ -0,0 +1,188 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief On-disk cache of compiled OpenCL programs.
+ * (See Aqua::CalcServer::ProgramCache for details)
+ */
+
+#ifndef PROGRAMCACHE_H_INCLUDED
+#define PROGRAMCACHE_H_INCLUDED
+
+#include <CL/cl.h>
+#include <pthread.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <sphPrerequisites.h>
+
+namespace Aqua{ namespace CalcServer{
+
+/** @class ProgramCache ProgramCache.h CalcServer/ProgramCache.h
+ * @brief On-disk cache of compiled OpenCL programs.
+ *
+ * The programs are created with create() and built with build(), which are
+ * replacing clCreateProgramWithSource() and clBuildProgram() respectively.
+ * The binaries of the built programs are stored in the cache folder, such
+ * that the next time the same program is requested, it is created from the
+ * binaries, which is way faster to build.
+ *
+ * The programs are identified by the context devices names and driver
+ * versions, the source code, including the files recursively included by
+ * means of the "-I" folders, and the compilation flags. Hence, the cache is
+ * automatically invalidated when any of them changes.
+ *
+ * Along with the on-disk cache, the built programs are registered in memory
+ * by get(), such that the tools using the same source code file with the
+ * same flags, but different entry points, are sharing a single program.
+ *
+ * The cache can be simultaneously used by several threads.
+ */
+class ProgramCache
+{
+public:
+    /** @brief Constructor.
+     * @param context OpenCL context.
+     * @param path Cache folder. If it is an empty string, the cache is
+     * disabled.
+     */
+    ProgramCache(cl_context context, const std::string path);
+
+    /// Destructor.
+    ~ProgramCache();
+
+    /** @brief Create a program.
+     *
+     * The program is created from the cached binaries if they are
+     * available, and from the source code otherwise.
+     * @param source Source code.
+     * @param flags Compilation flags, which will be passed to build().
+     * @param err_code Returning error code.
+     * @return The OpenCL program.
+     */
+    cl_program create(const std::string source,
+                      const std::string flags,
+                      cl_int *err_code);
+
+    /** @brief Build a program created with create().
+     *
+     * If the program has been created from the source code, the resulting
+     * binaries are stored in the cache.
+     * @param program OpenCL program.
+     * @param flags Compilation flags.
+     * @return The clBuildProgram() error code.
+     */
+    cl_int build(cl_program program, const std::string flags);
+
+    /** @brief Get a built program, compiling it just if it has not been
+     * already requested with the same source code and flags.
+     *
+     * The programs are created and built by means of create() and build().
+     * @param source Source code.
+     * @param flags Compilation flags.
+     * @param err_code Returning error code. If the program cannot be built,
+     * the clBuildProgram() error code is returned along with the program,
+     * such that the building log can be queried.
+     * @return The OpenCL program, NULL if it cannot be created. The program
+     * should be released by the caller.
+     */
+    cl_program get(const std::string source,
+                   const std::string flags,
+                   cl_int *err_code);
+
+    /** @brief Release the registered programs.
+     *
+     * The programs are still alive while their kernels are in use, so this
+     * can be called as soon as all the tools have been set up.
+     */
+    void release();
+
+private:
+    /** @brief Get the source code of the files included by a source code.
+     * @param source Source code.
+     * @param folder Folder of the source code file, where the included files
+     * are looked for first.
+     * @param paths Include folders.
+     * @param visited Already included files, which are not parsed again.
+     * @return Included source codes, concatenated.
+     */
+    std::string includes(const std::string source,
+                         const std::string folder,
+                         const std::vector<std::string> &paths,
+                         std::set<std::string> &visited);
+
+    /** @brief Get the cache file of a program.
+     * @param source Source code.
+     * @param flags Compilation flags.
+     * @return Cache file path.
+     */
+    std::string file(const std::string source, const std::string flags);
+
+    /** @brief Load the binaries of a program.
+     * @param path Cache file path.
+     * @param err_code Returning error code.
+     * @return The OpenCL program, NULL if the binaries cannot be loaded.
+     */
+    cl_program load(const std::string path, cl_int *err_code);
+
+    /** @brief Store the binaries of a program.
+     * @param program OpenCL program.
+     * @param path Cache file path.
+     */
+    void save(cl_program program, const std::string path);
+
+    /// OpenCL context
+    cl_context _context;
+
+    /// Context devices
+    std::vector<cl_device_id> _devices;
+
+    /// Cache folder
+    std::string _path;
+
+    /// Devices identifier
+    std::string _devices_id;
+
+    /// Cache files of the programs created from source
+    std::map<cl_program, std::string> _pending;
+
+    /// Mutex to access the programs created from source, and the files
+    pthread_mutex_t _mutex;
+
+    /// Registered program
+    typedef struct {
+        /// OpenCL program, NULL until it is created
+        cl_program program;
+        /// Error code of the creation and building
+        cl_int err_code;
+        /// Mutex to create and build the program just once
+        pthread_mutex_t mutex;
+    } registeredProgram;
+
+    /// Registered programs, by source code and flags
+    std::map<std::pair<std::string, std::string>, registeredProgram*> _programs;
+
+    /// Mutex to access the registered programs
+    pthread_mutex_t _programs_mutex;
+};
+
+}}  // namespace
+
+#endif // PROGRAMCACHE_H_INCLUDED
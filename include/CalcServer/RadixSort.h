@@ -31,13 +31,15 @@
 #include <CalcServer.h>
 #include <CalcServer/Tool.h>
 
-/** @def _ITEMS Number of items in a group
+/** @def _ITEMS Maximum number of items in a group
  * @note Must be power of 2, and in some devices greather than 32.
+ * @note The actual number of items is selected at runtime, depending on the
+ * kernels and the device limits.
  */
 #ifndef _ITEMS
     #define _ITEMS  128
 #endif
-/** @def _GROUPS Number of groups (data must be divisible of _ITEMS*_GROUPS)
+/** @def _GROUPS Maximum number of groups
  * @note Must be power of 2
  */
 #ifndef _GROUPS
@@ -47,15 +49,17 @@
 #ifndef __UINTBITS__
     #define __UINTBITS__ 32
 #endif
-/// @def _STEPBITS Bits that be sorted in each pass
-#ifndef _STEPBITS
-    #define _STEPBITS 4
+/** @def _MAXSTEPBITS Maximum bits that be sorted in each pass
+ * @note The actual number of bits, the largest divisor of __UINTBITS__
+ * between 4 and this value (i.e. 8 or 4), is selected at runtime depending on
+ * the available local memory. Set it to 4 to force the narrow digits.
+ */
+#ifndef _MAXSTEPBITS
+    #define _MAXSTEPBITS 8
 #endif
-/// @def _RADIX Bits that be sorted in each pass
-#define _RADIX (1 << _STEPBITS)
 /** @def _HISTOSPLIT Number of splits of the histogram
- * @remarks (_GROUPS * _ITEMS * _RADIX) % _HISTOSPLIT must be equal to zero
- * @remarks (2 * _HISTOSPLIT) % _RADIX must be equal to zero
+ * @remarks (_GROUPS * _ITEMS * radix) % _HISTOSPLIT must be equal to zero
+ * @remarks (2 * _HISTOSPLIT) % radix must be equal to zero
  * @remarks Must be power of 2, and in some devices greather than 64.
  */
 #ifndef _HISTOSPLIT
@@ -73,10 +77,6 @@
     #undef _HISTOSPLIT
     #define _HISTOSPLIT 2*__CL_MIN_LOCALSIZE__
 #endif
-#if _RADIX*_GROUPS*_ITEMS/2/_HISTOSPLIT < __CL_MIN_LOCALSIZE__
-    #undef _GROUPS
-    #define _GROUPS 2*__CL_MIN_LOCALSIZE__*_HISTOSPLIT / (_RADIX*_ITEMS)
-#endif
 
 namespace Aqua{ namespace CalcServer{
 
@@ -89,6 +89,13 @@ namespace Aqua{ namespace CalcServer{
  *   -# Permut the variables.
  * To learn more about this code, please see also
  * http://code.google.com/p/ocl-radix-sort/updates/list.
+ *
+ * The keys array may have any length, i.e. it is not required to be a power
+ * of 2, or a multiple of the number of threads. The number of bits sorted on
+ * each pass (8 or 4), as well as the number of items and groups, are selected
+ * at runtime from the device limits. The number of passes is computed from
+ * the maximum key, which for "icell" is known from "n_cells", and is computed
+ * in the device otherwise.
  * @note Hardcoded versions of the files CalcServer/RadixSort.cl.in and
  * CalcServer/RadixSort.hcl.in are internally included as a text array.
  */
@@ -143,6 +150,13 @@ private:
      */
     void inversePermutations();
 
+    /** Compute the maximum key.
+     * @return Maximum key value.
+     * @note This method is blocking the host until the maximum key is
+     * available.
+     */
+    unsigned int maxKey();
+
     /** Get the variables to compute.
      */
     void variables();
@@ -151,13 +165,19 @@ private:
      */
     void setupOpenCL();
 
+    /** Select the number of bits sorted on each pass, _bits, from the
+     * available local memory.
+     */
+    void setupBits();
+
     /** Compile the source code and generate the corresponding kernels
      * @param source Source code to compile.
      */
     void compile(const std::string source);
 
     /** Setup the main computing dimensions _items, _groups and _histo_split
-     * from the valid local work sizes per each kernel.
+     * from the valid local work sizes per each kernel, and the available
+     * local memory.
      */
     void setupDims();
 
@@ -179,13 +199,13 @@ private:
     std::string _inv_perms_name;
 
     /// Variable to sort
-    InputOutput::ArrayVariable *_var;
+    InputOutput::ArrayVariableRef _var;
 
     /// Permutations array
-    InputOutput::ArrayVariable *_perms;
+    InputOutput::ArrayVariableRef _perms;
 
     /// Inverse permutations array
-    InputOutput::ArrayVariable *_inv_perms;
+    InputOutput::ArrayVariableRef _inv_perms;
 
     /// Number of keys to sort
     unsigned int _n;
@@ -202,6 +222,8 @@ private:
     cl_kernel _sort_kernel;
     /// OpenCL reverse permutations kernel
     cl_kernel _inv_perms_kernel;
+    /// OpenCL maximum key kernel
+    cl_kernel _max_key_kernel;
 
     /// Input keys
     cl_mem _in_keys;
@@ -217,6 +239,8 @@ private:
     cl_mem _global_sums;
     /// Temporal memory
     cl_mem _temp_mem;
+    /// Maximum key
+    cl_mem _max_key;
 
     /// Number of items in a group
     unsigned int _items;
@@ -231,11 +255,17 @@ private:
 
     /// Key bits (maximum)
     unsigned int _key_bits;
-    /// Needed radix pass (_key_bits / _STEPBITS)
+    /// Needed radix pass (_key_bits / _bits)
     unsigned int _n_pass;
     /// Pass of the radix decomposition
     unsigned int _pass;
 
+    /// Number of cells, used to limit the keys when sorting "icell"
+    InputOutput::VariableRef _n_cells_var;
+
+    /// Local memory available in the device
+    cl_ulong _local_mem_size;
+
     /// Maximum local work size allowed by the device
     size_t _local_work_size;
     /// Global work size (assuming the maximum local work size) to compute _n threads.
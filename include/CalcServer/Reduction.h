@@ -44,7 +44,14 @@ public:
     /** @brief Reduction definition.
      * @param name Tool name.
      * @param input_name Variable to be reduced name.
-     * @param output_name Variable where the reduced value will be stored.
+     * @param output_name Variable where the reduced value will be stored. If
+     * it is an array, the reduced value is stored in its first component,
+     * i.e. it is kept in the computational device. Otherwise the value is
+     * asynchronously downloaded, and the host will just wait for it when it
+     * is actually required (see Aqua::InputOutput::Variable::setEvent()).
+     * Meanwhile, the kernels declaring the scalar as a pointer argument can
+     * read it straight from the computational device (see
+     * Aqua::InputOutput::Variable::setDeviceMem()).
      * @param operation The reduction operation.
      * For instance:
      *   - "c += b;"
@@ -108,9 +115,15 @@ private:
     /** @brief Compile the source code and generate the corresponding kernel.
      * @param source Source code to be compiled.
      * @param local_work_size Desired local work size.
+     * @param storage Storage of the input array, "half", "packed" or an
+     * empty string for the native one. Just the first reduction step is
+     * reading the input variable, while the rest of steps are reading the
+     * intermediate native results.
      * @return Kernel instance.
      */
-    cl_kernel compile(const std::string source, size_t local_work_size);
+    cl_kernel compile(const std::string source,
+                      size_t local_work_size,
+                      const std::string storage="");
 
     /** Update the input variables.
      *
@@ -129,9 +142,9 @@ private:
     std::string _null_val;
 
     /// Input variable
-    InputOutput::ArrayVariable *_input_var;
+    InputOutput::ArrayVariableRef _input_var;
     /// Output variable
-    InputOutput::Variable *_output_var;
+    InputOutput::VariableRef _output_var;
 
     /// Input array
     cl_mem _input;
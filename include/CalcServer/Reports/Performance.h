@@ -109,6 +109,19 @@ private:
     bool _first_execution;
     /// Output file handler
     std::ofstream _f;
+
+    /// Time variable
+    InputOutput::VariableRef _t_var;
+    /// Maximum time variable
+    InputOutput::VariableRef _end_t_var;
+    /// Time step variable
+    InputOutput::VariableRef _iter_var;
+    /// Maximum time step variable
+    InputOutput::VariableRef _end_iter_var;
+    /// Frame variable
+    InputOutput::VariableRef _frame_var;
+    /// Maximum frame variable
+    InputOutput::VariableRef _end_frame_var;
 };
 
 }}} // namespace
@@ -120,6 +120,9 @@ private:
     std::string _output_file;
     /// Output file handler
     std::ofstream _f;
+
+    /// Time variable
+    InputOutput::VariableRef _time_var;
 };
 
 }}} // namespace
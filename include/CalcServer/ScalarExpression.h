@@ -0,0 +1,183 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Evaluate a scalar expression in the computational device.
+ * (See Aqua::CalcServer::ScalarExpression for details)
+ * @note Hardcoded versions of the files CalcServer/ScalarExpression.cl.in and
+ * CalcServer/ScalarExpression.hcl.in are internally included as a text array.
+ */
+
+#ifndef SCALAREXPRESSION_H_INCLUDED
+#define SCALAREXPRESSION_H_INCLUDED
+
+#include <CalcServer.h>
+#include <CalcServer/Tool.h>
+#include <CalcServer/ExecutionPlan.h>
+
+namespace Aqua{ namespace CalcServer{
+
+/** @class ScalarExpression ScalarExpression.h CalcServer/ScalarExpression.h
+ * @brief Evaluate a scalar expression in the computational device.
+ *
+ * The mathematical expression, written in the same language used by
+ * Aqua::InputOutput::Variables::solve(), is translated into a tiny OpenCL
+ * kernel executed by a single work item. The result is stored in a device
+ * memory object (see output()), such that it is not required to synchronize
+ * the host and the device to evaluate the expression.
+ *
+ * The scalar variables used in the expression are sent as kernel arguments,
+ * while the array variables are read from their first component, which is
+ * useful to operate with the results of the device resident reductions (see
+ * Aqua::CalcServer::Reduction).
+ *
+ * The vectorial variables components can be accessed with the "_x", "_y",
+ * "_z" and "_w" suffixes, and the vectorial results are provided as a comma
+ * separated list of components.
+ */
+class ScalarExpression : public Aqua::CalcServer::Tool
+{
+public:
+    /** @brief Constructor.
+     * @param name Tool name.
+     * @param expression Expression to evaluate.
+     * @param type Type of the result. It should be a scalar type.
+     * @param once Run this tool just once. Useful to make initializations.
+     */
+    ScalarExpression(const std::string name,
+                     const std::string expression,
+                     const std::string type="float",
+                     bool once=false);
+
+    /// Destructor.
+    ~ScalarExpression();
+
+    /** @brief Initialize the tool.
+     */
+    void setup();
+
+    /** @brief Get the memory object where the result is stored.
+     * @return Device memory object, with a single component of the result
+     * type.
+     */
+    cl_mem output() const {return _output;}
+
+    /** @brief Get the variables required to evaluate the expression.
+     * @return Variables used in the expression.
+     */
+    const std::vector<InputOutput::Variable*> variables() const {
+        return _vars;
+    }
+
+protected:
+    /** @brief Perform the work.
+     */
+    void _execute();
+
+private:
+    /** @brief Translate the expression into OpenCL code.
+     * @return OpenCL expression.
+     */
+    std::string translate();
+
+    /** @brief Translate a single component of the expression.
+     * @param expr Expression component.
+     * @return OpenCL expression component.
+     */
+    std::string translateComponent(const std::string expr);
+
+    /** @brief Parse a ternary expression, i.e. the lowest priority one.
+     * @param expr Expression.
+     * @param pos Position in the expression, which is moved forward.
+     * @return OpenCL code.
+     */
+    std::string parseTernary(const std::string &expr, size_t &pos);
+
+    /** @brief Parse a binary operations chain.
+     * @param expr Expression.
+     * @param pos Position in the expression, which is moved forward.
+     * @param level Operators priority level.
+     * @return OpenCL code.
+     */
+    std::string parseBinary(const std::string &expr,
+                            size_t &pos,
+                            unsigned int level);
+
+    /** @brief Parse an unary operation, or a power.
+     * @param expr Expression.
+     * @param pos Position in the expression, which is moved forward.
+     * @return OpenCL code.
+     */
+    std::string parseUnary(const std::string &expr, size_t &pos);
+
+    /** @brief Parse a number, a variable, a function call or a parenthesized
+     * expression.
+     * @param expr Expression.
+     * @param pos Position in the expression, which is moved forward.
+     * @return OpenCL code.
+     */
+    std::string parsePrimary(const std::string &expr, size_t &pos);
+
+    /** @brief Translate a variable (or a variable component) name.
+     * @param var_name Variable name.
+     * @return OpenCL code.
+     */
+    std::string parseVariable(const std::string var_name);
+
+    /** @brief Report a parsing error, and throw an exception.
+     * @param expr Expression.
+     * @param pos Position in the expression where the error is detected.
+     * @param error Error description.
+     */
+    void parseError(const std::string &expr,
+                    size_t pos,
+                    const std::string error);
+
+    /** @brief Setup the OpenCL stuff
+     * @param value OpenCL expression to evaluate.
+     */
+    void setupOpenCL(const std::string value);
+
+    /** @brief Compile the source code and generate the corresponding kernel
+     * @param source Source code to compile.
+     * @return Kernel instance.
+     */
+    cl_kernel compile(const std::string source);
+
+    /// Expression to evaluate
+    std::string _expression;
+
+    /// Result type
+    std::string _type;
+
+    /// Variables used in the expression
+    std::vector<InputOutput::Variable*> _vars;
+
+    /// OpenCL kernel
+    cl_kernel _kernel;
+
+    /// Memory object where the result is stored
+    cl_mem _output;
+
+    /// Kernel arguments execution plan
+    ExecutionPlan _plan;
+};
+
+}}  // namespace
+
+#endif // SCALAREXPRESSION_H_INCLUDED
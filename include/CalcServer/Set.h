@@ -64,6 +64,16 @@ public:
      */
     void setup();
 
+    /** Get the variable to set.
+     * @return Array variable, NULL if the tool has not been setup yet.
+     */
+    InputOutput::ArrayVariable* getVariable() const {return _var.get();}
+
+    /** Get the value to set.
+     * @return Value expression.
+     */
+    const std::string getValue() const {return _value;}
+
 protected:
     /** Compute the reduction.
      */
@@ -95,7 +105,7 @@ private:
     std::string _value;
 
     /// Input variable
-    InputOutput::ArrayVariable *_var;
+    InputOutput::ArrayVariableRef _var;
 
     /// Memory object sent
     cl_mem _input;
@@ -26,11 +26,20 @@
 
 #include <CalcServer.h>
 #include <CalcServer/Tool.h>
+#include <CalcServer/ScalarExpression.h>
 
 namespace Aqua{ namespace CalcServer{
 
 /** @class SetScalar SetScalar.h CalcServer/SetScalar.h
  * @brief Set a scalar variable.
+ *
+ * By default the value is evaluated in the host, which requires to
+ * synchronize it with the computational device if the expression is using
+ * variables computed there. Alternatively, the value can be evaluated in the
+ * computational device (see Aqua::CalcServer::ScalarExpression), such that the
+ * host is just lazily downloading the result. In that case, an array variable
+ * can be also set, where the first component will be the one set, which is
+ * useful to keep the results in the device.
  */
 class SetScalar : public Aqua::CalcServer::Tool
 {
@@ -40,11 +49,14 @@ public:
      * @param var_name Variable to set.
      * @param value Value to set.
      * @param once Run this tool just once. Useful to make initializations.
+     * @param device true if the value should be evaluated in the
+     * computational device, false otherwise.
      */
     SetScalar(const std::string name,
               const std::string var_name,
               const std::string value,
-              bool once=false);
+              bool once=false,
+              bool device=false);
 
     /// Destructor.
     ~SetScalar();
@@ -59,6 +71,10 @@ protected:
     void _execute();
 
 private:
+    /** @brief Evaluate the value in the computational device.
+     */
+    void executeDevice();
+
     /** @brief Get the input variable
      */
     void variable();
@@ -67,9 +83,14 @@ private:
     std::string _var_name;
     /// Value to set
     std::string _value;
+    /// true if the value should be evaluated in the computational device
+    bool _device;
 
     /// Input variable
-    InputOutput::Variable *_var;
+    InputOutput::VariableRef _var;
+
+    /// Device side expression evaluator, NULL if the host is evaluating it
+    ScalarExpression *_expr;
 };
 
 }}  // namespace
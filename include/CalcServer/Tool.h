@@ -27,8 +27,19 @@
 
 #include <sphPrerequisites.h>
 #include <math.h>
+#include <vector>
+#include <deque>
+#include <exception>
 
-namespace Aqua{ namespace CalcServer{
+#include <InputOutput/Logger.h>
+
+namespace Aqua{
+
+namespace InputOutput{
+class Variable;
+}
+
+namespace CalcServer{
 
 /** @class Tool Tool.h CalcServer/Tool.h
  * @brief Tools base class. The way that AQUAgpusph compute each problem is set
@@ -62,6 +73,74 @@ public:
      */
     const std::string name(){return _name;}
 
+    /** Check whether the tool shall be run just once.
+     * @return true if the tool shall be run just once, false otherwise.
+     */
+    bool once() const {return _once;}
+
+    /** @brief Execute the tool just every n calls, i.e. time steps.
+     * @param n Number of calls between executions, 1 to execute the tool
+     * every time.
+     */
+    void every(unsigned int n){_every = n ? n : 1;}
+
+    /** @brief Execute the tool just every dt simulation time.
+     * @param dt Simulation time between executions, 0 to ignore this
+     * criteria.
+     */
+    void everyTime(float dt){_every_t = dt;}
+
+    /** @brief Execute the tool just if an expression is fulfilled.
+     * @param expr Expression, which is evaluated with
+     * Aqua::InputOutput::Variables::solve(). The tool is executed if the
+     * result is not zero. An empty string to ignore this criteria.
+     */
+    void condition(const std::string expr){_condition = expr;}
+
+    /** @brief Check whether the tool is not executed every time step.
+     * @return true if any execution condition has been set, false otherwise.
+     * @see every(), everyTime(), condition()
+     */
+    bool conditional() const {
+        return (_every > 1) || (_every_t > 0.f) || _condition.compare("");
+    }
+
+    /** @brief Set whether the tool can be fused with the neighbour ones.
+     * @param fusable false to prevent the tool from being fused, true
+     * otherwise.
+     * @see Aqua::CalcServer::ElementWise
+     */
+    void fusable(bool fusable){_fusable = fusable;}
+
+    /** @brief Check whether the tool can be fused with the neighbour ones.
+     * @return true if the tool can be fused, false otherwise.
+     */
+    bool fusable() const {return _fusable;}
+
+    /** @brief Execute a fused tool in place of this one.
+     *
+     * The tool is kept, such that it is still reported with its own name,
+     * but its work is carried out by the fused tool, which is executed by
+     * the first tool of the fused ones. The tool is scheduled with the
+     * dependencies of the fused tool as well.
+     * @param tool Fused tool.
+     * @param owner true if this tool is executing, and owning, the fused
+     * tool, false otherwise.
+     */
+    void fused(Tool *tool, bool owner);
+
+    /** @brief Perform in advance the part of the setup which can be executed
+     * in parallel with the other tools, e.g. compiling the OpenCL programs.
+     *
+     * This method is called by Aqua::CalcServer::CalcServer::setup() from a
+     * worker thread, before calling setup() on the tools sequentially. The
+     * log messages and the exceptions are retained, and reported later when
+     * setup() calls prepared(), such that they remain attributed to the tool.
+     * @note Usually you don't want to overload this method, but the
+     * _prepare() protected one.
+     */
+    void prepare();
+
     /** Initialize the tool.
      */
     virtual void setup(){return;}
@@ -70,7 +149,8 @@ public:
      *
      * Actually this method is just ensuring that the tool can be executed,
      * e.g. the tool has been already executed, but it is asked to be ran just
-     * once.
+     * once, or the execution conditions are not fulfilled (see every(),
+     * everyTime() and condition()).
      * If the tool can be executed, then _execute() method is called, measuring
      * the time required to carry out the task.
      * @return false if all gone right, true otherwise.
@@ -112,6 +192,49 @@ public:
      */
     float elapsedTimeDeviation() const {return sqrt(elapsedTimeVariance());}
 
+    /** @brief Gather the device timestamps of the already finished commands.
+     *
+     * Just the executions whose commands has been already completed by the
+     * device are processed, such that this method is never blocking.
+     * @note This method does nothing if AQUAgpusph has been compiled without
+     * GPU profiling support.
+     */
+    void updateProfiling();
+
+    /** @brief Notify the tool that the computational device has finished the
+     * time step.
+     *
+     * The tools can use it to consume the results of their non-blocking
+     * transfers without stalling the device.
+     */
+    virtual void synchronize(){return;}
+
+    /** @brief Get the variables read by the tool.
+     * @return Input variables.
+     * @see hasDependencies()
+     */
+    const std::vector<InputOutput::Variable*> getInputDependencies() const {
+        return _in_vars;
+    }
+
+    /** @brief Get the variables written by the tool.
+     * @return Output variables.
+     * @see hasDependencies()
+     */
+    const std::vector<InputOutput::Variable*> getOutputDependencies() const {
+        return _out_vars;
+    }
+
+    /** @brief Check whether the tool has reported the variables that it is
+     * reading and writing.
+     *
+     * The tools which are not reporting their dependencies (e.g. Python
+     * scripts, which may access any variable) are considered synchronization
+     * points by the scheduler.
+     * @return true if the dependencies are known, false otherwise.
+     */
+    bool hasDependencies() const {return _has_dependencies;}
+
 protected:
     /** Set the allocated memory for this tool.
      * @param mem_size allocated memory by this tool.
@@ -127,7 +250,49 @@ protected:
      */
     void addElapsedTime(float elapsed_time);
 
+    /** @brief Thread-safe part of the setup, see prepare().
+     *
+     * It should neither register nor modify variables.
+     */
+    virtual void _prepare(){return;}
+
+    /** @brief Report the result of prepare().
+     *
+     * The retained log messages are printed, and the retained exception, if
+     * any, is thrown again.
+     * @return true if the tool has been prepared, false otherwise.
+     */
+    bool prepared();
+
+    /** @brief Get an event to be attached to an enqueued command.
+     *
+     * If AQUAgpusph has been compiled with GPU profiling support
+     * (AQUAGPUSPH_GPU_PROFILE), the returned event is used to compute the
+     * elapsed time from the device timestamps, instead of the host time
+     * required to enqueue the commands.
+     * Hence, every tool should pass it to each clEnqueue* call.
+     * @return The event to be filled by OpenCL, NULL if GPU profiling is
+     * disabled or the tool is not being executed.
+     * @warning The returned pointer is just valid until the next call.
+     */
+    cl_event* profilingEvent();
+
+    /** @brief Report the variables read and written by the tool.
+     *
+     * This information is used by the scheduler to know which tools can be
+     * executed simultaneously. Hence it should be called along setup().
+     * @param inputs Input variables (read only).
+     * @param outputs Output variables (written, and eventually read).
+     */
+    void setDependencies(std::vector<InputOutput::Variable*> inputs,
+                         std::vector<InputOutput::Variable*> outputs);
+
 private:
+    /** @brief Check the execution conditions.
+     * @return true if the tool should be executed, false otherwise.
+     */
+    bool mustExecute();
+
     /// Kernel name
     std::string _name;
 
@@ -140,6 +305,24 @@ private:
     /// Times that this tool has been called
     unsigned int _n_iters;
 
+    /// Number of calls between executions
+    unsigned int _every;
+
+    /// Simulation time between executions
+    float _every_t;
+
+    /// Expression to be fulfilled to execute the tool
+    std::string _condition;
+
+    /// Times that the execution conditions has been checked
+    unsigned int _n_calls;
+
+    /// Simulation time of the last execution
+    float _last_t;
+
+    /// Number of elapsed time samples already averaged
+    unsigned int _n_samples;
+
     /// Average elapsed time
     float _elapsed_time;
 
@@ -148,6 +331,41 @@ private:
 
     /// Average squared elapsed time
     float _squared_elapsed_time;
+
+    /// true if the dependencies has been reported, false otherwise
+    bool _has_dependencies;
+
+    /// Variables read by the tool
+    std::vector<InputOutput::Variable*> _in_vars;
+
+    /// Variables written by the tool
+    std::vector<InputOutput::Variable*> _out_vars;
+
+    /// true if prepare() has been executed, and not reported yet
+    bool _prepared;
+
+    /// Log messages retained along prepare()
+    std::vector<InputOutput::Logger::logMessage> _prepare_log;
+
+    /// Exception thrown along prepare()
+    std::exception_ptr _prepare_error;
+
+    /// false if the tool cannot be fused with the neighbour ones
+    bool _fusable;
+
+    /// Fused tool carrying out the work of this one, NULL if it is not fused
+    Tool *_fused;
+
+    /// true if this tool is executing, and owning, the fused tool
+    bool _fused_owner;
+
+#ifdef HAVE_GPUPROFILE
+    /// Events enqueued along the current execution
+    std::vector<cl_event> _events;
+
+    /// Events of the past executions, which have not been profiled yet
+    std::deque<std::vector<cl_event> > _pending_events;
+#endif
 };
 
 }}  // namespace
@@ -0,0 +1,114 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Communication between several AQUAgpusph processes.
+ * (See Aqua::CalcServer::Transport for details)
+ */
+
+#ifndef TRANSPORT_H_INCLUDED
+#define TRANSPORT_H_INCLUDED
+
+#include <sphPrerequisites.h>
+#include <vector>
+
+namespace Aqua{ namespace CalcServer{
+
+/** @class Transport Transport.h CalcServer/Transport.h
+ * @brief Communication between several AQUAgpusph processes, named ranks.
+ *
+ * This is the base class of the communication backends, which should just
+ * implement the blocking send() and recv() methods between pairs of ranks.
+ * @see Aqua::CalcServer::UnixSocketTransport
+ */
+class Transport
+{
+public:
+    /** @brief Constructor.
+     * @param rank Rank of this process.
+     * @param n_ranks Number of processes.
+     */
+    Transport(unsigned int rank, unsigned int n_ranks);
+
+    /// Destructor.
+    virtual ~Transport();
+
+    /** @brief Get the rank of this process.
+     * @return Rank of this process.
+     */
+    unsigned int rank() const {return _rank;}
+
+    /** @brief Get the number of processes.
+     * @return Number of processes.
+     */
+    unsigned int size() const {return _n_ranks;}
+
+    /** @brief Send data to other process.
+     *
+     * This method is blocking until the data is sent.
+     * @param rank Destination process.
+     * @param data Data to be sent.
+     * @param size Size of the data, in bytes.
+     */
+    virtual void send(unsigned int rank, const void *data, size_t size)=0;
+
+    /** @brief Receive data from other process.
+     *
+     * This method is blocking until the data is received.
+     * @param rank Source process.
+     * @param data Memory where the data should be stored.
+     * @param size Size of the data, in bytes.
+     */
+    virtual void recv(unsigned int rank, void *data, size_t size)=0;
+
+    /** @brief Exchange a message of arbitrary size with other process.
+     *
+     * The process with the lower rank is sending first, while the other one
+     * is receiving first, such that both processes are not blocked sending
+     * large messages.
+     * @param rank Process to exchange data with.
+     * @param data_out Data to be sent.
+     * @param data_in Received data.
+     */
+    void exchange(unsigned int rank,
+                  const std::vector<char> &data_out,
+                  std::vector<char> &data_in);
+
+private:
+    /** @brief Send a message of arbitrary size.
+     * @param rank Destination process.
+     * @param data Data to be sent.
+     */
+    void sendMessage(unsigned int rank, const std::vector<char> &data);
+
+    /** @brief Receive a message of arbitrary size.
+     * @param rank Source process.
+     * @param data Received data.
+     */
+    void recvMessage(unsigned int rank, std::vector<char> &data);
+
+    /// Rank of this process
+    unsigned int _rank;
+
+    /// Number of processes
+    unsigned int _n_ranks;
+};
+
+}}  // namespace
+
+#endif // TRANSPORT_H_INCLUDED
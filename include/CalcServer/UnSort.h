@@ -91,10 +91,10 @@ private:
     std::string _var_name;
 
     /// ID variable
-    InputOutput::ArrayVariable *_id_var;
+    InputOutput::ArrayVariableRef _id_var;
 
     /// Input variable
-    InputOutput::ArrayVariable *_var;
+    InputOutput::ArrayVariableRef _var;
 
     /// ID Memory object sent
     cl_mem _id_input;
@@ -0,0 +1,108 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Communication between several AQUAgpusph processes running in the
+ * same host.
+ * (See Aqua::CalcServer::UnixSocketTransport for details)
+ */
+
+#ifndef UNIXSOCKETTRANSPORT_H_INCLUDED
+#define UNIXSOCKETTRANSPORT_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include <CalcServer/Transport.h>
+
+namespace Aqua{ namespace CalcServer{
+
+/** @class UnixSocketTransport UnixSocketTransport.h
+ * CalcServer/UnixSocketTransport.h
+ * @brief Communication between several AQUAgpusph processes running in the
+ * same host, by means of Unix domain sockets.
+ *
+ * Each process is listening in the socket file "path.rank", such that each
+ * process is connecting with the processes with lower ranks, and accepting
+ * the connections of the processes with higher ranks.
+ */
+class UnixSocketTransport : public Aqua::CalcServer::Transport
+{
+public:
+    /** @brief Constructor.
+     *
+     * The connections with the other processes are established, so this
+     * method is blocking until all the processes are launched.
+     * @param rank Rank of this process.
+     * @param n_ranks Number of processes.
+     * @param path Sockets base path.
+     */
+    UnixSocketTransport(unsigned int rank,
+                        unsigned int n_ranks,
+                        const std::string path);
+
+    /// Destructor.
+    ~UnixSocketTransport();
+
+    /** @brief Send data to other process.
+     * @param rank Destination process.
+     * @param data Data to be sent.
+     * @param size Size of the data, in bytes.
+     */
+    void send(unsigned int rank, const void *data, size_t size);
+
+    /** @brief Receive data from other process.
+     * @param rank Source process.
+     * @param data Memory where the data should be stored.
+     * @param size Size of the data, in bytes.
+     */
+    void recv(unsigned int rank, void *data, size_t size);
+
+private:
+    /** @brief Get the socket file of a process.
+     * @param rank Process.
+     * @return Socket file path.
+     */
+    std::string address(unsigned int rank) const;
+
+    /** @brief Start listening for the connections of other processes.
+     */
+    void listen();
+
+    /** @brief Connect with a process with a lower rank.
+     * @param rank Process to connect with.
+     */
+    void connect(unsigned int rank);
+
+    /** @brief Accept the connection of a process with a higher rank.
+     */
+    void accept();
+
+    /// Sockets base path
+    std::string _path;
+
+    /// Listening socket
+    int _listener;
+
+    /// Socket connected with each process
+    std::vector<int> _sockets;
+};
+
+}}  // namespace
+
+#endif // UNIXSOCKETTRANSPORT_H_INCLUDED
@@ -29,6 +29,8 @@
 #include <string>
 #include <fstream>
 #include <vector>
+#include <map>
+#include <pthread.h>
 #include <CL/cl.h>
 
 #ifdef HAVE_NCURSES
@@ -160,6 +162,35 @@ public:
      */
     void printOpenCLError(cl_int error, TLogLevel level=L_DEBUG);
 
+    /// Retained log message
+    typedef struct {
+        /// Message classification
+        TLogLevel level;
+        /// Log message
+        std::string log;
+        /// Function name
+        std::string func;
+    } logMessage;
+
+    /** @brief Start retaining the messages of the calling thread, instead of
+     * printing them.
+     *
+     * This is useful to keep the messages generated by several threads
+     * working in parallel attributed, printing them afterwards with
+     * replay().
+     */
+    void retain();
+
+    /** @brief Stop retaining the messages of the calling thread.
+     * @return The retained messages.
+     */
+    std::vector<logMessage> retained();
+
+    /** @brief Print some previously retained messages.
+     * @param logs Retained messages.
+     */
+    void replay(const std::vector<logMessage> &logs);
+
     /** @brief Do nothing.
      *
      * @param t Simulation time
@@ -197,6 +228,12 @@ private:
     std::vector<std::string> _log;
     /// Output log file
     std::ofstream _log_file;
+
+    /// Retained messages of each thread
+    std::map<pthread_t, std::vector<logMessage> > _retained;
+
+    /// Retained messages mutex
+    pthread_mutex_t _retained_mutex;
 };
 
 }}  // namespace
@@ -83,7 +83,9 @@ public:
      * saved time instant.
      *
      * The output XML file will be the first non existing file named
-     * `"AQUAgpusph.save.%d.xml"`, where `"%d"` is an unsigned integer.
+     * `"AQUAgpusph.save.%d.xml"`, where `"%d"` is an unsigned integer. In
+     * multi-process runs each process is saving its own file,
+     * `"AQUAgpusph.save.%d.rank%r.xml"`, where `"%r"` is the process rank.
      *
      * Of course, to can load a saved simulation, the output particles file
      * should be saved as well.
@@ -137,19 +137,32 @@ private:
      *
      * Such file is used to indicates Paraview the list of files which compose
      * an animation, and the time instant of each one.
+     * In multi-process runs, the first process is also generating a PVD file
+     * collecting the files written by all the processes.
      * @param t Simulation time
      */
     void updatePVD(float t);
 
+    /** @brief Append a time instant to a Paraview Data File.
+     * @param fname PVD file name.
+     * @param t Simulation time
+     * @param files Files of the time instant, one per part.
+     */
+    void updatePVD(const std::string fname,
+                   float t,
+                   const std::vector<std::string> files);
+
     /** @brief Check if the Paraview Data File exist, creating it otherwise.
      *
      * Such file is used to indicates Paraview the list of files which compose
      * an animation, and the time instant of each one.
+     * @param fname PVD file name.
      * @param generate true if the file should be generated in case it does not
      * exist, false if the document should be associated to an existing file.
      * @return The document object. NULL if the file cannot be open/generated
      */
-    xercesc::DOMDocument* getPVD(bool generate=true);
+    xercesc::DOMDocument* getPVD(const std::string fname,
+                                  bool generate=true);
 
     /** @brief PVD file name
      * @return the PVD file name
@@ -160,6 +160,117 @@ public:
          */
         cl_device_type device_type;
 
+        /** @brief Number of command queues to be used in the selected device.
+         *
+         * If more than one command queue is used, the tools which are not
+         * depending on each other may be simultaneously executed in different
+         * command queues, using the variables read and written by each tool
+         * to build the dependency graph.
+         *
+         * This field can be set with the tag `Device`, for instance:
+         * `<Device platform="0" device="0" type="GPU" queues="4" />`
+         *
+         * 1 by default, i.e. the tools are sequentially executed.
+         */
+        unsigned int n_queues;
+
+        /** @brief Number of devices where the particles are distributed.
+         *
+         * The selected device is partitioned in sub-devices, and the kernels
+         * are split in slabs of consecutive work groups, each one executed
+         * by a sub-device. Since the particles are sorted by cells, each
+         * sub-device is computing a slab of cells with the same number of
+         * particles. The sub-devices are sharing the memory of the selected
+         * device, so the neighbours from other slabs are directly read, and
+         * several real devices are never used. The rest of the tools, e.g.
+         * the link-list, the reductions or the kernels depending on the work
+         * groups, are still executed by the whole selected device.
+         * Partitioning is usually supported just by the CPU devices.
+         *
+         * This field can be set with the tag `Device`, for instance:
+         * `<Device platform="0" device="0" type="CPU" domains="4" />`
+         *
+         * 1 by default, i.e. just the selected device is used.
+         */
+        unsigned int n_domains;
+
+        /** @brief Autotune the kernels.
+         *
+         * The kernels tools are executed, during the first time steps, with
+         * several work group sizes, both with and without local memory,
+         * selecting the fastest combination afterwards.
+         *
+         * This field can be set with the tag `Autotune`, for instance:
+         * `<Autotune value="true" file="AQUAgpusph.tuning" />`
+         *
+         * false by default.
+         */
+        bool autotune;
+
+        /** @brief Tuning database file.
+         *
+         * The autotuning results are stored in this file, such that they are
+         * reused in subsequent runs with the same device, kernel and number
+         * of threads.
+         *
+         * This field can be set with the tag `Autotune`, see #autotune.
+         *
+         * "AQUAgpusph.tuning" by default.
+         */
+        std::string tuning_path;
+
+        /** @brief Compiled programs cache folder.
+         *
+         * The binaries of the compiled OpenCL programs are stored in this
+         * folder, such that the following runs are not compiling them again
+         * (see Aqua::CalcServer::ProgramCache).
+         *
+         * This field can be set with the tag `ProgramCache`, for instance:
+         * `<ProgramCache path="./cache" />`, or with the command line option
+         * `--cache`.
+         *
+         * An empty string by default, i.e. the cache is disabled.
+         */
+        std::string cache_path;
+
+        /** @brief Just compile the programs, filling the cache, and exit.
+         *
+         * This field is set with the command line option `--prewarm`.
+         *
+         * false by default.
+         */
+        bool prewarm;
+
+        /** @brief Rank of this process, in a multi-process run.
+         *
+         * The particles are split in several processes, each one computing a
+         * slab of the domain, and exchanging the halo particles (see
+         * Aqua::CalcServer::Halo).
+         *
+         * This field is set with the command line option `--rank`.
+         *
+         * 0 by default.
+         */
+        unsigned int rank;
+
+        /** @brief Number of processes in a multi-process run.
+         *
+         * This field is set with the command line option `--ranks`.
+         *
+         * 1 by default, i.e. a single process run.
+         */
+        unsigned int n_ranks;
+
+        /** @brief Base path of the sockets used to communicate the processes.
+         *
+         * Each process is listening in the file "transport_path.rank".
+         *
+         * This field is set with the command line option `--socket`.
+         *
+         * "/tmp/aquagpusph" by default.
+         */
+        std::string transport_path;
+
         /** @brief AQUAgpusph root path.
          *
          * Usually this option is automatically set by the basic module, using
@@ -196,6 +307,12 @@ public:
         </Variables>
      * @endcode
      *
+     * The float based arrays can be optionally stored in half precision in the
+     * computational device, setting the attribute storage="half", while the
+     * maths are still carried out in float precision. Similarly, the 3D vec
+     * and the vec3 arrays can be stored as 3 floats per component, saving
+     * the padding, setting the attribute storage="packed".
+     *
      * @see Aqua::InputOutput::Variables
      * @see Aqua::InputOutput::ProblemSetup
      */
@@ -215,6 +332,8 @@ public:
         std::vector<std::string> lengths;
         /// Values
         std::vector<std::string> values;
+        /// Storage precision, "half" or an empty string for the native one
+        std::vector<std::string> storages;
 
         /** @brief Add a new variable.
          *
@@ -228,11 +347,14 @@ public:
          * which requires the number of cells).
          * @param value Variable value, NULL for arrays. It is optional for
          * scalar variables.
+         * @param storage Storage of the array, "half", "packed" or an empty
+         * string for the native one.
          */
         void registerVariable(std::string name,
                               std::string type,
                               std::string length,
-                              std::string value);
+                              std::string value,
+                              std::string storage="");
     };
 
     /// Variables storage
@@ -623,6 +745,15 @@ public:
          */
         const std::string outputPath() const {return _out_path;}
 
+        /** @brief Change the output file path.
+         *
+         * Used to let each process of a multi-process run write its own
+         * files.
+         * @param path File path.
+         * @see output()
+         */
+        void outputPath(const std::string path) {_out_path = path;}
+
         /** @brief Get the output file format
          * @return File format.
          * @see output()
@@ -26,6 +26,7 @@
 
 #include <sphPrerequisites.h>
 #include <ProblemSetup.h>
+#include <Variable.h>
 
 namespace Aqua{ namespace InputOutput{
 
@@ -70,41 +71,41 @@ public:
     /** @brief Set the simulation time step index.
      * @param s Simulation time step index.
      */
-    void step(unsigned int s){*_step = s;}
+    void step(unsigned int s){_step->set(&s);}
     /** @brief Get the simulation time step index.
      * @return Simulation time step index.
      */
-    unsigned int step(){return *_step;}
+    unsigned int step(){return *(unsigned int*)_step->get();}
     /** @brief Set the simulation time instant.
      * @param t Simulation time instant.
      */
-    void time(float t){*_time = t;}
+    void time(float t){_time->set(&t);}
     /** @brief Get the simulation time instant.
      * @return Simulation time instant.
      */
-    float time(){return *_time;}
+    float time(){return *(float*)_time->get();}
     /** @brief Set the simulation frame.
      *
      * The frame is the index of the current particles output.
      *
      * @param frame Simulation frame.
      */
-    void frame(unsigned int frame){*_frame = frame;}
+    void frame(unsigned int frame){_frame->set(&frame);}
     /** @brief Get the simulation frame.
      *
      * The frame is the index of the current particles output.
      *
      * @return Simulation frame.
      */
-    unsigned int frame(){return *_frame;}
+    unsigned int frame(){return *(unsigned int*)_frame->get();}
     /** @brief Set the simulation time step \f$ \Delta t \f$.
      * @param dt Simulation time step \f$ \Delta t \f$.
      */
-    void dt(float dt){*_dt = dt;}
+    void dt(float dt){_dt->set(&dt);}
     /** @brief Get the simulation time step \f$ \Delta t \f$.
      * @return Simulation time step \f$ \Delta t \f$.
      */
-    float dt(){return *_dt;}
+    float dt(){return *(float*)_dt->get();}
     /** @brief Set the simulation starting frame.
      *
      * The frame is the index of the current particles output.
@@ -156,35 +157,35 @@ public:
     /** @brief Get the total simulation time to compute.
      * @return Total simulation time to compute.
      */
-    float maxTime(){return *_time_max;}
+    float maxTime(){return *(float*)_time_max->get();}
     /** @brief Get the number of frames to compute.
      * @return Number of frames to compute.
      */
-    unsigned int maxStep(){return *_steps_max;}
+    unsigned int maxStep(){return *(unsigned int*)_steps_max->get();}
     /** @brief Get the number of frames to compute.
      * @return Number of frames to compute.
      */
-    unsigned int maxFrame(){return *_frames_max;}
+    unsigned int maxFrame(){return *(unsigned int*)_frames_max->get();}
 
 private:
     /// Actual step
-    unsigned int *_step;
+    VariableRef _step;
     /// Actual time
-    float *_time;
+    VariableRef _time;
     /// Time step
-    float *_dt;
+    VariableRef _dt;
     /// Actual frame
-    unsigned int *_frame;
+    VariableRef _frame;
     /// Start frame
     float _start_time;
     /// Start frame
     int _start_frame;
     /// Maximum time into simulation (-1 if simulation don't stop by time criteria)
-    float *_time_max;
+    VariableRef _time_max;
     /// Maximum number of steps into simulation (-1 if simulation don't stop by steps criteria)
-    unsigned int *_steps_max;
+    VariableRef _steps_max;
     /// Maximum number of frames into simulation (-1 if simulation don't stop by frames criteria)
-    unsigned int *_frames_max;
+    VariableRef _frames_max;
 
     /// Time when last log file printed
     float _log_time;
@@ -30,6 +30,7 @@
 
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <sphPrerequisites.h>
 #include <Tokenizer/Tokenizer.h>
 
@@ -60,7 +61,7 @@ public:
 
     /** @brief Destructor.
      */
-    virtual ~Variable() {};
+    virtual ~Variable();
 
     /** @brief Name of the variable
      * @return The name of the variable
@@ -83,9 +84,11 @@ public:
     virtual size_t size() const {return typesize();}
 
     /** @brief Get variable pointer basis pointer
+     * @param synced true if the pending transfers from the computational
+     * device should be waited for, false otherwise.
      * @return Implementation pointer, NULL for this class.
      */
-    virtual void* get(){return NULL;}
+    virtual void* get(bool synced=true){return NULL;}
 
     /** @brief Set variable from memory
      * @param ptr Memory to copy.
@@ -114,12 +117,87 @@ public:
      * @return The variable represented as a string, NULL in case of errors.
      */
     virtual const std::string asString(){return "";}
+
+    /** @brief Set the event to be waited for before accessing the variable
+     * value.
+     *
+     * This is used to asynchronously download the variable value from the
+     * computational device (see Aqua::CalcServer::Reduction), such that the
+     * host value is just valid after the event is completed.
+     * @param event OpenCL event, NULL if no event shall be waited for.
+     * @note A new reference to the event is retained, while the previous
+     * event is released.
+     */
+    void setEvent(cl_event event);
+
+    /** @brief Get the event to be waited for before accessing the variable
+     * value.
+     * @return OpenCL event, NULL if the variable value is already available.
+     */
+    cl_event getEvent() const {return _event;}
+
+    /** @brief Wait until the variable value is available in the host.
+     */
+    void sync();
+
+    /** @brief Set the computational device buffer where the current
+     * variable value is stored.
+     *
+     * This is used to let the kernels read the value of the scalar variables
+     * straight from the computational device (see
+     * Aqua::CalcServer::Reduction), without waiting for the host copy.
+     * @param mem OpenCL memory object, NULL if the value is just available in
+     * the host.
+     * @note A new reference to the memory object is retained, while the
+     * previous one is released.
+     * @note The buffer is considered outdated as soon as the variable value
+     * is modified.
+     */
+    void setDeviceMem(cl_mem mem);
+
+    /** @brief Get the computational device buffer where the current variable
+     * value is stored.
+     * @return OpenCL memory object, NULL if the value is not available in the
+     * computational device.
+     */
+    cl_mem getDeviceMem() const
+    {
+        return (_device_version == _version) ? _device_mem : NULL;
+    }
+
+    /** @brief Get the variable value version.
+     *
+     * The version is increased each time the variable value is modified, such
+     * that the tools can cheaply know whether they should send it again to
+     * the computational device (see Aqua::CalcServer::ExecutionPlan).
+     * @return Version counter.
+     */
+    unsigned int version() const {return _version;}
+
+    /** @brief Mark the variable value as modified.
+     *
+     * This should be called each time the variable value is modified without
+     * using set(), e.g. writing it through the get() pointer.
+     */
+    void touch(){_version++;}
 private:
+    /// The manager shall keep the versions on redeclaration
+    friend class Variables;
+
     /// Name of the variable
     std::string _name;
 
     /// Type of the variable
     std::string _typename;
+
+    /// Event to be waited for before accessing the variable value
+    cl_event _event;
+    /// Computational device buffer where the variable value is stored
+    cl_mem _device_mem;
+    /// Variable value version stored in the computational device buffer
+    unsigned int _device_version;
+    /// Variable value version
+    unsigned int _version;
 };
 
 /** @class ScalarVariable Variable.h Variable.h
@@ -145,14 +223,22 @@ public:
     size_t typesize() const {return sizeof(T);}
 
     /** @brief Get variable pointer basis pointer
+     * @param synced true if the pending transfers from the computational
+     * device should be waited for, false otherwise.
      * @return Implementation pointer.
      */
-    T* get(){return &_value;}
+    T* get(bool synced=true){if(synced) this->sync(); return &_value;}
 
     /** @brief Set variable from memory
      * @param ptr Memory to copy.
      */
-    void set(void* ptr){memcpy(&_value, ptr, sizeof(T));}
+    void set(void* ptr){
+        this->sync();
+        if(!memcmp(&_value, ptr, sizeof(T)))
+            return;
+        memcpy(&_value, ptr, sizeof(T));
+        this->touch();
+    }
 
     /** @brief Get the variable text representation
      * @return The variable represented as a string, NULL in case of errors.
@@ -607,8 +693,12 @@ public:
     /** Constructor.
      * @param varname Name of the variable.
      * @param vartype Type of the variable.
+     * @param storage Storage in the computational device, "half", "packed"
+     * or an empty string for the native one.
      */
-    ArrayVariable(const std::string varname, const std::string vartype);
+    ArrayVariable(const std::string varname,
+                  const std::string vartype,
+                  const std::string storage="");
 
     /** Destructor.
      */
@@ -622,21 +712,65 @@ public:
     size_t typesize() const {return sizeof(cl_mem);}
 
     /** Get the array size.
-     * @return Array allocated memory (in bytes)
+     * @return Array allocated memory (in bytes), as if it was stored in the
+     * native precision
      * @note In order to get the length of the array the command
      * size() / Variables::typeToBytes(type()) can be used
      */
     size_t size() const;
 
+    /** Get the storage in the computational device.
+     * @return "half" for the arrays stored in half precision, "packed" for
+     * the vec arrays stored with 3 components, an empty string otherwise.
+     */
+    const std::string storage() const {return _storage;}
+
+    /** Get the actually allocated memory in the computational device.
+     * @return Allocated memory (in bytes)
+     * @see size()
+     */
+    size_t storageSize() const;
+
+    /** Download data from the computational device.
+     *
+     * The arrays stored in half precision are converted to float precision,
+     * and the packed ones are padded with zeros. The transfer is blocking.
+     * @param offset Offset in the array (in bytes of the native precision)
+     * @param cb Number of bytes to read (in the native precision)
+     * @param ptr Host memory where the data should be written
+     * @return CL_SUCCESS if the data is successfully downloaded, an OpenCL
+     * error code otherwise.
+     */
+    cl_int read(size_t offset, size_t cb, void *ptr);
+
+    /** Upload data to the computational device.
+     *
+     * The arrays stored in half precision are converted from float
+     * precision, and the packed ones drop the padding component. The
+     * transfer is blocking.
+     * @param offset Offset in the array (in bytes of the native precision)
+     * @param cb Number of bytes to write (in the native precision)
+     * @param ptr Host memory where the data should be read
+     * @return CL_SUCCESS if the data is successfully uploaded, an OpenCL
+     * error code otherwise.
+     */
+    cl_int write(size_t offset, size_t cb, const void *ptr);
+
     /** Get variable pointer basis pointer
+     * @param synced Ignored parameter, the memory object is always available.
      * @return Implementation pointer.
      */
-    cl_mem* get(){return &_value;}
+    cl_mem* get(bool synced=true){return &_value;}
 
     /** Set variable from memory
      * @param ptr Memory to copy.
      */
-    void set(void* ptr){_value = *(cl_mem*)ptr;}
+    void set(void* ptr){
+        if(_value == *(cl_mem*)ptr)
+            return;
+        _value = *(cl_mem*)ptr;
+        touch();
+    }
 
     /** Get a PyArrayObject interpretation of the variable
      * @param i0 First component to be read.
@@ -670,6 +804,8 @@ private:
 
     /// Variable value
     cl_mem _value;
+    /// Storage precision
+    std::string _storage;
     /** @brief List of helpers data array storages for the Python objects
      *
      * The memory array inside numpy objects must be dynamically allocated and
@@ -695,8 +831,14 @@ private:
 // Variables manager
 // ---------------------------------------------------------------------------
 
+class VariableRef;
+
 /** @class Variables Variables.h Variables.h
  * @brief Variables manager, which can interpret the types on the fly.
+ *
+ * The variables are indexed by name in a hash table, and each one keeps its
+ * index (see handle()) even if it is redeclared, such that the tools can
+ * resolve their variables just once.
  */
 class Variables
 {
@@ -717,11 +859,16 @@ public:
      * which requires the number of cells).
      * @param value Variable value, NULL for arrays. It is optional for
      * scalar variables.
+     * @param storage Storage precision of the arrays in the computational
+     * device, "half" or an empty string for the native one. Just the float
+     * based arrays can be stored in half precision, and just the 3D vec and
+     * the vec3 arrays can be "packed".
      */
     void registerVariable(const std::string name,
                           const std::string type,
                           const std::string length,
-                          const std::string value);
+                          const std::string value,
+                          const std::string storage="");
 
     /** Get a variable.
      * @param index Index of the variable.
@@ -735,6 +882,16 @@ public:
      */
     Variable* get(const std::string name);
 
+    /** Get a stable handle to a variable.
+     *
+     * The handle remains valid, pointing to the new variable, if the variable
+     * is redeclared.
+     * @param name Name of the variable.
+     * @return Variable handle, which evaluates to false if the variable
+     * cannot be found.
+     */
+    VariableRef handle(const std::string name);
+
     /** Get all the registered variables.
      * @return Variable, NULL if the variable cannot be found.
      */
@@ -762,6 +919,15 @@ public:
      */
     static unsigned int typeToN(const std::string type);
 
+    /** Convert a type name to the bytes taken in the computational device.
+     * @param type Type name.
+     * @param storage Storage of the array, "half", "packed" or an empty
+     * string for the native one.
+     * @return Stored component size in bytes.
+     */
+    static size_t storageToBytes(const std::string type,
+                                 const std::string storage);
+
     /** Get if two types strings are the same one.
      * @param type_a First type name.
      * @param type_b Second type name.
@@ -796,6 +962,16 @@ public:
      * @param var Variable to be populated.
      */
     void populate(Variable* var);
+
+    /** @brief Populate a variable as soon as the tokenizer requires it.
+     *
+     * This is useful for the variables asynchronously downloaded from the
+     * computational device (see Aqua::InputOutput::Variable::setEvent()),
+     * which should not be populated until they are actually required, to
+     * avoid synchronizing the device and the host.
+     * @param var Variable to be populated.
+     */
+    void populateLazy(Variable* var);
 private:
 
     /** Register a scalar variable
@@ -813,10 +989,13 @@ private:
      * @param length Array length, 1 for scalars, 0 for arrays that will
      * not be allocated at the start (for instance the heads of chains,
      * which requires the number of cells).
+     * @param storage Storage of the array, "half", "packed" or an empty
+     * string for the native one.
      */
     void registerClMem(const std::string name,
                        const std::string type,
-                       const std::string length);
+                       const std::string length,
+                       const std::string storage);
 
     /** Read a set of components from a value array.
      * @param name Name of the variable. It is used to register variables in
@@ -833,10 +1012,97 @@ private:
 
     /// Set of available variables
     std::vector<Variable*> _vars;
+    /// Index of each variable in _vars, by name
+    std::unordered_map<std::string, unsigned int> _names;
+    /// Variables pending to be populated
+    std::vector<Variable*> _lazy_vars;
     /// Tokenizer to evaluate variables
     Tokenizer tok;
 };
 
+/** @class VariableRef Variable.h Variable.h
+ * @brief Stable handle to a registered variable.
+ *
+ * The handle is just the index of the variable in the manager, so it can be
+ * dereferenced in constant time, and it follows the variable if it is
+ * redeclared (see Aqua::InputOutput::Variables::handle()).
+ */
+class VariableRef
+{
+public:
+    /** @brief Constructor of an invalid handle.
+     */
+    VariableRef() : _vars(NULL), _index(0) {}
+
+    /** @brief Constructor.
+     * @param vars Variables manager.
+     * @param index Index of the variable.
+     */
+    VariableRef(Variables *vars, unsigned int index)
+        : _vars(vars)
+        , _index(index)
+    {}
+
+    /** @brief Get the variable.
+     * @return Variable, NULL if the handle is not valid.
+     */
+    Variable* get() const {return _vars ? _vars->get(_index) : NULL;}
+
+    /** @brief Access the variable members.
+     * @return Variable.
+     */
+    Variable* operator->() const {return get();}
+
+    /** @brief Check whether the handle is valid.
+     * @return true if the handle points to a variable, false otherwise.
+     */
+    operator bool() const {return get() != NULL;}
+
+    /** @brief Get the index of the variable.
+     * @return Index of the variable in the manager.
+     */
+    unsigned int index() const {return _index;}
+private:
+    /// Variables manager
+    Variables *_vars;
+    /// Index of the variable
+    unsigned int _index;
+};
+
+/** @class TypedVariableRef Variable.h Variable.h
+ * @brief Stable handle to a registered variable of a known class.
+ *
+ * It is just a Aqua::InputOutput::VariableRef which is casting the variable,
+ * such that the tools can keep the handle instead of the variable itself.
+ * @warning The variable class is not checked.
+ */
+template <class T>
+class TypedVariableRef : public VariableRef
+{
+public:
+    /** @brief Constructor of an invalid handle.
+     */
+    TypedVariableRef() : VariableRef() {}
+
+    /** @brief Constructor.
+     * @param var Variable handle.
+     */
+    TypedVariableRef(const VariableRef &var) : VariableRef(var) {}
+
+    /** @brief Get the variable.
+     * @return Variable, NULL if the handle is not valid.
+     */
+    T* get() const {return (T*)VariableRef::get();}
+
+    /** @brief Access the variable members.
+     * @return Variable.
+     */
+    T* operator->() const {return get();}
+};
+
+/// Stable handle to a registered array variable
+typedef TypedVariableRef<ArrayVariable> ArrayVariableRef;
+
 }}  // namespace
 
 #endif // VARIABLE_H_INCLUDED
@@ -78,15 +78,15 @@
  */
 __kernel void entry(__global int* imove,
                     __global unsigned int* iset,
-                    __global vec* r,
-                    __global vec* u,
-                    __global vec* dudt,
-                    __global float* rho,
+                    __global STORAGE(vec, r)* r,
+                    __global STORAGE(vec, u)* u,
+                    __global STORAGE(vec, dudt)* dudt,
+                    __global STORAGE(float, rho)* rho,
                     __global float* drhodt,
-                    __global vec* r_in,
-                    __global vec* u_in,
-                    __global vec* dudt_in,
-                    __global float* rho_in,
+                    __global STORAGE(vec, r_in)* r_in,
+                    __global STORAGE(vec, u_in)* u_in,
+                    __global STORAGE(vec, dudt_in)* dudt_in,
+                    __global STORAGE(float, rho_in)* rho_in,
                     __global float* drhodt_in,
                     unsigned int N,
                     float dt)
@@ -99,13 +99,16 @@ __kernel void entry(__global int* imove,
     if(imove[i] <= 0)
         DT = 0.f;
 
-    u[i] += DT * (dudt[i] - dudt_in[i]);
-    rho[i] += DT * (drhodt[i] - drhodt_in[i]);
+    const vec dudt_i = LOAD(vec, dudt, i);
+    const vec u_i = LOAD(vec, u, i) + DT * (dudt_i - LOAD(vec, dudt_in, i));
+    STORE(vec, u, i, u_i);
+    const float rho_i = LOAD(float, rho, i) + DT * (drhodt[i] - drhodt_in[i]);
+    STORE(float, rho, i, rho_i);
 
-    r_in[i] = r[i];
-    u_in[i] = u[i];
-    rho_in[i] = rho[i];
-    dudt_in[i] = dudt[i];
+    STORE(vec, r_in, i, LOAD(vec, r, i));
+    STORE(vec, u_in, i, u_i);
+    STORE(float, rho_in, i, rho_i);
+    STORE(vec, dudt_in, i, dudt_i);
     drhodt_in[i] = drhodt[i];
 }
 
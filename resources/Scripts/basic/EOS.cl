@@ -56,8 +56,8 @@
  */
 __kernel void entry(__global unsigned int* iset,
                     __global unsigned int* imove,
-                    __global float* rho,
-                    __global float* p,
+                    __global STORAGE(float, rho)* rho,
+                    __global STORAGE(float, p)* p,
                     __constant float* refd,
                     unsigned int N,
                     float cs,
@@ -69,7 +69,8 @@ __kernel void entry(__global unsigned int* iset,
     if(EXCLUDED_PARTICLE(i))
         return;
 
-    p[i] = p0 + cs * cs * (rho[i] - refd[iset[i]]);
+    STORE(float, p, i,
+          p0 + cs * cs * (LOAD(float, rho, i) - refd[iset[i]]));
 }
 
 /*
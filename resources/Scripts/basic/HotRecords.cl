@@ -0,0 +1,72 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @addtogroup basic
+ * @{
+ */
+
+/** @file
+ * @brief Hot particle records building.
+ */
+
+#include "resources/Scripts/types/types.h"
+
+/** @brief Interleave the fields read by the neighbours loops.
+ *
+ * This kernel is executed once the particles have been sorted, and the
+ * pressure computed.
+ *
+ * @param r Position \f$ \mathbf{r} \f$.
+ * @param u Velocity \f$ \mathbf{u} \f$.
+ * @param m Mass \f$ m \f$.
+ * @param rho Density \f$ \rho \f$.
+ * @param p Pressure \f$ p \f$.
+ * @param hot_r Position and mass record.
+ * @param hot_u Velocity and density (and pressure in 2D) record.
+ * @param N Number of particles.
+ * @see HOT_RECORDS_ARGS
+ */
+__kernel void entry(const __global STORAGE(vec, r)* r,
+                    const __global STORAGE(vec, u)* u,
+                    const __global STORAGE(float, m)* m,
+                    const __global STORAGE(float, rho)* rho,
+                    const __global STORAGE(float, p)* p,
+                    __global vec4* hot_r,
+                    __global vec4* hot_u,
+                    unsigned int N)
+{
+    unsigned int i = get_global_id(0);
+    if(i >= N)
+        return;
+
+    vec4 r_i = (vec4)(0.f, 0.f, 0.f, 0.f);
+    vec4 u_i = (vec4)(0.f, 0.f, 0.f, 0.f);
+    r_i.XYZ = LOAD(vec, r, i).XYZ;
+    r_i.w = LOAD(float, m, i);
+    u_i.XYZ = LOAD(vec, u, i).XYZ;
+    u_i.w = LOAD(float, rho, i);
+    #ifndef HAVE_3D
+        u_i.z = LOAD(float, p, i);
+    #endif
+    hot_r[i] = r_i;
+    hot_u[i] = u_i;
+}
+
+/*
+ * @}
+ */
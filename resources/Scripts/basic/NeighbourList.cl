@@ -0,0 +1,167 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @addtogroup basic
+ * @{
+ */
+
+/** @file
+ * @brief Verlet neighbour lists building.
+ */
+
+#include "resources/Scripts/types/types.h"
+
+/** @brief Displacement of each particle since the last time the neighbour
+ * lists were built.
+ *
+ * The particles which have been activated or deactivated since then are
+ * reported with a displacement equal to the skin, such that the lists are
+ * rebuilt.
+ *
+ * @param imove Moving flags.
+ *   - imove > 0 for regular fluid particles.
+ *   - imove = 0 for sensors.
+ *   - imove < 0 for boundary elements/particles.
+ * @param id Original index of each particle.
+ * @param r Position \f$ \mathbf{r} \f$.
+ * @param neigh_r Position of each particle when the lists were built, indexed
+ * by the original particle index.
+ * @param neigh_n Number of neighbours of each particle, indexed by the
+ * original particle index.
+ * @param neigh_disp Displacement of each particle.
+ * @param neigh_skin Skin distance.
+ * @param N Number of particles.
+ */
+__kernel void displacement(const __global int* imove,
+                           const __global uint* id,
+                           const __global STORAGE(vec, r)* r,
+                           const __global vec* neigh_r,
+                           const __global uint* neigh_n,
+                           __global float* neigh_disp,
+                           float neigh_skin,
+                           unsigned int N)
+{
+    unsigned int i = get_global_id(0);
+    if(i >= N)
+        return;
+
+    const float skin = min(neigh_skin, SUPPORT * H);
+    const uint i_id = id[i];
+    if(imove[i] <= -255){
+        neigh_disp[i] = neigh_n[i_id] ? skin : 0.f;
+        return;
+    }
+    if(!neigh_n[i_id]){
+        neigh_disp[i] = skin;
+        return;
+    }
+    neigh_disp[i] = length(LOAD(vec, r, i).XYZ - neigh_r[i_id].XYZ);
+}
+
+/** @brief Build the neighbour lists.
+ *
+ * Nothing is done unless some particle has moved more than half of the skin.
+ * Since the cells length is support * h, the cells at a distance of 2 are
+ * traversed as well, hence the skin is clamped to support * h.
+ *
+ * @param imove Moving flags.
+ *   - imove > 0 for regular fluid particles.
+ *   - imove = 0 for sensors.
+ *   - imove < 0 for boundary elements/particles.
+ * @param id Original index of each particle.
+ * @param r Position \f$ \mathbf{r} \f$.
+ * @param neigh_r Position of each particle when the lists were built, indexed
+ * by the original particle index.
+ * @param neigh_n Number of neighbours of each particle, indexed by the
+ * original particle index. It may be bigger than neigh_list_capacity, in
+ * which case the list is truncated.
+ * @param neigh_list Original index of the neighbours of each particle.
+ * @param neigh_disp_max Maximum displacement of the particles.
+ * @param icell Cell where each particle is located.
+ * @param ihoc Head of chain for each cell (first particle found).
+ * @param N Number of particles.
+ * @param n_cells Number of cells in each direction
+ * @param neigh_skin Skin distance.
+ * @param neigh_list_capacity Maximum number of neighbours per particle.
+ */
+__kernel void build(const __global int* imove,
+                    const __global uint* id,
+                    const __global STORAGE(vec, r)* r,
+                    __global vec* neigh_r,
+                    __global uint* neigh_n,
+                    __global uint* neigh_list,
+                    const __global float* neigh_disp_max,
+                    // Link-list data
+                    const __global uint *icell,
+                    const __global uint *ihoc,
+                    // Simulation data
+                    uint N,
+                    uivec4 n_cells,
+                    float neigh_skin,
+                    uint neigh_list_capacity)
+{
+    const uint i = get_global_id(0);
+    if(i >= N)
+        return;
+
+    const float skin = min(neigh_skin, SUPPORT * H);
+    if(neigh_disp_max[0] < 0.5f * skin)
+        return;
+
+    const uint i_id = id[i];
+    if(imove[i] <= -255){
+        neigh_n[i_id] = 0;
+        return;
+    }
+
+    const vec r_i = LOAD(vec, r, i);
+    const float dist = SUPPORT * H + skin;
+    const uint row = i_id * neigh_list_capacity;
+    uint n = 0;
+
+    const uivec c_i = CELL_COORDS(icell[i], n_cells);
+    for(int ci = -2; ci <= 2; ci++) {
+        for(int cj = -2; cj <= 2; cj++) {
+            #ifdef HAVE_3D
+            for(int ck = -2; ck <= 2; ck++) {
+                const uivec c = c_i + (uivec)((uint)ci, (uint)cj, (uint)ck, 0u);
+            #else
+            {
+                const uivec c = c_i + (uivec)((uint)ci, (uint)cj);
+            #endif
+                const uint c_j = CELL_ID(c, n_cells);
+                uint j = ihoc[c_j];
+                while((j < N) && (icell[j] == c_j)) {
+                    if(length(LOAD(vec, r, j).XYZ - r_i.XYZ) < dist){
+                        if(n < neigh_list_capacity)
+                            neigh_list[row + n] = id[j];
+                        n++;
+                    }
+                    j++;
+                }
+            }
+        }
+    }
+
+    neigh_n[i_id] = n;
+    neigh_r[i_id] = r_i;
+}
+
+/*
+ * @}
+ */
@@ -80,15 +80,15 @@
  * @see basic/Corrector.cl
  */
 __kernel void entry(__global int* imove,
-                    __global vec* r,
-                    __global vec* u,
-                    __global vec* dudt,
-                    __global float* rho,
+                    __global STORAGE(vec, r)* r,
+                    __global STORAGE(vec, u)* u,
+                    __global STORAGE(vec, dudt)* dudt,
+                    __global STORAGE(float, rho)* rho,
                     __global float* drhodt,
-                    __global vec* r_in,
-                    __global vec* u_in,
-                    __global vec* dudt_in,
-                    __global float* rho_in,
+                    __global STORAGE(vec, r_in)* r_in,
+                    __global STORAGE(vec, u_in)* u_in,
+                    __global STORAGE(vec, dudt_in)* dudt_in,
+                    __global STORAGE(float, rho_in)* rho_in,
                     __global float* drhodt_in,
                     unsigned int N,
                     float dt,
@@ -102,12 +102,15 @@ __kernel void entry(__global int* imove,
     if(imove[i] <= 0)
         DT = 0.f;
 
-    dudt_in[i] = dudt[i];
-    u_in[i] = u[i] + DT * dudt[i];
-    r_in[i] = r[i] + DT * u[i] + 0.5f * DT * DT * dudt[i];
+    const vec r_i = LOAD(vec, r, i);
+    const vec u_i = LOAD(vec, u, i);
+    const vec dudt_i = LOAD(vec, dudt, i);
+    STORE(vec, dudt_in, i, dudt_i);
+    STORE(vec, u_in, i, u_i + DT * dudt_i);
+    STORE(vec, r_in, i, r_i + DT * u_i + 0.5f * DT * DT * dudt_i);
     
     drhodt_in[i] = drhodt[i];
-    rho_in[i] = rho[i] + DT * drhodt[i];
+    STORE(float, rho_in, i, LOAD(float, rho, i) + DT * drhodt[i]);
 }
 
 /*
@@ -74,10 +74,12 @@
  * @param n_cells Number of cells in each direction
  */
 __kernel void entry(const __global int* imove,
-                    const __global vec* r,
-                    const __global float* rho,
-                    const __global float* m,
-                    __global float* shepard,
+                    const __global STORAGE(vec, r)* r,
+                    const __global STORAGE(float, rho)* rho,
+                    const __global STORAGE(float, m)* m,
+                    __global STORAGE(float, shepard)* shepard,
+                    HOT_RECORDS_ARGS
+                    NEIGHBOUR_LIST_ARGS
                     // Link-list data
                     const __global uint *icell,
                     const __global uint *ihoc,
@@ -92,24 +94,27 @@ __kernel void entry(const __global int* imove,
     if((imove[i] < -3) || ((imove[i] > 0) && (EXCLUDED_PARTICLE(i))))
         return;
 
-    const vec_xyz r_i = r[i].XYZ;
+    const vec_xyz r_i = LOAD(vec, r, i).XYZ;
 
     // Initialize the output
     #ifndef LOCAL_MEM_SIZE
-        #define _SHEPARD_ shepard[i]
+        // The factor may be stored in half precision, so it is accumulated
+        // in private memory
+        float shepard_i = LOAD(float, shepard, i);
+        #define _SHEPARD_ shepard_i
     #else
         #define _SHEPARD_ shepard_l[it]
         __local float shepard_l[LOCAL_MEM_SIZE];
         _SHEPARD_ = 0.f;
     #endif
 
-    BEGIN_LOOP_OVER_NEIGHS(){
+    BEGIN_LOOP_OVER_NEIGHBOUR_LIST(){
         if(EXCLUDED_PARTICLE(j)){
             j++;
             continue;
         }
 
-        const vec_xyz r_ij = r[j].XYZ - r_i;
+        const vec_xyz r_ij = HOT_R(j) - r_i;
         const float q = length(r_ij) / H;
         if(q >= SUPPORT)
         {
@@ -118,11 +123,9 @@ __kernel void entry(const __global int* imove,
         }
 
         {
-            _SHEPARD_ += kernelW(q) * CONW * m[j] / rho[j];
+            _SHEPARD_ += kernelW(q) * CONW * HOT_M(j) / HOT_RHO(j);
         }
-    }END_LOOP_OVER_NEIGHS()
+    }END_LOOP_OVER_NEIGHBOUR_LIST()
 
-    #ifdef LOCAL_MEM_SIZE
-        shepard[i] = _SHEPARD_;
-    #endif
+    STORE(float, shepard, i, _SHEPARD_);
 }
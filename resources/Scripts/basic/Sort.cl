@@ -57,9 +57,12 @@
 __kernel void stage1(const __global uint *id_in, __global uint *id,
                      const __global uint *iset_in, __global uint *iset,
                      const __global int *imove_in, __global int *imove,
-                     const __global vec *r_in, __global vec *r,
-                     const __global vec *normal_in, __global vec *normal,
-                     const __global vec *u_in, __global vec *u,
+                     const __global STORAGE(vec, r_in) *r_in,
+                     __global STORAGE(vec, r) *r,
+                     const __global STORAGE(vec, normal_in) *normal_in,
+                     __global STORAGE(vec, normal) *normal,
+                     const __global STORAGE(vec, u_in) *u_in,
+                     __global STORAGE(vec, u) *u,
                      const __global unit *id_sorted,
                      unsigned int N)
 {
@@ -72,9 +75,9 @@ __kernel void stage1(const __global uint *id_in, __global uint *id,
     id[i_out] = id_in[i];
     iset[i_out] = iset_in[i];
     imove[i_out] = imove_in[i];
-    r[i_out] = r_in[i];
-    normal[i_out] = normal_in[i];
-    u[i_out] = u_in[i];
+    STORE(vec, r, i_out, LOAD(vec, r_in, i));
+    STORE(vec, normal, i_out, LOAD(vec, normal_in, i));
+    STORE(vec, u, i_out, LOAD(vec, u_in, i));
 }
 
 /** @brief Sort all the particle variables by the cell indexes.
@@ -97,10 +100,13 @@ __kernel void stage1(const __global uint *id_in, __global uint *id,
  * one.
  * @param N Number of particles.
  */
-__kernel void stage2(const __global vec *dudt_in, __global vec *dudt,
-                     const __global float *rho_in, __global float *rho,
+__kernel void stage2(const __global STORAGE(vec, dudt_in) *dudt_in,
+                     __global STORAGE(vec, dudt) *dudt,
+                     const __global STORAGE(float, rho_in) *rho_in,
+                     __global STORAGE(float, rho) *rho,
                      const __global float *drhodt_in, __global float *drhodt,
-                     const __global float *m_in, __global float *m,
+                     const __global STORAGE(float, m_in) *m_in,
+                     __global STORAGE(float, m) *m,
                      const __global unit *id_sorted,
                      unsigned int N)
 {
@@ -110,10 +116,10 @@ __kernel void stage2(const __global vec *dudt_in, __global vec *dudt,
 
     const uint i_out = id_sorted[i];
 
-    dudt[i_out] = dudt_in[i];
-    rho[i_out] = rho_in[i];
+    STORE(vec, dudt, i_out, LOAD(vec, dudt_in, i));
+    STORE(float, rho, i_out, LOAD(float, rho_in, i));
     drhodt[i_out] = drhodt_in[i];
-    m[i_out] = m_in[i];
+    STORE(float, m, i_out, LOAD(float, m_in, i));
 }
 
 /*
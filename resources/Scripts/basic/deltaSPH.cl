@@ -97,6 +97,8 @@ __kernel void full(const __global int* imove,
                    const __global float* m,
                    const __global float* p,
                    __global vec* lap_p_corr,
+                   HOT_RECORDS_ARGS
+                   NEIGHBOUR_LIST_ARGS
                    const __global uint *icell,
                    const __global uint *ihoc,
                    uint N,
@@ -122,12 +124,12 @@ __kernel void full(const __global int* imove,
         _GRADP_ = VEC_ZERO.XYZ;
     #endif
 
-    BEGIN_LOOP_OVER_NEIGHS(){
+    BEGIN_LOOP_OVER_NEIGHBOUR_LIST(){
         if( (i == j) || (EXCLUDED_PARTICLE(j))){
             j++;
             continue;
         }
-        const vec_xyz r_ij = r[j].XYZ - r_i;
+        const vec_xyz r_ij = HOT_R(j) - r_i;
         const float q = length(r_ij) / H;
         if(q >= SUPPORT)
         {
@@ -135,10 +137,10 @@ __kernel void full(const __global int* imove,
             continue;
         }
         {
-            const float f_ij = kernelF(q) * CONF * m[j] / rho[j];
-            _GRADP_ += (p[j] - p_i) * f_ij * r_ij;
+            const float f_ij = kernelF(q) * CONF * HOT_M(j) / HOT_RHO(j);
+            _GRADP_ += (HOT_P(j) - p_i) * f_ij * r_ij;
         }
-    }END_LOOP_OVER_NEIGHS()
+    }END_LOOP_OVER_NEIGHBOUR_LIST()
 
     #ifdef LOCAL_MEM_SIZE
         lap_p_corr[i].XYZ = _GRADP_;
@@ -195,6 +197,8 @@ __kernel void lapp(const __global int* imove,
                    const __global float* m,
                    const __global float* p,
                    __global float* lap_p,
+                   HOT_RECORDS_ARGS
+                   NEIGHBOUR_LIST_ARGS
                    const __global uint *icell,
                    const __global uint *ihoc,
                    uint N,
@@ -220,12 +224,12 @@ __kernel void lapp(const __global int* imove,
         _LAPP_ = 0.f;
     #endif
 
-    BEGIN_LOOP_OVER_NEIGHS(){
+    BEGIN_LOOP_OVER_NEIGHBOUR_LIST(){
         if( (i == j) || (EXCLUDED_PARTICLE(j))){
             j++;
             continue;
         }
-        const vec_xyz r_ij = r[j].XYZ - r_i;
+        const vec_xyz r_ij = HOT_R(j) - r_i;
         const float q = length(r_ij) / H;
         if(q >= SUPPORT)
         {
@@ -233,10 +237,10 @@ __kernel void lapp(const __global int* imove,
             continue;
         }
         {
-            const float f_ij = kernelF(q) * CONF * m[j] / rho[j];
-            _LAPP_ += (p[j] - p_i) * f_ij;
+            const float f_ij = kernelF(q) * CONF * HOT_M(j) / HOT_RHO(j);
+            _LAPP_ += (HOT_P(j) - p_i) * f_ij;
         }
-    }END_LOOP_OVER_NEIGHS()
+    }END_LOOP_OVER_NEIGHBOUR_LIST()
 
     #ifdef LOCAL_MEM_SIZE
         lap_p[i] = _LAPP_;
@@ -266,6 +270,8 @@ __kernel void lapp_corr(const __global int* imove,
                         const __global float* m,
                         const __global vec* lap_p_corr,
                         __global float* lap_p,
+                        HOT_RECORDS_ARGS
+                        NEIGHBOUR_LIST_ARGS
                         const __global uint *icell,
                         const __global uint *ihoc,
                         uint N,
@@ -291,12 +297,12 @@ __kernel void lapp_corr(const __global int* imove,
         _LAPP_ = lap_p[i];
     #endif
 
-    BEGIN_LOOP_OVER_NEIGHS(){
+    BEGIN_LOOP_OVER_NEIGHBOUR_LIST(){
         if( (i == j) || (EXCLUDED_PARTICLE(j))){
             j++;
             continue;
         }
-        const vec_xyz r_ij = r[j].XYZ - r_i;
+        const vec_xyz r_ij = HOT_R(j) - r_i;
         const float q = length(r_ij) / H;
         if(q >= SUPPORT)
         {
@@ -305,10 +311,10 @@ __kernel void lapp_corr(const __global int* imove,
         }
         {
             const vec_xyz gradp_ij = lap_p_corr[j].XYZ + gradp_i;
-            const float f_ij = kernelF(q) * CONF * m[j] / rho[j];
+            const float f_ij = kernelF(q) * CONF * HOT_M(j) / HOT_RHO(j);
             _LAPP_ -= 0.5f * dot(gradp_ij, r_ij) * f_ij;
         }
-    }END_LOOP_OVER_NEIGHS()
+    }END_LOOP_OVER_NEIGHBOUR_LIST()
 
     #ifdef LOCAL_MEM_SIZE
         lap_p[i] = _LAPP_;
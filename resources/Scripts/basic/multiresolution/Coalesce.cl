@@ -181,9 +181,9 @@ __kernel void seeds(__global const unsigned int* iset,
  * particles to become generated.
  *
  * Since isplit is used to sort the particles, it should have "n_radix" items,
- * which is bigger than "N". But in order to conveniently sort isplit, you must
- * ensure that the values "out of bounds" are bigger than the other ones (and
- * therefore kept at the end of the list). in this case a value of 3 is
+ * which may be bigger than "N". But in order to conveniently sort isplit, you
+ * must ensure that the values "out of bounds" are bigger than the other ones
+ * (and therefore kept at the end of the list). in this case a value of 3 is
  * selected.
  *
  * @param isplit 0 if the particle should not become split, 1 otherwise
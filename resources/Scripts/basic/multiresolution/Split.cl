@@ -93,9 +93,9 @@ __kernel void check_split(__global const int* imove,
  * to become generated.
  *
  * Since isplit is used to sort the particles, it should have "n_radix" items,
- * which is bigger than "N". But in order to conveniently sort isplit, you must
- * ensure that the values "out of bounds" are bigger than the other ones (and
- * therefore kept at the end of the list). in this case a value of 2 is
+ * which may be bigger than "N". But in order to conveniently sort isplit, you
+ * must ensure that the values "out of bounds" are bigger than the other ones
+ * (and therefore kept at the end of the list). in this case a value of 2 is
  * selected.
  *
  * @param isplit 0 if the particle should not become split, 1 otherwise
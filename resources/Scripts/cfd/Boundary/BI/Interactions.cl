@@ -59,6 +59,8 @@ __kernel void entry(const __global uint* iset,
                     __constant float* refd,
                     __global vec* grad_p,
                     __global float* div_u,
+                    HOT_RECORDS_ARGS
+                    NEIGHBOUR_LIST_ARGS
                     // Link-list data
                     __global uint *icell,
                     __global uint *ihoc,
@@ -93,12 +95,12 @@ __kernel void entry(const __global uint* iset,
         _DIVU_ = div_u[i];
     #endif
 
-    BEGIN_LOOP_OVER_NEIGHS(){
+    BEGIN_LOOP_OVER_NEIGHBOUR_LIST(){
         if(imove[j] != -3){
             j++;
             continue;
         }
-        const vec_xyz r_ij = r[j].XYZ - r_i;
+        const vec_xyz r_ij = HOT_R(j) - r_i;
         const float q = length(r_ij) / H;
         if(q >= SUPPORT)
         {
@@ -114,7 +116,7 @@ __kernel void entry(const __global uint* iset,
 
         {
             const vec_xyz n_j = normal[j].XYZ;  // Assumed outwarding oriented
-            const float area_j = m[j];
+            const float area_j = HOT_M(j);
             const float p_j = p[j];
             const vec_xyz du = u[j].XYZ - u_i;
             const float w_ij = kernelW(q) * CONW * area_j;
@@ -122,7 +124,7 @@ __kernel void entry(const __global uint* iset,
             _GRADP_ += (p_i + p_j) / rho_i * w_ij * n_j;
             _DIVU_ += rho_i * dot(du, n_j) * w_ij;
         }
-    }END_LOOP_OVER_NEIGHS()
+    }END_LOOP_OVER_NEIGHBOUR_LIST()
 
     #ifdef LOCAL_MEM_SIZE
         grad_p[i].XYZ = _GRADP_;
@@ -78,13 +78,7 @@ __kernel void entry(const __global int* imove,
     cell.y = (unsigned int)((r[i].y - r_min.y) * idist) + 3u;
     #ifdef HAVE_3D
         cell.z = (unsigned int)((r[i].z - r_min.z) * idist) + 3u;
-        cell_id = cell.x - 1u +
-                  (cell.y - 1u) * n_cells.x +
-                  (cell.z - 1u) * n_cells.x * n_cells.y;
-        gp_icell[i] = cell_id;
-    #else
-        cell_id = cell.x - 1u +
-                  (cell.y - 1u) * n_cells.x;
-        gp_icell[i] = cell_id;
     #endif
+    cell_id = CELL_ID(cell - 1u, n_cells);
+    gp_icell[i] = cell_id;
 }
@@ -58,14 +58,16 @@
  * @param n_cells Number of cells in each direction
  */
 __kernel void entry(const __global int* imove,
-                    const __global vec* r,
-                    const __global vec* u,
-                    const __global float* rho,
-                    const __global float* m,
-                    const __global float* p,
+                    const __global STORAGE(vec, r)* r,
+                    const __global STORAGE(vec, u)* u,
+                    const __global STORAGE(float, rho)* rho,
+                    const __global STORAGE(float, m)* m,
+                    const __global STORAGE(float, p)* p,
                     __global vec* grad_p,
                     __global vec* lap_u,
                     __global float* div_u,
+                    HOT_RECORDS_ARGS
+                    NEIGHBOUR_LIST_ARGS
                     // Link-list data
                     const __global uint *icell,
                     const __global uint *ihoc,
@@ -81,10 +83,10 @@ __kernel void entry(const __global int* imove,
         return;
     }
 
-    const vec_xyz r_i = r[i].XYZ;
-    const vec_xyz u_i = u[i].XYZ;
-    const float p_i = p[i];
-    const float rho_i = rho[i];
+    const vec_xyz r_i = LOAD(vec, r, i).XYZ;
+    const vec_xyz u_i = LOAD(vec, u, i).XYZ;
+    const float p_i = LOAD(float, p, i);
+    const float rho_i = LOAD(float, rho, i);
 
     // Initialize the output
     #ifndef LOCAL_MEM_SIZE
@@ -103,7 +105,7 @@ __kernel void entry(const __global int* imove,
         _DIVU_ = 0.f;
     #endif
 
-    BEGIN_LOOP_OVER_NEIGHS(){
+    BEGIN_LOOP_OVER_NEIGHBOUR_LIST(){
         if(i == j){
             j++;
             continue;
@@ -112,7 +114,7 @@ __kernel void entry(const __global int* imove,
             j++;
             continue;
         }
-        const vec_xyz r_ij = r[j].XYZ - r_i;
+        const vec_xyz r_ij = HOT_R(j) - r_i;
         const float q = length(r_ij) / H;
         if(q >= SUPPORT)
         {
@@ -120,10 +122,11 @@ __kernel void entry(const __global int* imove,
             continue;
         }
         {
-            const float rho_j = rho[j];
-            const float p_j = p[j];
-            const float udr = dot(u[j].XYZ - u_i, r_ij);
-            const float f_ij = kernelF(q) * CONF * m[j];
+            const float rho_j = HOT_RHO(j);
+            const float p_j = HOT_P(j);
+            const vec_xyz u_ij = HOT_U(j) - u_i;
+            const float udr = dot(u_ij, r_ij);
+            const float f_ij = kernelF(q) * CONF * HOT_M(j);
 
             _GRADP_ += (p_i + p_j) / (rho_i * rho_j) * f_ij * r_ij;
 
@@ -131,14 +134,14 @@ __kernel void entry(const __global int* imove,
                 const float r2 = (q * q + 0.01f) * H * H;
                 _LAPU_ += f_ij * __CLEARY__ * udr / (r2 * rho_i * rho_j) * r_ij;
             #elif __LAP_FORMULATION__ == __LAP_MORRIS__
-                _LAPU_ += f_ij * 2.f / (rho_i * rho_j) * (u[j].XYZ - u_i);
+                _LAPU_ += f_ij * 2.f / (rho_i * rho_j) * u_ij;
             #else
                 #error Unknown Laplacian formulation: __LAP_FORMULATION__
             #endif
 
             _DIVU_ += udr * f_ij * rho_i / rho_j;
         }
-    }END_LOOP_OVER_NEIGHS()
+    }END_LOOP_OVER_NEIGHBOUR_LIST()
 
     #ifdef LOCAL_MEM_SIZE
         grad_p[i].XYZ = _GRADP_;
@@ -54,11 +54,11 @@
  */
 __kernel void entry(const __global uint* iset,
                     const __global int* imove,
-                    const __global float* rho,
+                    const __global STORAGE(float, rho)* rho,
                     const __global vec* grad_p,
                     const __global vec* lap_u,
                     const __global float* div_u,
-                    __global vec* dudt,
+                    __global STORAGE(vec, dudt)* dudt,
                     __global float* drhodt,
                     __constant float* visc_dyn,
                     unsigned int N,
@@ -71,7 +71,7 @@ __kernel void entry(const __global uint* iset,
         return;
 
     // Momentum equation
-    dudt[i] = -grad_p[i] + visc_dyn[iset[i]] * lap_u[i] + g;
+    STORE(vec, dudt, i, -grad_p[i] + visc_dyn[iset[i]] * lap_u[i] + g);
     // Conservation of mass equation
     drhodt[i] = -div_u[i];
 }
\ No newline at end of file
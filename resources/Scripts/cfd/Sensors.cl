@@ -56,11 +56,12 @@
  */
 __kernel void entry(const __global uint* iset,
                     const __global int* imove,
-                    const __global vec* r,
-                    const __global float* m,
-                    __global vec* u,
-                    __global float* rho,
-                    __global float* p,
+                    const __global STORAGE(vec, r)* r,
+                    const __global STORAGE(float, m)* m,
+                    __global STORAGE(vec, u)* u,
+                    __global STORAGE(float, rho)* rho,
+                    __global STORAGE(float, p)* p,
+                    NEIGHBOUR_LIST_ARGS
                     // Link-list data
                     const __global uint *icell,
                     const __global uint *ihoc,
@@ -77,26 +78,24 @@ __kernel void entry(const __global uint* iset,
         return;
     }
 
-    const vec_xyz r_i = r[i].XYZ;
+    const vec_xyz r_i = LOAD(vec, r, i).XYZ;
 
     // Initialize the output
     #ifndef LOCAL_MEM_SIZE
-        #define _U_ u[i].XYZ
-        #define _RHO_ rho[i]
-        #define _P_ p[i]
+        // The velocity may be packed, so it is accumulated in private memory
+        vec_xyz u_i;
+        #define _U_ u_i
     #else
         #define _U_ u_l[it]
-        #define _RHO_ rho_l[it]
-        #define _P_ p_l[it]
         __local vec_xyz u_l[LOCAL_MEM_SIZE];
-        __local float rho_l[LOCAL_MEM_SIZE];
-        __local float p_l[LOCAL_MEM_SIZE];
     #endif
+    // The density and the pressure may be stored in half precision, so they
+    // are accumulated in private memory
+    float rho_i = 0.f;
+    float p_i = 0.f;
     _U_ = VEC_ZERO.XYZ;
-    _RHO_ = 0.f;
-    _P_ = 0.f;
 
-    BEGIN_LOOP_OVER_NEIGHS(){
+    BEGIN_LOOP_OVER_NEIGHBOUR_LIST(){
         if(i == j){
             j++;
             continue;
@@ -105,7 +104,7 @@ __kernel void entry(const __global uint* iset,
             j++;
             continue;
         }
-        const vec_xyz r_ij = r[j].XYZ - r_i;
+        const vec_xyz r_ij = LOAD(vec, r, j).XYZ - r_i;
         const float q = length(r_ij) / H;
         if(q >= SUPPORT)
         {
@@ -113,21 +112,21 @@ __kernel void entry(const __global uint* iset,
             continue;
         }
         {
-            const float rho_j = rho[j];
-            const float m_j = m[j];
-            const float p_j = p[j];
-            const vec_xyz u_j = u[j].XYZ;
+            const float rho_j = LOAD(float, rho, j);
+            const float m_j = LOAD(float, m, j);
+            const float p_j = LOAD(float, p, j);
+            const vec_xyz u_j = LOAD(vec, u, j).XYZ;
             const float w_ij = kernelW(q) * CONW * m_j / rho_j;
 
             _U_ += u_j * w_ij;
-            _RHO_ += rho_j * w_ij;
-            _P_ += p_j * w_ij;
+            rho_i += rho_j * w_ij;
+            p_i += p_j * w_ij;
         }
-    }END_LOOP_OVER_NEIGHS()
+    }END_LOOP_OVER_NEIGHBOUR_LIST()
 
-    #ifdef LOCAL_MEM_SIZE
-        u[i].XYZ = _U_;
-        rho[i] = _RHO_;
-        p[i] = _P_;
-    #endif
+    vec u_w = LOAD(vec, u, i);
+    u_w.XYZ = _U_;
+    STORE(vec, u, i, u_w);
+    STORE(float, rho, i, rho_i);
+    STORE(float, p, i, p_i);
 }
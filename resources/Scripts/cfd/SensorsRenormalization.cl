@@ -40,10 +40,10 @@
  * @see Sensors.cl
  */
 __kernel void entry(const __global int* imove,
-                    const __global float* shepard,
-                    __global vec* u,
-                    __global float* rho,
-                    __global float* p,
+                    const __global STORAGE(float, shepard)* shepard,
+                    __global STORAGE(vec, u)* u,
+                    __global STORAGE(float, rho)* rho,
+                    __global STORAGE(float, p)* p,
                     unsigned int N,
                     float dt,
                     vec g)
@@ -54,14 +54,14 @@ __kernel void entry(const __global int* imove,
     if(imove[i] != 0)
         return;
 
-    float shepard_i = shepard[i];
+    float shepard_i = LOAD(float, shepard, i);
     if(shepard_i < 1.0E-6f){
         // It will be considered that there are not enough
         // particles to interpolate
         shepard_i = 1.f;
     }
 
-    u[i] /= shepard_i;
-    rho[i] /= shepard_i;
-    p[i] /= shepard_i;
+    STORE(vec, u, i, LOAD(vec, u, i) / shepard_i);
+    STORE(float, rho, i, LOAD(float, rho, i) / shepard_i);
+    STORE(float, p, i, LOAD(float, p, i) / shepard_i);
 }
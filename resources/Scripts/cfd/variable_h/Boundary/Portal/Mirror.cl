@@ -38,13 +38,8 @@ unsigned int cell(vec r, vec r_min, float h, uivec4 n_cells)
     cell.y = (unsigned int)((r.y - r_min.y) * idist) + 3u;
     #ifdef HAVE_3D
         cell.z = (unsigned int)((r.z - r_min.z) * idist) + 3u;
-        return cell.x - 1u +
-               (cell.y - 1u) * n_cells.x +
-               (cell.z - 1u) * n_cells.x * n_cells.y;
-    #else
-        return cell.x - 1u +
-               (cell.y - 1u) * n_cells.x;
     #endif
+    return CELL_ID(cell - 1u, n_cells);
 }
 
 /** @brief Compute the mirrored position of the fluid particles.
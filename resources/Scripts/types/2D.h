@@ -155,6 +155,68 @@
  */
 #define C_I() const uint c_i = icell[i]
 
+#ifndef HAVE_MORTON_CELLS
+/** @brief Index of a cell.
+ *
+ * By default the cells are linearly numbered, i.e. x + y * n_x
+ *
+ * @param c Cell coordinates, starting at 0.
+ * @param n_cells Number of cells in each direction.
+ * @see HAVE_MORTON_CELLS
+ */
+#define CELL_ID(c, n_cells) ((c).x + (c).y * (n_cells).x)
+
+/** @brief Coordinates of a cell, i.e. the inverse of CELL_ID().
+ *
+ * @param id Cell index.
+ * @param n_cells Number of cells in each direction.
+ */
+#define CELL_COORDS(id, n_cells) (                                             \
+    (uivec)((id) % (n_cells).x, (id) / (n_cells).x))
+#else
+/** @brief Spread the 4 bits of a tile coordinate, leaving room to interleave
+ * the other coordinate.
+ */
+#define _MORTON_SPREAD(v) (((v) & 1u) | (((v) & 2u) << 1) |                    \
+                           (((v) & 4u) << 2) | (((v) & 8u) << 3))
+
+/** @brief Inverse of _MORTON_SPREAD()
+ */
+#define _MORTON_COMPACT(m) (((m) & 1u) | (((m) >> 1) & 2u) |                   \
+                            (((m) >> 2) & 4u) | (((m) >> 3) & 8u))
+
+/** @brief Number of tiles of 16 cells in a direction.
+ */
+#define CELL_TILES(n) (((n) + 15u) >> 4)
+
+/** @brief Index of a cell.
+ *
+ * If HAVE_MORTON_CELLS is defined (see resources/Presets/basic/mortonCells.xml)
+ * the cells are grouped in tiles of 16x16 cells, which are linearly numbered,
+ * while the cells inside each tile are numbered along the Morton (Z-order)
+ * curve. Hence, the cells which are close in the space are close in memory
+ * as well.
+ *
+ * @param c Cell coordinates, starting at 0.
+ * @param n_cells Number of cells in each direction.
+ */
+#define CELL_ID(c, n_cells) (                                                  \
+    ((((c).x >> 4) + ((c).y >> 4) * CELL_TILES((n_cells).x)) << 8)             \
+    | _MORTON_SPREAD((c).x & 15u)                                              \
+    | (_MORTON_SPREAD((c).y & 15u) << 1))
+
+/** @brief Coordinates of a cell, i.e. the inverse of CELL_ID().
+ *
+ * @param id Cell index.
+ * @param n_cells Number of cells in each direction.
+ */
+#define CELL_COORDS(id, n_cells) (                                             \
+    (uivec)(((((id) >> 8) % CELL_TILES((n_cells).x)) << 4)                    \
+                | _MORTON_COMPACT((id) & 255u),                                \
+            ((((id) >> 8) / CELL_TILES((n_cells).x)) << 4)                     \
+                | _MORTON_COMPACT(((id) & 255u) >> 1)))
+#endif
+
 /** @brief Loop over the neighs to compute the interactions.
  * 
  * All the code between this macro and END_LOOP_OVER_NEIGHS will be executed for
@@ -173,10 +235,13 @@
  *   - cj: Index of the cell of the neighbour particle j, in the x direction
  *   - ck: Index of the cell of the neighbour particle j, in the x direction
  *   - c_j: Index of the cell of the neighbour particle j
+ *   - c_i_coords: The coordinates of the cell c_i, just if HAVE_MORTON_CELLS
+ *     is defined
  *   - j: Index of the neighbour particle.
  *
  * @see END_LOOP_OVER_NEIGHS
  */
+#ifndef HAVE_MORTON_CELLS
 #define BEGIN_LOOP_OVER_NEIGHS()                                               \
     C_I();                                                                     \
     for(int ci = -1; ci <= 1; ci++) {                                          \
@@ -186,6 +251,18 @@
                              cj * n_cells.x;                                   \
             uint j = ihoc[c_j];                                                \
             while((j < N) && (icell[j] == c_j)) {
+#else
+#define BEGIN_LOOP_OVER_NEIGHS()                                               \
+    C_I();                                                                     \
+    const uivec c_i_coords = CELL_COORDS(c_i, n_cells);                        \
+    for(int ci = -1; ci <= 1; ci++) {                                          \
+        for(int cj = -1; cj <= 1; cj++) {                                      \
+            const uint c_j = CELL_ID(c_i_coords + (uivec)((uint)ci,            \
+                                                          (uint)cj),           \
+                                     n_cells);                                 \
+            uint j = ihoc[c_j];                                                \
+            while((j < N) && (icell[j] == c_j)) {
+#endif
 
 /** @brief End of the loop over the neighs to compute the interactions.
  * 
@@ -171,6 +171,79 @@
  */
 #define C_I() const uint c_i = icell[i]
 
+#ifndef HAVE_MORTON_CELLS
+/** @brief Index of a cell.
+ *
+ * By default the cells are linearly numbered, i.e. x + y * n_x + z * n_x * n_y
+ *
+ * @param c Cell coordinates, starting at 0.
+ * @param n_cells Number of cells in each direction.
+ * @see HAVE_MORTON_CELLS
+ */
+#define CELL_ID(c, n_cells) ((c).x +                                           \
+                             (c).y * (n_cells).x +                             \
+                             (c).z * (n_cells).x * (n_cells).y)
+
+/** @brief Coordinates of a cell, i.e. the inverse of CELL_ID().
+ *
+ * @param id Cell index.
+ * @param n_cells Number of cells in each direction.
+ */
+#define CELL_COORDS(id, n_cells) (                                             \
+    (uivec)((id) % (n_cells).x,                                                \
+            ((id) / (n_cells).x) % (n_cells).y,                                \
+            (id) / ((n_cells).x * (n_cells).y),                                \
+            0u))
+#else
+/** @brief Spread the 3 bits of a tile coordinate, leaving room to interleave
+ * the other coordinates.
+ */
+#define _MORTON_SPREAD(v) (((v) & 1u) | (((v) & 2u) << 2) | (((v) & 4u) << 4))
+
+/** @brief Inverse of _MORTON_SPREAD()
+ */
+#define _MORTON_COMPACT(m) (((m) & 1u) | (((m) >> 2) & 2u) | (((m) >> 4) & 4u))
+
+/** @brief Number of tiles of 8 cells in a direction.
+ */
+#define CELL_TILES(n) (((n) + 7u) >> 3)
+
+/** @brief Index of a cell.
+ *
+ * If HAVE_MORTON_CELLS is defined (see resources/Presets/basic/mortonCells.xml)
+ * the cells are grouped in tiles of 8x8x8 cells, which are linearly numbered,
+ * while the cells inside each tile are numbered along the Morton (Z-order)
+ * curve. Hence, the cells which are close in the space are close in memory
+ * as well.
+ *
+ * @param c Cell coordinates, starting at 0.
+ * @param n_cells Number of cells in each direction.
+ */
+#define CELL_ID(c, n_cells) (                                                  \
+    ((((c).x >> 3) +                                                           \
+      ((c).y >> 3) * CELL_TILES((n_cells).x) +                                 \
+      ((c).z >> 3) * CELL_TILES((n_cells).x) * CELL_TILES((n_cells).y)) << 9) \
+    | _MORTON_SPREAD((c).x & 7u)                                               \
+    | (_MORTON_SPREAD((c).y & 7u) << 1)                                        \
+    | (_MORTON_SPREAD((c).z & 7u) << 2))
+
+/** @brief Coordinates of a cell, i.e. the inverse of CELL_ID().
+ *
+ * @param id Cell index.
+ * @param n_cells Number of cells in each direction.
+ */
+#define CELL_COORDS(id, n_cells) (                                             \
+    (uivec)(((((id) >> 9) % CELL_TILES((n_cells).x)) << 3)                    \
+                | _MORTON_COMPACT((id) & 511u),                                \
+            (((((id) >> 9) / CELL_TILES((n_cells).x))                          \
+                % CELL_TILES((n_cells).y)) << 3)                               \
+                | _MORTON_COMPACT(((id) & 511u) >> 1),                         \
+            ((((id) >> 9) / (CELL_TILES((n_cells).x)                           \
+                             * CELL_TILES((n_cells).y))) << 3)                 \
+                | _MORTON_COMPACT(((id) & 511u) >> 2),                         \
+            0u))
+#endif
+
 /** @brief Loop over the neighs to compute the interactions.
  * 
  * All the code between this macro and END_LOOP_OVER_NEIGHS will be executed for
@@ -189,10 +262,13 @@
  *   - cj: Index of the cell of the neighbour particle j, in the x direction
  *   - ck: Index of the cell of the neighbour particle j, in the x direction
  *   - c_j: Index of the cell of the neighbour particle j
+ *   - c_i_coords: The coordinates of the cell c_i, just if HAVE_MORTON_CELLS
+ *     is defined
  *   - j: Index of the neighbour particle.
  *
  * @see END_LOOP_OVER_NEIGHS
  */
+#ifndef HAVE_MORTON_CELLS
 #define BEGIN_LOOP_OVER_NEIGHS()                                               \
     C_I();                                                                     \
     for(int ci = -1; ci <= 1; ci++) {                                          \
@@ -204,6 +280,21 @@
                                  ck * n_cells.x * n_cells.y;                   \
                 uint j = ihoc[c_j];                                            \
                 while((j < N) && (icell[j] == c_j)) {
+#else
+#define BEGIN_LOOP_OVER_NEIGHS()                                               \
+    C_I();                                                                     \
+    const uivec c_i_coords = CELL_COORDS(c_i, n_cells);                        \
+    for(int ci = -1; ci <= 1; ci++) {                                          \
+        for(int cj = -1; cj <= 1; cj++) {                                      \
+            for(int ck = -1; ck <= 1; ck++) {                                  \
+                const uint c_j = CELL_ID(c_i_coords + (uivec)((uint)ci,        \
+                                                              (uint)cj,        \
+                                                              (uint)ck,        \
+                                                              0u),             \
+                                         n_cells);                             \
+                uint j = ihoc[c_j];                                            \
+                while((j < N) && (icell[j] == c_j)) {
+#endif
 
 /** @brief End of the loop over the neighs to compute the interactions.
  * 
@@ -23,8 +23,215 @@
  * on HAVE_3D
  */
 
+#ifndef _TYPES_H_INCLUDED_
+#define _TYPES_H_INCLUDED_
+
 #ifdef HAVE_3D
     #include "resources/Scripts/types/3D.h"
 #else
     #include "resources/Scripts/types/2D.h"
-#endif
\ No newline at end of file
+#endif
+
+#ifndef _HALF_STORAGE
+/** @brief Probes used to detect the arrays with a non-native storage.
+ *
+ * The computational server is defining STORAGE_name=_HALF_STORAGE for each
+ * array "name" declared with storage="half" in the XML definition, and
+ * STORAGE_name=_PACKED_STORAGE for the ones declared with storage="packed".
+ * @see STORAGE()
+ */
+#define _HALF_STORAGE ~, 1
+#define _PACKED_STORAGE ~, 2
+
+/** @brief Helper functions for the storage detection.
+ *
+ * _STORAGE_ID(name) is expanded to 1 if STORAGE_name is defined as
+ * _HALF_STORAGE, 2 if it is defined as _PACKED_STORAGE, and 0 otherwise.
+ */
+#define _SECOND(a, b, ...) b
+#define _EXPAND_SECOND(...) _SECOND(__VA_ARGS__)
+#define _STORAGE_ID(name) _EXPAND_SECOND(STORAGE_ ## name, 0, ~)
+#define _CAT(a, b) a ## b
+#define CAT(a, b) _CAT(a, b)
+
+/** @brief Helper functions for LOAD() and STORE() on half precision arrays.
+ *
+ * The vec3 are padded as vec4, in the same way they are padded in float
+ * precision.
+ */
+#define vload_half_float(i, p) vload_half(i, p)
+#define vload_half_float2(i, p) vload_half2(i, p)
+#define vload_half_float3(i, p) vload_half4(i, p).xyz
+#define vload_half_float4(i, p) vload_half4(i, p)
+#define vstore_half_float(v, i, p) vstore_half(v, i, p)
+#define vstore_half_float2(v, i, p) vstore_half2(v, i, p)
+#define vstore_half_float3(v, i, p) vstore_half4((float4)(v, 0.f), i, p)
+#define vstore_half_float4(v, i, p) vstore_half4(v, i, p)
+
+/** @brief Helper functions for LOAD() and STORE() on packed arrays.
+ *
+ * Just 3 components are stored, so the fourth component of the 3D vec is
+ * read as 0.
+ */
+#define vload3_float3(i, p) vload3(i, p)
+#define vload3_float4(i, p) (float4)(vload3(i, p), 0.f)
+#define vstore3_float3(v, i, p) vstore3(v, i, p)
+#define vstore3_float4(v, i, p) vstore3((v).xyz, i, p)
+
+#define _STORAGE_0(T) T
+#define _STORAGE_1(T) half
+#define _STORAGE_2(T) float
+#define _LOAD_0(T, p, i) p[i]
+#define _LOAD_1(T, p, i) CAT(vload_half_, T)(i, p)
+#define _LOAD_2(T, p, i) CAT(vload3_, T)(i, p)
+#define _STORE_0(T, p, i, v) p[i] = (v)
+#define _STORE_1(T, p, i, v) CAT(vstore_half_, T)(v, i, p)
+#define _STORE_2(T, p, i, v) CAT(vstore3_, T)(v, i, p)
+
+/** @brief Storage type of an array argument.
+ *
+ * The float and vec arrays can be stored in half precision (see the
+ * attribute storage="half" of the variables XML definition), while the maths
+ * are still carried out in float precision. Similarly, the 3D vec and vec3
+ * arrays can be packed as 3 floats per component (see the attribute
+ * storage="packed"), saving the padding. Hence, the kernels willing to
+ * operate on such arrays should declare the arguments as
+ * @code{.c}
+ * const __global STORAGE(float, rho)* rho
+ * @endcode
+ * and access to them by means of LOAD() and STORE().
+ *
+ * @param T Native type, i.e. float, vec, vec2, vec3 or vec4.
+ * @param name Argument name, which should match the variable name.
+ */
+#define STORAGE(T, name) CAT(_STORAGE_, _STORAGE_ID(name))(T)
+
+/** @brief Load a component of an array argument.
+ * @param T Native type, i.e. float, vec, vec2, vec3 or vec4.
+ * @param name Argument name, which should match the variable name.
+ * @param i Component index.
+ * @return The component, in float precision.
+ * @see STORAGE()
+ */
+#define LOAD(T, name, i) CAT(_LOAD_, _STORAGE_ID(name))(T, name, i)
+
+/** @brief Store a component of an array argument.
+ * @param T Native type, i.e. float, vec, vec2, vec3 or vec4.
+ * @param name Argument name, which should match the variable name.
+ * @param i Component index.
+ * @param v Value, in float precision.
+ * @see STORAGE()
+ */
+#define STORE(T, name, i, v) CAT(_STORE_, _STORAGE_ID(name))(T, name, i, v)
+#endif
+
+#ifndef HOT_RECORDS_ARGS
+#ifdef HAVE_HOT_RECORDS
+/** @brief Arguments of the hot particle records.
+ *
+ * The neighbours loops are reading the position, velocity, mass, density and
+ * pressure of each neighbour. If the hot records are enabled (see
+ * resources/Presets/basic/hotRecords.xml), such fields are interleaved in
+ * two vec4 arrays, rebuilt at the end of the sorting stage, such that fewer
+ * memory streams are accessed per pair:
+ *   - hot_r: Position in the first components, and mass in the w one.
+ *   - hot_u: Velocity in the first components, and density in the w one.
+ *     In 2D the pressure is placed in the z component.
+ *
+ * Hence, the kernels should add this macro to the arguments list, and read
+ * the neighbours data by means of HOT_R(), HOT_M(), HOT_U(), HOT_RHO() and
+ * HOT_P(). The arrays are used otherwise.
+ */
+#define HOT_RECORDS_ARGS const __global vec4* hot_r, const __global vec4* hot_u,
+
+/** @brief Position of the neighbour j.
+ * @see HOT_RECORDS_ARGS
+ */
+#define HOT_R(j) hot_r[j].XYZ
+/** @brief Mass of the neighbour j.
+ * @see HOT_RECORDS_ARGS
+ */
+#define HOT_M(j) hot_r[j].w
+/** @brief Velocity of the neighbour j.
+ * @see HOT_RECORDS_ARGS
+ */
+#define HOT_U(j) hot_u[j].XYZ
+/** @brief Density of the neighbour j.
+ * @see HOT_RECORDS_ARGS
+ */
+#define HOT_RHO(j) hot_u[j].w
+/** @brief Pressure of the neighbour j.
+ * @see HOT_RECORDS_ARGS
+ */
+#ifdef HAVE_3D
+    #define HOT_P(j) LOAD(float, p, j)
+#else
+    #define HOT_P(j) hot_u[j].z
+#endif
+#else
+#define HOT_RECORDS_ARGS
+#define HOT_R(j) LOAD(vec, r, j).XYZ
+#define HOT_M(j) LOAD(float, m, j)
+#define HOT_U(j) LOAD(vec, u, j).XYZ
+#define HOT_RHO(j) LOAD(float, rho, j)
+#define HOT_P(j) LOAD(float, p, j)
+#endif
+#endif
+
+#ifndef NEIGHBOUR_LIST_ARGS
+#ifdef HAVE_NEIGHBOUR_LIST
+/** @brief Arguments of the Verlet neighbour lists.
+ *
+ * If the neighbour lists are enabled (see
+ * resources/Presets/basic/neighbourList.xml), the neighbours of each particle
+ * within a distance support * h + neigh_skin are stored, and the lists are
+ * rebuilt just when some particle has moved more than neigh_skin / 2. The
+ * lists are indexed by the original particle index, id, such that they are
+ * not affected by the sorting:
+ *   - neigh_n: Number of neighbours of each particle.
+ *   - neigh_list: neigh_list_capacity neighbours per particle.
+ *
+ * Hence, the kernels should add this macro to the arguments list, and loop
+ * over the neighbours by means of BEGIN_LOOP_OVER_NEIGHBOUR_LIST() and
+ * END_LOOP_OVER_NEIGHBOUR_LIST(). The link-list is traversed otherwise.
+ */
+#define NEIGHBOUR_LIST_ARGS const __global uint* id,                           \
+                            const __global uint* id_inverse,                   \
+                            const __global uint* neigh_n,                      \
+                            const __global uint* neigh_list,                   \
+                            uint neigh_list_capacity,
+
+/** @brief Loop over the stored neighbours of the particle i.
+ *
+ * It is a replacement of BEGIN_LOOP_OVER_NEIGHS(), i.e. the neighbour will be
+ * identified by the unsigned integer variable j, which can be increased
+ * before \code{.c}continue\endcode. The neighbours beyond support * h are
+ * visited as well, so the kernels should discard them as usual.
+ *
+ * The following variables will be declared, and therefore cannot be used
+ * elsewhere:
+ *   - neigh_row: First neighbour of the particle i in neigh_list.
+ *   - neigh_count: Number of neighbours of the particle i.
+ *   - neigh_k: Index of the neighbour in the list.
+ *   - j: Index of the neighbour particle.
+ *
+ * @see NEIGHBOUR_LIST_ARGS
+ */
+#define BEGIN_LOOP_OVER_NEIGHBOUR_LIST()                                       \
+    const uint neigh_row = id[i] * neigh_list_capacity;                        \
+    const uint neigh_count = min(neigh_n[id[i]], neigh_list_capacity);         \
+    for(uint neigh_k = 0; neigh_k < neigh_count; neigh_k++) {                  \
+        uint j = id_inverse[neigh_list[neigh_row + neigh_k]];
+
+/** @brief End of the loop over the stored neighbours.
+ * @see BEGIN_LOOP_OVER_NEIGHBOUR_LIST
+ */
+#define END_LOOP_OVER_NEIGHBOUR_LIST() }
+#else
+#define NEIGHBOUR_LIST_ARGS
+#define BEGIN_LOOP_OVER_NEIGHBOUR_LIST() BEGIN_LOOP_OVER_NEIGHS()
+#define END_LOOP_OVER_NEIGHBOUR_LIST() END_LOOP_OVER_NEIGHS()
+#endif
+#endif
+
+#endif // _TYPES_H_INCLUDED_
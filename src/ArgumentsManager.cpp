@@ -33,9 +33,14 @@
 
 // Short and long runtime options (see
 // http://www.gnu.org/software/libc/manual/html_node/Getopt.html#Getopt)
-static const char *opts = "i:vh";
+static const char *opts = "i:r:n:s:c:wvh";
 static const struct option longOpts[] = {
     { "input", required_argument, NULL, 'i' },
+    { "rank", required_argument, NULL, 'r' },
+    { "ranks", required_argument, NULL, 'n' },
+    { "socket", required_argument, NULL, 's' },
+    { "cache", required_argument, NULL, 'c' },
+    { "prewarm", no_argument, NULL, 'w' },
     { "version", no_argument, NULL, 'v' },
     { "help", no_argument, NULL, 'h' },
     { NULL, no_argument, NULL, 0 }
@@ -60,6 +65,16 @@ void displayUsage()
               << "the short ones." << std::endl;
     std::cout << "  -i, --input=INPUT            XML definition input file "
               << "(Input.xml by default)" << std::endl;
+    std::cout << "  -r, --rank=RANK              Rank of this process in a "
+              << "multi-process run (0 by default)" << std::endl;
+    std::cout << "  -n, --ranks=RANKS            Number of processes of a "
+              << "multi-process run (1 by default)" << std::endl;
+    std::cout << "  -s, --socket=PATH            Sockets base path of a "
+              << "multi-process run (/tmp/aquagpusph by default)" << std::endl;
+    std::cout << "  -c, --cache=PATH             Compiled programs cache "
+              << "folder (disabled by default)" << std::endl;
+    std::cout << "  -w, --prewarm                Just compile the programs, "
+              << "filling the cache, and exit" << std::endl;
     std::cout << "  -v, --version                Show the AQUAgpusph version" << std::endl;
     std::cout << "  -h, --help                   Show this help page" << std::endl;
 }
@@ -79,6 +94,46 @@ void parse(int argc, char **argv, FileManager &file_manager)
                 LOG(L_INFO, msg.str());
                 break;
 
+            case 'r':
+                file_manager.problemSetup().settings.rank = atoi(optarg);
+                msg.str(std::string());
+                msg << "Process rank = "
+                    << file_manager.problemSetup().settings.rank << std::endl;
+                LOG(L_INFO, msg.str());
+                break;
+
+            case 'n':
+                file_manager.problemSetup().settings.n_ranks = atoi(optarg);
+                msg.str(std::string());
+                msg << "Number of processes = "
+                    << file_manager.problemSetup().settings.n_ranks
+                    << std::endl;
+                LOG(L_INFO, msg.str());
+                break;
+
+            case 's':
+                file_manager.problemSetup().settings.transport_path = optarg;
+                msg.str(std::string());
+                msg << "Sockets path = "
+                    << file_manager.problemSetup().settings.transport_path
+                    << std::endl;
+                LOG(L_INFO, msg.str());
+                break;
+
+            case 'c':
+                file_manager.problemSetup().settings.cache_path = optarg;
+                msg.str(std::string());
+                msg << "Programs cache = "
+                    << file_manager.problemSetup().settings.cache_path
+                    << std::endl;
+                LOG(L_INFO, msg.str());
+                break;
+
+            case 'w':
+                file_manager.problemSetup().settings.prewarm = true;
+                LOG(L_INFO, "Programs cache prewarm\n");
+                break;
+
             case 'v':
                 std::cout << "VERSION: " << PACKAGE_VERSION << std::endl << std::endl;
                 return;
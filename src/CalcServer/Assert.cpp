@@ -30,14 +30,30 @@
 
 namespace Aqua{ namespace CalcServer{
 
-Assert::Assert(const std::string name, const std::string condition, bool once)
+Assert::Assert(const std::string name,
+               const std::string condition,
+               bool once,
+               bool device)
     : Tool(name, once)
     , _condition(condition)
+    , _expr(NULL)
+    , _result(1)
+    , _event(NULL)
 {
+    // The tools ran just once would never check the device result
+    if(device && !once){
+        std::stringstream expr_name;
+        expr_name << name << "->Condition";
+        _expr = new ScalarExpression(expr_name.str(), condition, "int");
+    }
 }
 
 Assert::~Assert()
 {
+    if(_event) clReleaseEvent(_event);
+    _event=NULL;
+    if(_expr) delete _expr;
+    _expr=NULL;
 }
 
 void Assert::setup()
@@ -45,6 +61,21 @@ void Assert::setup()
     std::ostringstream msg;
     msg << "Loading the tool \"" << name() << "\"..." << std::endl;
     LOG(L_INFO, msg.str());
+
+    std::vector<InputOutput::Variable*> inputs, outputs;
+    if(_expr){
+        _expr->setup();
+        inputs = _expr->variables();
+    }
+    // Otherwise the condition is evaluated in the host, so it is not depending
+    // on any device data
+    setDependencies(inputs, outputs);
+}
+
+void Assert::synchronize()
+{
+    // The device has already finished, so the result is available
+    check();
 }
 
 
@@ -53,6 +84,11 @@ void Assert::_execute()
     int result;
     InputOutput::Variables *vars = CalcServer::singleton()->variables();
 
+    if(_expr){
+        executeDevice();
+        return;
+    }
+
     void *data = malloc(sizeof(int));
     if(!data){
         std::stringstream msg;
@@ -75,4 +111,65 @@ void Assert::_execute()
     }
 }
 
+void Assert::executeDevice()
+{
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+
+    // Check the previous result before overwriting it
+    check();
+
+    _expr->execute();
+
+    // Get back the result, without waiting for it
+    cl_event *profiling_event = profilingEvent();
+    err_code = clEnqueueReadBuffer(C->command_queue(),
+                                   _expr->output(),
+                                   CL_FALSE,
+                                   0,
+                                   sizeof(int),
+                                   &_result,
+                                   0,
+                                   NULL,
+                                   &_event);
+    if(err_code != CL_SUCCESS) {
+        std::ostringstream msg;
+        msg << "Failure reading back the result within the tool \""
+            << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+    if(profiling_event && (clRetainEvent(_event) == CL_SUCCESS))
+        *profiling_event = _event;
+}
+
+void Assert::check()
+{
+    cl_int err_code;
+
+    if(!_event)
+        return;
+
+    err_code = clWaitForEvents(1, &_event);
+    clReleaseEvent(_event);
+    _event = NULL;
+    if(err_code != CL_SUCCESS) {
+        std::ostringstream msg;
+        msg << "Failure waiting for the result within the tool \""
+            << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+
+    if(_result == 0){
+        std::stringstream msg;
+        msg << "Assertion error. The expression \"" <<
+               std::string(_condition) << "\" is false" << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Assertion error");
+    }
+}
+
 }}  // namespaces
@@ -22,13 +22,18 @@
  */
 
 #include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <algorithm>
 #include <limits>
+#include <set>
 
 #include <CalcServer.h>
 #include <AuxiliarMethods.h>
 #include <InputOutput/Logger.h>
 #include <CalcServer/Assert.h>
 #include <CalcServer/Copy.h>
+#include <CalcServer/ElementWise.h>
 #include <CalcServer/Kernel.h>
 #include <CalcServer/LinkList.h>
 #include <CalcServer/Python.h>
@@ -37,6 +42,8 @@
 #include <CalcServer/Set.h>
 #include <CalcServer/SetScalar.h>
 #include <CalcServer/UnSort.h>
+#include <CalcServer/Halo.h>
+#include <CalcServer/UnixSocketTransport.h>
 #include <CalcServer/Reports/Performance.h>
 #include <CalcServer/Reports/Screen.h>
 #include <CalcServer/Reports/TabFile.h>
@@ -54,12 +61,26 @@ CalcServer::CalcServer(const Aqua::InputOutput::ProblemSetup& sim_data)
     , _platform(NULL)
     , _device(NULL)
     , _command_queue(NULL)
+    , _transport(NULL)
+    , _program_cache(NULL)
+    , _memory_pool(NULL)
     , _current_tool_name(NULL)
     , _sim_data(sim_data)
 {
     unsigned int i, j;
 
     setupOpenCL();
+    _program_cache = new ProgramCache(_context,
+                                      _sim_data.settings.cache_path);
+    // The scratch memory can be shared just if the tools are sequentially
+    // executed
+    _memory_pool = new MemoryPool(_context, _queues.size() < 2);
+
+    if(_sim_data.settings.n_ranks > 1){
+        _transport = new UnixSocketTransport(_sim_data.settings.rank,
+                                             _sim_data.settings.n_ranks,
+                                             _sim_data.settings.transport_path);
+    }
 
     _base_path = _sim_data.settings.base_path;
     _current_tool_name = new char[256];
@@ -71,8 +92,8 @@ CalcServer::CalcServer(const Aqua::InputOutput::ProblemSetup& sim_data)
         N += set->n();
     }
 
-    unsigned int num_icell = nextPowerOf2(N);
-    num_icell = roundUp(num_icell, _ITEMS*_GROUPS);
+    // The radix sort can handle any number of keys, so no padding is required
+    unsigned int num_icell = N;
 
     // Register default scalars
     std::ostringstream valstr;
@@ -94,8 +115,14 @@ CalcServer::CalcServer(const Aqua::InputOutput::ProblemSetup& sim_data)
     _vars.registerVariable("end_frame", "unsigned int", "", valstr.str());
     valstr.str(""); valstr << N;
     _vars.registerVariable("N", "unsigned int", "", valstr.str());
+    // Number of active particles, compacted at the front by the link-list
+    _vars.registerVariable("N_active", "unsigned int", "", valstr.str());
     valstr.str(""); valstr << _sim_data.sets.size();
     _vars.registerVariable("n_sets", "unsigned int", "", valstr.str());
+    valstr.str(""); valstr << _sim_data.settings.rank;
+    _vars.registerVariable("rank", "unsigned int", "", valstr.str());
+    valstr.str(""); valstr << _sim_data.settings.n_ranks;
+    _vars.registerVariable("n_ranks", "unsigned int", "", valstr.str());
     valstr.str(""); valstr << num_icell;
     _vars.registerVariable("n_radix", "unsigned int", "", valstr.str());
     // Number of cells in x, y, z directions, and the total (n_x * n_y * n_z)
@@ -119,7 +146,8 @@ CalcServer::CalcServer(const Aqua::InputOutput::ProblemSetup& sim_data)
         _vars.registerVariable(_sim_data.variables.names.at(i),
                                 _sim_data.variables.types.at(i),
                                 _sim_data.variables.lengths.at(i),
-                                _sim_data.variables.values.at(i));
+                                _sim_data.variables.values.at(i),
+                                _sim_data.variables.storages.at(i));
     }
 
     // Register the user definitions
@@ -146,6 +174,21 @@ CalcServer::CalcServer(const Aqua::InputOutput::ProblemSetup& sim_data)
         _definitions.push_back(valstr.str());
     }
 
+    // Let the kernels know the arrays with a non-native storage (see
+    // STORAGE(), LOAD() and STORE() in resources/Scripts/types/types.h)
+    for(auto var : _vars.getAll()){
+        if(var->type().find('*') == std::string::npos)
+            continue;
+        const std::string storage =
+            ((InputOutput::ArrayVariable*)var)->storage();
+        if(!storage.compare(""))
+            continue;
+        valstr.str("");
+        valstr << "-DSTORAGE_" << var->name() << "=_"
+               << (storage.compare("half") ? "PACKED" : "HALF") << "_STORAGE";
+        _definitions.push_back(valstr.str());
+    }
+
     // Register the tools
     for(auto t : _sim_data.tools){
         bool once = false;
@@ -189,7 +232,8 @@ CalcServer::CalcServer(const Aqua::InputOutput::ProblemSetup& sim_data)
             SetScalar *tool = new SetScalar(t->get("name"),
                                             t->get("in"),
                                             t->get("value"),
-                                            once);
+                                            once,
+                                            !t->get("device").compare("true"));
             _tools.push_back(tool);
         }
         else if(!t->get("type").compare("reduction")){
@@ -217,7 +261,16 @@ CalcServer::CalcServer(const Aqua::InputOutput::ProblemSetup& sim_data)
         else if(!t->get("type").compare("assert")){
             Assert *tool = new Assert(t->get("name"),
                                       t->get("condition"),
-                                      once);
+                                      once,
+                                      !t->get("device").compare("true"));
+            _tools.push_back(tool);
+        }
+        else if(!t->get("type").compare("halo")){
+            Halo *tool = new Halo(t->get("name"),
+                                  t->get("fields"),
+                                  std::stoi(t->get("set")),
+                                  t->get("bounds"),
+                                  once);
             _tools.push_back(tool);
         }
         else if(!t->get("type").compare("dummy")){
@@ -225,7 +278,7 @@ CalcServer::CalcServer(const Aqua::InputOutput::ProblemSetup& sim_data)
             _tools.push_back(tool);
         }
         // Reports
-        if(!t->get("type").compare("report_screen")){
+        else if(!t->get("type").compare("report_screen")){
             bool bold = false;
             if(!t->get("bold").compare("true") ||
                !t->get("bold").compare("True")){
@@ -299,6 +352,24 @@ CalcServer::CalcServer(const Aqua::InputOutput::ProblemSetup& sim_data)
             LOG(L_ERROR, msg.str());
             throw std::runtime_error("Invalid tool type");
         }
+
+        // Execution conditions
+        Tool *tool = _tools.back();
+        if(t->get("every").compare("")){
+            unsigned int every;
+            _vars.solve("unsigned int", t->get("every"), &every);
+            tool->every(every);
+        }
+        if(t->get("every_t").compare("")){
+            float every_t;
+            _vars.solve("float", t->get("every_t"), &every_t);
+            tool->everyTime(every_t);
+        }
+        tool->condition(t->get("if"));
+        if(!t->get("fuse").compare("false"))
+            tool->fusable(false);
+        else if(!t->get("fuse").compare("true"))
+            tool->fusable(true);
     }
 
     // Register the reporters
@@ -390,6 +461,27 @@ CalcServer::~CalcServer()
     unsigned int i;
     delete[] _current_tool_name;
 
+    for(auto event : _tools_event){
+        if(event) clReleaseEvent(event);
+    }
+    _tools_event.clear();
+    for(i = 1; i < _queues.size(); i++){
+        clReleaseCommandQueue(_queues.at(i));
+    }
+    _queues.clear();
+
+    // The domains are just owned if the selected device has been partitioned
+    if(_domain_devices.size() > 1){
+        for(auto queue : _domain_queues)
+            clReleaseCommandQueue(queue);
+        for(auto device : _domain_devices)
+            clReleaseDevice(device);
+    }
+    _domain_devices.clear();
+    _domain_queues.clear();
+
+    if(_program_cache) delete _program_cache;
+    _program_cache = NULL;
     if(_context) clReleaseContext(_context); _context = NULL;
     for(i = 0; i < _num_devices; i++){
         if(_command_queues[i]) clReleaseCommandQueue(_command_queues[i]);
@@ -408,6 +500,11 @@ CalcServer::~CalcServer()
     for (auto& unsorter : unsorters) {
         delete unsorter.second;
     }
+
+    if(_transport) delete _transport;
+    _transport = NULL;
+    if(_memory_pool) delete _memory_pool;
+    _memory_pool = NULL;
 }
 
 void CalcServer::update(InputOutput::TimeManager& t_manager)
@@ -418,16 +515,29 @@ void CalcServer::update(InputOutput::TimeManager& t_manager)
 
         // Execute the tools
         strcpy(_current_tool_name, "__pre execution__");
-        for(auto tool : _tools){
+        for(i = 0; i < _tools.size(); i++){
+            Tool *tool = _tools.at(i);
             strncpy(_current_tool_name, tool->name().c_str(), 255);
             _current_tool_name[255] = '\0';
             try {
+                if(_queues.size() > 1){
+                    _command_queue = _tools_queue.at(i);
+                    waitTools(i);
+                }
                 tool->execute();
+                if(_queues.size() > 1){
+                    signalTool(i);
+                }
             } catch (std::runtime_error &e) {
+                _command_queue = _queues.at(0);
                 sleep(__ERROR_SHOW_TIME__);
                 throw;
             }
         }
+        if(_queues.size() > 1){
+            _command_queue = _queues.at(0);
+            joinQueues();
+        }
         strcpy(_current_tool_name, "__post execution__");
 
         // Key events
@@ -439,7 +549,17 @@ void CalcServer::update(InputOutput::TimeManager& t_manager)
             }
         }
 
-        clFinish(command_queue());
+        for(auto queue : _queues){
+            clFinish(queue);
+        }
+        for(auto tool : _tools){
+            tool->synchronize();
+        }
+        #ifdef HAVE_GPUPROFILE
+            for(auto tool : _tools){
+                tool->updateProfiling();
+            }
+        #endif
         InputOutput::Logger::singleton()->endFrame();
     }
 }
@@ -734,10 +854,24 @@ void CalcServer::setupDevices()
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL error");
     }
+    // The domains are sharing the memory objects, which is just safe if they
+    // are sub-devices of the selected one. Hence the selected device is
+    // always partitioned, and several real devices are never used. The
+    // selected device is kept as well, to execute the tools which are not
+    // split in domains
+    const cl_uint device_id = _sim_data.settings.device_id;
+    if(_sim_data.settings.n_domains > 1){
+        partitionDevice(_devices[device_id]);
+    }
+    std::vector<cl_device_id> context_devices(_devices,
+                                              _devices + _num_devices);
+    context_devices.insert(context_devices.end(),
+                           _domain_devices.begin(),
+                           _domain_devices.end());
     // Create a devices context
     _context = clCreateContext(0,
-                               _num_devices,
-                               _devices,
+                               context_devices.size(),
+                               context_devices.data(),
                                context_error_notify,
                                _current_tool_name,
                                &err_code);
@@ -755,10 +889,14 @@ void CalcServer::setupDevices()
         LOG(L_ERROR, msg.str());
         throw std::bad_alloc();
     }
+    cl_command_queue_properties properties = 0;
+    #ifdef HAVE_GPUPROFILE
+        properties |= CL_QUEUE_PROFILING_ENABLE;
+    #endif
     for(i = 0; i < _num_devices; i++) {
         _command_queues[i] = clCreateCommandQueue(_context,
                                                   _devices[i],
-                                                  0,
+                                                  properties,
                                                   &err_code);
         if(err_code != CL_SUCCESS) {
             std::ostringstream msg;
@@ -770,8 +908,139 @@ void CalcServer::setupDevices()
         }
     }
     // Store the selected ones
-    _device = _devices[_sim_data.settings.device_id];
-    _command_queue = _command_queues[_sim_data.settings.device_id];
+    _device = _devices[device_id];
+    _command_queue = _command_queues[device_id];
+
+    // And the ones where the particles are distributed
+    for(i = 0; i < _domain_devices.size(); i++) {
+        cl_command_queue queue = clCreateCommandQueue(_context,
+                                                      _domain_devices.at(i),
+                                                      properties,
+                                                      &err_code);
+        if(err_code != CL_SUCCESS) {
+            std::ostringstream msg;
+            msg << "Failure generating the command queue of the domain " << i
+                << "." << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+        _domain_queues.push_back(queue);
+    }
+    if(!_domain_devices.size()){
+        _domain_devices.push_back(_device);
+        _domain_queues.push_back(_command_queue);
+    }
+    if(_domain_devices.size() > 1){
+        std::ostringstream msg;
+        msg << "The particles will be distributed in "
+            << _domain_devices.size() << " devices." << std::endl;
+        LOG(L_INFO, msg.str());
+    }
+
+    // Create the additional command queues for the tools scheduler
+    unsigned int n_queues = _sim_data.settings.n_queues;
+    if((n_queues > 1) && (_domain_devices.size() > 1)){
+        LOG(L_WARNING, "The tools scheduler cannot be used with several domains, so a single command queue will be used.\n");
+        n_queues = 1;
+    }
+    _queues.push_back(_command_queue);
+    for(i = 1; i < n_queues; i++) {
+        cl_command_queue queue = clCreateCommandQueue(_context,
+                                                      _device,
+                                                      properties,
+                                                      &err_code);
+        if(err_code != CL_SUCCESS) {
+            std::ostringstream msg;
+            msg << "Failure generating the additional command queue number "
+                << i << "." << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+        _queues.push_back(queue);
+    }
+    if(_queues.size() > 1){
+        std::ostringstream msg;
+        msg << _queues.size() << " command queues will be used." << std::endl;
+        LOG(L_INFO, msg.str());
+    }
+}
+
+void CalcServer::partitionDevice(cl_device_id device)
+{
+    cl_int err_code;
+    cl_uint i, n_units, n_sub_devices;
+    cl_uint n_domains = _sim_data.settings.n_domains;
+
+    err_code = clGetDeviceInfo(device,
+                               CL_DEVICE_MAX_COMPUTE_UNITS,
+                               sizeof(cl_uint),
+                               &n_units,
+                               NULL);
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Failure getting the number of compute units.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+    if(n_units < n_domains) {
+        LOG(L_ERROR, "The selected device can't be partitioned.\n");
+        std::ostringstream msg;
+        msg << "\t" << n_domains
+            << " domains has been asked, but just " << n_units
+            << " compute units are available." << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Invalid number of domains");
+    }
+
+    const cl_device_partition_property properties[3] = {
+        CL_DEVICE_PARTITION_EQUALLY,
+        (cl_device_partition_property)(n_units / n_domains),
+        0};
+    err_code = clCreateSubDevices(device,
+                                  properties,
+                                  0,
+                                  NULL,
+                                  &n_sub_devices);
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Failure partitioning the selected device.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+    cl_device_id *sub_devices = new cl_device_id[n_sub_devices];
+    if(!sub_devices){
+        std::ostringstream msg;
+        msg << "Failure allocating " << n_sub_devices * sizeof(cl_device_id)
+            << " bytes for the sub-devices array." << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::bad_alloc();
+    }
+    err_code = clCreateSubDevices(device,
+                                  properties,
+                                  n_sub_devices,
+                                  sub_devices,
+                                  NULL);
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Failure creating the sub-devices.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        delete[] sub_devices;
+        throw std::runtime_error("OpenCL error");
+    }
+    // Just the required sub-devices are kept (the remaining compute units
+    // are not used)
+    for(i = 0; i < n_sub_devices; i++) {
+        if(i < n_domains)
+            _domain_devices.push_back(sub_devices[i]);
+        else
+            clReleaseDevice(sub_devices[i]);
+    }
+    delete[] sub_devices;
+
+    std::ostringstream msg;
+    msg << "The selected device has been partitioned in " << n_domains
+        << " sub-devices of " << n_units / n_domains << " compute units."
+        << std::endl;
+    LOG(L_INFO, msg.str());
 }
 
 void CalcServer::setup()
@@ -850,10 +1119,7 @@ void CalcServer::setup()
                 LOG(L_ERROR, msg.str());
                 throw;
             }
-            cl_mem mem = *(cl_mem*)_vars.get(name.c_str())->get();
-            err_code = clEnqueueWriteBuffer(_command_queue, mem, CL_TRUE,
-                                            i * typesize, typesize, data,
-                                            0, NULL, NULL);
+            err_code = var->write(i * typesize, typesize, data);
             free(data); data = NULL;
             if(err_code != CL_SUCCESS) {
                 std::ostringstream msg;
@@ -867,10 +1133,518 @@ void CalcServer::setup()
         }
     }
 
-    // Setup the tools
+    // Setup the tools, compiling them in parallel first
+    prepareTools();
     for(auto tool : _tools){
         tool->setup();
     }
+    // The kernels are already retaining their programs
+    _program_cache->release();
+
+    aliasArrays();
+    fuseTools();
+    setupScheduler();
+}
+
+/** @struct preparePool
+ * @brief Tools to be prepared by the workers of CalcServer::prepareTools().
+ */
+struct preparePool{
+    /// Tools
+    std::vector<Tool*> *tools;
+    /// Next tool to be prepared
+    unsigned int next;
+    /// Mutex to get the next tool
+    pthread_mutex_t mutex;
+};
+
+/** @brief Worker of CalcServer::prepareTools().
+ * @param data Tools to be prepared (see preparePool).
+ * @return NULL.
+ */
+static void* prepareWorker(void *data)
+{
+    struct preparePool *pool = (struct preparePool*)data;
+    while(true){
+        pthread_mutex_lock(&(pool->mutex));
+        unsigned int i = pool->next++;
+        pthread_mutex_unlock(&(pool->mutex));
+        if(i >= pool->tools->size())
+            break;
+        pool->tools->at(i)->prepare();
+    }
+    return NULL;
+}
+
+void CalcServer::prepareTools()
+{
+    unsigned int i;
+    long n_procs = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int n_threads = n_procs > 1 ? n_procs : 1;
+    if(n_threads > _tools.size())
+        n_threads = _tools.size();
+
+    std::ostringstream msg;
+    msg << "Preparing " << _tools.size() << " tools with "
+        << n_threads << " threads..." << std::endl;
+    LOG(L_INFO, msg.str());
+
+    struct preparePool pool;
+    pool.tools = &_tools;
+    pool.next = 0;
+    pthread_mutex_init(&(pool.mutex), NULL);
+    std::vector<pthread_t> threads;
+    for(i = 1; i < n_threads; i++){
+        pthread_t thread;
+        if(pthread_create(&thread, NULL, prepareWorker, &pool))
+            break;
+        threads.push_back(thread);
+    }
+    // The calling thread is working as well, which is also ensuring that
+    // the tools are prepared if the threads cannot be created
+    prepareWorker(&pool);
+    for(auto thread : threads){
+        pthread_join(thread, NULL);
+    }
+    pthread_mutex_destroy(&(pool.mutex));
+}
+
+void CalcServer::fuseTools()
+{
+    unsigned int i, j, n;
+
+    i = 0;
+    while(i < _tools.size()){
+        Tool *tool = _tools.at(i);
+        std::vector<Tool*> fused;
+        fused.push_back(tool);
+        // The conditional tools cannot be fused, since their execution
+        // conditions would be lost
+        if(!tool->conditional() && ElementWise::isFusable(tool, n)){
+            for(j = i + 1; j < _tools.size(); j++){
+                Tool *next = _tools.at(j);
+                if(next->conditional() ||
+                   !ElementWise::isFusable(tool, next) ||
+                   (next->once() != tool->once())){
+                    break;
+                }
+                fused.push_back(next);
+            }
+        }
+        i += fused.size();
+        if(fused.size() < 2)
+            continue;
+
+        std::ostringstream name;
+        name << tool->name() << " -> " << fused.back()->name();
+        ElementWise *fused_tool = new ElementWise(name.str(),
+                                                  fused,
+                                                  tool->once());
+        try {
+            fused_tool->setup();
+        } catch(std::runtime_error &e) {
+            // The kernels are fused on demand, so they can be still executed
+            // separately if their sources cannot be merged
+            if(!dynamic_cast<Kernel*>(tool))
+                throw;
+            delete fused_tool;
+            std::ostringstream msg;
+            msg << "The tools \"" << name.str()
+                << "\" cannot be fused, executing them separately."
+                << std::endl;
+            LOG(L_WARNING, msg.str());
+            continue;
+        }
+        // The fused tools are kept in place, executing the new one, such
+        // that they are still reported, and can be still referenced, by
+        // their names
+        for(j = 0; j < fused.size(); j++){
+            fused.at(j)->fused(fused_tool, j == 0);
+        }
+    }
+}
+
+/** @struct liveArray
+ * @brief Liveness interval of a transient array (see
+ * CalcServer::aliasArrays()).
+ */
+struct liveArray{
+    /// Array variable
+    InputOutput::ArrayVariable *var;
+    /// First tool accessing it, which is completely overwriting it
+    unsigned int first;
+    /// Last tool accessing it
+    unsigned int last;
+};
+
+void CalcServer::aliasArrays()
+{
+    unsigned int i;
+    cl_int err_code;
+
+    _aliases.clear();
+
+    // The particles sets fields are alive along the whole simulation
+    std::set<std::string> fields;
+    for(auto set : _sim_data.sets){
+        for(auto field : set->inputFields())
+            fields.insert(field);
+        for(auto field : set->outputFields())
+            fields.insert(field);
+    }
+
+    // Get the liveness interval of each array
+    std::map<InputOutput::ArrayVariable*, liveArray> intervals;
+    std::set<InputOutput::ArrayVariable*> persistent;
+    for(i = 0; i < _tools.size(); i++){
+        Tool *tool = _tools.at(i);
+        std::vector<InputOutput::Variable*> used;
+        if(tool->hasDependencies()){
+            used = tool->getInputDependencies();
+            for(auto var : tool->getOutputDependencies())
+                used.push_back(var);
+        }
+        else{
+            used = _vars.getAll();
+        }
+
+        // Arrays completely overwritten by the tool
+        std::vector<InputOutput::ArrayVariable*> overwritten;
+        if(!tool->once() && !tool->conditional()){
+            Set *set_tool = dynamic_cast<Set*>(tool);
+            Copy *copy_tool = dynamic_cast<Copy*>(tool);
+            if(set_tool && set_tool->getVariable()){
+                overwritten.push_back(set_tool->getVariable());
+            }
+            else if(copy_tool && copy_tool->getInputVariable() &&
+                    copy_tool->getOutputVariable() &&
+                    (copy_tool->getInputVariable()->size() ==
+                     copy_tool->getOutputVariable()->size()))
+            {
+                overwritten.push_back(copy_tool->getOutputVariable());
+            }
+        }
+
+        for(auto var : used){
+            if(var->type().find('*') == std::string::npos)
+                continue;
+            InputOutput::ArrayVariable *array =
+                (InputOutput::ArrayVariable*)var;
+            if(persistent.find(array) != persistent.end())
+                continue;
+            auto it = intervals.find(array);
+            if(it != intervals.end()){
+                it->second.last = i;
+                continue;
+            }
+            if(fields.find(array->name()) != fields.end() ||
+               std::find(overwritten.begin(), overwritten.end(), array) ==
+               overwritten.end())
+            {
+                // Read before being written, so it carries data from the
+                // previous time step
+                persistent.insert(array);
+                continue;
+            }
+            liveArray interval;
+            interval.var = array;
+            interval.first = i;
+            interval.last = i;
+            intervals[array] = interval;
+        }
+    }
+
+    // Assign the arrays to groups of non-overlapping intervals, allocating
+    // the largest arrays first to waste as less memory as possible
+    std::vector<liveArray> arrays;
+    for(auto it : intervals){
+        if(it.first->storageSize())
+            arrays.push_back(it.second);
+    }
+    std::sort(arrays.begin(), arrays.end(),
+              [](const liveArray &a, const liveArray &b){
+                  return a.var->storageSize() > b.var->storageSize();
+              });
+    std::vector<std::vector<liveArray> > groups;
+    for(auto array : arrays){
+        bool assigned = false;
+        for(auto &group : groups){
+            bool overlap = false;
+            for(auto member : group){
+                if((array.first <= member.last) &&
+                   (member.first <= array.last))
+                {
+                    overlap = true;
+                    break;
+                }
+            }
+            if(!overlap){
+                group.push_back(array);
+                assigned = true;
+                break;
+            }
+        }
+        if(!assigned)
+            groups.push_back(std::vector<liveArray>(1, array));
+    }
+
+    // Allocate the shared memory, where each array is a sub-buffer
+    size_t saved = 0;
+    for(auto group : groups){
+        if(group.size() < 2)
+            continue;
+        // The first array is the largest one
+        size_t size = group.front().var->storageSize();
+        cl_mem mem = _memory_pool->dedicated(size, &err_code);
+        if(err_code != CL_SUCCESS){
+            LOG(L_WARNING, "Failure allocating shared device memory.\n");
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            continue;
+        }
+        std::ostringstream msg;
+        msg << "Sharing " << size << " bytes between the arrays:"
+            << std::endl;
+        LOG(L_INFO, msg.str());
+        size_t shared = 0;
+        for(auto member : group){
+            cl_buffer_region region;
+            region.origin = 0;
+            region.size = member.var->storageSize();
+            cl_mem sub_mem = clCreateSubBuffer(mem,
+                                               CL_MEM_READ_WRITE,
+                                               CL_BUFFER_CREATE_TYPE_REGION,
+                                               &region,
+                                               &err_code);
+            if(err_code != CL_SUCCESS){
+                LOG(L_WARNING, "Failure creating a sub-buffer.\n");
+                InputOutput::Logger::singleton()->printOpenCLError(err_code);
+                continue;
+            }
+            cl_mem old_mem = *(cl_mem*)member.var->get();
+            member.var->set(&sub_mem);
+            if(old_mem) clReleaseMemObject(old_mem);
+            _aliases[member.var] = group.front().var;
+            shared += region.size;
+            msg.str("");
+            msg << "\t\"" << member.var->name() << "\" (tools "
+                << member.first << " to " << member.last << ")" << std::endl;
+            LOG0(L_DEBUG, msg.str());
+        }
+        // The sub-buffers are retaining the memory object
+        clReleaseMemObject(mem);
+        if(shared > size)
+            saved += shared - size;
+    }
+
+    std::ostringstream msg;
+    msg << "Device memory saved by sharing the transient arrays: "
+        << saved << " bytes" << std::endl;
+    LOG(L_INFO, msg.str());
+}
+
+InputOutput::Variable* CalcServer::alias(InputOutput::Variable *var)
+{
+    auto it = _aliases.find(var);
+    if(it == _aliases.end())
+        return var;
+    return it->second;
+}
+
+void CalcServer::setupScheduler()
+{
+    unsigned int i, q;
+
+    _tools_queue.clear();
+    _tools_wait.clear();
+    _tools_signal.clear();
+    _tools_event.clear();
+    if(_queues.size() < 2)
+        return;
+
+    // Last tool enqueued in each command queue
+    std::vector<int> tails(_queues.size(), -1);
+    // Command queue index of each tool
+    std::vector<unsigned int> tools_queue_id;
+    // Last tool writing each variable, and tools reading it since then
+    std::map<InputOutput::Variable*, unsigned int> writer;
+    std::map<InputOutput::Variable*, std::vector<unsigned int> > readers;
+    // Last synchronization point
+    int sync = -1;
+
+    for(i = 0; i < _tools.size(); i++){
+        Tool *tool = _tools.at(i);
+        std::set<unsigned int> parents;
+        int queue_id = -1;
+
+        if(!tool->hasDependencies()){
+            // Synchronization point, waiting for all the command queues
+            for(auto tail : tails){
+                if(tail >= 0)
+                    parents.insert(tail);
+            }
+            queue_id = 0;
+            sync = i;
+            writer.clear();
+            readers.clear();
+        }
+        else{
+            if(sync >= 0)
+                parents.insert(sync);
+            // The variables sharing memory are the same for the scheduler
+            for(auto in_var : tool->getInputDependencies()){
+                InputOutput::Variable *var = alias(in_var);
+                if(writer.find(var) != writer.end())
+                    parents.insert(writer[var]);
+            }
+            for(auto out_var : tool->getOutputDependencies()){
+                InputOutput::Variable *var = alias(out_var);
+                if(writer.find(var) != writer.end())
+                    parents.insert(writer[var]);
+                for(auto reader : readers[var])
+                    parents.insert(reader);
+            }
+
+            // Try to continue the command queue of the latest dependency
+            for(auto it = parents.rbegin(); it != parents.rend(); ++it){
+                q = tools_queue_id.at(*it);
+                if(tails.at(q) == (int)(*it)){
+                    queue_id = q;
+                    break;
+                }
+            }
+            // Otherwise take the command queue which has been idle for more
+            // time
+            if(queue_id < 0){
+                queue_id = 0;
+                for(q = 1; q < tails.size(); q++){
+                    if(tails.at(q) < tails.at(queue_id))
+                        queue_id = q;
+                }
+            }
+        }
+
+        // Register the variables access
+        for(auto var : tool->getInputDependencies()){
+            readers[alias(var)].push_back(i);
+        }
+        for(auto var : tool->getOutputDependencies()){
+            writer[alias(var)] = i;
+            readers[alias(var)].clear();
+        }
+
+        // The tools in the same command queue are already sorted
+        std::vector<unsigned int> wait;
+        for(auto parent : parents){
+            if(tools_queue_id.at(parent) == (unsigned int)queue_id)
+                continue;
+            wait.push_back(parent);
+            _tools_signal.at(parent) = true;
+        }
+
+        tails.at(queue_id) = i;
+        tools_queue_id.push_back(queue_id);
+        _tools_queue.push_back(_queues.at(queue_id));
+        _tools_wait.push_back(wait);
+        _tools_signal.push_back(false);
+        _tools_event.push_back(NULL);
+    }
+
+    for(i = 0; i < _tools.size(); i++){
+        std::ostringstream msg;
+        msg << "Tool \"" << _tools.at(i)->name() << "\" assigned to the queue "
+            << tools_queue_id.at(i) << ", waiting for "
+            << _tools_wait.at(i).size() << " tools" << std::endl;
+        LOG0(L_DEBUG, msg.str());
+    }
+}
+
+void CalcServer::waitTools(unsigned int tool_id)
+{
+    cl_int err_code;
+    std::vector<cl_event> events;
+    for(auto parent : _tools_wait.at(tool_id)){
+        events.push_back(_tools_event.at(parent));
+    }
+    if(!events.size())
+        return;
+
+    err_code = clEnqueueBarrierWithWaitList(_tools_queue.at(tool_id),
+                                            events.size(),
+                                            events.data(),
+                                            NULL);
+    if(err_code != CL_SUCCESS) {
+        std::ostringstream msg;
+        msg << "Failure setting the dependencies of the tool \""
+            << _tools.at(tool_id)->name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+}
+
+void CalcServer::signalTool(unsigned int tool_id)
+{
+    cl_int err_code;
+    if(!_tools_signal.at(tool_id))
+        return;
+
+    if(_tools_event.at(tool_id))
+        clReleaseEvent(_tools_event.at(tool_id));
+    err_code = clEnqueueMarkerWithWaitList(_tools_queue.at(tool_id),
+                                           0,
+                                           NULL,
+                                           &(_tools_event.at(tool_id)));
+    if(err_code != CL_SUCCESS) {
+        _tools_event.at(tool_id) = NULL;
+        std::ostringstream msg;
+        msg << "Failure setting the completion event of the tool \""
+            << _tools.at(tool_id)->name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+}
+
+void CalcServer::joinQueues()
+{
+    unsigned int i;
+    cl_int err_code;
+    std::vector<cl_event> events;
+    cl_event event;
+
+    // Collect the last command of all the additional queues in the main one
+    for(i = 1; i < _queues.size(); i++){
+        err_code = clEnqueueMarkerWithWaitList(_queues.at(i), 0, NULL, &event);
+        if(err_code != CL_SUCCESS) {
+            LOG(L_ERROR, "Failure joining the command queues.\n");
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+        events.push_back(event);
+    }
+    err_code = clEnqueueBarrierWithWaitList(_queues.at(0),
+                                            events.size(),
+                                            events.data(),
+                                            &event);
+    for(auto e : events)
+        clReleaseEvent(e);
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Failure joining the command queues.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+
+    // And make all the additional queues wait for the main one
+    for(i = 1; i < _queues.size(); i++){
+        err_code = clEnqueueBarrierWithWaitList(_queues.at(i), 1, &event, NULL);
+        if(err_code != CL_SUCCESS) {
+            clReleaseEvent(event);
+            LOG(L_ERROR, "Failure joining the command queues.\n");
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+    }
+    clReleaseEvent(event);
 }
 
 }}  // namespace
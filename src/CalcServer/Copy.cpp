@@ -39,8 +39,6 @@ Copy::Copy(const std::string name,
     : Tool(name, once)
     , _input_name(input_name)
     , _output_name(output_name)
-    , _input_var(NULL)
-    , _output_var(NULL)
 {
 }
 
@@ -55,6 +53,11 @@ void Copy::setup()
     LOG(L_INFO, msg.str());
 
     variables();
+
+    std::vector<InputOutput::Variable*> inputs, outputs;
+    inputs.push_back(_input_var.get());
+    outputs.push_back(_output_var.get());
+    setDependencies(inputs, outputs);
 }
 
 
@@ -69,10 +72,10 @@ void Copy::_execute()
                                    *(cl_mem*)_output_var->get(),
                                    0,
                                    0,
-                                   _output_var->size(),
+                                   _output_var->storageSize(),
                                    0,
                                    NULL,
-                                   NULL);
+                                   profilingEvent());
     if(err_code != CL_SUCCESS){
         std::stringstream msg;
         msg << "Failure executing the tool \"" <<
@@ -103,7 +106,7 @@ void Copy::variables()
         LOG(L_ERROR, msg.str());
         throw std::runtime_error("Invalid variable type");
     }
-    _input_var = (InputOutput::ArrayVariable *)vars->get(_input_name);
+    _input_var = vars->handle(_input_name);
     size_t n_in = _input_var->size() / vars->typeToBytes(_input_var->type());
     if(!vars->get(_output_name)){
         std::stringstream msg;
@@ -121,7 +124,7 @@ void Copy::variables()
         LOG(L_ERROR, msg.str());
         throw std::runtime_error("Invalid variable type");
     }
-    _output_var = (InputOutput::ArrayVariable *)vars->get(_output_name);
+    _output_var = vars->handle(_output_name);
     size_t n_out = _input_var->size() / vars->typeToBytes(_input_var->type());
     if(!vars->isSameType(_input_var->type(), _output_var->type())){
         std::stringstream msg;
@@ -137,6 +140,14 @@ void Copy::variables()
         LOG0(L_DEBUG, msg.str());
         throw std::runtime_error("Incompatible types");
     }
+    if(_input_var->storage().compare(_output_var->storage())){
+        // The raw data is copied, so no precision conversion is carried out
+        std::stringstream msg;
+        msg << "The input and output storage precisions mismatch for the "
+            << "tool \"" << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Incompatible storages");
+    }
     if(n_in != n_out){
         std::stringstream msg;
         msg << "Input and output lengths mismatch for the tool \""
@@ -0,0 +1,463 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Fused element-wise tools.
+ * (See Aqua::CalcServer::ElementWise for details)
+ * @note Hardcoded versions of the files CalcServer/ElementWise.cl.in and
+ * CalcServer/Set.hcl.in are internally included as a text array.
+ */
+
+#include <algorithm>
+#include <typeinfo>
+
+#include <AuxiliarMethods.h>
+#include <InputOutput/Logger.h>
+#include <CalcServer/ElementWise.h>
+#include <CalcServer/Set.h>
+#include <CalcServer/Copy.h>
+#include <CalcServer.h>
+
+namespace Aqua{ namespace CalcServer{
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+namespace{
+// The types are defined as in the set tool, whose values are fused
+#include "CalcServer/Set.hcl"
+}
+#include "CalcServer/ElementWise.cl"
+#endif
+std::string ELEMENTWISE_INC = xxd2string(Set_hcl_in, Set_hcl_in_len);
+std::string ELEMENTWISE_SRC = xxd2string(ElementWise_cl_in,
+                                         ElementWise_cl_in_len);
+
+/** @brief Get the kernel to be fused.
+ * @param tool Tool.
+ * @return The kernel, NULL if the tool is not a kernel.
+ */
+static Kernel* fusableKernel(Tool *tool)
+{
+    // The tools derived from the kernels are setting their own arguments
+    if(typeid(*tool) != typeid(Kernel))
+        return NULL;
+    return (Kernel*)tool;
+}
+
+ElementWise::ElementWise(const std::string name,
+                         std::vector<Tool*> tools,
+                         bool once)
+    : Tool(name, once)
+    , _tools(tools)
+    , _kernel(NULL)
+    , _global_work_size(0)
+    , _local_work_size(0)
+    , _n(0)
+    , _plan(this)
+{
+}
+
+ElementWise::~ElementWise()
+{
+    if(_kernel)
+        clReleaseKernel(_kernel);
+    _kernel = NULL;
+}
+
+void ElementWise::setup()
+{
+    std::ostringstream msg;
+    msg << "Loading the tool \"" << name() << "\"..." << std::endl;
+    LOG(L_INFO, msg.str());
+    for(auto tool : _tools){
+        msg.str("");
+        msg << "\tFusing \"" << tool->name() << "\"" << std::endl;
+        LOG0(L_DEBUG, msg.str());
+    }
+
+    if(!_tools.size() || !isFusable(_tools.front(), _n)){
+        std::stringstream msg;
+        msg << "The tool \"" << name()
+            << "\" cannot fuse the provided tools." << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Invalid tools");
+    }
+
+    setupOpenCL();
+
+    std::vector<InputOutput::Variable*> inputs, outputs;
+    for(auto tool : _tools){
+        for(auto var : tool->getInputDependencies()){
+            if(std::find(inputs.begin(), inputs.end(), var) == inputs.end())
+                inputs.push_back(var);
+        }
+        for(auto var : tool->getOutputDependencies()){
+            if(std::find(outputs.begin(), outputs.end(), var) == outputs.end())
+                outputs.push_back(var);
+        }
+    }
+    setDependencies(inputs, outputs);
+}
+
+bool ElementWise::isFusable(Tool *tool, unsigned int &n)
+{
+    if(!tool->fusable())
+        return false;
+    Set *set_tool = dynamic_cast<Set*>(tool);
+    if(set_tool){
+        InputOutput::ArrayVariable *var = set_tool->getVariable();
+        if(!var || var->storage().compare(""))
+            return false;
+        n = var->size() / InputOutput::Variables::typeToBytes(var->type());
+        return true;
+    }
+    Copy *copy_tool = dynamic_cast<Copy*>(tool);
+    if(copy_tool){
+        InputOutput::ArrayVariable *in_var = copy_tool->getInputVariable();
+        InputOutput::ArrayVariable *out_var = copy_tool->getOutputVariable();
+        if(!in_var || !out_var)
+            return false;
+        // The half precision arrays are handled by their own tools
+        if(in_var->storage().compare("") || out_var->storage().compare(""))
+            return false;
+        unsigned int n_in = in_var->size() /
+            InputOutput::Variables::typeToBytes(in_var->type());
+        unsigned int n_out = out_var->size() /
+            InputOutput::Variables::typeToBytes(out_var->type());
+        // The copy tool is copying the full output array
+        if(n_in != n_out)
+            return false;
+        n = n_out;
+        return true;
+    }
+    Kernel *kernel = fusableKernel(tool);
+    if(kernel){
+        // The arguments declarations are required to generate the fused
+        // kernel, and the local memory cannot be shared
+        const std::vector<std::string> types = kernel->varTypes();
+        const std::vector<cl_kernel_arg_address_qualifier> addresses =
+            kernel->varAddresses();
+        for(unsigned int i = 0; i < types.size(); i++){
+            if(!types.at(i).compare("") ||
+               (addresses.at(i) == CL_KERNEL_ARG_ADDRESS_LOCAL))
+                return false;
+        }
+        n = kernel->nThreads();
+        return true;
+    }
+    return false;
+}
+
+bool ElementWise::isFusable(Tool *tool, Tool *next)
+{
+    unsigned int n, n_next;
+    if(!isFusable(tool, n) || !isFusable(next, n_next))
+        return false;
+    Kernel *kernel = fusableKernel(tool);
+    Kernel *next_kernel = fusableKernel(next);
+    if(kernel || next_kernel){
+        if(!kernel || !next_kernel)
+            return false;
+        return !kernel->n().compare(next_kernel->n());
+    }
+    return n == n_next;
+}
+
+void ElementWise::_execute()
+{
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+
+    _plan.update();
+    Kernel *kernel = fusableKernel(_tools.front());
+    if(kernel && (kernel->nThreads() != _n))
+        setNumberOfElements(kernel->nThreads());
+
+    err_code = clEnqueueNDRangeKernel(C->command_queue(),
+                                      _kernel,
+                                      1,
+                                      NULL,
+                                      &_global_work_size,
+                                      &_local_work_size,
+                                      0,
+                                      NULL,
+                                      profilingEvent());
+    if(err_code != CL_SUCCESS) {
+        std::stringstream msg;
+        msg << "Failure executing the tool \"" <<
+               name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+}
+
+std::string ElementWise::argument(InputOutput::ArrayVariable *var)
+{
+    if(std::find(_vars.begin(), _vars.end(), var) == _vars.end()){
+        _vars.push_back(var);
+        _var_decls.push_back("__global " + var->type() + " v_" + var->name());
+        _var_devices.push_back(false);
+    }
+    return "v_" + var->name();
+}
+
+std::string ElementWise::argument(Kernel *kernel, unsigned int i)
+{
+    InputOutput::Variables *vars = CalcServer::singleton()->variables();
+    const std::string var_name = kernel->varNames().at(i);
+    const cl_kernel_arg_address_qualifier address =
+        kernel->varAddresses().at(i);
+    InputOutput::Variable *var = vars->get(var_name);
+
+    // The constness is not declared, since the non-constant pointers can be
+    // passed to all the fused kernels
+    std::ostringstream decl;
+    if(address == CL_KERNEL_ARG_ADDRESS_GLOBAL)
+        decl << "__global ";
+    else if(address == CL_KERNEL_ARG_ADDRESS_CONSTANT)
+        decl << "__constant ";
+    decl << kernel->varTypes().at(i) << " v_" << var_name;
+
+    auto it = std::find(_vars.begin(), _vars.end(), var);
+    if(it == _vars.end()){
+        _vars.push_back(var);
+        _var_decls.push_back(decl.str());
+        // The scalars declared as pointers are read from the device, as
+        // done by the kernel itself
+        _var_devices.push_back(
+            (var->type().find('*') == std::string::npos) &&
+            (address != CL_KERNEL_ARG_ADDRESS_PRIVATE));
+    }
+    else if(_var_decls.at(it - _vars.begin()).compare(decl.str())){
+        std::stringstream msg;
+        msg << "The tool \"" << kernel->name()
+            << "\" is declaring the argument \"" << var_name
+            << "\" as \"" << decl.str() << "\", while another fused tool "
+            << "declared it as \"" << _var_decls.at(it - _vars.begin())
+            << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Invalid argument");
+    }
+    return "v_" + var_name;
+}
+
+std::string ElementWise::elementsSource(std::string &flags)
+{
+    // Generate the operations, in the same order of the tools
+    std::ostringstream body;
+    for(auto tool : _tools){
+        Set *set_tool = dynamic_cast<Set*>(tool);
+        if(set_tool){
+            body << argument(set_tool->getVariable()) << "[i] = "
+                 << set_tool->getValue() << "; ";
+            continue;
+        }
+        Copy *copy_tool = dynamic_cast<Copy*>(tool);
+        body << argument(copy_tool->getOutputVariable()) << "[i] = "
+             << argument(copy_tool->getInputVariable()) << "[i]; ";
+    }
+
+    std::ostringstream args;
+    for(auto decl : _var_decls){
+        args << decl << ", ";
+    }
+
+    std::ostringstream source;
+    source << ELEMENTWISE_INC << std::endl
+           << "#define ELEMENTWISE_ARGS " << args.str() << std::endl
+           << "#define ELEMENTWISE_BODY " << body.str() << std::endl
+           << ELEMENTWISE_SRC;
+
+    std::ostringstream compile_flags;
+    #ifdef AQUA_DEBUG
+        compile_flags << " -DDEBUG";
+    #else
+        compile_flags << " -DNDEBUG";
+    #endif
+    compile_flags << " -cl-mad-enable -cl-fast-relaxed-math";
+    #ifdef HAVE_3D
+        compile_flags << " -DHAVE_3D";
+    #else
+        compile_flags << " -DHAVE_2D";
+    #endif
+    flags = compile_flags.str();
+
+    return source.str();
+}
+
+std::string ElementWise::kernelsSource(std::string &flags)
+{
+    unsigned int i, j;
+    std::ostringstream source, body, compile_flags;
+
+    // The kernels are concatenated, renaming their entry points, and called
+    // in the same order of the tools
+    for(i = 0; i < _tools.size(); i++){
+        Kernel *kernel = (Kernel*)_tools.at(i);
+        std::ostringstream entry_point;
+        entry_point << "elementwise_" << i;
+        source << "#define " << kernel->entryPoint() << " "
+               << entry_point.str() << std::endl
+               << kernel->source() << std::endl
+               << "#undef " << kernel->entryPoint() << std::endl;
+        body << entry_point.str() << "(";
+        for(j = 0; j < kernel->varNames().size(); j++){
+            body << (j ? ", " : "") << argument(kernel, j);
+        }
+        body << "); ";
+        // The flags are the same for all the kernels, but the include paths
+        if(!i)
+            compile_flags << kernel->flags();
+        else
+            compile_flags << " -I" << getFolderFromFilePath(kernel->path());
+    }
+
+    std::ostringstream args;
+    for(auto decl : _var_decls){
+        args << decl << ", ";
+    }
+
+    source << "#define ELEMENTWISE_ARGS " << args.str() << std::endl
+           << "#define ELEMENTWISE_BODY " << body.str() << std::endl
+           << ELEMENTWISE_SRC;
+    flags = compile_flags.str();
+
+    return source.str();
+}
+
+void ElementWise::setupOpenCL()
+{
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+
+    std::string flags;
+    Kernel *kernel = fusableKernel(_tools.front());
+    const std::string source = kernel ? kernelsSource(flags) :
+                                        elementsSource(flags);
+
+    _kernel = compile(source, flags);
+    err_code = clGetKernelWorkGroupInfo(_kernel,
+                                        C->device(),
+                                        CL_KERNEL_WORK_GROUP_SIZE,
+                                        sizeof(size_t),
+                                        &_local_work_size,
+                                        NULL);
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Failure querying the work group size.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+    if(_local_work_size < __CL_MIN_LOCALSIZE__){
+        LOG(L_ERROR, "insufficient local memory.\n");
+        std::stringstream msg;
+        msg << "\t" << _local_work_size
+            << " local work group size with __CL_MIN_LOCALSIZE__="
+            << __CL_MIN_LOCALSIZE__ << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("OpenCL error");
+    }
+
+    InputOutput::Variables *vars = C->variables();
+    for(unsigned int i = 0; i < _vars.size(); i++){
+        _plan.bind(_kernel,
+                   i,
+                   vars->handle(_vars.at(i)->name()),
+                   _var_devices.at(i));
+    }
+    setNumberOfElements(_n);
+}
+
+void ElementWise::setNumberOfElements(unsigned int n)
+{
+    cl_int err_code;
+
+    _n = n;
+    _global_work_size = roundUp(_n, _local_work_size);
+    err_code = clSetKernelArg(_kernel,
+                              _vars.size(),
+                              sizeof(unsigned int),
+                              (void*)&_n);
+    if(err_code != CL_SUCCESS){
+        LOG(L_ERROR, "Failure sending the array size argument\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+}
+
+cl_kernel ElementWise::compile(const std::string source,
+                               const std::string flags)
+{
+    cl_int err_code;
+    cl_program program;
+    cl_kernel kernel;
+    CalcServer *C = CalcServer::singleton();
+
+    program = C->programCache()->create(source, flags, &err_code);
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Failure creating the OpenCL program.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL compilation error");
+    }
+    err_code = C->programCache()->build(program, flags);
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Error compiling the source code\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        LOG0(L_ERROR, "--- Build log ---------------------------------\n");
+        size_t log_size = 0;
+        clGetProgramBuildInfo(program,
+                              C->device(),
+                              CL_PROGRAM_BUILD_LOG,
+                              0,
+                              NULL,
+                              &log_size);
+        char *log = (char*)malloc(log_size + sizeof(char));
+        if(!log){
+            std::stringstream msg;
+            msg << "Failure allocating " << log_size
+                << " bytes for the building log" << std::endl;
+            LOG0(L_ERROR, msg.str());
+            LOG0(L_ERROR, "--------------------------------- Build log ---\n");
+            throw std::bad_alloc();
+        }
+        strcpy(log, "");
+        clGetProgramBuildInfo(program,
+                              C->device(),
+                              CL_PROGRAM_BUILD_LOG,
+                              log_size,
+                              log,
+                              NULL);
+        strcat(log, "\n");
+        LOG0(L_DEBUG, log);
+        LOG0(L_ERROR, "--------------------------------- Build log ---\n");
+        free(log);
+        log=NULL;
+        clReleaseProgram(program);
+        throw std::runtime_error("OpenCL compilation error");
+    }
+    kernel = clCreateKernel(program, "elementwise", &err_code);
+    clReleaseProgram(program);
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Failure creating the kernel.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+
+    return kernel;
+}
+
+}}  // namespaces
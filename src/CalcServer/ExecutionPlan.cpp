@@ -0,0 +1,158 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Pre-bound kernel arguments.
+ * (See Aqua::CalcServer::ExecutionPlan for details)
+ */
+
+#include <InputOutput/Logger.h>
+#include <CalcServer/ExecutionPlan.h>
+#include <CalcServer.h>
+
+namespace Aqua{ namespace CalcServer{
+
+ExecutionPlan::ExecutionPlan(Tool *tool)
+    : _tool(tool)
+{
+}
+
+ExecutionPlan::~ExecutionPlan()
+{
+    clear();
+}
+
+void ExecutionPlan::bind(cl_kernel kernel,
+                         cl_uint index,
+                         InputOutput::VariableRef var,
+                         bool device)
+{
+    boundArg arg;
+    arg.kernel = kernel;
+    arg.index = index;
+    arg.var = var;
+    arg.version = var->version();
+    arg.device = device;
+    arg.mem = NULL;
+    _args.push_back(arg);
+    set(_args.size() - 1);
+}
+
+void ExecutionPlan::update()
+{
+    unsigned int i;
+    for(i = 0; i < _args.size(); i++){
+        if(_args.at(i).version == _args.at(i).var->version()){
+            // The variable still being valid
+            continue;
+        }
+        set(i);
+    }
+}
+
+void ExecutionPlan::clear()
+{
+    for(auto arg : _args){
+        if(arg.mem) clReleaseMemObject(arg.mem);
+    }
+    _args.clear();
+}
+
+void ExecutionPlan::set(unsigned int i)
+{
+    cl_int err_code;
+    boundArg &arg = _args.at(i);
+
+    arg.version = arg.var->version();
+    if(arg.device){
+        setDevice(arg);
+        return;
+    }
+    err_code = clSetKernelArg(arg.kernel,
+                              arg.index,
+                              arg.var->typesize(),
+                              arg.var->get());
+    if(err_code != CL_SUCCESS) {
+        std::stringstream msg;
+        msg << "Failure setting the variable \"" << arg.var->name()
+            << "\" (id=" << arg.index
+            << ") to the tool \"" << _tool->name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+}
+
+void ExecutionPlan::setDevice(boundArg &arg)
+{
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+
+    // Don't wait for the host value if it is already in the device
+    cl_mem mem = arg.var->getDeviceMem();
+    if(!mem){
+        if(!arg.mem){
+            arg.mem = C->memoryPool()->allocate(arg.var->typesize(),
+                                                &err_code);
+            if(!arg.mem){
+                std::stringstream msg;
+                msg << "Failure allocating memory for the variable \""
+                    << arg.var->name() << "\" in the tool \""
+                    << _tool->name() << "\"." << std::endl;
+                LOG(L_ERROR, msg.str());
+                InputOutput::Logger::singleton()->printOpenCLError(err_code);
+                throw std::bad_alloc();
+            }
+        }
+        err_code = clEnqueueWriteBuffer(C->command_queue(),
+                                        arg.mem,
+                                        CL_TRUE,
+                                        0,
+                                        arg.var->typesize(),
+                                        arg.var->get(),
+                                        0,
+                                        NULL,
+                                        NULL);
+        if(err_code != CL_SUCCESS){
+            std::stringstream msg;
+            msg << "Failure sending the variable \"" << arg.var->name()
+                << "\" to the tool \"" << _tool->name() << "\"."
+                << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+        mem = arg.mem;
+    }
+
+    err_code = clSetKernelArg(arg.kernel,
+                              arg.index,
+                              sizeof(cl_mem),
+                              (void*)&mem);
+    if(err_code != CL_SUCCESS) {
+        std::stringstream msg;
+        msg << "Failure setting the device buffer of the variable \""
+            << arg.var->name() << "\" (id=" << arg.index
+            << ") to the tool \"" << _tool->name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+}
+
+}}  // namespaces
@@ -0,0 +1,781 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Particles exchange between the processes of a multi-process run.
+ * (See Aqua::CalcServer::Halo for details)
+ * @note Hardcoded versions of the files CalcServer/Halo.cl.in and
+ * CalcServer/LinkList.hcl.in are internally included as a text array.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+
+#include <AuxiliarMethods.h>
+#include <InputOutput/Logger.h>
+#include <CalcServer/Halo.h>
+#include <CalcServer/LinkList.h>
+
+/// Flag of the halo particles in the list of particles to send
+#define __HALO_FLAG__ 0x80000000u
+/// Number of cells of the bands around the slab borders
+#define __HALO_BAND__ 6
+
+namespace Aqua{ namespace CalcServer{
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+namespace{
+// The cells should be numbered as in the link-list
+#include "CalcServer/LinkList.hcl"
+}
+#include "CalcServer/Halo.cl"
+#endif
+std::string HALO_INC = xxd2string(LinkList_hcl_in, LinkList_hcl_in_len);
+std::string HALO_SRC = xxd2string(Halo_cl_in, Halo_cl_in_len);
+
+Halo::Halo(const std::string name,
+           const std::string fields,
+           unsigned int set,
+           const std::string bounds,
+           bool once)
+    : Tool(name, once)
+    , _record_size(0)
+    , _iset_field(0)
+    , _set(set)
+    , _bounds(bounds)
+    , _n(0)
+    , _decomposed(false)
+    , _border(NULL)
+    , _slots(NULL)
+    , _remove(NULL)
+    , _gather(NULL)
+    , _scatter(NULL)
+    , _lws(0)
+    , _plan(this)
+    , _ids_mem(NULL)
+    , _slots_mem(NULL)
+    , _n_ids_mem(NULL)
+    , _data_mem(NULL)
+    , _data_size(0)
+{
+    std::istringstream f(replaceAllCopy(fields, " ", ""));
+    std::string s;
+    while(getline(f, s, ',')){
+        if(std::find(_fields_names.begin(), _fields_names.end(), s) ==
+           _fields_names.end())
+        {
+            _fields_names.push_back(s);
+        }
+    }
+    const char *required[3] = {"r", "imove", "iset"};
+    for(unsigned int i = 0; i < 3; i++){
+        if(std::find(_fields_names.begin(),
+                     _fields_names.end(),
+                     required[i]) == _fields_names.end())
+        {
+            _fields_names.push_back(required[i]);
+        }
+    }
+    _x.x = 0.f; _x.y = 0.f;
+}
+
+Halo::~Halo()
+{
+    cl_kernel kernels[5] = {_border, _slots, _remove, _gather, _scatter};
+    for(auto kernel : kernels){
+        if(kernel)
+            clReleaseKernel(kernel);
+    }
+    cl_mem mems[4] = {_ids_mem, _slots_mem, _n_ids_mem, _data_mem};
+    for(auto mem : mems){
+        if(mem)
+            clReleaseMemObject(mem);
+    }
+}
+
+void Halo::setup()
+{
+    std::ostringstream msg;
+    msg << "Loading the tool \"" << name() << "\"..." << std::endl;
+    LOG(L_INFO, msg.str());
+
+    CalcServer *C = CalcServer::singleton();
+    InputOutput::Variables *vars = C->variables();
+
+    _n = *(unsigned int *)vars->get("N")->get();
+    variables();
+
+    vars->solve("vec2", _bounds, &_x);
+    if(_x.y <= _x.x){
+        std::stringstream msg;
+        msg << "The tool \"" << name() << "\" got the invalid bounds ("
+            << _x.x << ", " << _x.y << ")." << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Invalid bounds");
+    }
+
+    std::vector<InputOutput::Variable*> inputs;
+    const char *scalars[7] = {"N", "support", "h", "r_min", "n_cells",
+                              "icell", "ihoc"};
+    for(unsigned int i = 0; i < 7; i++){
+        if(!vars->get(scalars[i])){
+            std::stringstream msg;
+            msg << "The tool \"" << name()
+                << "\" is asking for the undeclared variable \""
+                << scalars[i] << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Invalid variable");
+        }
+        inputs.push_back(vars->get(scalars[i]));
+    }
+    std::vector<InputOutput::Variable*> outputs;
+    for(auto field : _fields){
+        outputs.push_back(field.get());
+    }
+    setDependencies(inputs, outputs);
+
+    Transport *transport = C->transport();
+    if(!transport || (transport->size() < 2))
+        return;
+
+    // The received particles should be linked in the same time step
+    std::vector<Tool*> tools = C->tools();
+    auto it = std::find(tools.begin(), tools.end(), this);
+    bool linked = false;
+    for(; it != tools.end(); it++){
+        if(dynamic_cast<LinkList*>(*it)){
+            linked = true;
+            break;
+        }
+    }
+    if(!linked){
+        std::stringstream msg;
+        msg << "The tool \"" << name()
+            << "\" should be executed before the link-list." << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Invalid tools order");
+    }
+
+    // The bands around the slab borders should not overlap
+    const float l = *(float *)vars->get("support")->get() *
+                    *(float *)vars->get("h")->get();
+    if((_x.y - _x.x) / transport->size() < __HALO_BAND__ * l){
+        std::stringstream msg;
+        msg << "The tool \"" << name() << "\" got too narrow slabs."
+            << std::endl;
+        LOG(L_ERROR, msg.str());
+        msg.str("");
+        msg << "\t" << (_x.y - _x.x) / transport->size()
+            << " slabs width, but at least " << __HALO_BAND__ * l
+            << " is required" << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Invalid bounds");
+    }
+
+    setupOpenCL();
+
+    // The particles lists are just used within the execution, so they can be
+    // shared with the other tools
+    cl_int err_code;
+    cl_mem *mems[3] = {&_ids_mem, &_slots_mem, &_n_ids_mem};
+    const size_t sizes[3] = {_n * sizeof(unsigned int),
+                             _n * sizeof(unsigned int),
+                             4 * sizeof(unsigned int)};
+    C->memoryPool()->releaseScratch(this);
+    for(unsigned int i = 0; i < 3; i++){
+        *mems[i] = C->memoryPool()->scratch(this, sizes[i], &err_code);
+        if(err_code != CL_SUCCESS){
+            std::stringstream msg;
+            msg << "Failure allocating device memory in the tool \"" <<
+                   name() << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL allocation error");
+        }
+    }
+    setArg(_border, 5, sizeof(cl_mem), &_ids_mem);
+    setArg(_border, 6, sizeof(cl_mem), &_n_ids_mem);
+    setArg(_slots, 2, sizeof(cl_mem), &_slots_mem);
+    setArg(_slots, 3, sizeof(cl_mem), &_n_ids_mem);
+    setArg(_remove, 1, sizeof(cl_mem), &_ids_mem);
+    setArg(_gather, 2, sizeof(cl_mem), &_ids_mem);
+    setArg(_scatter, 2, sizeof(cl_mem), &_ids_mem);
+
+    allocate(_record_size);
+}
+
+void Halo::_execute()
+{
+    unsigned int i, f, side;
+    CalcServer *C = CalcServer::singleton();
+    Transport *transport = C->transport();
+    if(!transport || (transport->size() < 2))
+        return;
+
+    const unsigned int rank = transport->rank();
+    const unsigned int n_ranks = transport->size();
+    // Neighbour processes, at the left and right sides
+    uivec2 neigh;
+    neigh.x = rank > 0;
+    neigh.y = rank + 1 < n_ranks;
+    const bool has_neigh[2] = {neigh.x != 0, neigh.y != 0};
+    const unsigned int neigh_rank[2] = {rank - 1, rank + 1};
+
+    unsigned int n_ids[4];
+    findParticles(neigh, n_ids);
+    _decomposed = true;
+
+    // Download the particles to send, split in the migrating and the halo
+    // ones
+    std::vector<unsigned int> ids(n_ids[0] + n_ids[1]);
+    if(n_ids[0]){
+        copy(_ids_mem, false, true,
+             0,
+             n_ids[0] * sizeof(unsigned int),
+             ids.data());
+    }
+    if(n_ids[1]){
+        copy(_ids_mem, false, true,
+             (_n - n_ids[1]) * sizeof(unsigned int),
+             n_ids[1] * sizeof(unsigned int),
+             ids.data() + n_ids[0]);
+    }
+    std::vector<unsigned int> migrate[2], halo[2];
+    for(i = 0; i < ids.size(); i++){
+        side = (i < n_ids[0]) ? 0 : 1;
+        if(ids[i] & __HALO_FLAG__)
+            halo[side].push_back(ids[i] & ~__HALO_FLAG__);
+        else
+            migrate[side].push_back(ids[i]);
+    }
+    std::vector<unsigned int> send;
+    send.insert(send.end(), migrate[0].begin(), migrate[0].end());
+    send.insert(send.end(), migrate[1].begin(), migrate[1].end());
+    const unsigned int n_migrate = send.size();
+    send.insert(send.end(), halo[0].begin(), halo[0].end());
+    send.insert(send.end(), halo[1].begin(), halo[1].end());
+    const unsigned int n_send = send.size();
+
+    // Gather their fields, and release the migrating ones, becoming available
+    // to store the received particles
+    if(n_send){
+        if(n_send * _record_size > _data_size){
+            allocate(MemoryPool::capacity(n_send * _record_size,
+                                          _data_size));
+        }
+        copy(_ids_mem, true, true,
+             0,
+             n_send * sizeof(unsigned int),
+             send.data());
+        transfer(_gather, n_send);
+        if(n_migrate){
+            setArg(_remove, 2, sizeof(unsigned int), &n_migrate);
+            launch(_remove, n_migrate);
+        }
+        _data.resize(n_send * _record_size);
+        copy(_data_mem, false, true, 0, _data.size(), _data.data());
+    }
+
+    // Exchange the particles with the neighbours. The fields are
+    // consecutively sent, first the migrating particles and then the halo
+    // ones
+    std::vector<char> data_in[2];
+    for(side = 0; side < 2; side++){
+        if(!has_neigh[side])
+            continue;
+        std::vector<char> data_out;
+        uint32_t header[2] = {(uint32_t)migrate[side].size(),
+                              (uint32_t)halo[side].size()};
+        data_out.insert(data_out.end(),
+                        (char*)header,
+                        (char*)header + sizeof(header));
+        size_t block = 0;
+        for(f = 0; f < _fields.size(); f++){
+            const size_t typesize = _typesizes.at(f);
+            const char *src = _data.data() + block;
+            const size_t m0 = side ? migrate[0].size() : 0;
+            const size_t h0 = side ? halo[0].size() : 0;
+            data_out.insert(data_out.end(),
+                            src + m0 * typesize,
+                            src + (m0 + header[0]) * typesize);
+            data_out.insert(data_out.end(),
+                            src + (n_migrate + h0) * typesize,
+                            src + (n_migrate + h0 + header[1]) * typesize);
+            block += n_send * typesize;
+        }
+        transport->exchange(neigh_rank[side], data_out, data_in[side]);
+    }
+
+    uint32_t header[2][2] = {{0, 0}, {0, 0}};
+    for(side = 0; side < 2; side++){
+        if(!has_neigh[side])
+            continue;
+        if(data_in[side].size() < sizeof(header[side])){
+            std::stringstream msg;
+            msg << "The tool \"" << name()
+                << "\" received a truncated message from the process "
+                << neigh_rank[side] << "." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Transport error");
+        }
+        memcpy(header[side], data_in[side].data(), sizeof(header[side]));
+        if(data_in[side].size() != sizeof(header[side]) +
+           (header[side][0] + header[side][1]) * _record_size)
+        {
+            std::stringstream msg;
+            msg << "The tool \"" << name()
+                << "\" received a malformed message from the process "
+                << neigh_rank[side] << "." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Transport error");
+        }
+    }
+    const unsigned int n_recv_migrate = header[0][0] + header[1][0];
+    const unsigned int n_recv_halo = header[0][1] + header[1][1];
+    const unsigned int n_recv = n_recv_migrate + n_recv_halo;
+    if(n_recv_migrate > n_ids[2] + n_migrate){
+        std::stringstream msg;
+        msg << "The tool \"" << name() << "\" has not enough buffer "
+            << "particles to store the migrated ones." << std::endl;
+        LOG(L_ERROR, msg.str());
+        msg.str("");
+        msg << "\t" << n_ids[2] + n_migrate << " buffer particles, but "
+            << n_recv_migrate << " are required" << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Insufficient buffer particles");
+    }
+    if(n_recv_halo > n_ids[3]){
+        std::stringstream msg;
+        msg << "The tool \"" << name() << "\" has not enough particles "
+            << "in the set " << _set << " to store the halo ones."
+            << std::endl;
+        LOG(L_ERROR, msg.str());
+        msg.str("");
+        msg << "\t" << n_ids[3] << " halo particles, but "
+            << n_recv_halo << " are required" << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Insufficient halo particles");
+    }
+    if(!n_recv)
+        return;
+
+    // Download just the required slots, using the released particles if
+    // there are not enough buffer particles
+    _ids.resize(n_recv);
+    const unsigned int n_free = std::min(n_recv_migrate, n_ids[2]);
+    if(n_free){
+        copy(_slots_mem, false, true,
+             0,
+             n_free * sizeof(unsigned int),
+             _ids.data());
+    }
+    std::copy(send.begin(),
+              send.begin() + (n_recv_migrate - n_free),
+              _ids.begin() + n_free);
+    if(n_recv_halo){
+        copy(_slots_mem, false, true,
+             (_n - n_recv_halo) * sizeof(unsigned int),
+             n_recv_halo * sizeof(unsigned int),
+             _ids.data() + n_recv_migrate);
+    }
+
+    // Arrange the received fields as the sent ones, i.e. consecutively
+    // stored, first the migrating particles and then the halo ones
+    _data.resize(n_recv * _record_size);
+    size_t block = 0, offset[2] = {sizeof(header[0]), sizeof(header[1])};
+    for(f = 0; f < _fields.size(); f++){
+        const size_t typesize = _typesizes.at(f);
+        char *dst = _data.data() + block;
+        for(side = 0; side < 2; side++){
+            const size_t m0 = side ? header[0][0] : 0;
+            const size_t h0 = side ? header[0][1] : 0;
+            const char *src = data_in[side].data() + offset[side];
+            memcpy(dst + m0 * typesize,
+                   src,
+                   header[side][0] * typesize);
+            memcpy(dst + (n_recv_migrate + h0) * typesize,
+                   src + header[side][0] * typesize,
+                   header[side][1] * typesize);
+            offset[side] += (header[side][0] + header[side][1]) * typesize;
+        }
+        if(f == _iset_field){
+            // The halo particles should still belong to the halo set
+            for(i = n_recv_migrate; i < n_recv; i++)
+                memcpy(dst + i * typesize, &_set, typesize);
+        }
+        block += n_recv * typesize;
+    }
+
+    // And scatter them. The host copies are kept alive until the next
+    // execution, which is starting with a blocking download
+    if(_data.size() > _data_size)
+        allocate(MemoryPool::capacity(_data.size(), _data_size));
+    copy(_ids_mem, true, false,
+         0,
+         n_recv * sizeof(unsigned int),
+         _ids.data());
+    copy(_data_mem, true, false, 0, _data.size(), _data.data());
+    transfer(_scatter, n_recv);
+}
+
+void Halo::variables()
+{
+    CalcServer *C = CalcServer::singleton();
+    InputOutput::Variables *vars = C->variables();
+
+    for(auto field : _fields_names){
+        InputOutput::Variable *var = vars->get(field);
+        if(!var){
+            std::stringstream msg;
+            msg << "The tool \"" << name()
+                << "\" is asking for the undeclared variable \""
+                << field << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Invalid variable");
+        }
+        if(var->type().find('*') == std::string::npos){
+            std::stringstream msg;
+            msg << "The tool \"" << name()
+                << "\" may not use a scalar variable (\""
+                << field << "\")." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Invalid variable type");
+        }
+        InputOutput::ArrayVariable *array = (InputOutput::ArrayVariable*)var;
+        size_t typesize = InputOutput::Variables::typeToBytes(array->type());
+        if(array->size() < _n * typesize){
+            std::stringstream msg;
+            msg << "The tool \"" << name()
+                << "\" requires a value per particle of the variable \""
+                << field << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Invalid variable length");
+        }
+        if(!field.compare("iset"))
+            _iset_field = _fields.size();
+        // The values are exchanged as stored in the computational device
+        typesize = InputOutput::Variables::storageToBytes(array->type(),
+                                                          array->storage());
+        _fields.push_back(vars->handle(field));
+        _typesizes.push_back(typesize);
+        _record_size += typesize;
+    }
+}
+
+void Halo::setupOpenCL()
+{
+    cl_int err_code;
+    cl_program program;
+    CalcServer *C = CalcServer::singleton();
+    InputOutput::Variables *vars = C->variables();
+
+    std::ostringstream source;
+    const std::vector<std::string> defs = C->definitions();
+    if(std::find(defs.begin(), defs.end(), "-DHAVE_MORTON_CELLS") !=
+       defs.end())
+    {
+        source << "#define HAVE_MORTON_CELLS" << std::endl;
+    }
+    const std::string storage =
+        ((InputOutput::ArrayVariable*)vars->get("r"))->storage();
+    if(!storage.compare("half"))
+        source << "#define HALF_R" << std::endl;
+    else if(!storage.compare("packed"))
+        source << "#define PACKED_R" << std::endl;
+    source << HALO_INC << HALO_SRC;
+
+    std::ostringstream flags;
+    #ifdef AQUA_DEBUG
+        flags << " -DDEBUG ";
+    #else
+        flags << " -DNDEBUG ";
+    #endif
+    flags << " -cl-mad-enable -cl-fast-relaxed-math";
+    #ifdef HAVE_3D
+        flags << " -DHAVE_3D ";
+    #else
+        flags << " -DHAVE_2D ";
+    #endif
+    program = C->programCache()->create(source.str(), flags.str(), &err_code);
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Failure creating the OpenCL program.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL compilation error");
+    }
+    err_code = C->programCache()->build(program, flags.str());
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Error compiling the source code\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        LOG0(L_ERROR, "--- Build log ---------------------------------\n");
+        size_t log_size = 0;
+        clGetProgramBuildInfo(program,
+                              C->device(),
+                              CL_PROGRAM_BUILD_LOG,
+                              0,
+                              NULL,
+                              &log_size);
+        char *log = (char*)malloc(log_size + sizeof(char));
+        if(!log){
+            std::stringstream msg;
+            msg << "Failure allocating " << log_size
+                << " bytes for the building log" << std::endl;
+            LOG0(L_ERROR, msg.str());
+            LOG0(L_ERROR, "--------------------------------- Build log ---\n");
+            throw std::bad_alloc();
+        }
+        strcpy(log, "");
+        clGetProgramBuildInfo(program,
+                              C->device(),
+                              CL_PROGRAM_BUILD_LOG,
+                              log_size,
+                              log,
+                              NULL);
+        strcat(log, "\n");
+        LOG0(L_DEBUG, log);
+        LOG0(L_ERROR, "--------------------------------- Build log ---\n");
+        free(log);
+        log = NULL;
+        clReleaseProgram(program);
+        throw std::runtime_error("OpenCL compilation error");
+    }
+
+    const char *names[5] = {"borderCells", "freeSlots", "removeParticles",
+                            "gatherField", "scatterField"};
+    cl_kernel *kernels[5] = {&_border, &_slots, &_remove, &_gather,
+                             &_scatter};
+    _lws = 0;
+    for(unsigned int i = 0; i < 5; i++){
+        *kernels[i] = clCreateKernel(program, names[i], &err_code);
+        if(err_code != CL_SUCCESS) {
+            std::stringstream msg;
+            msg << "Failure creating the \"" << names[i] << "\" kernel."
+                << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            clReleaseProgram(program);
+            throw std::runtime_error("OpenCL error");
+        }
+        size_t lws;
+        err_code = clGetKernelWorkGroupInfo(*kernels[i],
+                                            C->device(),
+                                            CL_KERNEL_WORK_GROUP_SIZE,
+                                            sizeof(size_t),
+                                            &lws,
+                                            NULL);
+        if(err_code != CL_SUCCESS) {
+            std::stringstream msg;
+            msg << "Failure querying the work group size (\"" << names[i]
+                << "\")." << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            clReleaseProgram(program);
+            throw std::runtime_error("OpenCL error");
+        }
+        if(!_lws || (lws < _lws))
+            _lws = lws;
+    }
+    clReleaseProgram(program);
+    if(_lws < __CL_MIN_LOCALSIZE__){
+        std::stringstream msg;
+        msg << "insufficient local memory for the tool \"" << name()
+            << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        msg.str("");
+        msg << "\t" << _lws
+            << " local work group size with __CL_MIN_LOCALSIZE__="
+            << __CL_MIN_LOCALSIZE__ << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("OpenCL error");
+    }
+
+    // Bind the variables
+    const char *border_vars[10] = {"icell", "ihoc", "r", "imove", "iset",
+                                   "N", "n_cells", "r_min", "support", "h"};
+    const cl_uint border_indexes[10] = {0, 1, 2, 3, 4, 7, 8, 9, 10, 11};
+    for(unsigned int i = 0; i < 10; i++){
+        _plan.bind(_border, border_indexes[i], vars->handle(border_vars[i]));
+    }
+    _plan.bind(_slots, 0, vars->handle("imove"));
+    _plan.bind(_slots, 1, vars->handle("iset"));
+    _plan.bind(_slots, 4, vars->handle("N"));
+    _plan.bind(_remove, 0, vars->handle("imove"));
+    setArg(_border, 14, sizeof(unsigned int), &_set);
+    setArg(_slots, 5, sizeof(unsigned int), &_set);
+}
+
+void Halo::allocate(size_t data_size)
+{
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+
+    if(_data_mem)
+        clReleaseMemObject(_data_mem);
+    _data_mem = C->memoryPool()->allocate(data_size, &err_code);
+    if(err_code != CL_SUCCESS){
+        std::stringstream msg;
+        msg << "Failure allocating device memory in the tool \"" <<
+               name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL allocation error");
+    }
+    _data_size = data_size;
+    allocatedMemory((2 * _n + 4) * sizeof(unsigned int) + _data_size);
+
+    cl_kernel kernels[2] = {_gather, _scatter};
+    for(auto kernel : kernels){
+        setArg(kernel, 1, sizeof(cl_mem), &_data_mem);
+    }
+}
+
+void Halo::findParticles(const uivec2 neigh, unsigned int *n_ids)
+{
+    CalcServer *C = CalcServer::singleton();
+    InputOutput::Variables *vars = C->variables();
+    Transport *transport = C->transport();
+
+    static const unsigned int zeros[4] = {0, 0, 0, 0};
+    copy(_n_ids_mem, true, false, 0, sizeof(zeros), (void*)zeros);
+    _plan.update();
+
+    // Just the bands around the slab borders are traversed, but the first
+    // time, when the particles out of the slab should be removed, and the
+    // link-list has not been computed yet
+    const unsigned int rank = transport->rank();
+    const unsigned int n_ranks = transport->size();
+    vec2 slab;
+    slab.x = _x.x + (_x.y - _x.x) * rank / n_ranks;
+    slab.y = _x.x + (_x.y - _x.x) * (rank + 1) / n_ranks;
+    const unsigned int n_band = __HALO_BAND__;
+    const unsigned int decompose = _decomposed ? 0 : 1;
+    setArg(_border, 12, sizeof(vec2), &slab);
+    setArg(_border, 13, sizeof(uivec2), &neigh);
+    setArg(_border, 15, sizeof(unsigned int), &n_band);
+    setArg(_border, 16, sizeof(unsigned int), &decompose);
+
+    if(decompose){
+        launch(_border, _n);
+    }
+    else{
+        const uivec4 n_cells = *(uivec4*)vars->get("n_cells")->get();
+        launch(_border, 2 * n_band * n_cells.y * n_cells.z);
+    }
+    launch(_slots, _n);
+
+    copy(_n_ids_mem, false, true, 0, 4 * sizeof(unsigned int), n_ids);
+}
+
+void Halo::transfer(cl_kernel kernel, unsigned int n)
+{
+    size_t offset = 0;
+    setArg(kernel, 3, sizeof(unsigned int), &n);
+    for(unsigned int i = 0; i < _fields.size(); i++){
+        const cl_mem mem = *(cl_mem*)_fields.at(i)->get();
+        const unsigned int typesize = _typesizes.at(i);
+        const unsigned int data_offset = offset;
+        setArg(kernel, 0, sizeof(cl_mem), &mem);
+        setArg(kernel, 4, sizeof(unsigned int), &typesize);
+        setArg(kernel, 5, sizeof(unsigned int), &data_offset);
+        launch(kernel, n * typesize);
+        offset += n * typesize;
+    }
+}
+
+void Halo::setArg(cl_kernel kernel,
+                  cl_uint index,
+                  size_t size,
+                  const void *value)
+{
+    cl_int err_code = clSetKernelArg(kernel, index, size, value);
+    if(err_code != CL_SUCCESS){
+        std::stringstream msg;
+        msg << "Failure setting the argument " << index
+            << " within the tool \"" << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+}
+
+void Halo::launch(cl_kernel kernel, size_t n)
+{
+    CalcServer *C = CalcServer::singleton();
+    const size_t gws = roundUp(n, _lws);
+    cl_int err_code = clEnqueueNDRangeKernel(C->command_queue(),
+                                             kernel,
+                                             1,
+                                             NULL,
+                                             &gws,
+                                             &_lws,
+                                             0,
+                                             NULL,
+                                             profilingEvent());
+    if(err_code != CL_SUCCESS){
+        std::stringstream msg;
+        msg << "Failure executing the tool \"" << name() << "\"."
+            << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+}
+
+void Halo::copy(cl_mem mem,
+                bool write,
+                bool blocking,
+                size_t offset,
+                size_t size,
+                void *ptr)
+{
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+
+    if(write){
+        err_code = clEnqueueWriteBuffer(C->command_queue(),
+                                        mem,
+                                        blocking ? CL_TRUE : CL_FALSE,
+                                        offset,
+                                        size,
+                                        ptr,
+                                        0,
+                                        NULL,
+                                        profilingEvent());
+    }
+    else{
+        err_code = clEnqueueReadBuffer(C->command_queue(),
+                                       mem,
+                                       blocking ? CL_TRUE : CL_FALSE,
+                                       offset,
+                                       size,
+                                       ptr,
+                                       0,
+                                       NULL,
+                                       profilingEvent());
+    }
+    if(err_code != CL_SUCCESS) {
+        std::stringstream msg;
+        msg << "Failure " << (write ? "uploading" : "downloading")
+            << " data within the tool \"" << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+}
+
+}}  // namespaces
@@ -21,6 +21,12 @@
  * (see Aqua::CalcServer::Kernel for details)
  */
 
+#include <sys/time.h>
+#include <pthread.h>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <map>
 #include <clang-c/Index.h>
 #include <clang-c/Platform.h>
 #include <AuxiliarMethods.h>
@@ -28,6 +34,11 @@
 #include <CalcServer.h>
 #include <CalcServer/Kernel.h>
 
+/// Number of timed executions of each autotuning candidate
+#ifndef __AUTOTUNE_SAMPLES__
+    #define __AUTOTUNE_SAMPLES__ 3
+#endif
+
 namespace Aqua{ namespace CalcServer{
 
 Kernel::Kernel(const std::string tool_name,
@@ -42,16 +53,20 @@ Kernel::Kernel(const std::string tool_name,
     , _kernel(NULL)
     , _work_group_size(0)
     , _global_work_size(0)
+    , _n_threads(0)
+    , _domains(true)
+    , _candidate(0)
+    , _plan(this)
 {
+    // The kernels are not granted to be element-wise ones, so they are just
+    // fused if it is explicitly requested (see ElementWise)
+    fusable(false);
 }
 
 Kernel::~Kernel()
 {
+    releaseCandidates(_kernel);
     if(_kernel) clReleaseKernel(_kernel); _kernel=NULL;
-
-    for(auto it = _var_values.begin(); it < _var_values.end(); it++){
-        free(*it);
-    }
 }
 
 void Kernel::setup()
@@ -61,18 +76,45 @@ void Kernel::setup()
         << "\" from the file \"" << path() << "\"..." << std::endl;
     LOG(L_INFO, msg.str());
 
-    compile(_entry_point);
-    variables(_entry_point);
+    if(!prepared()){
+        compile(_entry_point);
+        variables(_entry_point);
+    }
     setVariables();
     computeGlobalWorkSize();
+    computeDependencies();
+    if(CalcServer::singleton()->settings().autotune)
+        setupAutotune();
+}
+
+void Kernel::_prepare()
+{
+    compile(_entry_point);
+    variables(_entry_point);
 }
 
 void Kernel::_execute()
+{
+    _plan.update();
+    if(nChanged())
+        computeGlobalWorkSize();
+
+    if(_candidates.size()){
+        autotune();
+        return;
+    }
+    enqueue();
+}
+
+void Kernel::enqueue()
 {
     cl_int err_code;
     CalcServer *C = CalcServer::singleton();
 
-    setVariables();
+    if((C->nDomains() > 1) && _domains){
+        executeDomains();
+        return;
+    }
 
     err_code = clEnqueueNDRangeKernel(C->command_queue(),
                                       _kernel,
@@ -82,7 +124,7 @@ void Kernel::_execute()
                                       &_work_group_size,
                                       0,
                                       NULL,
-                                      NULL);
+                                      profilingEvent());
     if(err_code != CL_SUCCESS){
         std::stringstream msg;
         msg << "Failure executing the tool \"" <<
@@ -93,6 +135,97 @@ void Kernel::_execute()
     }
 }
 
+void Kernel::executeDomains()
+{
+    unsigned int i;
+    cl_int err_code;
+    cl_event start;
+    std::vector<cl_event> ends;
+    CalcServer *C = CalcServer::singleton();
+    unsigned int n_domains = C->nDomains();
+    size_t n_groups = _global_work_size / _work_group_size;
+
+    err_code = clEnqueueMarkerWithWaitList(C->command_queue(),
+                                           0,
+                                           NULL,
+                                           &start);
+    if(err_code != CL_SUCCESS){
+        std::stringstream msg;
+        msg << "Failure setting the start mark of the tool \"" <<
+               name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+
+    for(i = 0; i < n_domains; i++){
+        size_t offset = n_groups * i / n_domains * _work_group_size;
+        size_t global_work_size =
+            n_groups * (i + 1) / n_domains * _work_group_size - offset;
+        if(!global_work_size)
+            continue;
+        cl_command_queue queue = C->domainQueue(i);
+        err_code = clEnqueueBarrierWithWaitList(queue, 1, &start, NULL);
+        if(err_code != CL_SUCCESS){
+            std::stringstream msg;
+            msg << "Failure waiting for the start mark in the domain "
+                << i << " of the tool \"" << name() << "\"."
+                << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL execution error");
+        }
+        err_code = clEnqueueNDRangeKernel(queue,
+                                          _kernel,
+                                          1,
+                                          &offset,
+                                          &global_work_size,
+                                          &_work_group_size,
+                                          0,
+                                          NULL,
+                                          profilingEvent());
+        if(err_code != CL_SUCCESS){
+            std::stringstream msg;
+            msg << "Failure executing the domain " << i
+                << " of the tool \"" << name() << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL execution error");
+        }
+        cl_event end;
+        err_code = clEnqueueMarkerWithWaitList(queue, 0, NULL, &end);
+        if(err_code != CL_SUCCESS){
+            std::stringstream msg;
+            msg << "Failure setting the end mark in the domain " << i
+                << " of the tool \"" << name() << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL execution error");
+        }
+        ends.push_back(end);
+        clFlush(queue);
+    }
+    clReleaseEvent(start);
+
+    if(!ends.size())
+        return;
+    err_code = clEnqueueBarrierWithWaitList(C->command_queue(),
+                                            ends.size(),
+                                            ends.data(),
+                                            NULL);
+    for(auto end : ends){
+        clReleaseEvent(end);
+    }
+    if(err_code != CL_SUCCESS){
+        std::stringstream msg;
+        msg << "Failure waiting for the domains of the tool \"" <<
+               name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+}
+
 void Kernel::compile(const std::string entry_point,
                      const std::string add_flags,
                      const std::string header)
@@ -102,7 +235,6 @@ void Kernel::compile(const std::string entry_point,
     cl_kernel kernel;
     std::ostringstream source;
     std::ostringstream flags;
-    size_t source_length = 0;
     cl_int err_code = CL_SUCCESS;
     size_t work_group_size = 0;
     CalcServer *C = CalcServer::singleton();
@@ -131,7 +263,7 @@ void Kernel::compile(const std::string entry_point,
     if(C->base_path().compare("")){
         flags << "-I" << C->base_path() << " ";
     }
-    flags << " -cl-mad-enable -cl-fast-relaxed-math ";
+    flags << " -cl-mad-enable -cl-fast-relaxed-math -cl-kernel-arg-info ";
     #ifdef HAVE_3D
         flags << " -DHAVE_3D ";
     #else
@@ -143,24 +275,29 @@ void Kernel::compile(const std::string entry_point,
     }
     // Add the additionally specified flags
     flags << add_flags;
+    _source = source.str();
+    _flags = flags.str();
+
+    // The kernels depending on the work groups or the global size cannot be
+    // split in slabs (see executeDomains())
+    const char* group_funcs[4] = {"get_group_id", "get_num_groups",
+                                  "get_global_size", "get_global_offset"};
+    _domains = true;
+    for(auto group_func : group_funcs){
+        if(_source.find(group_func) != std::string::npos)
+            _domains = false;
+    }
 
     // Try to compile without using local memory
     LOG(L_INFO, "Compiling without local memory... ");
-    source_length = source.str().size();
-    std::string source_str = source.str();
-    const char *source_cstr = source_str.c_str();
-    program = clCreateProgramWithSource(C->context(),
-                                        1,
-                                        &source_cstr,
-                                        &source_length,
-                                        &err_code);
-    if(err_code != CL_SUCCESS) {
+    // The program is shared with the tools using the same file and flags
+    program = C->programCache()->get(_source, _flags, &err_code);
+    if(!program) {
         LOG0(L_DEBUG, "FAIL\n");
         LOG(L_ERROR, "Failure creating the OpenCL program.\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL compilation error");
     }
-    err_code = clBuildProgram(program, 0, NULL, flags.str().c_str(), NULL, NULL);
     if(err_code != CL_SUCCESS) {
         LOG0(L_DEBUG, "FAIL\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
@@ -221,6 +358,25 @@ void Kernel::compile(const std::string entry_point,
         clReleaseKernel(kernel);
         throw std::runtime_error("OpenCL error");
     }
+    // The work groups should fit in all the devices sharing the particles
+    for(i = 0; i < C->nDomains(); i++){
+        size_t domain_work_group_size;
+        err_code = clGetKernelWorkGroupInfo(kernel,
+                                            C->domainDevice(i),
+                                            CL_KERNEL_WORK_GROUP_SIZE,
+                                            sizeof(size_t),
+                                            &domain_work_group_size,
+                                            NULL);
+        if(err_code != CL_SUCCESS) {
+            LOG0(L_DEBUG, "FAIL\n");
+            LOG(L_ERROR, "Failure querying the work group size.\n");
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            clReleaseKernel(kernel);
+            throw std::runtime_error("OpenCL error");
+        }
+        if(domain_work_group_size < work_group_size)
+            work_group_size = domain_work_group_size;
+    }
     LOG0(L_DEBUG, "OK\n");
 
     _kernel = kernel;
@@ -228,20 +384,15 @@ void Kernel::compile(const std::string entry_point,
 
     // Try to compile with local memory
     LOG(L_INFO, "Compiling with local memory... ");
-    program = clCreateProgramWithSource(C->context(),
-                                        1,
-                                        &source_cstr,
-                                        &source_length,
-                                        &err_code);
-    if(err_code != CL_SUCCESS) {
+    flags << " -DLOCAL_MEM_SIZE=" << work_group_size;
+    program = C->programCache()->get(_source, flags.str(), &err_code);
+    if(!program) {
         LOG0(L_DEBUG, "FAIL\n");
         LOG(L_ERROR, "Failure creating the OpenCL program.\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         LOG(L_INFO, "Falling back to no local memory usage.\n");
         return;
     }
-    flags << " -DLOCAL_MEM_SIZE=" << work_group_size;
-    err_code = clBuildProgram(program, 0, NULL, flags.str().c_str(), NULL, NULL);
     if(err_code != CL_SUCCESS) {
         LOG0(L_DEBUG, "FAIL\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
@@ -336,6 +487,34 @@ void Kernel::compile(const std::string entry_point,
     _kernel = kernel;
 }
 
+/** @struct argSignature
+ * @brief Kernel argument signature.
+ */
+struct argSignature{
+    /// Argument name
+    std::string name;
+    /// true if the argument is a pointer to constant data
+    bool is_const;
+    /// Address space qualifier, CL_KERNEL_ARG_ADDRESS_*
+    cl_kernel_arg_address_qualifier address;
+};
+
+/** @struct fileSignatures
+ * @brief Signatures of all the functions declared in a source code file.
+ */
+struct fileSignatures{
+    /// Number of declarations of each function
+    std::map<std::string, unsigned int> count;
+    /// Arguments of each function
+    std::map<std::string, std::vector<argSignature> > args;
+};
+
+/// Parsed files, such that each file is parsed just once
+static std::map<std::string, fileSignatures> parsed_files;
+
+/// Parsed files mutex, since the kernels are prepared in parallel
+static pthread_mutex_t parsed_files_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 /** @brief Main traverse method, which will parse all tokens except functions
  * declarations.
  * @param cursor the cursor whose child may be visited. All kinds of cursors can
@@ -366,20 +545,12 @@ CXChildVisitResult functionDeclVisitor(CXCursor cursor,
                                        CXCursor parent,
                                        CXClientData client_data);
 
-/** @struct clientData
- * @brief Data structure to store the variables requested and a flag
- * to know if the entry point has been found.
+/** @brief Parse a source code file, getting the signatures of all the
+ * functions declared there.
+ * @param path Source code file.
+ * @return Functions signatures.
  */
-struct clientData{
-    /// Entry point
-    std::string entry_point;
-    /// Number of instances of the entry point found.
-    unsigned int entry_points;
-    /// List of required variables
-    std::vector<std::string> var_names;
-};
-
-void Kernel::variables(const std::string entry_point)
+static fileSignatures parseFile(const std::string path)
 {
     CXIndex index = clang_createIndex(0, 0);
     if(index == 0){
@@ -388,7 +559,7 @@ void Kernel::variables(const std::string entry_point)
     }
 
     int argc = 2;
-    const char* argv[2] = {"Kernel", _path.c_str()};
+    const char* argv[2] = {"Kernel", path.c_str()};
     CXTranslationUnit translation_unit = clang_parseTranslationUnit(
         index,
         0,
@@ -399,54 +570,165 @@ void Kernel::variables(const std::string entry_point)
         CXTranslationUnit_None);
     if(translation_unit == 0){
         LOG(L_ERROR, "Failure parsing the source code.\n");
+        clang_disposeIndex(index);
         throw std::runtime_error("clang parsing error");
     }
 
     CXCursor root_cursor = clang_getTranslationUnitCursor(translation_unit);
-    struct clientData client_data;
-    client_data.entry_point = entry_point;
-    client_data.entry_points = 0;
-    client_data.var_names = _var_names;
-    clang_visitChildren(root_cursor, *cursorVisitor, &client_data);
-    if(client_data.entry_points == 0){
+    fileSignatures signatures;
+    clang_visitChildren(root_cursor, *cursorVisitor, &signatures);
+
+    clang_disposeTranslationUnit(translation_unit);
+    clang_disposeIndex(index);
+    return signatures;
+}
+
+bool Kernel::argsInfo()
+{
+    cl_int err_code;
+    cl_uint i, num_args;
+
+    err_code = clGetKernelInfo(_kernel,
+                               CL_KERNEL_NUM_ARGS,
+                               sizeof(cl_uint),
+                               &num_args,
+                               NULL);
+    if(err_code != CL_SUCCESS)
+        return false;
+
+    std::vector<std::string> names;
+    std::vector<bool> consts;
+    std::vector<cl_kernel_arg_address_qualifier> addresses;
+    std::vector<std::string> types;
+    for(i = 0; i < num_args; i++){
+        size_t name_size, type_size;
+        cl_kernel_arg_type_qualifier type_qualifier;
+        cl_kernel_arg_address_qualifier address_qualifier;
+        err_code = clGetKernelArgInfo(_kernel,
+                                      i,
+                                      CL_KERNEL_ARG_NAME,
+                                      0,
+                                      NULL,
+                                      &name_size);
+        if(err_code != CL_SUCCESS)
+            return false;
+        std::vector<char> name(name_size + 1, '\0');
+        err_code = clGetKernelArgInfo(_kernel,
+                                      i,
+                                      CL_KERNEL_ARG_NAME,
+                                      name_size,
+                                      name.data(),
+                                      NULL);
+        err_code |= clGetKernelArgInfo(_kernel,
+                                       i,
+                                       CL_KERNEL_ARG_TYPE_QUALIFIER,
+                                       sizeof(cl_kernel_arg_type_qualifier),
+                                       &type_qualifier,
+                                       NULL);
+        err_code |= clGetKernelArgInfo(_kernel,
+                                       i,
+                                       CL_KERNEL_ARG_ADDRESS_QUALIFIER,
+                                       sizeof(cl_kernel_arg_address_qualifier),
+                                       &address_qualifier,
+                                       NULL);
+        if(err_code != CL_SUCCESS)
+            return false;
+        err_code = clGetKernelArgInfo(_kernel,
+                                      i,
+                                      CL_KERNEL_ARG_TYPE_NAME,
+                                      0,
+                                      NULL,
+                                      &type_size);
+        if(err_code != CL_SUCCESS)
+            return false;
+        std::vector<char> type(type_size + 1, '\0');
+        err_code = clGetKernelArgInfo(_kernel,
+                                      i,
+                                      CL_KERNEL_ARG_TYPE_NAME,
+                                      type_size,
+                                      type.data(),
+                                      NULL);
+        if(err_code != CL_SUCCESS)
+            return false;
+        names.push_back(name.data());
+        consts.push_back((type_qualifier & CL_KERNEL_ARG_TYPE_CONST) != 0);
+        addresses.push_back(address_qualifier);
+        types.push_back(type.data());
+    }
+
+    _var_names = names;
+    _var_consts = consts;
+    _var_addresses = addresses;
+    _var_types = types;
+    return true;
+}
+
+void Kernel::variables(const std::string entry_point)
+{
+    // The OpenCL implementation can directly report the arguments
+    if(_kernel && argsInfo())
+        return;
+
+    // Otherwise the source code should be parsed, just once per file
+    fileSignatures signatures;
+    pthread_mutex_lock(&parsed_files_mutex);
+    try {
+        auto it = parsed_files.find(_path);
+        if(it == parsed_files.end()){
+            parsed_files[_path] = parseFile(_path);
+            it = parsed_files.find(_path);
+        }
+        signatures = it->second;
+    } catch (...) {
+        pthread_mutex_unlock(&parsed_files_mutex);
+        throw;
+    }
+    pthread_mutex_unlock(&parsed_files_mutex);
+
+    if(signatures.count.find(entry_point) == signatures.count.end()){
         std::stringstream msg;
         msg << "The entry point \"" << entry_point
             << "\" cannot be found." << std::endl;
         LOG(L_ERROR, msg.str());
         throw std::runtime_error("Invalid entry point");
     }
-    if(client_data.entry_points != 1){
+    if(signatures.count[entry_point] != 1){
         std::stringstream msg;
         msg << "The entry point \"" << entry_point
-            << "\" has been found " << client_data.entry_points
+            << "\" has been found " << signatures.count[entry_point]
             << "times." << std::endl;
         LOG(L_ERROR, msg.str());
         throw std::runtime_error("Invalid entry point");
     }
-    _var_names = client_data.var_names;
-    
-    for(unsigned int i = 0; i < _var_names.size(); i++){
-        _var_values.push_back(NULL);
+    _var_names.clear();
+    _var_consts.clear();
+    _var_addresses.clear();
+    _var_types.clear();
+    for(auto arg : signatures.args[entry_point]){
+        _var_names.push_back(arg.name);
+        _var_consts.push_back(arg.is_const);
+        _var_addresses.push_back(arg.address);
+        // The types are not reliable, since the flags are not considered
+        _var_types.push_back("");
     }
-
-    clang_disposeTranslationUnit(translation_unit);
-    clang_disposeIndex(index);
 }
 
 CXChildVisitResult cursorVisitor(CXCursor cursor,
                                  CXCursor parent,
                                  CXClientData client_data)
 {
-    struct clientData *data = (struct clientData *)client_data;
+    fileSignatures *data = (fileSignatures *)client_data;
     CXCursorKind kind = clang_getCursorKind(cursor);
-    CXString name = clang_getCursorSpelling(cursor);
     if (kind == CXCursor_FunctionDecl ||
         kind == CXCursor_ObjCInstanceMethodDecl)
     {
-        if(!data->entry_point.compare(clang_getCString(name))){
-            data->entry_points++;
-            clang_visitChildren(cursor, *functionDeclVisitor, client_data);
-        }
+        CXString name = clang_getCursorSpelling(cursor);
+        std::string name_str = clang_getCString(name);
+        clang_disposeString(name);
+        data->count[name_str]++;
+        std::vector<argSignature> args;
+        clang_visitChildren(cursor, *functionDeclVisitor, &args);
+        data->args[name_str] = args;
         return CXChildVisit_Continue;
     }
     return CXChildVisit_Recurse;
@@ -456,11 +738,29 @@ CXChildVisitResult functionDeclVisitor(CXCursor cursor,
                                        CXCursor parent,
                                        CXClientData client_data)
 {
-    struct clientData *data = (struct clientData *)client_data;
+    std::vector<argSignature> *args = (std::vector<argSignature> *)client_data;
     CXCursorKind kind = clang_getCursorKind(cursor);
     if (kind == CXCursor_ParmDecl){
+        argSignature arg;
         CXString name = clang_getCursorSpelling(cursor);
-        data->var_names.push_back(clang_getCString(name));
+        arg.name = clang_getCString(name);
+        clang_disposeString(name);
+        // Just the pointers to constant data are considered read only
+        CXString type = clang_getTypeSpelling(clang_getCursorType(cursor));
+        std::string type_str = clang_getCString(type);
+        clang_disposeString(type);
+        size_t pos = type_str.find('*');
+        arg.is_const = (pos != std::string::npos) &&
+            (type_str.substr(0, pos).find("const") != std::string::npos);
+        if(type_str.find("constant") != std::string::npos)
+            arg.address = CL_KERNEL_ARG_ADDRESS_CONSTANT;
+        else if(type_str.find("local") != std::string::npos)
+            arg.address = CL_KERNEL_ARG_ADDRESS_LOCAL;
+        else if(pos != std::string::npos)
+            arg.address = CL_KERNEL_ARG_ADDRESS_GLOBAL;
+        else
+            arg.address = CL_KERNEL_ARG_ADDRESS_PRIVATE;
+        args->push_back(arg);
     }
     return CXChildVisit_Continue;
 }
@@ -468,9 +768,9 @@ CXChildVisitResult functionDeclVisitor(CXCursor cursor,
 void Kernel::setVariables()
 {
     unsigned int i;
-    cl_int err_code;
     InputOutput::Variables *vars = CalcServer::singleton()->variables();
 
+    _plan.clear();
     for(i = 0; i < _var_names.size(); i++){
         if(!vars->get(_var_names.at(i))){
             std::stringstream msg;
@@ -480,28 +780,68 @@ void Kernel::setVariables()
             LOG(L_ERROR, msg.str());
             throw std::runtime_error("Invalid variable");
         }
+        checkStorage(i);
+        // The scalars declared as pointers are read from the device, so the
+        // asynchronously downloaded values (e.g. reductions) are not awaited
+        const bool device =
+            (vars->get(_var_names.at(i))->type().find('*') ==
+                std::string::npos) &&
+            ((_var_addresses.at(i) == CL_KERNEL_ARG_ADDRESS_GLOBAL) ||
+             (_var_addresses.at(i) == CL_KERNEL_ARG_ADDRESS_CONSTANT));
+        _plan.bind(_kernel, i, vars->handle(_var_names.at(i)), device);
+    }
+}
+
+void Kernel::checkStorage(unsigned int i)
+{
+    InputOutput::Variables *vars = CalcServer::singleton()->variables();
+    InputOutput::Variable *var = vars->get(_var_names.at(i));
+    if(!_var_types.at(i).compare("") ||
+       (var->type().find('*') == std::string::npos))
+        return;
+
+    const std::string storage =
+        ((InputOutput::ArrayVariable*)var)->storage();
+    const bool half_arg = _var_types.at(i).find("half") == 0;
+    if(!storage.compare("packed")){
+        // Packed as 3 floats per component
+        if(!_var_types.at(i).compare("float*"))
+            return;
+    }
+    else if(half_arg == !storage.compare("half")){
+        return;
+    }
+    std::stringstream msg;
+    msg << "The tool \"" << name() << "\" is declaring the argument \""
+        << _var_names.at(i) << "\" as \"" << _var_types.at(i)
+        << "\", but the variable storage is \""
+        << (storage.compare("") ? storage : "native") << "\"." << std::endl;
+    LOG(L_ERROR, msg.str());
+    LOG0(L_DEBUG, "\tSTORAGE(), LOAD() and STORE() macros can be used\n");
+    throw std::runtime_error("Invalid variable storage");
+}
+
+void Kernel::computeDependencies()
+{
+    unsigned int i;
+    InputOutput::Variables *vars = CalcServer::singleton()->variables();
+    std::vector<InputOutput::Variable*> inputs, outputs;
+
+    for(i = 0; i < _var_names.size(); i++){
         InputOutput::Variable *var = vars->get(_var_names.at(i));
-        if(_var_values.at(i) == NULL){
-            _var_values.at(i) = malloc(var->typesize());
-        }
-        else if(!memcmp(_var_values.at(i), var->get(), var->typesize())){
-            // The variable still being valid
+        // The constant address space and the pointers to constant data are
+        // read only
+        if((var->type().find('*') != std::string::npos) &&
+           !_var_consts.at(i) &&
+           (_var_addresses.at(i) != CL_KERNEL_ARG_ADDRESS_CONSTANT))
+        {
+            outputs.push_back(var);
             continue;
         }
-
-        // Update the variable
-        err_code = clSetKernelArg(_kernel, i, var->typesize(), var->get());
-        if(err_code != CL_SUCCESS) {
-            std::stringstream msg;
-            msg << "Failure setting the variable \"" << _var_names.at(i)
-                << "\" (id=" << i
-                << ") to the tool \"" << name() << "\"." << std::endl;
-            LOG(L_ERROR, msg.str());
-            InputOutput::Logger::singleton()->printOpenCLError(err_code);
-            throw std::runtime_error("OpenCL error");
-        }
-        memcpy(_var_values.at(i), var->get(), var->typesize());
+        inputs.push_back(var);
     }
+
+    setDependencies(inputs, outputs);
 }
 
 void Kernel::computeGlobalWorkSize()
@@ -519,7 +859,321 @@ void Kernel::computeGlobalWorkSize()
         throw std::runtime_error("Invalid number of threads");
     }
 
+    _n_threads = N;
     _global_work_size = (size_t)roundUp(N, (unsigned int)_work_group_size);
+
+    // Collect the variables used in the expression, which may change along
+    // the simulation (e.g. "N_active")
+    _n_vars.clear();
+    _n_versions.clear();
+    size_t pos = 0;
+    while(pos < _n.size()){
+        if(!isalpha(_n[pos]) && (_n[pos] != '_')){
+            pos++;
+            continue;
+        }
+        size_t end = pos;
+        while((end < _n.size()) && (isalnum(_n[end]) || (_n[end] == '_')))
+            end++;
+        std::string var_name = _n.substr(pos, end - pos);
+        pos = end;
+        // The vectorial components are accessed with suffixes
+        if(!vars->get(var_name) && (var_name.size() > 2) &&
+           (var_name[var_name.size() - 2] == '_'))
+        {
+            var_name = var_name.substr(0, var_name.size() - 2);
+        }
+        if(!vars->get(var_name))
+            continue;
+        _n_vars.push_back(vars->handle(var_name));
+        _n_versions.push_back(_n_vars.back()->version());
+    }
+}
+
+unsigned int Kernel::nThreads()
+{
+    if(nChanged())
+        computeGlobalWorkSize();
+    return _n_threads;
+}
+
+bool Kernel::nChanged()
+{
+    unsigned int i;
+    for(i = 0; i < _n_vars.size(); i++){
+        if(_n_vars.at(i)->version() != _n_versions.at(i))
+            return true;
+    }
+    return false;
+}
+
+cl_kernel Kernel::build(const std::string flags, size_t work_group_size)
+{
+    cl_int err_code;
+    cl_program program;
+    cl_kernel kernel;
+    CalcServer *C = CalcServer::singleton();
+
+    program = C->programCache()->get(_source, flags, &err_code);
+    if(!program) {
+        LOG(L_WARNING, "Failure creating the OpenCL program.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        return NULL;
+    }
+    if(err_code != CL_SUCCESS) {
+        clReleaseProgram(program);
+        return NULL;
+    }
+    kernel = clCreateKernel(program, _entry_point.c_str(), &err_code);
+    clReleaseProgram(program);
+    if(err_code != CL_SUCCESS) {
+        return NULL;
+    }
+
+    // Check that the kernel can be launched with the work group size
+    size_t kernel_work_group_size;
+    cl_ulong used_local_mem, available_local_mem;
+    err_code = clGetKernelWorkGroupInfo(kernel,
+                                        C->device(),
+                                        CL_KERNEL_WORK_GROUP_SIZE,
+                                        sizeof(size_t),
+                                        &kernel_work_group_size,
+                                        NULL);
+    err_code |= clGetKernelWorkGroupInfo(kernel,
+                                         C->device(),
+                                         CL_KERNEL_LOCAL_MEM_SIZE,
+                                         sizeof(cl_ulong),
+                                         &used_local_mem,
+                                         NULL);
+    err_code |= clGetDeviceInfo(C->device(),
+                                CL_DEVICE_LOCAL_MEM_SIZE,
+                                sizeof(cl_ulong),
+                                &available_local_mem,
+                                NULL);
+    if((err_code != CL_SUCCESS) ||
+       (kernel_work_group_size < work_group_size) ||
+       (available_local_mem < used_local_mem))
+    {
+        clReleaseKernel(kernel);
+        return NULL;
+    }
+    return kernel;
+}
+
+void Kernel::setupAutotune()
+{
+    size_t work_group_size;
+    bool local;
+    CalcServer *C = CalcServer::singleton();
+
+    // Build the tuning database key
+    char device_name[1024], driver_version[1024];
+    strcpy(device_name, "");
+    strcpy(driver_version, "");
+    clGetDeviceInfo(C->device(),
+                    CL_DEVICE_NAME,
+                    sizeof(device_name),
+                    device_name,
+                    NULL);
+    clGetDeviceInfo(C->device(),
+                    CL_DRIVER_VERSION,
+                    sizeof(driver_version),
+                    driver_version,
+                    NULL);
+    std::hash<std::string> hasher;
+    std::ostringstream key;
+    key << std::hex << hasher(std::string(device_name) + driver_version)
+        << " " << hasher(_source + _flags) << std::dec
+        << " " << _global_work_size;
+    _tuning_key = key.str();
+
+    // The local memory variants are just meaningful if the kernel can use it
+    const bool use_local = _source.find("LOCAL_MEM_SIZE") != std::string::npos;
+
+    if(loadTuning(local, work_group_size)){
+        std::ostringstream msg;
+        msg << "Tuned \"" << name() << "\": work group size = "
+            << work_group_size << ", local memory = "
+            << (local ? "true" : "false") << std::endl;
+        LOG(L_INFO, msg.str());
+        cl_kernel kernel = _kernel;
+        if(local && use_local){
+            std::ostringstream flags;
+            flags << _flags << " -DLOCAL_MEM_SIZE=" << work_group_size;
+            kernel = build(flags.str(), work_group_size);
+        }
+        else if(!local){
+            kernel = build(_flags, work_group_size);
+        }
+        if(!kernel){
+            LOG(L_WARNING, "The tuned kernel cannot be built, ignoring it.\n");
+            return;
+        }
+        if(kernel != _kernel)
+            clReleaseKernel(_kernel);
+        select(kernel, work_group_size);
+        return;
+    }
+
+    std::ostringstream msg;
+    msg << "Building the autotuning candidates of \"" << name() << "\"..."
+        << std::endl;
+    LOG(L_INFO, msg.str());
+    cl_kernel plain = build(_flags, _work_group_size);
+    if(!plain){
+        LOG(L_WARNING, "The kernel cannot be rebuilt, disabling autotuning.\n");
+        return;
+    }
+    for(work_group_size = _work_group_size;
+        work_group_size >= __CL_MIN_LOCALSIZE__;
+        work_group_size /= 2)
+    {
+        tuneCandidate candidate;
+        candidate.kernel = plain;
+        candidate.local = false;
+        candidate.work_group_size = work_group_size;
+        candidate.time = 0.f;
+        candidate.samples = 0;
+        _candidates.push_back(candidate);
+        if(!use_local)
+            continue;
+        std::ostringstream flags;
+        flags << _flags << " -DLOCAL_MEM_SIZE=" << work_group_size;
+        candidate.kernel = build(flags.str(), work_group_size);
+        if(!candidate.kernel)
+            continue;
+        candidate.local = true;
+        _candidates.push_back(candidate);
+    }
+    if(_candidates.size() < 2){
+        // Nothing to tune
+        releaseCandidates(NULL);
+        return;
+    }
+
+    // The compiled kernel is replaced by the candidates
+    clReleaseKernel(_kernel);
+    _candidate = 0;
+    select(_candidates.front().kernel, _candidates.front().work_group_size);
+}
+
+void Kernel::autotune()
+{
+    CalcServer *C = CalcServer::singleton();
+    tuneCandidate &candidate = _candidates.at(_candidate);
+
+    // The previously enqueued commands should not be accounted
+    clFinish(C->command_queue());
+    timeval tic, tac;
+    gettimeofday(&tic, NULL);
+    enqueue();
+    clFinish(C->command_queue());
+    gettimeofday(&tac, NULL);
+
+    // The first execution is just warming up
+    if(candidate.samples++){
+        candidate.time += (float)(tac.tv_sec - tic.tv_sec);
+        candidate.time += (float)(tac.tv_usec - tic.tv_usec) * 1E-6f;
+    }
+    if(candidate.samples <= __AUTOTUNE_SAMPLES__)
+        return;
+
+    if(++_candidate < _candidates.size()){
+        select(_candidates.at(_candidate).kernel,
+               _candidates.at(_candidate).work_group_size);
+        return;
+    }
+
+    // Lock in the fastest candidate
+    unsigned int i, best = 0;
+    for(i = 0; i < _candidates.size(); i++){
+        std::ostringstream msg;
+        msg << "\t" << name() << ": work group size = "
+            << _candidates.at(i).work_group_size << ", local memory = "
+            << (_candidates.at(i).local ? "true" : "false") << ", "
+            << _candidates.at(i).time / __AUTOTUNE_SAMPLES__ << " s"
+            << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        if(_candidates.at(i).time < _candidates.at(best).time)
+            best = i;
+    }
+    tuneCandidate selected = _candidates.at(best);
+    std::ostringstream msg;
+    msg << "Tuned \"" << name() << "\": work group size = "
+        << selected.work_group_size << ", local memory = "
+        << (selected.local ? "true" : "false") << std::endl;
+    LOG(L_INFO, msg.str());
+
+    releaseCandidates(selected.kernel);
+    select(selected.kernel, selected.work_group_size);
+    saveTuning(selected.local, selected.work_group_size);
+}
+
+void Kernel::select(cl_kernel kernel, size_t work_group_size)
+{
+    _kernel = kernel;
+    _work_group_size = work_group_size;
+    setVariables();
+    computeGlobalWorkSize();
+}
+
+void Kernel::releaseCandidates(cl_kernel keep)
+{
+    std::vector<cl_kernel> released;
+    for(auto candidate : _candidates){
+        if((candidate.kernel == keep) ||
+           (std::find(released.begin(),
+                      released.end(),
+                      candidate.kernel) != released.end()))
+        {
+            continue;
+        }
+        clReleaseKernel(candidate.kernel);
+        released.push_back(candidate.kernel);
+    }
+    _candidates.clear();
+}
+
+bool Kernel::loadTuning(bool &local, size_t &work_group_size)
+{
+    std::ifstream f(CalcServer::singleton()->settings().tuning_path);
+    if(!f.is_open())
+        return false;
+
+    // The last entry is the valid one
+    bool found = false;
+    std::string line;
+    while(getline(f, line)){
+        if(line.compare(0, _tuning_key.size() + 1, _tuning_key + " "))
+            continue;
+        std::istringstream entry(line.substr(_tuning_key.size() + 1));
+        unsigned int entry_local;
+        size_t entry_work_group_size;
+        if(!(entry >> entry_local >> entry_work_group_size) ||
+           !entry_work_group_size)
+        {
+            continue;
+        }
+        local = entry_local != 0;
+        work_group_size = entry_work_group_size;
+        found = true;
+    }
+    return found;
+}
+
+void Kernel::saveTuning(bool local, size_t work_group_size)
+{
+    const std::string path = CalcServer::singleton()->settings().tuning_path;
+    std::ofstream f(path, std::ios::out | std::ios::app);
+    if(!f.is_open()){
+        std::ostringstream msg;
+        msg << "Failure writing the tuning database \"" << path << "\"."
+            << std::endl;
+        LOG(L_WARNING, msg.str());
+        return;
+    }
+    f << _tuning_key << " " << (local ? 1 : 0) << " " << work_group_size
+      << std::endl;
 }
 
 }}  // namespace
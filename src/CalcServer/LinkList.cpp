@@ -23,6 +23,8 @@
  * CalcServer/LinkList.hcl.in are internally included as a text array.
  */
 
+#include <algorithm>
+
 #include <AuxiliarMethods.h>
 #include <InputOutput/Logger.h>
 #include <CalcServer.h>
@@ -44,6 +46,21 @@ LinkList::LinkList(const std::string tool_name,
     : Tool(tool_name, once)
     , _input_name(input)
     , _cell_length(0.f)
+    , _has_imove(false)
+    , _morton(false)
+    , _incremental_max(0)
+    , _n_radix(0)
+    , _icell_prev(NULL)
+    , _icell_prev_valid(false)
+    , _icell_sorted(NULL)
+    , _moved(NULL)
+    , _moved_ids(NULL)
+    , _moved_keys(NULL)
+    , _moved_idx(NULL)
+    , _n_moved_mem(NULL)
+    , _n_moved(0)
+    , _n_active(0)
+    , _n_active_event(NULL)
     , _min_pos(NULL)
     , _max_pos(NULL)
     , _ihoc(NULL)
@@ -55,6 +72,17 @@ LinkList::LinkList(const std::string tool_name,
     , _ll(NULL)
     , _ll_lws(0)
     , _ll_gws(0)
+    , _changed(NULL)
+    , _changed_lws(0)
+    , _changed_gws(0)
+    , _rank(NULL)
+    , _rank_lws(0)
+    , _merge(NULL)
+    , _merge_lws(0)
+    , _merge_gws(0)
+    , _merge_moved(NULL)
+    , _merge_moved_lws(0)
+    , _plan(this)
 {
     std::stringstream min_pos_name;
     min_pos_name << tool_name << "->Min. Pos.";
@@ -85,18 +113,30 @@ LinkList::~LinkList()
     if(_ihoc) clReleaseKernel(_ihoc); _ihoc=NULL;
     if(_icell) clReleaseKernel(_icell); _icell=NULL;
     if(_ll) clReleaseKernel(_ll); _ll=NULL;
-    for(auto arg : _ihoc_args){
-        free(arg);
-    }
-    _ihoc_args.clear();
-    for(auto arg : _icell_args){
-        free(arg);
-    }
-    _icell_args.clear();
-    for(auto arg : _ll_args){
-        free(arg);
-    }
-    _ll_args.clear();
+    if(_changed) clReleaseKernel(_changed);
+    _changed=NULL;
+    if(_rank) clReleaseKernel(_rank);
+    _rank=NULL;
+    if(_merge) clReleaseKernel(_merge);
+    _merge=NULL;
+    if(_merge_moved) clReleaseKernel(_merge_moved);
+    _merge_moved=NULL;
+    if(_icell_prev) clReleaseMemObject(_icell_prev);
+    _icell_prev=NULL;
+    if(_icell_sorted) clReleaseMemObject(_icell_sorted);
+    _icell_sorted=NULL;
+    if(_moved) clReleaseMemObject(_moved);
+    _moved=NULL;
+    if(_moved_ids) clReleaseMemObject(_moved_ids);
+    _moved_ids=NULL;
+    if(_moved_keys) clReleaseMemObject(_moved_keys);
+    _moved_keys=NULL;
+    if(_moved_idx) clReleaseMemObject(_moved_idx);
+    _moved_idx=NULL;
+    if(_n_moved_mem) clReleaseMemObject(_n_moved_mem);
+    _n_moved_mem=NULL;
+    if(_n_active_event) clReleaseEvent(_n_active_event);
+    _n_active_event=NULL;
 }
 
 void LinkList::setup()
@@ -111,6 +151,46 @@ void LinkList::setup()
     _min_pos->setup();
     _max_pos->setup();
 
+    // Resolve the variables used at each execution
+    _r_min_var = vars->handle("r_min");
+    _r_max_var = vars->handle("r_max");
+    _n_cells_var = vars->handle("n_cells");
+    _ihoc_var = vars->handle("ihoc");
+    _n_active_var = vars->handle("N_active");
+    _has_imove = vars->get("imove") != NULL;
+    const std::vector<std::string> defs =
+        CalcServer::singleton()->definitions();
+    _morton = std::find(defs.begin(), defs.end(),
+                        "-DHAVE_MORTON_CELLS") != defs.end();
+    _icell_var = vars->handle("icell");
+    if(vars->get("incremental_sort_max")){
+        InputOutput::Variable *var = vars->get("incremental_sort_max");
+        if(var->type().compare("unsigned int")){
+            std::stringstream msg;
+            msg << "\"incremental_sort_max\" has and invalid type for \""
+                << name() << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            msg.str("");
+            msg << "\tVariable \"incremental_sort_max\" type is \""
+                << var->type() << "\", while \"unsigned int\" was expected"
+                << std::endl;
+            LOG0(L_DEBUG, msg.str());
+            throw std::runtime_error("Invalid incremental_sort_max type");
+        }
+        _incremental_max = *(unsigned int*)var->get();
+    }
+    if(_n_cells_var->type().compare("uivec4")){
+        std::stringstream msg;
+        msg << "\"n_cells\" has and invalid type for \"" << name()
+            << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        msg.str("");
+        msg << "\tVariable \"n_cells\" type is \"" << _n_cells_var->type()
+            << "\", while \"uivec4\" was expected" << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Invalid n_cells type");
+    }
+
     // Compute the cells length
     InputOutput::Variable *s = vars->get("support");
     InputOutput::Variable *h = vars->get("h");
@@ -121,6 +201,20 @@ void LinkList::setup()
 
     // Setup the radix-sort
     _sort->setup();
+
+    // The dependencies are the ones of the kernels and the internal tools
+    std::vector<InputOutput::Variable*> inputs, outputs;
+    const char* in_names[4] = {"N", "n_radix", "support", "h"};
+    const char* out_names[7] = {"r_min", "r_max", "n_cells", "icell", "ihoc",
+                                "id_sorted", "id_unsorted"};
+    inputs.push_back(vars->get(_input_name));
+    if(_has_imove)
+        inputs.push_back(vars->get("imove"));
+    for(auto var_name : in_names)
+        inputs.push_back(vars->get(var_name));
+    for(auto var_name : out_names)
+        outputs.push_back(vars->get(var_name));
+    setDependencies(inputs, outputs);
 }
 
 void LinkList::_execute()
@@ -135,8 +229,8 @@ void LinkList::_execute()
     nCells();
     allocate();
 
-    // Check the validity of the variables
-    setVariables();
+    // Send the modified variables
+    _plan.update();
 
     // Compute the cell of each particle
     err_code = clEnqueueNDRangeKernel(C->command_queue(),
@@ -147,7 +241,7 @@ void LinkList::_execute()
                                       &_icell_lws,
                                       0,
                                       NULL,
-                                      NULL);
+                                      profilingEvent());
     if(err_code != CL_SUCCESS) {
         std::stringstream msg;
         msg << "Failure executing \"iCell\" from tool \"" <<
@@ -157,8 +251,45 @@ void LinkList::_execute()
         throw std::runtime_error("OpenCL execution error");
     }
 
-    // Sort the particles from the cells
-    _sort->execute();
+    // Sort the particles from the cells. If the number of cells has not
+    // changed, the particles are still sorted by the last time step cells, so
+    // it may be enough to sort the ones which have changed of cell
+    bool incremental = false;
+    if(_incremental_max){
+        const uivec4 n_cells = *(uivec4*)_n_cells_var->get();
+        incremental = _icell_prev_valid &&
+                      (n_cells.x == _n_cells_prev.x) &&
+                      (n_cells.y == _n_cells_prev.y) &&
+                      (n_cells.z == _n_cells_prev.z) &&
+                      (n_cells.w == _n_cells_prev.w);
+        _n_cells_prev = n_cells;
+        if(incremental)
+            incremental = changedCells();
+    }
+    if(incremental)
+        incrementalSort();
+    else
+        _sort->execute();
+    if(_incremental_max){
+        err_code = clEnqueueCopyBuffer(C->command_queue(),
+                                       *(cl_mem*)_icell_var->get(),
+                                       _icell_prev,
+                                       0,
+                                       0,
+                                       _n_radix * sizeof(unsigned int),
+                                       0,
+                                       NULL,
+                                       profilingEvent());
+        if(err_code != CL_SUCCESS){
+            std::stringstream msg;
+            msg << "Failure backing up the sorted cells in tool \""
+                << name() << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL execution error");
+        }
+        _icell_prev_valid = true;
+    }
 
     // Compute the head of cells
     err_code = clEnqueueNDRangeKernel(C->command_queue(),
@@ -169,7 +300,7 @@ void LinkList::_execute()
                                       &_ihoc_lws,
                                       0,
                                       NULL,
-                                      NULL);
+                                      profilingEvent());
     if(err_code != CL_SUCCESS) {
         std::stringstream msg;
         msg << "Failure executing \"iHoc\" from tool \"" <<
@@ -187,7 +318,7 @@ void LinkList::_execute()
                                       &_ll_lws,
                                       0,
                                       NULL,
-                                      NULL);
+                                      profilingEvent());
     if(err_code != CL_SUCCESS) {
         std::stringstream msg;
         msg << "Failure executing \"linkList\" from tool \"" <<
@@ -196,6 +327,53 @@ void LinkList::_execute()
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL execution error");
     }
+
+    // Download the number of active particles, i.e. the head of chain of
+    // the inactive particles cell, without blocking
+    if(!_has_imove)
+        return;
+    if(_n_active_event) clReleaseEvent(_n_active_event);
+    _n_active_event=NULL;
+    uivec4 n_cells = *(uivec4*)_n_cells_var->get();
+    err_code = clEnqueueReadBuffer(C->command_queue(),
+                                   *(cl_mem*)_ihoc_var->get(),
+                                   CL_FALSE,
+                                   n_cells.w * sizeof(unsigned int),
+                                   sizeof(unsigned int),
+                                   &_n_active,
+                                   0,
+                                   NULL,
+                                   &_n_active_event);
+    if(err_code != CL_SUCCESS) {
+        std::stringstream msg;
+        msg << "Failure downloading the number of active particles in tool \""
+            << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+}
+
+void LinkList::synchronize()
+{
+    cl_int err_code, status;
+
+    if(!_n_active_event)
+        return;
+    err_code = clGetEventInfo(_n_active_event,
+                              CL_EVENT_COMMAND_EXECUTION_STATUS,
+                              sizeof(cl_int),
+                              &status,
+                              NULL);
+    if((err_code != CL_SUCCESS) || (status != CL_COMPLETE))
+        return;
+    clReleaseEvent(_n_active_event);
+    _n_active_event=NULL;
+
+    if(*(unsigned int*)_n_active_var->get() != _n_active){
+        unsigned int n_active = _n_active;
+        _n_active_var->set(&n_active);
+    }
 }
 
 void LinkList::setupOpenCL()
@@ -209,6 +387,16 @@ void LinkList::setupOpenCL()
 
     // Create a header for the source code where the operation will be placed
     std::ostringstream source;
+    if(_has_imove)
+        source << "#define HAVE_IMOVE" << std::endl;
+    if(_morton)
+        source << "#define HAVE_MORTON_CELLS" << std::endl;
+    const std::string storage =
+        ((InputOutput::ArrayVariable*)vars->get(_input_name))->storage();
+    if(!storage.compare("half"))
+        source << "#define HALF_R" << std::endl;
+    else if(!storage.compare("packed"))
+        source << "#define PACKED_R" << std::endl;
     source << LINKLIST_INC << LINKLIST_SRC;
     compile(source.str());
 
@@ -233,25 +421,10 @@ void LinkList::setupOpenCL()
         throw std::runtime_error("OpenCL error");
     }
     n_cells = *(uivec4*)vars->get("n_cells")->get();
-    _ihoc_gws = roundUp(n_cells.w, _ihoc_lws);
+    _ihoc_gws = roundUp(n_cells.w + 1, _ihoc_lws);
     const char *_ihoc_vars[3] = {"ihoc", "N", "n_cells"};
     for(i = 0; i < 3; i++){
-        err_code = clSetKernelArg(_ihoc,
-                                  i,
-                                  vars->get(_ihoc_vars[i])->typesize(),
-                                  vars->get(_ihoc_vars[i])->get());
-        if(err_code != CL_SUCCESS){
-            std::stringstream msg;
-            msg << "Failure sending \"" << _ihoc_vars[i]
-                << "\" argument to \"iHoc\"." << std::endl;
-            LOG(L_ERROR, msg.str());
-            InputOutput::Logger::singleton()->printOpenCLError(err_code);
-            throw std::runtime_error("OpenCL error");
-        }
-        _ihoc_args.push_back(malloc(vars->get(_ihoc_vars[i])->typesize()));
-        memcpy(_ihoc_args.at(i),
-               vars->get(_ihoc_vars[i])->get(),
-               vars->get(_ihoc_vars[i])->typesize());
+        _plan.bind(_ihoc, i, vars->handle(_ihoc_vars[i]));
     }
 
     err_code = clGetKernelWorkGroupInfo(_icell,
@@ -276,25 +449,13 @@ void LinkList::setupOpenCL()
     }
     n_radix = *(unsigned int*)vars->get("n_radix")->get();
     _icell_gws = roundUp(n_radix, _icell_lws);
-    const char *_icell_vars[8] = {"icell", _input_name.c_str(), "N", "n_radix",
-                                  "r_min", "support", "h", "n_cells"};
-    for(i = 0; i < 8; i++){
-        err_code = clSetKernelArg(_icell,
-                                  i,
-                                  vars->get(_icell_vars[i])->typesize(),
-                                  vars->get(_icell_vars[i])->get());
-        if(err_code != CL_SUCCESS){
-            std::stringstream msg;
-            msg << "Failure sending \"" << _icell_vars[i]
-                << "\" argument to \"iCell\"." << std::endl;
-            LOG(L_ERROR, msg.str());
-            InputOutput::Logger::singleton()->printOpenCLError(err_code);
-            throw std::runtime_error("OpenCL error");
-        }
-        _icell_args.push_back(malloc(vars->get(_icell_vars[i])->typesize()));
-        memcpy(_icell_args.at(i),
-               vars->get(_icell_vars[i])->get(),
-               vars->get(_icell_vars[i])->typesize());
+    std::vector<std::string> _icell_vars = {"icell", _input_name, "N",
+                                            "n_radix", "r_min", "support",
+                                            "h", "n_cells"};
+    if(_has_imove)
+        _icell_vars.insert(_icell_vars.begin() + 2, "imove");
+    for(i = 0; i < _icell_vars.size(); i++){
+        _plan.bind(_icell, i, vars->handle(_icell_vars.at(i)));
     }
 
     err_code = clGetKernelWorkGroupInfo(_ll,
@@ -321,23 +482,11 @@ void LinkList::setupOpenCL()
     _ll_gws = roundUp(N, _ll_lws);
     const char *_ll_vars[3] = {"icell", "ihoc", "N"};
     for(i = 0; i < 3; i++){
-        err_code = clSetKernelArg(_ll,
-                                  i,
-                                  vars->get(_ll_vars[i])->typesize(),
-                                  vars->get(_ll_vars[i])->get());
-        if(err_code != CL_SUCCESS){
-            std::stringstream msg;
-            msg << "Failure sending \"" << _ll_vars[i]
-                << "\" argument to \"iCell\"." << std::endl;
-            LOG(L_ERROR, msg.str());
-            InputOutput::Logger::singleton()->printOpenCLError(err_code);
-            throw std::runtime_error("OpenCL error");
-        }
-        _ll_args.push_back(malloc(vars->get(_ll_vars[i])->typesize()));
-        memcpy(_ll_args.at(i),
-               vars->get(_ll_vars[i])->get(),
-               vars->get(_ll_vars[i])->typesize());
+        _plan.bind(_ll, i, vars->handle(_ll_vars[i]));
     }
+
+    if(_incremental_max)
+        setupIncremental();
 }
 
 void LinkList::compile(const std::string source)
@@ -358,19 +507,13 @@ void LinkList::compile(const std::string source)
     #else
         flags << " -DHAVE_2D ";
     #endif
-    size_t source_length = source.size();
-    const char* source_cstr = source.c_str();
-    program = clCreateProgramWithSource(C->context(),
-                                        1,
-                                        &source_cstr,
-                                        &source_length,
-                                        &err_code);
+    program = C->programCache()->create(source, flags.str(), &err_code);
     if(err_code != CL_SUCCESS) {
         LOG(L_ERROR, "Failure creating the OpenCL program.\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL compilation error");
     }
-    err_code = clBuildProgram(program, 0, NULL, flags.str().c_str(), NULL, NULL);
+    err_code = C->programCache()->build(program, flags.str());
     if(err_code != CL_SUCCESS) {
         LOG(L_ERROR, "Error compiling the source code\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
@@ -426,6 +569,25 @@ void LinkList::compile(const std::string source)
         clReleaseProgram(program);
         throw std::runtime_error("OpenCL error");
     }
+    if(!_incremental_max){
+        clReleaseProgram(program);
+        return;
+    }
+    const char *inc_names[4] = {"changedCells", "rankChanged",
+                                "mergeUnchanged", "mergeChanged"};
+    cl_kernel *inc_kernels[4] = {&_changed, &_rank, &_merge, &_merge_moved};
+    for(unsigned int i = 0; i < 4; i++){
+        *inc_kernels[i] = clCreateKernel(program, inc_names[i], &err_code);
+        if(err_code != CL_SUCCESS) {
+            std::stringstream msg;
+            msg << "Failure creating the \"" << inc_names[i] << "\" kernel."
+                << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            clReleaseProgram(program);
+            throw std::runtime_error("OpenCL error");
+        }
+    }
 
     clReleaseProgram(program);
 }
@@ -433,7 +595,6 @@ void LinkList::compile(const std::string source)
 void LinkList::nCells()
 {
     vec pos_min, pos_max;
-    InputOutput::Variables *vars = CalcServer::singleton()->variables();
 
     if(!_cell_length){
         std::stringstream msg;
@@ -443,8 +604,8 @@ void LinkList::nCells()
         throw std::runtime_error("Invalid number of cells");
     }
 
-    pos_min = *(vec*)vars->get("r_min")->get();
-    pos_max = *(vec*)vars->get("r_max")->get();
+    pos_min = *(vec*)_r_min_var->get();
+    pos_max = *(vec*)_r_max_var->get();
 
     _n_cells.x = (unsigned int)((pos_max.x - pos_min.x) / _cell_length) + 6;
     _n_cells.y = (unsigned int)((pos_max.y - pos_min.y) / _cell_length) + 6;
@@ -454,6 +615,18 @@ void LinkList::nCells()
         _n_cells.z = 1;
     #endif
     _n_cells.w = _n_cells.x * _n_cells.y * _n_cells.z;
+    if(_morton){
+        // The cells are numbered in full tiles (see CELL_ID() at
+        // LinkList.hcl.in)
+        #ifdef HAVE_3D
+            _n_cells.w = ((_n_cells.x + 7) / 8) *
+                         ((_n_cells.y + 7) / 8) *
+                         ((_n_cells.z + 7) / 8) * 512;
+        #else
+            _n_cells.w = ((_n_cells.x + 15) / 16) *
+                         ((_n_cells.y + 15) / 16) * 256;
+        #endif
+    }
 }
 
 void LinkList::allocate()
@@ -461,38 +634,25 @@ void LinkList::allocate()
     uivec4 n_cells;
     cl_int err_code;
     CalcServer *C = CalcServer::singleton();
-    InputOutput::Variables *vars = C->variables();
 
-    if(vars->get("n_cells")->type().compare("uivec4")){
-        std::stringstream msg;
-        msg << "\"n_cells\" has and invalid type for \"" << name()
-            << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        msg.str("");
-        msg << "\tVariable \"n_cells\" type is \"" << vars->get("n_cells")->type()
-            << "\", while \"uivec4\" was expected" << std::endl;
-        LOG0(L_DEBUG, msg.str());
-        throw std::runtime_error("Invalid n_cells type");
-    }
-
-    n_cells = *(uivec4*)vars->get("n_cells")->get();
+    n_cells = *(uivec4*)_n_cells_var->get();
 
     if(_n_cells.w <= n_cells.w){
         n_cells.x = _n_cells.x;
         n_cells.y = _n_cells.y;
         n_cells.z = _n_cells.z;
-        vars->get("n_cells")->set(&n_cells);
+        _n_cells_var->set(&n_cells);
         return;
     }
 
-    cl_mem mem = *(cl_mem*)vars->get("ihoc")->get();
+    cl_mem mem = *(cl_mem*)_ihoc_var->get();
     if(mem) clReleaseMemObject(mem); mem = NULL;
 
-    mem = clCreateBuffer(C->context(),
-                         CL_MEM_READ_WRITE,
-                         _n_cells.w * sizeof(unsigned int),
-                         NULL,
-                         &err_code);
+    // Grow geometrically, so the domain growth is not reallocating the
+    // memory every time step
+    _n_cells.w = MemoryPool::capacity(_n_cells.w, n_cells.w);
+    mem = C->memoryPool()->allocate((_n_cells.w + 1) * sizeof(unsigned int),
+                                    &err_code);
     if(err_code != CL_SUCCESS){
         std::stringstream msg;
         msg << "Failure allocating device memory in the tool \"" <<
@@ -503,82 +663,310 @@ void LinkList::allocate()
     }
 
     n_cells = _n_cells;
-    vars->get("n_cells")->set(&n_cells);
-    vars->get("ihoc")->set(&mem);
-    _ihoc_gws = roundUp(n_cells.w, _ihoc_lws);
+    _n_cells_var->set(&n_cells);
+    _ihoc_var->set(&mem);
+    _ihoc_gws = roundUp(n_cells.w + 1, _ihoc_lws);
 }
 
-void LinkList::setVariables()
+void LinkList::setupIncremental()
 {
     unsigned int i;
     cl_int err_code;
-    InputOutput::Variables *vars = CalcServer::singleton()->variables();
+    CalcServer *C = CalcServer::singleton();
+    InputOutput::Variables *vars = C->variables();
 
-    const char *_ihoc_vars[3] = {"ihoc", "N", "n_cells"};
-    for(i = 0; i < 3; i++){
-        InputOutput::Variable *var = vars->get(_ihoc_vars[i]);
-        if(!memcmp(var->get(), _ihoc_args.at(i), var->typesize())){
-            continue;
-        }
-        err_code = clSetKernelArg(_ihoc,
-                                  i,
-                                  var->typesize(),
-                                  var->get());
+    _n_radix = *(unsigned int*)vars->get("n_radix")->get();
+    if(_incremental_max > _n_radix)
+        _incremental_max = _n_radix;
+
+    // The sorted cells of the last time step should persist
+    _icell_prev = C->memoryPool()->allocate(_n_radix * sizeof(unsigned int),
+                                            &err_code);
+    if(err_code != CL_SUCCESS){
+        std::stringstream msg;
+        msg << "Failure allocating device memory in the tool \"" <<
+               name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL allocation error");
+    }
+
+    // The rest of memory objects are just used within the execution, so they
+    // can be shared with the other tools
+    cl_mem *scratch_mems[6] = {&_icell_sorted, &_moved, &_moved_ids,
+                               &_moved_keys, &_moved_idx, &_n_moved_mem};
+    const size_t scratch_lens[6] = {_n_radix, _incremental_max,
+                                    _incremental_max, _incremental_max,
+                                    _incremental_max, 1};
+    C->memoryPool()->releaseScratch(this);
+    for(i = 0; i < 6; i++){
+        *scratch_mems[i] = C->memoryPool()->scratch(
+            this, scratch_lens[i] * sizeof(unsigned int), &err_code);
         if(err_code != CL_SUCCESS){
             std::stringstream msg;
-            msg << "Failure setting the variable \"" << _ihoc_vars[i]
-                << "\" to the tool \"" << name()
-                << "\" (\"iHoc\")." << std::endl;
+            msg << "Failure allocating device memory in the tool \"" <<
+                   name() << "\"." << std::endl;
             LOG(L_ERROR, msg.str());
             InputOutput::Logger::singleton()->printOpenCLError(err_code);
-            throw std::runtime_error("OpenCL error");
+            throw std::runtime_error("OpenCL allocation error");
         }
-        memcpy(_ihoc_args.at(i), var->get(), var->typesize());
     }
-
-    const char *_icell_vars[8] = {"icell", _input_name.c_str(), "N", "n_radix",
-                                  "r_min", "support", "h", "n_cells"};
-    for(i = 0; i < 8; i++){
-        InputOutput::Variable *var = vars->get(_icell_vars[i]);
-        if(!memcmp(var->get(), _icell_args.at(i), var->typesize())){
-            continue;
+    allocatedMemory((2 * _n_radix + 4 * _incremental_max + 1) *
+                    sizeof(unsigned int));
+
+    // Get the work group sizes
+    cl_kernel kernels[4] = {_changed, _rank, _merge, _merge_moved};
+    size_t *lws[4] = {&_changed_lws, &_rank_lws, &_merge_lws,
+                      &_merge_moved_lws};
+    for(i = 0; i < 4; i++){
+        err_code = clGetKernelWorkGroupInfo(kernels[i],
+                                            C->device(),
+                                            CL_KERNEL_WORK_GROUP_SIZE,
+                                            sizeof(size_t),
+                                            lws[i],
+                                            NULL);
+        if(err_code != CL_SUCCESS) {
+            LOG(L_ERROR, "Failure querying the incremental sort work group size.\n");
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+        if(*lws[i] < __CL_MIN_LOCALSIZE__){
+            LOG(L_ERROR, "insufficient local memory for the incremental sort.\n");
+            std::stringstream msg;
+            msg << "\t" << *lws[i]
+                << " local work group size with __CL_MIN_LOCALSIZE__="
+                << __CL_MIN_LOCALSIZE__ << std::endl;
+            LOG0(L_DEBUG, msg.str());
+            throw std::runtime_error("OpenCL error");
         }
-        err_code = clSetKernelArg(_icell,
-                                  i,
-                                  var->typesize(),
-                                  var->get());
+    }
+    _changed_gws = roundUp(_n_radix, _changed_lws);
+    _merge_gws = roundUp(_n_radix, _merge_lws);
+
+    // Bind the variables
+    _plan.bind(_changed, 0, _icell_var);
+    _plan.bind(_changed, 4, vars->handle("n_radix"));
+    _plan.bind(_rank, 0, _icell_var);
+    _plan.bind(_merge, 0, _icell_var);
+    _plan.bind(_merge, 5, vars->handle("id_unsorted"));
+    _plan.bind(_merge, 6, vars->handle("id_sorted"));
+    _plan.bind(_merge, 8, vars->handle("n_radix"));
+    _plan.bind(_merge_moved, 4, vars->handle("id_unsorted"));
+    _plan.bind(_merge_moved, 5, vars->handle("id_sorted"));
+    _plan.bind(_merge_moved, 7, vars->handle("n_radix"));
+
+    // And send the memory objects owned by the tool
+    const cl_kernel mem_kernels[17] = {
+        _changed, _changed, _changed,
+        _rank, _rank, _rank, _rank,
+        _merge, _merge, _merge, _merge, _merge,
+        _merge_moved, _merge_moved, _merge_moved, _merge_moved, _merge_moved};
+    const cl_uint mem_indexes[17] = {
+        1, 2, 3,
+        1, 2, 3, 4,
+        1, 2, 3, 4, 7,
+        0, 1, 2, 3, 6};
+    const cl_mem mems[17] = {
+        _icell_prev, _moved, _n_moved_mem,
+        _moved, _moved_ids, _moved_keys, _moved_idx,
+        _icell_prev, _moved_ids, _moved_keys, _moved_idx, _icell_sorted,
+        _icell_prev, _moved_ids, _moved_keys, _moved_idx, _icell_sorted};
+    for(i = 0; i < 17; i++){
+        err_code = clSetKernelArg(mem_kernels[i],
+                                  mem_indexes[i],
+                                  sizeof(cl_mem),
+                                  (void*)&mems[i]);
         if(err_code != CL_SUCCESS){
             std::stringstream msg;
-            msg << "Failure setting the variable \"" << _ihoc_vars[i]
-                << "\" to the tool \"" << name()
-                << "\" (\"iCell\")." << std::endl;
+            msg << "Failure sending the argument " << mem_indexes[i]
+                << " to the incremental sort in tool \"" << name() << "\"."
+                << std::endl;
             LOG(L_ERROR, msg.str());
             InputOutput::Logger::singleton()->printOpenCLError(err_code);
             throw std::runtime_error("OpenCL error");
         }
-        memcpy(_icell_args.at(i), var->get(), var->typesize());
     }
+    err_code = clSetKernelArg(_changed,
+                              5,
+                              sizeof(unsigned int),
+                              (void*)&_incremental_max);
+    if(err_code != CL_SUCCESS){
+        std::stringstream msg;
+        msg << "Failure sending the argument 5 to \"changedCells\" in tool \""
+            << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+}
 
-    const char *_ll_vars[3] = {"icell", "ihoc", "N"};
+bool LinkList::changedCells()
+{
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+    static const unsigned int zero = 0;
+
+    err_code = clEnqueueWriteBuffer(C->command_queue(),
+                                    _n_moved_mem,
+                                    CL_FALSE,
+                                    0,
+                                    sizeof(unsigned int),
+                                    &zero,
+                                    0,
+                                    NULL,
+                                    profilingEvent());
+    if(err_code != CL_SUCCESS) {
+        std::stringstream msg;
+        msg << "Failure resetting the number of particles which have changed "
+            << "of cell in tool \"" << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+
+    err_code = clEnqueueNDRangeKernel(C->command_queue(),
+                                      _changed,
+                                      1,
+                                      NULL,
+                                      &_changed_gws,
+                                      &_changed_lws,
+                                      0,
+                                      NULL,
+                                      profilingEvent());
+    if(err_code != CL_SUCCESS) {
+        std::stringstream msg;
+        msg << "Failure executing \"changedCells\" from tool \"" <<
+               name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+
+    // The sorting method depends on the number of particles which have
+    // changed of cell, so we should wait for it
+    err_code = clEnqueueReadBuffer(C->command_queue(),
+                                   _n_moved_mem,
+                                   CL_TRUE,
+                                   0,
+                                   sizeof(unsigned int),
+                                   &_n_moved,
+                                   0,
+                                   NULL,
+                                   profilingEvent());
+    if(err_code != CL_SUCCESS) {
+        std::stringstream msg;
+        msg << "Failure downloading the number of particles which have "
+            << "changed of cell in tool \"" << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+
+    return _n_moved <= _incremental_max;
+}
+
+void LinkList::incrementalSort()
+{
+    unsigned int i;
+    size_t gws;
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+
+    // Send the number of particles which have changed of cell
+    cl_kernel kernels[3] = {_rank, _merge, _merge_moved};
+    cl_uint indexes[3] = {5, 9, 8};
     for(i = 0; i < 3; i++){
-        InputOutput::Variable *var = vars->get(_ll_vars[i]);
-        if(!memcmp(var->get(), _ll_args.at(i), var->typesize())){
-            continue;
-        }
-        err_code = clSetKernelArg(_ll,
-                                  i,
-                                  var->typesize(),
-                                  var->get());
+        err_code = clSetKernelArg(kernels[i],
+                                  indexes[i],
+                                  sizeof(unsigned int),
+                                  (void*)&_n_moved);
         if(err_code != CL_SUCCESS){
             std::stringstream msg;
-            msg << "Failure setting the variable \"" << _ihoc_vars[i]
-                << "\" to the tool \"" << name()
-                << "\" (\"linkList\")." << std::endl;
+            msg << "Failure sending the number of particles which have "
+                << "changed of cell in tool \"" << name() << "\"."
+                << std::endl;
             LOG(L_ERROR, msg.str());
             InputOutput::Logger::singleton()->printOpenCLError(err_code);
             throw std::runtime_error("OpenCL error");
         }
-        memcpy(_ll_args.at(i), var->get(), var->typesize());
+    }
+
+    if(_n_moved){
+        gws = roundUp(_n_moved, _rank_lws);
+        err_code = clEnqueueNDRangeKernel(C->command_queue(),
+                                          _rank,
+                                          1,
+                                          NULL,
+                                          &gws,
+                                          &_rank_lws,
+                                          0,
+                                          NULL,
+                                          profilingEvent());
+        if(err_code != CL_SUCCESS) {
+            std::stringstream msg;
+            msg << "Failure executing \"rankChanged\" from tool \"" <<
+                   name() << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL execution error");
+        }
+    }
+
+    err_code = clEnqueueNDRangeKernel(C->command_queue(),
+                                      _merge,
+                                      1,
+                                      NULL,
+                                      &_merge_gws,
+                                      &_merge_lws,
+                                      0,
+                                      NULL,
+                                      profilingEvent());
+    if(err_code != CL_SUCCESS) {
+        std::stringstream msg;
+        msg << "Failure executing \"mergeUnchanged\" from tool \"" <<
+               name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+
+    if(_n_moved){
+        gws = roundUp(_n_moved, _merge_moved_lws);
+        err_code = clEnqueueNDRangeKernel(C->command_queue(),
+                                          _merge_moved,
+                                          1,
+                                          NULL,
+                                          &gws,
+                                          &_merge_moved_lws,
+                                          0,
+                                          NULL,
+                                          profilingEvent());
+        if(err_code != CL_SUCCESS) {
+            std::stringstream msg;
+            msg << "Failure executing \"mergeChanged\" from tool \"" <<
+                   name() << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL execution error");
+        }
+    }
+
+    err_code = clEnqueueCopyBuffer(C->command_queue(),
+                                   _icell_sorted,
+                                   *(cl_mem*)_icell_var->get(),
+                                   0,
+                                   0,
+                                   _n_radix * sizeof(unsigned int),
+                                   0,
+                                   NULL,
+                                   profilingEvent());
+    if(err_code != CL_SUCCESS){
+        std::stringstream msg;
+        msg << "Failure copying the sorted cells in tool \"" << name()
+            << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
     }
 }
 
@@ -0,0 +1,342 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Device memory pool.
+ * (See Aqua::CalcServer::MemoryPool for details)
+ */
+
+#include <pthread.h>
+
+#include <InputOutput/Logger.h>
+#include <CalcServer/MemoryPool.h>
+
+/// Minimum size of the memory chunks (16 MB)
+#ifndef __MIN_CHUNK_SIZE__
+    #define __MIN_CHUNK_SIZE__ 16777216
+#endif
+
+namespace Aqua{ namespace CalcServer{
+
+/** @brief Mutex to access the pools.
+ *
+ * It is shared by all the pools, since their memory objects may be released
+ * after the pool itself, from the OpenCL implementation threads.
+ */
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** @brief Callback called by OpenCL when a memory object allocated by the
+ * pool is destroyed.
+ * @param mem Memory object.
+ * @param data Region (see Aqua::CalcServer::MemoryPool::poolRegion).
+ */
+static void CL_CALLBACK memDestructor(cl_mem mem, void *data)
+{
+    // The region is already known from the user data
+    (void)mem;
+    MemoryPool::poolRegion *region = (MemoryPool::poolRegion*)data;
+    pthread_mutex_lock(&pool_mutex);
+    if(region->pool)
+        region->pool->released(region);
+    pthread_mutex_unlock(&pool_mutex);
+    delete region;
+}
+
+MemoryPool::MemoryPool(cl_context context, bool share_scratch)
+    : _context(context)
+    , _share_scratch(share_scratch)
+    , _align(128)
+    , _max_alloc(0)
+    , _allocated(0)
+    , _scratch(NULL)
+    , _scratch_size(0)
+{
+    cl_int err_code;
+    cl_uint num_devices;
+
+    // The sub-buffers should be aligned, and the chunks should fit in all the
+    // devices
+    err_code = clGetContextInfo(_context,
+                                CL_CONTEXT_NUM_DEVICES,
+                                sizeof(cl_uint),
+                                &num_devices,
+                                NULL);
+    if(err_code != CL_SUCCESS){
+        LOG(L_ERROR, "Failure getting the number of context devices.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+    std::vector<cl_device_id> devices(num_devices);
+    err_code = clGetContextInfo(_context,
+                                CL_CONTEXT_DEVICES,
+                                num_devices * sizeof(cl_device_id),
+                                devices.data(),
+                                NULL);
+    if(err_code != CL_SUCCESS){
+        LOG(L_ERROR, "Failure getting the context devices.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+    for(auto device : devices){
+        cl_uint align_bits;
+        cl_ulong max_alloc;
+        err_code = clGetDeviceInfo(device,
+                                   CL_DEVICE_MEM_BASE_ADDR_ALIGN,
+                                   sizeof(cl_uint),
+                                   &align_bits,
+                                   NULL);
+        err_code |= clGetDeviceInfo(device,
+                                    CL_DEVICE_MAX_MEM_ALLOC_SIZE,
+                                    sizeof(cl_ulong),
+                                    &max_alloc,
+                                    NULL);
+        if(err_code != CL_SUCCESS){
+            LOG(L_ERROR, "Failure getting the device memory alignment.\n");
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+        if(align_bits / 8 > _align)
+            _align = align_bits / 8;
+        if(!_max_alloc || (max_alloc < _max_alloc))
+            _max_alloc = max_alloc;
+    }
+}
+
+MemoryPool::~MemoryPool()
+{
+    // The memory objects still alive will not report back
+    pthread_mutex_lock(&pool_mutex);
+    for(auto region : _regions){
+        region->pool = NULL;
+    }
+    _regions.clear();
+    pthread_mutex_unlock(&pool_mutex);
+
+    for(auto chunk : _chunks){
+        clReleaseMemObject(chunk.mem);
+    }
+    _chunks.clear();
+    if(_scratch) clReleaseMemObject(_scratch);
+    _scratch = NULL;
+    _scratch_used.clear();
+}
+
+cl_mem MemoryPool::allocate(size_t size, cl_int *err_code)
+{
+    unsigned int i;
+    cl_mem mem;
+
+    // The large objects are not worth to be carved
+    if(size > _max_alloc / 2)
+        return dedicated(size, err_code);
+
+    pthread_mutex_lock(&pool_mutex);
+    for(i = 0; i < _chunks.size(); i++){
+        mem = carve(i, size, err_code);
+        if(mem){
+            pthread_mutex_unlock(&pool_mutex);
+            return mem;
+        }
+    }
+
+    // Add a new chunk, geometrically growing the pool
+    size_t chunk_size = __MIN_CHUNK_SIZE__;
+    if(_chunks.size()){
+        size_t last_size = 0;
+        clGetMemObjectInfo(_chunks.back().mem,
+                           CL_MEM_SIZE,
+                           sizeof(size_t),
+                           &last_size,
+                           NULL);
+        chunk_size = 2 * last_size;
+    }
+    if(chunk_size < size)
+        chunk_size = size;
+    if(chunk_size > _max_alloc)
+        chunk_size = _max_alloc;
+    memChunk chunk;
+    chunk.mem = create(chunk_size, err_code);
+    if(!chunk.mem){
+        pthread_mutex_unlock(&pool_mutex);
+        return NULL;
+    }
+    chunk.free[0] = chunk_size;
+    _chunks.push_back(chunk);
+    std::ostringstream msg;
+    msg << "\tNew device memory chunk of " << chunk_size << " bytes"
+        << std::endl;
+    LOG0(L_DEBUG, msg.str());
+
+    mem = carve(_chunks.size() - 1, size, err_code);
+    pthread_mutex_unlock(&pool_mutex);
+    return mem;
+}
+
+cl_mem MemoryPool::dedicated(size_t size, cl_int *err_code)
+{
+    pthread_mutex_lock(&pool_mutex);
+    cl_mem mem = create(size, err_code);
+    pthread_mutex_unlock(&pool_mutex);
+    return mem;
+}
+
+cl_mem MemoryPool::scratch(const void *owner, size_t size, cl_int *err_code)
+{
+    if(!_share_scratch)
+        return allocate(size, err_code);
+
+    cl_mem old_scratch = NULL;
+    pthread_mutex_lock(&pool_mutex);
+    size_t offset = _scratch_used[owner];
+    size_t end = offset + ((size + _align - 1) / _align) * _align;
+    if(end > _scratch_size){
+        // The previous scratch memory is kept alive by its sub-buffers, until
+        // their owners ask for new ones
+        size_t scratch_size = capacity(end, _scratch_size);
+        cl_mem mem = create(scratch_size, err_code);
+        if(!mem){
+            pthread_mutex_unlock(&pool_mutex);
+            return NULL;
+        }
+        old_scratch = _scratch;
+        _scratch = mem;
+        _scratch_size = scratch_size;
+        // The owners sub-buffers cannot be moved to the new memory
+        _scratch_used.clear();
+        offset = 0;
+        end = ((size + _align - 1) / _align) * _align;
+    }
+    cl_mem mem = sub(_scratch, offset, size, err_code);
+    if(mem)
+        _scratch_used[owner] = end;
+    pthread_mutex_unlock(&pool_mutex);
+    // Released out of the lock, since the destructor callback may be called
+    if(old_scratch) clReleaseMemObject(old_scratch);
+    return mem;
+}
+
+void MemoryPool::releaseScratch(const void *owner)
+{
+    pthread_mutex_lock(&pool_mutex);
+    _scratch_used.erase(owner);
+    pthread_mutex_unlock(&pool_mutex);
+}
+
+size_t MemoryPool::capacity(size_t required, size_t current)
+{
+    size_t grown = current + current / 2;
+    return required > grown ? required : grown;
+}
+
+void MemoryPool::released(poolRegion *region)
+{
+    _regions.erase(region);
+    if(region->chunk < 0){
+        _allocated -= region->size;
+        return;
+    }
+
+    // Give back the region to the chunk, merging it with the neighbours
+    std::map<size_t, size_t> &free = _chunks.at(region->chunk).free;
+    size_t offset = region->offset;
+    size_t size = region->size;
+    auto next = free.lower_bound(offset);
+    if((next != free.end()) && (offset + size == next->first)){
+        size += next->second;
+        free.erase(next);
+    }
+    auto prev = free.lower_bound(offset);
+    if(prev != free.begin()){
+        --prev;
+        if(prev->first + prev->second == offset){
+            offset = prev->first;
+            size += prev->second;
+            free.erase(prev);
+        }
+    }
+    free[offset] = size;
+}
+
+cl_mem MemoryPool::create(size_t size, cl_int *err_code)
+{
+    cl_mem mem = clCreateBuffer(_context,
+                                CL_MEM_READ_WRITE,
+                                size,
+                                NULL,
+                                err_code);
+    if(*err_code != CL_SUCCESS)
+        return NULL;
+
+    poolRegion *region = new poolRegion;
+    region->pool = this;
+    region->chunk = -1;
+    region->offset = 0;
+    region->size = size;
+    _regions.insert(region);
+    clSetMemObjectDestructorCallback(mem, memDestructor, region);
+    _allocated += size;
+    return mem;
+}
+
+cl_mem MemoryPool::carve(unsigned int chunk, size_t size, cl_int *err_code)
+{
+    size_t aligned_size = ((size + _align - 1) / _align) * _align;
+    std::map<size_t, size_t> &free = _chunks.at(chunk).free;
+    for(auto it = free.begin(); it != free.end(); ++it){
+        if(it->second < aligned_size)
+            continue;
+        size_t offset = it->first;
+        cl_mem mem = sub(_chunks.at(chunk).mem, offset, size, err_code);
+        if(!mem)
+            return NULL;
+        // The offsets are ever aligned, since the sizes are
+        if(it->second > aligned_size)
+            free[offset + aligned_size] = it->second - aligned_size;
+        free.erase(offset);
+
+        poolRegion *region = new poolRegion;
+        region->pool = this;
+        region->chunk = chunk;
+        region->offset = offset;
+        region->size = aligned_size;
+        _regions.insert(region);
+        clSetMemObjectDestructorCallback(mem, memDestructor, region);
+        return mem;
+    }
+    return NULL;
+}
+
+cl_mem MemoryPool::sub(cl_mem parent,
+                       size_t offset,
+                       size_t size,
+                       cl_int *err_code)
+{
+    cl_buffer_region buffer_region;
+    buffer_region.origin = offset;
+    buffer_region.size = size;
+    cl_mem mem = clCreateSubBuffer(parent,
+                                   CL_MEM_READ_WRITE,
+                                   CL_BUFFER_CREATE_TYPE_REGION,
+                                   &buffer_region,
+                                   err_code);
+    if(*err_code != CL_SUCCESS)
+        return NULL;
+    return mem;
+}
+
+}}  // namespaces
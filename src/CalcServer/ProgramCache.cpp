@@ -0,0 +1,408 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief On-disk cache of compiled OpenCL programs.
+ * (See Aqua::CalcServer::ProgramCache for details)
+ */
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <fstream>
+#include <functional>
+
+#include <AuxiliarMethods.h>
+#include <InputOutput/Logger.h>
+#include <CalcServer/ProgramCache.h>
+
+namespace Aqua{ namespace CalcServer{
+
+ProgramCache::ProgramCache(cl_context context, const std::string path)
+    : _context(context)
+    , _path(path)
+{
+    cl_int err_code;
+    cl_uint num_devices;
+
+    pthread_mutex_init(&_mutex, NULL);
+    pthread_mutex_init(&_programs_mutex, NULL);
+
+    if(!_path.compare(""))
+        return;
+
+    err_code = clGetContextInfo(_context,
+                                CL_CONTEXT_NUM_DEVICES,
+                                sizeof(cl_uint),
+                                &num_devices,
+                                NULL);
+    if(err_code == CL_SUCCESS){
+        _devices.resize(num_devices);
+        err_code = clGetContextInfo(_context,
+                                    CL_CONTEXT_DEVICES,
+                                    num_devices * sizeof(cl_device_id),
+                                    _devices.data(),
+                                    NULL);
+    }
+    if(err_code != CL_SUCCESS){
+        LOG(L_WARNING, "Failure getting the context devices.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        LOG0(L_DEBUG, "\tThe programs cache is disabled\n");
+        _path = "";
+        return;
+    }
+
+    // The binaries are just valid for the same devices and drivers
+    std::ostringstream devices_id;
+    for(auto device : _devices){
+        char name[1024], version[1024];
+        strcpy(name, "");
+        strcpy(version, "");
+        clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(name), name, NULL);
+        clGetDeviceInfo(device, CL_DRIVER_VERSION, sizeof(version), version,
+                        NULL);
+        devices_id << name << ";" << version << ";";
+    }
+    _devices_id = devices_id.str();
+
+    if(mkdir(_path.c_str(), 0755) && (errno != EEXIST)){
+        std::ostringstream msg;
+        msg << "Failure creating the programs cache folder \"" << _path
+            << "\"." << std::endl;
+        LOG(L_WARNING, msg.str());
+        msg.str(""); msg << "\t" << strerror(errno) << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        LOG0(L_DEBUG, "\tThe programs cache is disabled\n");
+        _path = "";
+        return;
+    }
+
+    std::ostringstream msg;
+    msg << "Programs cache in \"" << _path << "\"" << std::endl;
+    LOG(L_INFO, msg.str());
+}
+
+ProgramCache::~ProgramCache()
+{
+    release();
+    _pending.clear();
+    pthread_mutex_destroy(&_mutex);
+    pthread_mutex_destroy(&_programs_mutex);
+}
+
+cl_program ProgramCache::create(const std::string source,
+                                const std::string flags,
+                                cl_int *err_code)
+{
+    cl_program program;
+    std::string path;
+
+    if(_path.compare("")){
+        path = file(source, flags);
+        program = load(path, err_code);
+        if(program)
+            return program;
+    }
+
+    size_t source_length = source.size();
+    const char* source_cstr = source.c_str();
+    program = clCreateProgramWithSource(_context,
+                                        1,
+                                        &source_cstr,
+                                        &source_length,
+                                        err_code);
+    if((*err_code == CL_SUCCESS) && _path.compare("")){
+        pthread_mutex_lock(&_mutex);
+        _pending[program] = path;
+        pthread_mutex_unlock(&_mutex);
+    }
+    return program;
+}
+
+cl_int ProgramCache::build(cl_program program, const std::string flags)
+{
+    cl_int err_code;
+
+    err_code = clBuildProgram(program, 0, NULL, flags.c_str(), NULL, NULL);
+    pthread_mutex_lock(&_mutex);
+    auto it = _pending.find(program);
+    if(it != _pending.end()){
+        if(err_code == CL_SUCCESS)
+            save(program, it->second);
+        _pending.erase(it);
+    }
+    pthread_mutex_unlock(&_mutex);
+    return err_code;
+}
+
+cl_program ProgramCache::get(const std::string source,
+                             const std::string flags,
+                             cl_int *err_code)
+{
+    registeredProgram *entry;
+
+    pthread_mutex_lock(&_programs_mutex);
+    auto key = std::make_pair(source, flags);
+    auto it = _programs.find(key);
+    if(it == _programs.end()){
+        entry = new registeredProgram;
+        entry->program = NULL;
+        entry->err_code = CL_SUCCESS;
+        pthread_mutex_init(&entry->mutex, NULL);
+        _programs[key] = entry;
+    }
+    else{
+        entry = it->second;
+    }
+    // Other threads requesting the same program are waiting for this one
+    pthread_mutex_lock(&entry->mutex);
+    pthread_mutex_unlock(&_programs_mutex);
+
+    if(!entry->program){
+        entry->program = create(source, flags, &entry->err_code);
+        if(entry->err_code == CL_SUCCESS)
+            entry->err_code = build(entry->program, flags);
+    }
+    else{
+        LOG0(L_DEBUG, "\tReusing an already built program\n");
+    }
+    cl_program program = entry->program;
+    *err_code = entry->err_code;
+    if(program)
+        clRetainProgram(program);
+    pthread_mutex_unlock(&entry->mutex);
+    return program;
+}
+
+void ProgramCache::release()
+{
+    pthread_mutex_lock(&_programs_mutex);
+    for(auto it : _programs){
+        if(it.second->program)
+            clReleaseProgram(it.second->program);
+        pthread_mutex_destroy(&it.second->mutex);
+        delete it.second;
+    }
+    _programs.clear();
+    pthread_mutex_unlock(&_programs_mutex);
+}
+
+std::string ProgramCache::includes(const std::string source,
+                                   const std::string folder,
+                                   const std::vector<std::string> &paths,
+                                   std::set<std::string> &visited)
+{
+    std::ostringstream included;
+    std::istringstream lines(source);
+    std::string line;
+    while(getline(lines, line)){
+        trim(line);
+        if(line.compare(0, 1, "#"))
+            continue;
+        line = trimCopy(line.substr(1));
+        if(line.compare(0, 7, "include"))
+            continue;
+        line = trimCopy(line.substr(7));
+        if(line.size() < 2)
+            continue;
+        size_t end = line.find((line[0] == '<') ? '>' : '"', 1);
+        if(end == std::string::npos)
+            continue;
+        std::string name = line.substr(1, end - 1);
+
+        // Look for the file, first in the folder of the including one
+        std::vector<std::string> folders;
+        folders.push_back(folder);
+        folders.insert(folders.end(), paths.begin(), paths.end());
+        for(auto f : folders){
+            std::string path = f.compare("") ? f + "/" + name : name;
+            if(!isFile(path))
+                continue;
+            if(visited.find(path) != visited.end())
+                break;
+            visited.insert(path);
+            std::ifstream file(path);
+            std::stringstream content;
+            content << file.rdbuf();
+            included << path << std::endl << content.str() << std::endl;
+            included << includes(content.str(),
+                                 getFolderFromFilePath(path),
+                                 paths,
+                                 visited);
+            break;
+        }
+    }
+    return included.str();
+}
+
+std::string ProgramCache::file(const std::string source,
+                               const std::string flags)
+{
+    // Get the include folders from the flags
+    std::vector<std::string> paths;
+    std::istringstream f(flags);
+    std::string flag;
+    while(f >> flag){
+        if(!flag.compare(0, 2, "-I") && (flag.size() > 2))
+            paths.push_back(flag.substr(2));
+    }
+    std::set<std::string> visited;
+    std::string included = includes(source, "", paths, visited);
+
+    std::hash<std::string> hasher;
+    std::ostringstream path;
+    path << _path << "/" << std::hex
+         << hasher(_devices_id) << "-"
+         << hasher(source + included) << "-"
+         << hasher(flags) << ".bin";
+    return path.str();
+}
+
+cl_program ProgramCache::load(const std::string path, cl_int *err_code)
+{
+    unsigned int i;
+    std::ifstream f(path, std::ios::in | std::ios::binary);
+    if(!f.is_open())
+        return NULL;
+
+    uint32_t num_devices = 0;
+    f.read((char*)&num_devices, sizeof(uint32_t));
+    if(!f || (num_devices != _devices.size()))
+        return NULL;
+    std::vector<size_t> sizes;
+    std::vector<std::vector<unsigned char> > binaries;
+    for(i = 0; i < num_devices; i++){
+        uint64_t size = 0;
+        f.read((char*)&size, sizeof(uint64_t));
+        if(!f)
+            return NULL;
+        std::vector<unsigned char> binary(size);
+        f.read((char*)binary.data(), size);
+        if(!f)
+            return NULL;
+        sizes.push_back(size);
+        binaries.push_back(binary);
+    }
+    std::vector<const unsigned char*> binaries_ptr;
+    for(auto &binary : binaries){
+        binaries_ptr.push_back(binary.data());
+    }
+
+    cl_program program = clCreateProgramWithBinary(_context,
+                                                   num_devices,
+                                                   _devices.data(),
+                                                   sizes.data(),
+                                                   binaries_ptr.data(),
+                                                   NULL,
+                                                   err_code);
+    if(*err_code != CL_SUCCESS){
+        std::ostringstream msg;
+        msg << "Failure loading the cached program \"" << path
+            << "\", it will be rebuilt." << std::endl;
+        LOG(L_WARNING, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(*err_code);
+        return NULL;
+    }
+    std::ostringstream msg;
+    msg << "\tUsing the cached program \"" << path << "\"" << std::endl;
+    LOG0(L_DEBUG, msg.str());
+    return program;
+}
+
+void ProgramCache::save(cl_program program, const std::string path)
+{
+    unsigned int i;
+    cl_int err_code;
+    cl_uint num_devices;
+
+    err_code = clGetProgramInfo(program,
+                                CL_PROGRAM_NUM_DEVICES,
+                                sizeof(cl_uint),
+                                &num_devices,
+                                NULL);
+    if((err_code != CL_SUCCESS) || (num_devices != _devices.size())){
+        LOG(L_WARNING, "Failure getting the program devices.\n");
+        return;
+    }
+    // The binaries are provided in the same order of the program devices,
+    // which is the context devices one
+    std::vector<size_t> sizes(num_devices);
+    err_code = clGetProgramInfo(program,
+                                CL_PROGRAM_BINARY_SIZES,
+                                num_devices * sizeof(size_t),
+                                sizes.data(),
+                                NULL);
+    if(err_code != CL_SUCCESS){
+        LOG(L_WARNING, "Failure getting the program binaries size.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        return;
+    }
+    std::vector<std::vector<unsigned char> > binaries;
+    std::vector<unsigned char*> binaries_ptr;
+    for(i = 0; i < num_devices; i++){
+        binaries.push_back(std::vector<unsigned char>(sizes.at(i)));
+    }
+    for(auto &binary : binaries){
+        binaries_ptr.push_back(binary.data());
+    }
+    err_code = clGetProgramInfo(program,
+                                CL_PROGRAM_BINARIES,
+                                num_devices * sizeof(unsigned char*),
+                                binaries_ptr.data(),
+                                NULL);
+    if(err_code != CL_SUCCESS){
+        LOG(L_WARNING, "Failure getting the program binaries.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        return;
+    }
+
+    // Write in a temporary file first, such that other processes are never
+    // reading an incomplete file. The temporary file is named after the
+    // process, so several processes can concurrently save the same program
+    std::ostringstream tmp_name;
+    tmp_name << path << "." << getpid() << ".tmp";
+    const std::string tmp_path = tmp_name.str();
+    std::ofstream f(tmp_path, std::ios::out | std::ios::binary);
+    if(!f.is_open()){
+        std::ostringstream msg;
+        msg << "Failure writing the cached program \"" << path << "\"."
+            << std::endl;
+        LOG(L_WARNING, msg.str());
+        return;
+    }
+    uint32_t n = num_devices;
+    f.write((char*)&n, sizeof(uint32_t));
+    for(i = 0; i < num_devices; i++){
+        uint64_t size = sizes.at(i);
+        f.write((char*)&size, sizeof(uint64_t));
+        f.write((char*)binaries.at(i).data(), size);
+    }
+    f.close();
+    if(rename(tmp_path.c_str(), path.c_str())){
+        std::ostringstream msg;
+        msg << "Failure writing the cached program \"" << path << "\"."
+            << std::endl;
+        LOG(L_WARNING, msg.str());
+        remove(tmp_path.c_str());
+    }
+}
+
+}}  // namespaces
@@ -46,9 +46,6 @@ RadixSort::RadixSort(const std::string tool_name,
     , _var_name(variable)
     , _perms_name(permutations)
     , _inv_perms_name(inv_permutations)
-    , _var(NULL)
-    , _perms(NULL)
-    , _inv_perms(NULL)
     , _n(0)
     , _init_kernel(NULL)
     , _histograms_kernel(NULL)
@@ -56,6 +53,7 @@ RadixSort::RadixSort(const std::string tool_name,
     , _paste_kernel(NULL)
     , _sort_kernel(NULL)
     , _inv_perms_kernel(NULL)
+    , _max_key_kernel(NULL)
     , _in_keys(NULL)
     , _out_keys(NULL)
     , _in_permut(NULL)
@@ -63,11 +61,13 @@ RadixSort::RadixSort(const std::string tool_name,
     , _histograms(NULL)
     , _global_sums(NULL)
     , _temp_mem(NULL)
+    , _max_key(NULL)
     , _items(_ITEMS)
     , _groups(_GROUPS)
-    , _bits(_STEPBITS)
-    , _radix(_RADIX)
+    , _bits(_MAXSTEPBITS)
+    , _radix(1 << _MAXSTEPBITS)
     , _histo_split(_HISTOSPLIT)
+    , _local_mem_size(0)
 {
 }
 
@@ -79,6 +79,8 @@ RadixSort::~RadixSort()
     if(_paste_kernel) clReleaseKernel(_paste_kernel); _paste_kernel=NULL;
     if(_sort_kernel) clReleaseKernel(_sort_kernel); _sort_kernel=NULL;
     if(_inv_perms_kernel) clReleaseKernel(_inv_perms_kernel); _inv_perms_kernel=NULL;
+    if(_max_key_kernel) clReleaseKernel(_max_key_kernel);
+    _max_key_kernel=NULL;
     if(_in_keys) clReleaseMemObject(_in_keys); _in_keys=NULL;
     if(_out_keys) clReleaseMemObject(_out_keys); _out_keys=NULL;
     if(_in_permut) clReleaseMemObject(_in_permut); _in_permut=NULL;
@@ -86,6 +88,8 @@ RadixSort::~RadixSort()
     if(_histograms) clReleaseMemObject(_histograms); _histograms=NULL;
     if(_global_sums) clReleaseMemObject(_global_sums); _global_sums=NULL;
     if(_temp_mem) clReleaseMemObject(_temp_mem); _temp_mem=NULL;
+    if(_max_key) clReleaseMemObject(_max_key);
+    _max_key=NULL;
 }
 
 void RadixSort::setup()
@@ -99,6 +103,12 @@ void RadixSort::setup()
 
     // Setup the working tools
     setupOpenCL();
+
+    std::vector<InputOutput::Variable*> inputs, outputs;
+    outputs.push_back(_var.get());
+    outputs.push_back(_perms.get());
+    outputs.push_back(_inv_perms.get());
+    setDependencies(inputs, outputs);
 }
 
 void RadixSort::_execute()
@@ -106,25 +116,6 @@ void RadixSort::_execute()
     cl_int err_code;
     unsigned int i, max_val;
     CalcServer *C = CalcServer::singleton();
-    InputOutput::Variables *vars = C->variables();
-
-    // Get maximum key bits, and needed pass
-    max_val = UINT_MAX;
-    if(!_var_name.compare("icell")){
-        uivec4 n_cells = *(uivec4 *)vars->get("n_cells")->get();
-        max_val = nextPowerOf2(n_cells.w);
-    }
-    else if(!isPowerOf2(max_val)){
-        max_val = nextPowerOf2(max_val / 2);
-    }
-    for(i=0; (max_val&1) == 0; max_val >>= 1, i++);
-    _key_bits = i;
-    _key_bits = roundUp(_key_bits, _bits);
-    if(_key_bits > __UINTBITS__){
-        LOG(L_ERROR, "Resultant keys overflows unsigned int type.\n");
-        throw std::runtime_error("Unsigned int overflow");
-    }
-    _n_pass = _key_bits / _bits;
 
     err_code = clEnqueueCopyBuffer(C->command_queue(),
                                    *(cl_mem *)_var->get(),
@@ -134,7 +125,7 @@ void RadixSort::_execute()
                                    _n * sizeof(cl_uint),
                                    0,
                                    NULL,
-                                   NULL);
+                                   profilingEvent());
     if(err_code != CL_SUCCESS){
         std::ostringstream msg;
         msg << "Failure copying the keys to sort within the tool \"" << name()
@@ -144,6 +135,24 @@ void RadixSort::_execute()
         throw std::runtime_error("OpenCL error");
     }
 
+    // Get maximum key bits, and needed pass
+    if(!_var_name.compare("icell")){
+        uivec4 n_cells = *(uivec4 *)_n_cells_var->get();
+        // The inactive particles and the out of bounds keys are stored in
+        // the cells n_cells.w and n_cells.w + 1 (see LinkList)
+        max_val = n_cells.w + 1;
+    }
+    else{
+        max_val = maxKey();
+    }
+    for(i=0; max_val; max_val >>= 1, i++);
+    _key_bits = roundUp(i, _bits);
+    if(_key_bits > __UINTBITS__){
+        LOG(L_ERROR, "Resultant keys overflows unsigned int type.\n");
+        throw std::runtime_error("Unsigned int overflow");
+    }
+    _n_pass = _key_bits / _bits;
+
     init();
 
     for(_pass = 0; _pass < _n_pass; _pass++){
@@ -160,7 +169,7 @@ void RadixSort::_execute()
                                    _n * sizeof(cl_uint),
                                    0,
                                    NULL,
-                                   NULL);
+                                   profilingEvent());
     if(err_code != CL_SUCCESS){
         std::ostringstream msg;
         msg << "Failure copying the sort keys within the tool \"" << name()
@@ -177,7 +186,7 @@ void RadixSort::_execute()
                                    _n * sizeof(cl_uint),
                                    0,
                                    NULL,
-                                   NULL);
+                                   profilingEvent());
     if(err_code != CL_SUCCESS){
         std::ostringstream msg;
         msg << "Failure copying the permutations within the tool \"" << name()
@@ -216,7 +225,7 @@ void RadixSort::init()
                                       NULL,
                                       0,
                                       NULL,
-                                      NULL);
+                                      profilingEvent());
     if(err_code != CL_SUCCESS) {
         std::ostringstream msg;
         msg << "Failure executing \"init\" within the tool \""
@@ -267,7 +276,7 @@ void RadixSort::histograms()
                                       &local_work_size,
                                       0,
                                       NULL,
-                                      NULL);
+                                      profilingEvent());
     if(err_code != CL_SUCCESS) {
         std::ostringstream msg;
         msg << "Failure executing \"histogram\" within the tool \""
@@ -322,7 +331,7 @@ void RadixSort::scan()
                                       &local_work_size,
                                       0,
                                       NULL,
-                                      NULL);
+                                      profilingEvent());
     if(err_code != CL_SUCCESS) {
         std::ostringstream msg;
         msg << "Failure executing \"scan\" (1st call) within the tool \""
@@ -369,7 +378,7 @@ void RadixSort::scan()
                                       &local_work_size,
                                       0,
                                       NULL,
-                                      NULL);
+                                      profilingEvent());
     if(err_code != CL_SUCCESS) {
         std::ostringstream msg;
         msg << "Failure executing \"scan\" (2nd call) within the tool \""
@@ -392,7 +401,7 @@ void RadixSort::scan()
                                       &local_work_size,
                                       0,
                                       NULL,
-                                      NULL);
+                                      profilingEvent());
     if(err_code != CL_SUCCESS) {
         std::ostringstream msg;
         msg << "Failure executing \"paste\" within the tool \""
@@ -479,7 +488,7 @@ void RadixSort::reorder()
                                       &local_work_size,
                                       0,
                                       NULL,
-                                      NULL);
+                                      profilingEvent());
     if(err_code != CL_SUCCESS) {
         std::ostringstream msg;
         msg << "Failure executing \"sort\" within the tool \""
@@ -539,7 +548,7 @@ void RadixSort::inversePermutations()
                                       NULL,
                                       0,
                                       NULL,
-                                      NULL);
+                                      profilingEvent());
     if(err_code != CL_SUCCESS) {
         std::ostringstream msg;
         msg << "Failure executing \"inversePermutation\" within the tool \""
@@ -550,6 +559,86 @@ void RadixSort::inversePermutations()
     }
 }
 
+unsigned int RadixSort::maxKey()
+{
+    cl_int err_code;
+    unsigned int max_val;
+    CalcServer *C = CalcServer::singleton();
+    size_t local_work_size = _items;
+    size_t global_work_size = _groups * _items;
+    static const unsigned int zero = 0;
+
+    err_code = clEnqueueWriteBuffer(C->command_queue(),
+                                    _max_key,
+                                    CL_FALSE,
+                                    0,
+                                    sizeof(unsigned int),
+                                    &zero,
+                                    0,
+                                    NULL,
+                                    profilingEvent());
+    if(err_code != CL_SUCCESS) {
+        std::ostringstream msg;
+        msg << "Failure resetting the maximum key within the tool \""
+            << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+
+    err_code = clSetKernelArg(_max_key_kernel,
+                              0,
+                              sizeof(cl_mem),
+                              (void*)&_in_keys);
+    if(err_code != CL_SUCCESS){
+        std::ostringstream msg;
+        msg << "Failure sending argument 0 to \"maxKey\" within the tool \""
+            << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+
+    err_code = clEnqueueNDRangeKernel(C->command_queue(),
+                                      _max_key_kernel,
+                                      1,
+                                      NULL,
+                                      &global_work_size,
+                                      &local_work_size,
+                                      0,
+                                      NULL,
+                                      profilingEvent());
+    if(err_code != CL_SUCCESS) {
+        std::ostringstream msg;
+        msg << "Failure executing \"maxKey\" within the tool \""
+            << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+
+    // The number of passes depends on the maximum key, so we should wait for
+    // it
+    err_code = clEnqueueReadBuffer(C->command_queue(),
+                                   _max_key,
+                                   CL_TRUE,
+                                   0,
+                                   sizeof(unsigned int),
+                                   &max_val,
+                                   0,
+                                   NULL,
+                                   profilingEvent());
+    if(err_code != CL_SUCCESS) {
+        std::ostringstream msg;
+        msg << "Failure downloading the maximum key within the tool \""
+            << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+
+    return max_val;
+}
 
 void RadixSort::variables()
 {
@@ -578,7 +667,7 @@ void RadixSort::variables()
         LOG(L_DEBUG, msg.str());
         throw std::runtime_error("Invalid variable type");
     }
-    _var = (InputOutput::ArrayVariable *)vars->get(_var_name);
+    _var = vars->handle(_var_name);
 
     if(!vars->get(_perms_name)){
         std::ostringstream msg;
@@ -600,7 +689,7 @@ void RadixSort::variables()
         LOG(L_DEBUG, msg.str());
         throw std::runtime_error("Invalid variable type");
     }
-    _perms = (InputOutput::ArrayVariable *)vars->get(_perms_name);
+    _perms = vars->handle(_perms_name);
 
     if(!vars->get(_inv_perms_name)){
         std::ostringstream msg;
@@ -622,22 +711,11 @@ void RadixSort::variables()
         LOG(L_DEBUG, msg.str());
         throw std::runtime_error("Invalid variable type");
     }
-    _inv_perms = (InputOutput::ArrayVariable *)vars->get(_inv_perms_name);
+    _inv_perms = vars->handle(_inv_perms_name);
+    _n_cells_var = vars->handle("n_cells");
 
     // Check the lengths
     n = _var->size() / vars->typeToBytes(_var->type());
-    if(!isPowerOf2(n)){
-        std::ostringstream msg;
-        msg << "Tool \"" << name()
-            << "\" cannot process variable \"" << _var_name
-            << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        msg.str("");
-        msg << "\tThe variable has length, n=" << n
-            << ", which is not power of 2." << std::endl;
-        LOG(L_DEBUG, msg.str());
-        throw std::runtime_error("Invalid variable length");
-    }
     _n = n;
     n = _perms->size() / vars->typeToBytes(_perms->type());
     if(n != _n){
@@ -675,6 +753,10 @@ void RadixSort::variables()
 
 void RadixSort::setupOpenCL()
 {
+    // Select the number of bits sorted on each pass, which should be known
+    // at compile time
+    setupBits();
+
     std::ostringstream source;
     source << RADIXSORT_INC << RADIXSORT_SRC;
     compile(source.str());
@@ -687,7 +769,9 @@ void RadixSort::setupOpenCL()
     setupArgs();
 
     std::ostringstream msg;
-    msg << "\titems: " << _items << std::endl;
+    msg << "\tbits: " << _bits << std::endl;
+    LOG0(L_DEBUG, msg.str());
+    msg.str(""); msg << "\titems: " << _items << std::endl;
     LOG0(L_DEBUG, msg.str());
     msg.str(""); msg << "\tgroups: " << _groups << std::endl;
     LOG0(L_DEBUG, msg.str());
@@ -695,6 +779,39 @@ void RadixSort::setupOpenCL()
     LOG0(L_DEBUG, msg.str());
 }
 
+void RadixSort::setupBits()
+{
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+
+    err_code = clGetDeviceInfo(C->device(),
+                               CL_DEVICE_LOCAL_MEM_SIZE,
+                               sizeof(cl_ulong),
+                               &_local_mem_size,
+                               NULL);
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Failure getting CL_DEVICE_LOCAL_MEM_SIZE.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+
+    // The wide digits are halving the number of passes, but the local
+    // histograms of the "histogram" and "sort" kernels are growing with the
+    // radix. Hence, they are just used if the histograms of
+    // __CL_MIN_LOCALSIZE__ items can be stored in the local memory. Just
+    // the widths dividing __UINTBITS__ are considered, so every key can be
+    // sorted in a whole number of passes
+    _bits = _MAXSTEPBITS;
+    while(_bits > 4){
+        if(!(__UINTBITS__ % _bits) &&
+           ((1 << _bits) * __CL_MIN_LOCALSIZE__ * sizeof(cl_uint) <=
+            _local_mem_size))
+            break;
+        _bits--;
+    }
+    _radix = 1 << _bits;
+}
+
 void RadixSort::compile(const std::string source)
 {
     cl_int err_code;
@@ -714,19 +831,13 @@ void RadixSort::compile(const std::string source)
     #else
         flags << " -DHAVE_2D";
     #endif
-    size_t source_length = source.size();
-    const char* source_cstr = source.c_str();
-    program = clCreateProgramWithSource(C->context(),
-                                        1,
-                                        &source_cstr,
-                                        &source_length,
-                                        &err_code);
+    program = C->programCache()->create(source, flags.str(), &err_code);
     if(err_code != CL_SUCCESS) {
         LOG(L_ERROR, "Failure creating the OpenCL program.\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL compilation error");
     }
-    err_code = clBuildProgram(program, 0, NULL, flags.str().c_str(), NULL, NULL);
+    err_code = C->programCache()->build(program, flags.str());
     if(err_code != CL_SUCCESS) {
         LOG(L_ERROR, "Error compiling the source code\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
@@ -804,6 +915,13 @@ void RadixSort::compile(const std::string source)
         clReleaseProgram(program);
         throw std::runtime_error("OpenCL error");
     }
+    _max_key_kernel = clCreateKernel(program, "maxKey", &err_code);
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Failure creating the \"maxKey\" kernel.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        clReleaseProgram(program);
+        throw std::runtime_error("OpenCL error");
+    }
     clReleaseProgram(program);
 }
 
@@ -837,10 +955,27 @@ void RadixSort::setupDims()
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL error");
     }
+    if(sort_local_work_size < max_local_work_size)
+        max_local_work_size = sort_local_work_size;
+    err_code = clGetKernelWorkGroupInfo(_max_key_kernel,
+                                        C->device(),
+                                        CL_KERNEL_WORK_GROUP_SIZE,
+                                        sizeof(size_t),
+                                        &sort_local_work_size,
+                                        NULL);
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Failure getting CL_KERNEL_WORK_GROUP_SIZE from \"maxKey\".\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
     if(sort_local_work_size < max_local_work_size)
         max_local_work_size = sort_local_work_size;
     if(max_local_work_size < _items)
         _items = max_local_work_size;
+    // The local histograms should fit in the local memory
+    while((_items > 1) &&
+          (_radix * _items * sizeof(cl_uint) > _local_mem_size))
+        _items /= 2;
     if(!isPowerOf2(_items))
         _items = nextPowerOf2(_items) / 2;
 
@@ -900,6 +1035,18 @@ void RadixSort::setupDims()
         LOG0(L_DEBUG, "\tYou can try to recompile the code decreasing __CL_MIN_LOCALSIZE__\n");
         throw std::runtime_error("OpenCL error");
     }
+    // The scan of the histograms is assuming that each split is containing
+    // whole radix digits
+    if((2 * _histo_split) % _radix){
+        std::ostringstream msg;
+        msg << "The number of histogram splits, " << _histo_split
+            << ", is not compatible with the radix, " << _radix
+            << "." << std::endl;
+        LOG(L_ERROR, msg.str());
+        LOG0(L_DEBUG, "\t(2 * splits) % radix must be equal to zero\n");
+        LOG0(L_DEBUG, "\tYou can try to recompile the code decreasing _MAXSTEPBITS\n");
+        throw std::runtime_error("Invalid radix");
+    }
 
     _local_work_size = getLocalWorkSize(_n, C->command_queue());
     _global_work_size = getGlobalWorkSize(_n, _local_work_size);
@@ -917,14 +1064,18 @@ void RadixSort::setupMems()
     if(_histograms) clReleaseMemObject(_histograms); _histograms=NULL;
     if(_global_sums) clReleaseMemObject(_global_sums); _global_sums=NULL;
     if(_temp_mem) clReleaseMemObject(_temp_mem); _temp_mem=NULL;
+    if(_max_key) clReleaseMemObject(_max_key);
+    _max_key=NULL;
+    C->memoryPool()->releaseScratch(this);
     allocatedMemory(0);
 
+    // The memory objects are just used within the execution, so they can be
+    // shared with the other tools
+
     // Get the memory identifiers
-    _in_keys = clCreateBuffer(C->context(),
-                              CL_MEM_READ_WRITE,
-                              _n * sizeof(unsigned int),
-                              NULL,
-                              &err_code);
+    _in_keys = C->memoryPool()->scratch(this,
+                                        _n * sizeof(unsigned int),
+                                        &err_code);
     if(err_code != CL_SUCCESS) {
         std::stringstream msg;
         msg << "Failure allocating device memory in the tool \"" <<
@@ -933,11 +1084,20 @@ void RadixSort::setupMems()
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL allocation error");
     }
-    _out_keys = clCreateBuffer(C->context(),
-                              CL_MEM_READ_WRITE,
-                              _n * sizeof(unsigned int),
-                              NULL,
-                              &err_code);
+    _out_keys = C->memoryPool()->scratch(this,
+                                         _n * sizeof(unsigned int),
+                                         &err_code);
+    if(err_code != CL_SUCCESS) {
+        std::stringstream msg;
+        msg << "Failure allocating device memory in the tool \"" <<
+               name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL allocation error");
+    }
+    _in_permut = C->memoryPool()->scratch(this,
+                                          _n * sizeof(unsigned int),
+                                          &err_code);
     if(err_code != CL_SUCCESS) {
         std::stringstream msg;
         msg << "Failure allocating device memory in the tool \"" <<
@@ -946,11 +1106,9 @@ void RadixSort::setupMems()
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL allocation error");
     }
-    _in_permut = clCreateBuffer(C->context(),
-                                CL_MEM_READ_WRITE,
-                                _n * sizeof(unsigned int),
-                                NULL,
-                                &err_code);
+    _out_permut = C->memoryPool()->scratch(this,
+                                           _n * sizeof(unsigned int),
+                                           &err_code);
     if(err_code != CL_SUCCESS) {
         std::stringstream msg;
         msg << "Failure allocating device memory in the tool \"" <<
@@ -959,11 +1117,9 @@ void RadixSort::setupMems()
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL allocation error");
     }
-    _out_permut = clCreateBuffer(C->context(),
-                                 CL_MEM_READ_WRITE,
-                                 _n * sizeof(unsigned int),
-                                 NULL,
-                                 &err_code);
+    _histograms = C->memoryPool()->scratch(this,
+                                           (_radix * _groups * _items) * sizeof(unsigned int),
+                                           &err_code);
     if(err_code != CL_SUCCESS) {
         std::stringstream msg;
         msg << "Failure allocating device memory in the tool \"" <<
@@ -972,11 +1128,9 @@ void RadixSort::setupMems()
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL allocation error");
     }
-    _histograms = clCreateBuffer(C->context(),
-                                 CL_MEM_READ_WRITE,
-                                 (_radix * _groups * _items) * sizeof(unsigned int),
-                                 NULL,
-                                 &err_code);
+    _global_sums = C->memoryPool()->scratch(this,
+                                            _histo_split * sizeof(unsigned int),
+                                            &err_code);
     if(err_code != CL_SUCCESS) {
         std::stringstream msg;
         msg << "Failure allocating device memory in the tool \"" <<
@@ -985,11 +1139,9 @@ void RadixSort::setupMems()
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL allocation error");
     }
-    _global_sums = clCreateBuffer(C->context(),
-                                  CL_MEM_READ_WRITE,
-                                  _histo_split * sizeof(unsigned int),
-                                  NULL,
-                                  &err_code);
+    _temp_mem = C->memoryPool()->scratch(this,
+                                         sizeof(unsigned int),
+                                         &err_code);
     if(err_code != CL_SUCCESS) {
         std::stringstream msg;
         msg << "Failure allocating device memory in the tool \"" <<
@@ -998,11 +1150,10 @@ void RadixSort::setupMems()
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL allocation error");
     }
-    _temp_mem = clCreateBuffer(C->context(),
-                               CL_MEM_READ_WRITE,
-                               sizeof(unsigned int),
-                               NULL,
-                               &err_code);
+
+    _max_key = C->memoryPool()->scratch(this,
+                                        sizeof(unsigned int),
+                                        &err_code);
     if(err_code != CL_SUCCESS) {
         std::stringstream msg;
         msg << "Failure allocating device memory in the tool \"" <<
@@ -1015,7 +1166,7 @@ void RadixSort::setupMems()
     allocatedMemory(4 * _n * sizeof(unsigned int) +
                     (_radix * _groups * _items) * sizeof(unsigned int) +
                     _histo_split * sizeof(unsigned int) +
-                    sizeof(unsigned int));
+                    2 * sizeof(unsigned int));
 }
 
 void RadixSort::setupArgs()
@@ -1171,6 +1322,43 @@ void RadixSort::setupArgs()
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL error");
     }
+
+    err_code = clSetKernelArg(_max_key_kernel,
+                              1,
+                              sizeof(cl_mem),
+                              (void*)&_max_key);
+    if(err_code != CL_SUCCESS){
+        std::ostringstream msg;
+        msg << "Failure sending argument 1 to \"maxKey\" within the tool \""
+            << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+    err_code = clSetKernelArg(_max_key_kernel,
+                              2,
+                              sizeof(cl_uint) * _items,
+                              NULL);
+    if(err_code != CL_SUCCESS){
+        std::ostringstream msg;
+        msg << "Failure sending argument 2 to \"maxKey\" within the tool \""
+            << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+    err_code = clSetKernelArg(_max_key_kernel,
+                              3,
+                              sizeof(cl_uint),
+                              (void*)&_n);
+    if(err_code != CL_SUCCESS){
+        std::ostringstream msg;
+        msg << "Failure sending argument 3 to \"maxKey\" within the tool \""
+            << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
 }
 
 }}  // namespace
@@ -49,8 +49,6 @@ Reduction::Reduction(const std::string name,
     , _output_name(output_name)
     , _operation(operation)
     , _null_val(null_val)
-    , _input_var(NULL)
-    , _output_var(NULL)
     , _input(NULL)
 {
 }
@@ -85,6 +83,11 @@ void Reduction::setup()
         _input_var->type());
     _n.push_back(n);
     setupOpenCL();
+
+    std::vector<InputOutput::Variable*> inputs, outputs;
+    inputs.push_back(_input_var.get());
+    outputs.push_back(_output_var.get());
+    setDependencies(inputs, outputs);
 }
 
 void Reduction::_execute()
@@ -108,7 +111,7 @@ void Reduction::_execute()
                                           &_local_work_size,
                                           0,
                                           NULL,
-                                          NULL);
+                                          profilingEvent());
         if(err_code != CL_SUCCESS) {
             std::ostringstream msg;
             msg << "Failure executing the step " << i << " within the tool \""
@@ -119,16 +122,41 @@ void Reduction::_execute()
         }
     }
 
-    // Get back the result
+    // Device resident result
+    if(_output_var->type().find('*') != std::string::npos){
+        err_code = clEnqueueCopyBuffer(C->command_queue(),
+                                       _mems.at(_mems.size()-1),
+                                       *(cl_mem*)_output_var->get(),
+                                       0,
+                                       0,
+                                       InputOutput::Variables::typeToBytes(
+                                           _output_var->type()),
+                                       0,
+                                       NULL,
+                                       profilingEvent());
+        if(err_code != CL_SUCCESS) {
+                std::ostringstream msg;
+                msg << "Failure copying the result within the tool \""
+                    << name() << "\"." << std::endl;
+                LOG(L_ERROR, msg.str());
+                InputOutput::Logger::singleton()->printOpenCLError(err_code);
+                throw std::runtime_error("OpenCL error");
+        }
+        return;
+    }
+
+    // Get back the result, without waiting for it
+    cl_event event;
+    cl_event *profiling_event = profilingEvent();
     err_code = clEnqueueReadBuffer(C->command_queue(),
                                    _mems.at(_mems.size()-1),
-                                   CL_TRUE,
+                                   CL_FALSE,
                                    0,
                                    _output_var->typesize(),
-                                   _output_var->get(),
+                                   _output_var->get(false),
                                    0,
                                    NULL,
-                                   NULL);
+                                   &event);
     if(err_code != CL_SUCCESS) {
             std::ostringstream msg;
             msg << "Failure reading back the result within the tool \""
@@ -137,9 +165,15 @@ void Reduction::_execute()
             InputOutput::Logger::singleton()->printOpenCLError(err_code);
             throw std::runtime_error("OpenCL error");
     }
-
-    // Ensure that the variable is populated
-    vars->populate(_output_var);
+    if(profiling_event && (clRetainEvent(event) == CL_SUCCESS))
+        *profiling_event = event;
+    _output_var->setEvent(event);
+    clReleaseEvent(event);
+    // The kernels can read the result straight from the device meanwhile
+    _output_var->setDeviceMem(_mems.at(_mems.size()-1));
+
+    // The variable will be populated when the result is required
+    vars->populateLazy(_output_var.get());
 }
 
 void Reduction::variables()
@@ -161,7 +195,7 @@ void Reduction::variables()
         LOG(L_ERROR, msg.str());
         throw std::runtime_error("Invalid variable type");
     }
-    _input_var = (InputOutput::ArrayVariable *)vars->get(_input_name);
+    _input_var = vars->handle(_input_name);
     if(!vars->get(_output_name)){
         std::stringstream msg;
         msg << "The tool \"" << name()
@@ -170,15 +204,28 @@ void Reduction::variables()
         LOG(L_ERROR, msg.str());
         throw std::runtime_error("Invalid variable");
     }
-    if(vars->get(_output_name)->type().find('*') != std::string::npos){
+    _output_var = vars->handle(_output_name);
+    if((_output_var->type().find('*') != std::string::npos) &&
+       (_output_var->size() <
+        InputOutput::Variables::typeToBytes(_output_var->type())))
+    {
         std::stringstream msg;
         msg << "The tool \"" << name()
             << "\" is asking the output variable \"" << _output_name
-            << "\", which is an array." << std::endl;
+            << "\", which is an empty array." << std::endl;
         LOG(L_ERROR, msg.str());
-        throw std::runtime_error("Invalid variable type");
+        throw std::runtime_error("Invalid variable length");
+    }
+    if((_output_var->type().find('*') != std::string::npos) &&
+       ((InputOutput::ArrayVariable*)_output_var.get())->storage().compare(""))
+    {
+        std::stringstream msg;
+        msg << "The tool \"" << name()
+            << "\" is asking the output variable \"" << _output_name
+            << "\", which is not stored in the native precision." << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Invalid variable storage");
     }
-    _output_var = vars->get(_output_name);
     if(!vars->isSameType(_input_var->type(), _output_var->type())){
         std::stringstream msg;
         msg << "Mismatching input and output types within the tool \"" << name()
@@ -220,7 +267,7 @@ void Reduction::setupOpenCL()
 
     // Starts a dummy kernel in order to study the local size that can be used
     local_size = __CL_MAX_LOCALSIZE__;
-    kernel = compile(source.str(), local_size);
+    kernel = compile(source.str(), local_size, _input_var->storage());
     err_code = clGetKernelWorkGroupInfo(kernel,
                                         C->device(),
                                         CL_KERNEL_WORK_GROUP_SIZE,
@@ -261,13 +308,19 @@ void Reduction::setupOpenCL()
         _number_groups.push_back(
             _global_work_sizes.at(i) / _local_work_sizes.at(i)
         );
-        // Build the output memory object
+        // Build the output memory object. The intermediate results are just
+        // used within the execution, so they can be shared with the other
+        // tools, but the final result should be preserved
         cl_mem output = NULL;
-        output = clCreateBuffer(C->context(),
-                                CL_MEM_READ_WRITE,
-                                _number_groups.at(i) * data_size,
-                                NULL,
-                                &err_code);
+        if(_number_groups.at(i) > 1){
+            output = C->memoryPool()->scratch(this,
+                                              _number_groups.at(i) * data_size,
+                                              &err_code);
+        }
+        else{
+            output = C->memoryPool()->allocate(_number_groups.at(i) * data_size,
+                                               &err_code);
+        }
         if(err_code != CL_SUCCESS) {
             std::stringstream msg;
             msg << "Failure allocating device memory in the tool \"" <<
@@ -279,7 +332,9 @@ void Reduction::setupOpenCL()
         allocatedMemory(_number_groups.at(i) * data_size + allocatedMemory());
         _mems.push_back(output);
         // Build the kernel
-        kernel = compile(source.str(), local_size);
+        kernel = compile(source.str(),
+                         local_size,
+                         i ? "" : _input_var->storage());
         _kernels.push_back(kernel);
 
         err_code = clSetKernelArg(kernel,
@@ -328,7 +383,9 @@ void Reduction::setupOpenCL()
     }
 }
 
-cl_kernel Reduction::compile(const std::string source, size_t local_work_size)
+cl_kernel Reduction::compile(const std::string source,
+                             size_t local_work_size,
+                             const std::string storage)
 {
     cl_int err_code;
     cl_program program;
@@ -343,6 +400,12 @@ cl_kernel Reduction::compile(const std::string source, size_t local_work_size)
     else{
         flags << "-DT=" << _output_var->type();
     }
+    if(!storage.compare("half")){
+        flags << " -DHALF_INPUT";
+    }
+    else if(!storage.compare("packed")){
+        flags << " -DPACKED_INPUT";
+    }
     flags << " -DLOCAL_WORK_SIZE=" << local_work_size << "u";
     #ifdef AQUA_DEBUG
         flags << " -DDEBUG";
@@ -356,19 +419,13 @@ cl_kernel Reduction::compile(const std::string source, size_t local_work_size)
         flags << " -DHAVE_2D";
     #endif
 
-    size_t source_length = source.size();
-    const char* source_cstr = source.c_str();
-    program = clCreateProgramWithSource(C->context(),
-                                        1,
-                                        &source_cstr,
-                                        &source_length,
-                                        &err_code);
+    program = C->programCache()->create(source, flags.str(), &err_code);
     if(err_code != CL_SUCCESS) {
         LOG(L_ERROR, "Failure creating the OpenCL program.\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL compilation error");
     }
-    err_code = clBuildProgram(program, 0, NULL, flags.str().c_str(), NULL, NULL);
+    err_code = C->programCache()->build(program, flags.str());
     if(err_code != CL_SUCCESS) {
         LOG0(L_ERROR, "Error compiling the source code\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
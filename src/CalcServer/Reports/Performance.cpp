@@ -59,6 +59,15 @@ void Performance::setup()
     // Set the color in lowercase
     std::transform(_color.begin(), _color.end(), _color.begin(), ::tolower);
 
+    // Resolve the variables required to compute the progress
+    InputOutput::Variables *vars = CalcServer::singleton()->variables();
+    _t_var = vars->handle("t");
+    _end_t_var = vars->handle("end_t");
+    _iter_var = vars->handle("iter");
+    _end_iter_var = vars->handle("end_iter");
+    _frame_var = vars->handle("frame");
+    _end_frame_var = vars->handle("end_frame");
+
     // Open the output file
     if(_output_file.compare("")) {
         _f.open(_output_file.c_str(), std::ios::out);
@@ -70,20 +79,10 @@ void Performance::setup()
 }
 
 size_t Performance::computeAllocatedMemory(){
-    size_t allocated_mem = 0;
-    CalcServer *C = CalcServer::singleton();
-
-    // Get the allocated memory in the variables
-    InputOutput::Variables *vars = C->variables();
-    allocated_mem += vars->allocatedMemory();
-
-    // Gwet the additionally allocated memory in the tools
-    std::vector<Tool*> tools = C->tools();
-    for(auto tool : tools){
-        allocated_mem += tool->allocatedMemory();
-    }
-
-    return allocated_mem;
+    // Both the variables and the tools are allocating their memory objects
+    // in the pool, which is accounting the actually allocated buffers (the
+    // shared and aliased memory is therefore not counted twice)
+    return CalcServer::singleton()->memoryPool()->allocatedMemory();
 }
 
 void Performance::_execute()
@@ -128,16 +127,15 @@ void Performance::_execute()
          << "s" << std::endl;
 
     // Compute the progress
-    InputOutput::Variables *vars = C->variables();
     float progress = 0.f;
-    float t = *(float *)vars->get("t")->get();
-    float end_t = *(float *)vars->get("end_t")->get();
+    float t = *(float *)_t_var->get();
+    float end_t = *(float *)_end_t_var->get();
     progress = max(progress, t / end_t);
-    unsigned int iter = *(unsigned int *)vars->get("iter")->get();
-    unsigned int end_iter = *(unsigned int *)vars->get("end_iter")->get();
+    unsigned int iter = *(unsigned int *)_iter_var->get();
+    unsigned int end_iter = *(unsigned int *)_end_iter_var->get();
     progress = max(progress, (float)iter / end_iter);
-    unsigned int frame = *(unsigned int *)vars->get("frame")->get();
-    unsigned int end_frame = *(unsigned int *)vars->get("end_frame")->get();
+    unsigned int frame = *(unsigned int *)_frame_var->get();
+    unsigned int end_frame = *(unsigned int *)_end_frame_var->get();
     progress = max(progress, (float)frame / end_frame);
 
     // And the estimated time to arrive
@@ -49,7 +49,14 @@ Report::~Report()
 
 void Report::setup()
 {
+    InputOutput::Variables *vars = CalcServer::singleton()->variables();
+    _iter_var = vars->handle("iter");
+    _time_var = vars->handle("t");
+
     processFields(_fields);
+
+    std::vector<InputOutput::Variable*> outputs;
+    setDependencies(variables(), outputs);
 }
 
 const std::string Report::data(bool with_title, bool with_names)
@@ -66,7 +73,7 @@ const std::string Report::data(bool with_title, bool with_names)
     // Set the variable per lines
     for(i = 0; i < _vars_per_line.size(); i++){
         for(j = 0; j < _vars_per_line.at(i); j++){
-            InputOutput::Variable* var = _vars.at(var_id);
+            InputOutput::Variable* var = _vars.at(var_id).get();
             if(with_names){
                 data << var->name() << "=";
             }
@@ -113,22 +120,23 @@ void Report::processFields(const std::string input)
             throw std::runtime_error("Invalid variable");
         }
         vars_in_line++;
-        _vars.push_back(var);
+        _vars.push_back(vars->handle(s));
     }
     _vars_per_line.push_back(vars_in_line);
 }
 
-bool Report::mustUpdate()
+std::vector<InputOutput::Variable*> Report::variables()
 {
-    CalcServer *C = CalcServer::singleton();
-    InputOutput::Variables *vars = C->variables();
+    std::vector<InputOutput::Variable*> vars;
+    for(auto var : _vars)
+        vars.push_back(var.get());
+    return vars;
+}
 
-    InputOutput::UIntVariable *iter_var =
-        (InputOutput::UIntVariable*)vars->get("iter");
-    unsigned int iter = *(unsigned int*)iter_var->get();
-    InputOutput::FloatVariable *time_var =
-        (InputOutput::FloatVariable*)vars->get("t");
-    float t = *(float*)time_var->get();
+bool Report::mustUpdate()
+{
+    unsigned int iter = *(unsigned int*)_iter_var->get();
+    float t = *(float*)_time_var->get();
 
     if(_ipf > 0){
         if(iter - _iter >= _ipf){
@@ -58,6 +58,8 @@ void SetTabFile::setup()
 
     Report::setup();
 
+    _time_var = CalcServer::singleton()->variables()->handle("t");
+
     // Write the header
     _f << "# Time ";
     std::vector<InputOutput::Variable*> vars = variables();
@@ -81,7 +83,7 @@ void SetTabFile::_execute()
     CalcServer *C = CalcServer::singleton();
 
     // Print the time instant
-    _f << C->variables()->get("t")->asString() << " ";
+    _f << _time_var->asString() << " ";
 
     // Get the data to be printed
     std::vector<InputOutput::Variable*> vars = variables();
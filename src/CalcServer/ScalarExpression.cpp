@@ -0,0 +1,640 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Evaluate a scalar expression in the computational device.
+ * (See Aqua::CalcServer::ScalarExpression for details)
+ * @note Hardcoded versions of the files CalcServer/ScalarExpression.cl.in and
+ * CalcServer/ScalarExpression.hcl.in are internally included as a text array.
+ */
+
+#include <ctype.h>
+#include <algorithm>
+
+#include <AuxiliarMethods.h>
+#include <InputOutput/Logger.h>
+#include <CalcServer/ScalarExpression.h>
+#include <CalcServer.h>
+
+namespace Aqua{ namespace CalcServer{
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+#include "CalcServer/ScalarExpression.hcl"
+#include "CalcServer/ScalarExpression.cl"
+#endif
+std::string SCALAREXPRESSION_INC = xxd2string(ScalarExpression_hcl_in,
+                                              ScalarExpression_hcl_in_len);
+std::string SCALAREXPRESSION_SRC = xxd2string(ScalarExpression_cl_in,
+                                              ScalarExpression_cl_in_len);
+
+/// Binary operators, sorted by priority, and by length within each level
+static const char* binary_operators[5][6] = {
+    {"||", NULL},
+    {"&&", NULL},
+    {"==", "!=", "<=", ">=", "<", ">"},
+    {"+", "-", NULL},
+    {"*", "/", NULL},
+};
+
+/// Single argument functions which have the same name in OpenCL
+static const char* cl_functions[] = {
+    "sin", "cos", "tan", "asin", "acos", "atan",
+    "sinh", "cosh", "tanh", "asinh", "acosh", "atanh",
+    "log2", "log10", "exp", "sqrt", "sign", "rint", NULL
+};
+
+ScalarExpression::ScalarExpression(const std::string name,
+                                   const std::string expression,
+                                   const std::string type,
+                                   bool once)
+    : Tool(name, once)
+    , _expression(expression)
+    , _type(trimCopy(type))
+    , _kernel(NULL)
+    , _output(NULL)
+    , _plan(this)
+{
+}
+
+ScalarExpression::~ScalarExpression()
+{
+    if(_kernel) clReleaseKernel(_kernel);
+    _kernel=NULL;
+    if(_output) clReleaseMemObject(_output);
+    _output=NULL;
+}
+
+void ScalarExpression::setup()
+{
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+
+    std::ostringstream msg;
+    msg << "Loading the tool \"" << name() << "\"..." << std::endl;
+    LOG(L_INFO, msg.str());
+
+    if(_type.find('*') != std::string::npos){
+        std::stringstream msg;
+        msg << "The tool \"" << name()
+            << "\" is asking for the array type \"" << _type
+            << "\", but just scalar results can be computed." << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Invalid variable type");
+    }
+
+    std::string value = translate();
+    setupOpenCL(value);
+
+    size_t typesize = InputOutput::Variables::typeToBytes(_type);
+    _output = C->memoryPool()->allocate(typesize, &err_code);
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Failure allocating the result memory object.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL allocation error");
+    }
+    allocatedMemory(typesize);
+
+    err_code = clSetKernelArg(_kernel, 0, sizeof(cl_mem), (void*)&_output);
+    if(err_code != CL_SUCCESS){
+        LOG(L_ERROR, "Failure sending the result argument\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+    InputOutput::Variables *vars = C->variables();
+    for(unsigned int i = 0; i < _vars.size(); i++){
+        _plan.bind(_kernel, i + 1, vars->handle(_vars.at(i)->name()));
+    }
+
+    std::vector<InputOutput::Variable*> outputs;
+    setDependencies(_vars, outputs);
+}
+
+void ScalarExpression::_execute()
+{
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+
+    _plan.update();
+
+    // A single work item is enough
+    size_t global_work_size = 1;
+    size_t local_work_size = 1;
+    err_code = clEnqueueNDRangeKernel(C->command_queue(),
+                                      _kernel,
+                                      1,
+                                      NULL,
+                                      &global_work_size,
+                                      &local_work_size,
+                                      0,
+                                      NULL,
+                                      profilingEvent());
+    if(err_code != CL_SUCCESS) {
+        std::stringstream msg;
+        msg << "Failure executing the tool \"" <<
+               name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+}
+
+std::string ScalarExpression::translate()
+{
+    unsigned int i, n = InputOutput::Variables::typeToN(_type);
+
+    // Split the expression in components, i.e. the commas outside functions,
+    // in the same way than Aqua::InputOutput::Variables::readComponents()
+    std::vector<std::string> components;
+    std::string component = "";
+    int parenthesis_counter = 0;
+    for(auto c : _expression){
+        if(c == '(')
+            parenthesis_counter++;
+        else if(c == ')')
+            parenthesis_counter--;
+        else if((c == ',') && (parenthesis_counter == 0)){
+            components.push_back(component);
+            component = "";
+            continue;
+        }
+        component += c;
+    }
+    components.push_back(component);
+    if(components.size() < n){
+        std::ostringstream msg;
+        msg << "Failure parsing the expression \"" << _expression
+            << "\" within the tool \"" << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        msg.str("");
+        msg << n << " fields expected, "
+            << components.size() << " received" << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Invalid number of fields");
+    }
+
+    // The expressions are evaluated as float values, so the integer results
+    // shall be rounded half away from zero, as
+    // Aqua::InputOutput::Variables::solve() does with round(). The relational
+    // and logical operations are returning int values, so every component is
+    // casted to float before rounding it
+    std::string cast = "";
+    if((_type.find("int") != std::string::npos) ||
+       (_type.find("ivec") != std::string::npos)){
+        cast = "convert_int";
+        if((_type.find("unsigned") != std::string::npos) ||
+           (_type.find("uivec") != std::string::npos)){
+            cast = "convert_uint";
+        }
+    }
+
+    std::ostringstream value;
+    if(n > 1)
+        value << "(T)(";
+    for(i = 0; i < n; i++){
+        if(i)
+            value << ", ";
+        if(cast.empty()){
+            value << "(" << translateComponent(components.at(i)) << ")";
+            continue;
+        }
+        value << cast << "(round((float)("
+              << translateComponent(components.at(i)) << ")))";
+    }
+    if(n > 1)
+        value << ")";
+    return value.str();
+}
+
+/** @brief Skip the blank characters
+ * @param expr Expression.
+ * @param pos Position in the expression, which is moved forward.
+ */
+static void skipSpaces(const std::string &expr, size_t &pos)
+{
+    while((pos < expr.size()) && isspace(expr[pos]))
+        pos++;
+}
+
+std::string ScalarExpression::translateComponent(const std::string expr)
+{
+    size_t pos = 0;
+    std::string result = parseTernary(expr, pos);
+    skipSpaces(expr, pos);
+    if(pos != expr.size()){
+        parseError(expr, pos, "Unexpected token");
+    }
+    return result;
+}
+
+std::string ScalarExpression::parseTernary(const std::string &expr,
+                                           size_t &pos)
+{
+    std::string condition = parseBinary(expr, pos, 0);
+    skipSpaces(expr, pos);
+    if((pos >= expr.size()) || (expr[pos] != '?'))
+        return condition;
+    pos++;
+    std::string a = parseTernary(expr, pos);
+    skipSpaces(expr, pos);
+    if((pos >= expr.size()) || (expr[pos] != ':')){
+        parseError(expr, pos, "':' expected");
+    }
+    pos++;
+    std::string b = parseTernary(expr, pos);
+    return "((" + condition + ") ? (float)(" + a + ") : (float)(" + b + "))";
+}
+
+std::string ScalarExpression::parseBinary(const std::string &expr,
+                                          size_t &pos,
+                                          unsigned int level)
+{
+    if(level >= sizeof(binary_operators) / sizeof(binary_operators[0]))
+        return parseUnary(expr, pos);
+
+    std::string result = parseBinary(expr, pos, level + 1);
+    while(true){
+        skipSpaces(expr, pos);
+        const char *op = NULL;
+        for(unsigned int i = 0; i < 6; i++){
+            const char *candidate = binary_operators[level][i];
+            if(!candidate)
+                break;
+            if(!expr.compare(pos, strlen(candidate), candidate)){
+                op = candidate;
+                break;
+            }
+        }
+        if(!op)
+            break;
+        pos += strlen(op);
+        std::string b = parseBinary(expr, pos, level + 1);
+        result = "(" + result + " " + op + " " + b + ")";
+    }
+    return result;
+}
+
+std::string ScalarExpression::parseUnary(const std::string &expr,
+                                         size_t &pos)
+{
+    skipSpaces(expr, pos);
+    if(pos >= expr.size()){
+        parseError(expr, pos, "Unexpected end of expression");
+    }
+    if(expr[pos] == '-'){
+        pos++;
+        return "(-" + parseUnary(expr, pos) + ")";
+    }
+    if(expr[pos] == '+'){
+        pos++;
+        return parseUnary(expr, pos);
+    }
+    if(expr[pos] == '!'){
+        pos++;
+        return "(!" + parseUnary(expr, pos) + ")";
+    }
+
+    std::string base = parsePrimary(expr, pos);
+    skipSpaces(expr, pos);
+    if((pos < expr.size()) && (expr[pos] == '^')){
+        // Right associative power
+        pos++;
+        std::string exponent = parseUnary(expr, pos);
+        return "pow((float)(" + base + "), (float)(" + exponent + "))";
+    }
+    return base;
+}
+
+std::string ScalarExpression::parsePrimary(const std::string &expr,
+                                           size_t &pos)
+{
+    skipSpaces(expr, pos);
+    if(pos >= expr.size()){
+        parseError(expr, pos, "Unexpected end of expression");
+    }
+
+    // Parenthesized expression
+    if(expr[pos] == '('){
+        pos++;
+        std::string result = parseTernary(expr, pos);
+        skipSpaces(expr, pos);
+        if((pos >= expr.size()) || (expr[pos] != ')')){
+            parseError(expr, pos, "')' expected");
+        }
+        pos++;
+        return "(" + result + ")";
+    }
+
+    // Number, which should be a float literal
+    if(isdigit(expr[pos]) || (expr[pos] == '.')){
+        size_t start = pos;
+        while((pos < expr.size()) && (isdigit(expr[pos]) || expr[pos] == '.'))
+            pos++;
+        if((pos < expr.size()) && ((expr[pos] == 'e') || (expr[pos] == 'E'))){
+            pos++;
+            if((pos < expr.size()) && ((expr[pos] == '+') || (expr[pos] == '-')))
+                pos++;
+            while((pos < expr.size()) && isdigit(expr[pos]))
+                pos++;
+        }
+        std::string number = expr.substr(start, pos - start);
+        if(number.find_first_of(".eE") == std::string::npos)
+            return number + ".f";
+        return number + "f";
+    }
+
+    if(!isalpha(expr[pos]) && (expr[pos] != '_')){
+        parseError(expr, pos, "Unexpected token");
+    }
+    size_t start = pos;
+    while((pos < expr.size()) && (isalnum(expr[pos]) || (expr[pos] == '_')))
+        pos++;
+    std::string identifier = expr.substr(start, pos - start);
+
+    skipSpaces(expr, pos);
+    if((pos >= expr.size()) || (expr[pos] != '(')){
+        // Constants and variables
+        if(!identifier.compare("_pi"))
+            return "M_PI_F";
+        if(!identifier.compare("_e"))
+            return "M_E_F";
+        return parseVariable(identifier);
+    }
+
+    // Function call
+    size_t func_pos = start;
+    std::vector<std::string> args;
+    pos++;
+    skipSpaces(expr, pos);
+    if((pos < expr.size()) && (expr[pos] == ')')){
+        pos++;
+    }
+    else{
+        while(true){
+            args.push_back("(float)(" + parseTernary(expr, pos) + ")");
+            skipSpaces(expr, pos);
+            if(pos >= expr.size()){
+                parseError(expr, pos, "')' expected");
+            }
+            if(expr[pos] == ')'){
+                pos++;
+                break;
+            }
+            if(expr[pos] != ','){
+                parseError(expr, pos, "',' or ')' expected");
+            }
+            pos++;
+        }
+    }
+
+    // Variadic functions
+    if(!identifier.compare("min") || !identifier.compare("max")){
+        if(!args.size()){
+            parseError(expr, func_pos, "Too few arguments");
+        }
+        std::string func = identifier[1] == 'i' ? "fmin" : "fmax";
+        std::string result = args.at(0);
+        for(unsigned int i = 1; i < args.size(); i++){
+            result = func + "(" + result + ", " + args.at(i) + ")";
+        }
+        return result;
+    }
+    if(!identifier.compare("sum") || !identifier.compare("avg")){
+        if(!args.size()){
+            parseError(expr, func_pos, "Too few arguments");
+        }
+        std::ostringstream result;
+        result << "(" << args.at(0);
+        for(unsigned int i = 1; i < args.size(); i++){
+            result << " + " << args.at(i);
+        }
+        result << ")";
+        if(!identifier.compare("avg")){
+            return "(" + result.str() + " / " + std::to_string(args.size())
+                + ".f)";
+        }
+        return result.str();
+    }
+
+    // Single argument functions
+    std::string func = "";
+    if(!identifier.compare("log"))
+        func = "log10";
+    else if(!identifier.compare("ln"))
+        func = "log";
+    else if(!identifier.compare("abs"))
+        func = "fabs";
+    else{
+        for(unsigned int i = 0; cl_functions[i]; i++){
+            if(!identifier.compare(cl_functions[i])){
+                func = identifier;
+                break;
+            }
+        }
+    }
+    if(func == ""){
+        parseError(expr, func_pos, "Unknown function \"" + identifier + "\"");
+    }
+    if(args.size() != 1){
+        parseError(expr, func_pos, "Function \"" + identifier
+                                   + "\" expects a single argument");
+    }
+    return func + "(" + args.at(0) + ")";
+}
+
+std::string ScalarExpression::parseVariable(const std::string var_name)
+{
+    InputOutput::Variables *vars = CalcServer::singleton()->variables();
+
+    InputOutput::Variable *var = vars->get(var_name);
+    std::string component = "";
+    if(!var && (var_name.size() > 2) && (var_name[var_name.size() - 2] == '_')){
+        // It can be a vectorial variable component
+        std::string suffix = var_name.substr(var_name.size() - 1);
+        if(std::string("xyzw").find(suffix) != std::string::npos){
+            var = vars->get(var_name.substr(0, var_name.size() - 2));
+            component = "." + suffix;
+            if(var && (InputOutput::Variables::typeToN(var->type()) < 2))
+                var = NULL;
+        }
+    }
+    if(!var){
+        std::stringstream msg;
+        msg << "The tool \"" << name()
+            << "\" is asking the undeclared variable \""
+            << var_name << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Invalid variable");
+    }
+    if(std::find(_vars.begin(), _vars.end(), var) == _vars.end())
+        _vars.push_back(var);
+
+    std::string result = "v_" + var->name();
+    if(var->type().find('*') != std::string::npos){
+        // The first component of the arrays is used
+        InputOutput::ArrayVariable *array = (InputOutput::ArrayVariable*)var;
+        if(!array->storage().compare("half")){
+            // Converted from half precision, loading the padded vec3 as vec4
+            unsigned int n = InputOutput::Variables::typeToN(var->type());
+            std::stringstream load;
+            load << "vload_half";
+            if(n > 1)
+                load << ((n == 3) ? 4 : n);
+            load << "(0, " << result << ")";
+            if(n == 3)
+                load << ".xyz";
+            result = load.str();
+        }
+        else if(!array->storage().compare("packed")){
+            // Just 3 components are stored
+            unsigned int n = InputOutput::Variables::typeToN(var->type());
+            if(n == 3)
+                result = "vload3(0, " + result + ")";
+            else
+                result = "(float4)(vload3(0, " + result + "), 0.f)";
+        }
+        else{
+            result += "[0]";
+        }
+    }
+    result += component;
+    if((component != "") || (InputOutput::Variables::typeToN(var->type()) == 1))
+        return "((float)" + result + ")";
+    return result;
+}
+
+void ScalarExpression::parseError(const std::string &expr,
+                                  size_t pos,
+                                  const std::string error)
+{
+    std::stringstream msg;
+    msg << "Failure parsing the expression \"" << _expression
+        << "\" within the tool \"" << name() << "\"." << std::endl;
+    LOG(L_ERROR, msg.str());
+    msg.str("");
+    msg << error << " at position " << pos << " of \"" << expr << "\""
+        << std::endl;
+    LOG0(L_DEBUG, msg.str());
+    throw std::runtime_error("Expression parsing error");
+}
+
+void ScalarExpression::setupOpenCL(const std::string value)
+{
+    // Create a header for the source code where the operation will be placed
+    std::ostringstream source;
+    source << SCALAREXPRESSION_INC << std::endl;
+    source << "#define EXPRESSION_ARGS";
+    for(auto var : _vars){
+        if(var->type().find('*') == std::string::npos){
+            source << ", " << var->type() << " v_" << var->name();
+            continue;
+        }
+        if(!((InputOutput::ArrayVariable*)var)->storage().compare("half"))
+            source << ", __global half* v_" << var->name();
+        else if(!((InputOutput::ArrayVariable*)var)->storage().compare("packed"))
+            source << ", __global float* v_" << var->name();
+        else
+            source << ", __global " << var->type() << " v_" << var->name();
+    }
+    source << std::endl;
+    source << "#define EXPRESSION_VALUE " << value << std::endl;
+    source << SCALAREXPRESSION_SRC;
+
+    _kernel = compile(source.str());
+}
+
+cl_kernel ScalarExpression::compile(const std::string source)
+{
+    cl_int err_code;
+    cl_program program;
+    cl_kernel kernel;
+    CalcServer *C = CalcServer::singleton();
+
+    std::ostringstream flags;
+    if(!_type.compare("unsigned int")){
+        // Spaces are not a good business into definitions passed as args
+        flags << "-DT=uint";
+    }
+    else{
+        flags << "-DT=" << _type;
+    }
+    #ifdef AQUA_DEBUG
+        flags << " -DDEBUG";
+    #else
+        flags << " -DNDEBUG";
+    #endif
+    flags << " -cl-mad-enable -cl-fast-relaxed-math";
+    #ifdef HAVE_3D
+        flags << " -DHAVE_3D";
+    #else
+        flags << " -DHAVE_2D";
+    #endif
+
+    program = C->programCache()->create(source, flags.str(), &err_code);
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Failure creating the OpenCL program.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL compilation error");
+    }
+    err_code = C->programCache()->build(program, flags.str());
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Error compiling the source code\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        LOG0(L_ERROR, "--- Build log ---------------------------------\n");
+        size_t log_size = 0;
+        clGetProgramBuildInfo(program,
+                              C->device(),
+                              CL_PROGRAM_BUILD_LOG,
+                              0,
+                              NULL,
+                              &log_size);
+        char *log = (char*)malloc(log_size + sizeof(char));
+        if(!log){
+            std::stringstream msg;
+            msg << "Failure allocating " << log_size
+                << " bytes for the building log" << std::endl;
+            LOG0(L_ERROR, msg.str());
+            LOG0(L_ERROR, "--------------------------------- Build log ---\n");
+            throw std::bad_alloc();
+        }
+        strcpy(log, "");
+        clGetProgramBuildInfo(program,
+                              C->device(),
+                              CL_PROGRAM_BUILD_LOG,
+                              log_size,
+                              log,
+                              NULL);
+        strcat(log, "\n");
+        LOG0(L_DEBUG, log);
+        LOG0(L_ERROR, "--------------------------------- Build log ---\n");
+        free(log);
+        log=NULL;
+        clReleaseProgram(program);
+        throw std::runtime_error("OpenCL compilation error");
+    }
+    kernel = clCreateKernel(program, "expression", &err_code);
+    clReleaseProgram(program);
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Failure creating the kernel.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+
+    return kernel;
+}
+
+}}  // namespaces
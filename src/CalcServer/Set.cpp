@@ -45,7 +45,6 @@ Set::Set(const std::string name,
     : Tool(name, once)
     , _var_name(var_name)
     , _value(value)
-    , _var(NULL)
     , _input(NULL)
     , _kernel(NULL)
     , _global_work_size(0)
@@ -70,6 +69,10 @@ void Set::setup()
     _input = *(cl_mem*)_var->get();
     _n = _var->size() / InputOutput::Variables::typeToBytes(_var->type());
     setupOpenCL();
+
+    std::vector<InputOutput::Variable*> inputs, outputs;
+    outputs.push_back(_var.get());
+    setDependencies(inputs, outputs);
 }
 
 
@@ -90,7 +93,7 @@ void Set::_execute()
                                       &_local_work_size,
                                       0,
                                       NULL,
-                                      NULL);
+                                      profilingEvent());
     if(err_code != CL_SUCCESS) {
         std::stringstream msg;
         msg << "Failure executing the tool \"" <<
@@ -120,7 +123,7 @@ void Set::variable()
         LOG(L_ERROR, msg.str());
         throw std::runtime_error("Invalid variable type");
     }
-    _var = (InputOutput::ArrayVariable *)vars->get(_var_name);
+    _var = vars->handle(_var_name);
 }
 
 void Set::setupOpenCL()
@@ -196,6 +199,12 @@ cl_kernel Set::compile(const std::string source)
         t.pop_back();  // Remove the asterisk
         flags << "-DT=" << t;
     }
+    if(!_var->storage().compare("half")){
+        flags << " -DHALF_STORAGE";
+    }
+    else if(!_var->storage().compare("packed")){
+        flags << " -DPACKED_STORAGE";
+    }
     #ifdef AQUA_DEBUG
         flags << " -DDEBUG";
     #else
@@ -208,19 +217,13 @@ cl_kernel Set::compile(const std::string source)
         flags << " -DHAVE_2D";
     #endif
 
-    size_t source_length = source.size();
-    const char* source_cstr = source.c_str();
-    program = clCreateProgramWithSource(C->context(),
-                                        1,
-                                        &source_cstr,
-                                        &source_length,
-                                        &err_code);
+    program = C->programCache()->create(source, flags.str(), &err_code);
     if(err_code != CL_SUCCESS) {
         LOG(L_ERROR, "Failure creating the OpenCL program.\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL compilation error");
     }
-    err_code = clBuildProgram(program, 0, NULL, flags.str().c_str(), NULL, NULL);
+    err_code = C->programCache()->build(program, flags.str());
     if(err_code != CL_SUCCESS) {
         LOG(L_ERROR, "Error compiling the source code\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
@@ -21,6 +21,7 @@
  * (See Aqua::CalcServer::SetScalar for details)
  */
 
+#include <AuxiliarMethods.h>
 #include <InputOutput/Logger.h>
 #include <CalcServer/SetScalar.h>
 #include <CalcServer.h>
@@ -30,16 +31,20 @@ namespace Aqua{ namespace CalcServer{
 SetScalar::SetScalar(const std::string name,
                      const std::string var_name,
                      const std::string value,
-                     bool once)
+                     bool once,
+                     bool device)
     : Tool(name, once)
     , _var_name(var_name)
     , _value(value)
-    , _var(NULL)
+    , _device(device)
+    , _expr(NULL)
 {
 }
 
 SetScalar::~SetScalar()
 {
+    if(_expr) delete _expr;
+    _expr=NULL;
 }
 
 void SetScalar::setup()
@@ -49,6 +54,22 @@ void SetScalar::setup()
     LOG(L_INFO, msg.str());
 
     variable();
+
+    std::vector<InputOutput::Variable*> inputs, outputs;
+    if(_device){
+        std::string type = trimCopy(_var->type());
+        if(type.back() == '*')
+            type.pop_back();  // Remove the asterisk
+        std::stringstream expr_name;
+        expr_name << name() << "->Expression";
+        _expr = new ScalarExpression(expr_name.str(), _value, type);
+        _expr->setup();
+        inputs = _expr->variables();
+    }
+    // Otherwise the value is evaluated in the host, so it is not depending on
+    // any device data
+    outputs.push_back(_var.get());
+    setDependencies(inputs, outputs);
 }
 
 
@@ -56,6 +77,11 @@ void SetScalar::_execute()
 {
     InputOutput::Variables *vars = CalcServer::singleton()->variables();
 
+    if(_expr){
+        executeDevice();
+        return;
+    }
+
     void *data = malloc(_var->typesize());
     if(!data){
         std::stringstream msg;
@@ -76,7 +102,67 @@ void SetScalar::_execute()
     _var->set(data);
     free(data);
     // Ensure that the variable is populated
-    vars->populate(_var);
+    vars->populate(_var.get());
+}
+
+void SetScalar::executeDevice()
+{
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+    InputOutput::Variables *vars = C->variables();
+
+    _expr->execute();
+
+    // Device resident result
+    if(_var->type().find('*') != std::string::npos){
+        err_code = clEnqueueCopyBuffer(C->command_queue(),
+                                       _expr->output(),
+                                       *(cl_mem*)_var->get(),
+                                       0,
+                                       0,
+                                       InputOutput::Variables::typeToBytes(
+                                           _var->type()),
+                                       0,
+                                       NULL,
+                                       profilingEvent());
+        if(err_code != CL_SUCCESS) {
+            std::ostringstream msg;
+            msg << "Failure copying the result within the tool \""
+                << name() << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+        return;
+    }
+
+    // Get back the result, without waiting for it
+    cl_event event;
+    cl_event *profiling_event = profilingEvent();
+    err_code = clEnqueueReadBuffer(C->command_queue(),
+                                   _expr->output(),
+                                   CL_FALSE,
+                                   0,
+                                   _var->typesize(),
+                                   _var->get(false),
+                                   0,
+                                   NULL,
+                                   &event);
+    if(err_code != CL_SUCCESS) {
+        std::ostringstream msg;
+        msg << "Failure reading back the result within the tool \""
+            << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+    if(profiling_event && (clRetainEvent(event) == CL_SUCCESS))
+        *profiling_event = event;
+    _var->setEvent(event);
+    clReleaseEvent(event);
+
+    // The variable will be populated when the result is required
+    vars->populateLazy(_var.get());
 }
 
 void SetScalar::variable()
@@ -91,7 +177,7 @@ void SetScalar::variable()
         LOG(L_ERROR, msg.str());
         throw std::runtime_error("Invalid variable");
     }
-    if(vars->get(_var_name)->type().find('*') != std::string::npos){
+    if(!_device && (vars->get(_var_name)->type().find('*') != std::string::npos)){
         std::stringstream msg;
         msg << "The tool \"" << name()
             << "\" is asking the variable \"" << _var_name
@@ -99,7 +185,7 @@ void SetScalar::variable()
         LOG(L_ERROR, msg.str());
         throw std::runtime_error("Invalid variable type");
     }
-    _var = vars->get(_var_name);
+    _var = vars->handle(_var_name);
 }
 
 }}  // namespaces
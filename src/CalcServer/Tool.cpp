@@ -24,37 +24,141 @@
 
 #include <CalcServer/Tool.h>
 #include <CalcServer.h>
+#include <InputOutput/Logger.h>
 #include <sys/time.h>
 
 namespace Aqua{ namespace CalcServer{
 
+#ifdef HAVE_GPUPROFILE
+/** @brief Tools currently being executed.
+ *
+ * Tools can be executed by other tools (e.g. the reductions and the radix sort
+ * within the link-list), so the events of the nested tools should be
+ * considered by the parent ones as well.
+ */
+static std::vector<Tool*> executing_tools;
+#endif
+
 Tool::Tool(const std::string tool_name, bool once)
     : _name(tool_name)
     , _once(once)
     , _allocated_memory(0)
     , _n_iters(0)
+    , _every(1)
+    , _every_t(0.f)
+    , _condition("")
+    , _n_calls(0)
+    , _last_t(0.f)
+    , _n_samples(0)
     , _elapsed_time(0.f)
     , _average_elapsed_time(0.f)
     , _squared_elapsed_time(0.f)
+    , _has_dependencies(false)
+    , _prepared(false)
+    , _fusable(true)
+    , _fused(NULL)
+    , _fused_owner(false)
 {
 }
 
 Tool::~Tool()
 {
+#ifdef HAVE_GPUPROFILE
+    for(auto events : _pending_events){
+        for(auto event : events){
+            clReleaseEvent(event);
+        }
+    }
+    _pending_events.clear();
+#endif
+    if(_fused_owner)
+        delete _fused;
+    _fused = NULL;
+}
+
+void Tool::prepare()
+{
+    InputOutput::Logger *logger = InputOutput::Logger::singleton();
+    logger->retain();
+    try {
+        _prepare();
+    } catch (...) {
+        _prepare_error = std::current_exception();
+    }
+    _prepare_log = logger->retained();
+    _prepared = true;
+}
+
+bool Tool::prepared()
+{
+    if(!_prepared)
+        return false;
+    _prepared = false;
+    InputOutput::Logger::singleton()->replay(_prepare_log);
+    _prepare_log.clear();
+    if(_prepare_error){
+        std::exception_ptr error = _prepare_error;
+        _prepare_error = nullptr;
+        std::rethrow_exception(error);
+    }
+    return true;
 }
 
 void Tool::execute()
 {
     if(_once && (_n_iters > 0))
         return;
+    if(!mustExecute())
+        return;
+
+#ifdef HAVE_GPUPROFILE
+    // Collect the data from the previous executions, if they are already done
+    updateProfiling();
+    _events.clear();
+    executing_tools.push_back(this);
+#endif
 
     timeval tic, tac;
     gettimeofday(&tic, NULL);
 
-    _execute();
+#ifdef HAVE_GPUPROFILE
+    try {
+        if(!_fused)
+            _execute();
+        else if(_fused_owner)
+            _fused->execute();
+    } catch (...) {
+        executing_tools.pop_back();
+        throw;
+    }
+    executing_tools.pop_back();
+#else
+    if(!_fused)
+        _execute();
+    else if(_fused_owner)
+        _fused->execute();
+#endif
 
     gettimeofday(&tac, NULL);
 
+    _n_iters++;
+
+#ifdef HAVE_GPUPROFILE
+    if(_events.size()){
+        // The parent tools should account the events of this one as well
+        for(auto tool : executing_tools){
+            for(auto event : _events){
+                if(clRetainEvent(event) == CL_SUCCESS)
+                    tool->_events.push_back(event);
+            }
+        }
+        // The elapsed time will be computed when the device finish
+        _pending_events.push_back(_events);
+        _events.clear();
+        return;
+    }
+#endif
+
     float elapsed_seconds;
     elapsed_seconds = (float)(tac.tv_sec - tic.tv_sec);
     elapsed_seconds += (float)(tac.tv_usec - tic.tv_usec) * 1E-6f;
@@ -62,19 +166,149 @@ void Tool::execute()
     addElapsedTime(elapsed_seconds);
 }
 
+void Tool::updateProfiling()
+{
+#ifdef HAVE_GPUPROFILE
+    cl_int err_code;
+    while(_pending_events.size()){
+        std::vector<cl_event> events = _pending_events.front();
+
+        // Check that all the commands have been completed
+        for(auto event : events){
+            cl_int status;
+            err_code = clGetEventInfo(event,
+                                      CL_EVENT_COMMAND_EXECUTION_STATUS,
+                                      sizeof(cl_int),
+                                      &status,
+                                      NULL);
+            if(err_code != CL_SUCCESS){
+                std::stringstream msg;
+                msg << "Failure querying the events status in tool \"" <<
+                       name() << "\"." << std::endl;
+                LOG(L_ERROR, msg.str());
+                InputOutput::Logger::singleton()->printOpenCLError(err_code);
+                throw std::runtime_error("OpenCL error");
+            }
+            if((status != CL_COMPLETE) && (status > 0)){
+                // Still running, we should wait for the next chance
+                return;
+            }
+        }
+
+        // Sum up the time spent by the device on each command
+        cl_ulong elapsed_time = 0;
+        for(auto event : events){
+            cl_ulong t_queued, t_submit, t_start, t_end;
+            err_code  = clGetEventProfilingInfo(event,
+                                                CL_PROFILING_COMMAND_QUEUED,
+                                                sizeof(cl_ulong),
+                                                &t_queued,
+                                                NULL);
+            err_code |= clGetEventProfilingInfo(event,
+                                                CL_PROFILING_COMMAND_SUBMIT,
+                                                sizeof(cl_ulong),
+                                                &t_submit,
+                                                NULL);
+            err_code |= clGetEventProfilingInfo(event,
+                                                CL_PROFILING_COMMAND_START,
+                                                sizeof(cl_ulong),
+                                                &t_start,
+                                                NULL);
+            err_code |= clGetEventProfilingInfo(event,
+                                                CL_PROFILING_COMMAND_END,
+                                                sizeof(cl_ulong),
+                                                &t_end,
+                                                NULL);
+            clReleaseEvent(event);
+            if(err_code != CL_SUCCESS){
+                // Failed commands have not valid timestamps
+                continue;
+            }
+            if((t_queued > t_submit) || (t_submit > t_start) ||
+               (t_start > t_end))
+            {
+                // Some implementations are reporting wrong timestamps
+                continue;
+            }
+            elapsed_time += t_end - t_start;
+        }
+        _pending_events.pop_front();
+
+        addElapsedTime(1E-9f * (float)elapsed_time);
+    }
+#endif
+}
+
 void Tool::addElapsedTime(float elapsed_time)
 {
     _elapsed_time = elapsed_time;
     // Invert the average computation
-    _average_elapsed_time *= _n_iters;
-    _squared_elapsed_time *= _n_iters;
+    _average_elapsed_time *= _n_samples;
+    _squared_elapsed_time *= _n_samples;
     // Add the new data
     _average_elapsed_time += elapsed_time;
     _squared_elapsed_time += elapsed_time * elapsed_time;
     // And average it again
-    _n_iters++;
-    _average_elapsed_time /= _n_iters;
-    _squared_elapsed_time /= _n_iters;
+    _n_samples++;
+    _average_elapsed_time /= _n_samples;
+    _squared_elapsed_time /= _n_samples;
+}
+
+void Tool::fused(Tool *tool, bool owner)
+{
+    _fused = tool;
+    _fused_owner = owner;
+    // The rest of fused tools cannot be executed before the first one, which
+    // is actually doing the work
+    setDependencies(tool->getInputDependencies(),
+                    tool->getOutputDependencies());
+}
+
+void Tool::setDependencies(std::vector<InputOutput::Variable*> inputs,
+                           std::vector<InputOutput::Variable*> outputs)
+{
+    _in_vars = inputs;
+    _out_vars = outputs;
+    _has_dependencies = true;
+}
+
+cl_event* Tool::profilingEvent()
+{
+#ifdef HAVE_GPUPROFILE
+    if(!executing_tools.size() || (executing_tools.back() != this))
+        return NULL;
+    _events.push_back(NULL);
+    return &(_events.back());
+#else
+    return NULL;
+#endif
+}
+
+bool Tool::mustExecute()
+{
+    // The cheapest criteria are checked first
+    unsigned int n_calls = _n_calls++;
+    if(n_calls % _every)
+        return false;
+
+    InputOutput::Variables *vars = CalcServer::singleton()->variables();
+    float t = 0.f;
+    if(_every_t > 0.f){
+        t = *(float *)vars->get("t")->get();
+        if(_n_iters && (t - _last_t < _every_t))
+            return false;
+    }
+
+    if(_condition.compare("")){
+        int result;
+        vars->solve("int", _condition, &result, "if_result");
+        if(!result)
+            return false;
+    }
+
+    if(_every_t > 0.f)
+        _last_t = t;
+    return true;
 }
 
 }}  // namespace
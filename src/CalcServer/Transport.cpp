@@ -0,0 +1,76 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Communication between several AQUAgpusph processes.
+ * (See Aqua::CalcServer::Transport for details)
+ */
+
+#include <stdint.h>
+
+#include <InputOutput/Logger.h>
+#include <CalcServer/Transport.h>
+
+namespace Aqua{ namespace CalcServer{
+
+Transport::Transport(unsigned int rank, unsigned int n_ranks)
+    : _rank(rank)
+    , _n_ranks(n_ranks)
+{
+}
+
+Transport::~Transport()
+{
+}
+
+void Transport::exchange(unsigned int rank,
+                         const std::vector<char> &data_out,
+                         std::vector<char> &data_in)
+{
+    if(rank == _rank){
+        data_in = data_out;
+        return;
+    }
+    if(_rank < rank){
+        sendMessage(rank, data_out);
+        recvMessage(rank, data_in);
+    }
+    else{
+        recvMessage(rank, data_in);
+        sendMessage(rank, data_out);
+    }
+}
+
+void Transport::sendMessage(unsigned int rank, const std::vector<char> &data)
+{
+    uint64_t size = data.size();
+    send(rank, &size, sizeof(uint64_t));
+    if(size)
+        send(rank, data.data(), size);
+}
+
+void Transport::recvMessage(unsigned int rank, std::vector<char> &data)
+{
+    uint64_t size;
+    recv(rank, &size, sizeof(uint64_t));
+    data.resize(size);
+    if(size)
+        recv(rank, data.data(), size);
+}
+
+}}  // namespaces
@@ -41,7 +41,6 @@ std::string UNSORT_SRC = xxd2string(UnSort_cl_in, UnSort_cl_in_len);
 UnSort::UnSort(const std::string name, const std::string var_name, bool once)
     : Tool(name, once)
     , _var_name(var_name)
-    , _var(NULL)
     , _input(NULL)
     , _id_input(NULL)
     , _output(NULL)
@@ -87,7 +86,7 @@ void UnSort::_execute()
                                       &_local_work_size,
                                       0,
                                       NULL,
-                                      NULL);
+                                      profilingEvent());
     if(err_code != CL_SUCCESS) {
         std::stringstream msg;
         msg << "Failure executing the tool \"" <<
@@ -121,7 +120,7 @@ void UnSort::variables()
         LOG0(L_DEBUG, msg.str());
         throw std::runtime_error("Invalid variable type");
     }
-    _id_var = (InputOutput::ArrayVariable *)vars->get("id");
+    _id_var = vars->handle("id");
 
     if(!vars->get(_var_name)){
         std::stringstream msg;
@@ -139,7 +138,7 @@ void UnSort::variables()
         LOG(L_ERROR, msg.str());
         throw std::runtime_error("Invalid variable type");
     }
-    _var = (InputOutput::ArrayVariable *)vars->get(_var_name);
+    _var = vars->handle(_var_name);
 }
 
 void UnSort::setupMem()
@@ -164,11 +163,8 @@ void UnSort::setupMem()
         throw std::runtime_error("Invalid variable length");
     }
 
-    _output = clCreateBuffer(C->context(),
-                             CL_MEM_WRITE_ONLY,
-                             len_id * InputOutput::Variables::typeToBytes(_var->type()),
-                             NULL,
-                               &err_code);
+    _output = C->memoryPool()->allocate(
+        len_id * InputOutput::Variables::typeToBytes(_var->type()), &err_code);
     if(err_code != CL_SUCCESS){
         std::stringstream msg;
         msg << "Failure allocating device memory in the tool \"" <<
@@ -267,6 +263,12 @@ cl_kernel UnSort::compile(const std::string source)
         t.pop_back();  // Remove the asterisk
         flags << "-DT=" << t;
     }
+    if(!_var->storage().compare("half")){
+        flags << " -DHALF_STORAGE";
+    }
+    else if(!_var->storage().compare("packed")){
+        flags << " -DPACKED_STORAGE";
+    }
     #ifdef AQUA_DEBUG
         flags << " -DDEBUG ";
     #else
@@ -278,19 +280,13 @@ cl_kernel UnSort::compile(const std::string source)
     #else
         flags << " -DHAVE_2D";
     #endif
-    size_t source_length = source.size();
-    const char* source_cstr = source.c_str();
-    program = clCreateProgramWithSource(C->context(),
-                                        1,
-                                        &source_cstr,
-                                        &source_length,
-                                        &err_code);
+    program = C->programCache()->create(source, flags.str(), &err_code);
     if(err_code != CL_SUCCESS) {
         LOG(L_ERROR, "Failure creating the OpenCL program\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL error");
     }
-    err_code = clBuildProgram(program, 0, NULL, flags.str().c_str(), NULL, NULL);
+    err_code = C->programCache()->build(program, flags.str());
     if(err_code != CL_SUCCESS) {
         LOG(L_ERROR, "Error compiling the OpenCL script\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
@@ -0,0 +1,261 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Communication between several AQUAgpusph processes running in the
+ * same host.
+ * (See Aqua::CalcServer::UnixSocketTransport for details)
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <InputOutput/Logger.h>
+#include <CalcServer/UnixSocketTransport.h>
+
+/// Time to wait for the other processes, in seconds
+#ifndef __TRANSPORT_TIMEOUT__
+    #define __TRANSPORT_TIMEOUT__ 60
+#endif
+
+namespace Aqua{ namespace CalcServer{
+
+UnixSocketTransport::UnixSocketTransport(unsigned int rank,
+                                         unsigned int n_ranks,
+                                         const std::string path)
+    : Transport(rank, n_ranks)
+    , _path(path)
+    , _listener(-1)
+    , _sockets(n_ranks, -1)
+{
+    unsigned int i;
+
+    std::ostringstream msg;
+    msg << "Connecting the process " << rank << " with other "
+        << n_ranks - 1 << " processes..." << std::endl;
+    LOG(L_INFO, msg.str());
+
+    listen();
+    // The processes with lower ranks are already listening
+    for(i = 0; i < rank; i++){
+        connect(i);
+    }
+    for(i = rank + 1; i < n_ranks; i++){
+        accept();
+    }
+
+    LOG(L_INFO, "Processes connected.\n");
+}
+
+UnixSocketTransport::~UnixSocketTransport()
+{
+    for(auto sock : _sockets){
+        if(sock >= 0) close(sock);
+    }
+    _sockets.clear();
+    if(_listener >= 0){
+        close(_listener);
+        unlink(address(rank()).c_str());
+    }
+}
+
+void UnixSocketTransport::send(unsigned int rank,
+                               const void *data,
+                               size_t size)
+{
+    const char *ptr = (const char*)data;
+    while(size){
+        ssize_t n = ::send(_sockets.at(rank), ptr, size, MSG_NOSIGNAL);
+        if(n < 0){
+            if(errno == EINTR)
+                continue;
+            std::ostringstream msg;
+            msg << "Failure sending data to the process " << rank
+                << "." << std::endl;
+            LOG(L_ERROR, msg.str());
+            msg.str(""); msg << "\t" << strerror(errno) << std::endl;
+            LOG0(L_DEBUG, msg.str());
+            throw std::runtime_error("Transport error");
+        }
+        ptr += n;
+        size -= n;
+    }
+}
+
+void UnixSocketTransport::recv(unsigned int rank, void *data, size_t size)
+{
+    char *ptr = (char*)data;
+    while(size){
+        ssize_t n = ::recv(_sockets.at(rank), ptr, size, 0);
+        if(n <= 0){
+            if((n < 0) && (errno == EINTR))
+                continue;
+            std::ostringstream msg;
+            msg << "Failure receiving data from the process " << rank
+                << "." << std::endl;
+            LOG(L_ERROR, msg.str());
+            msg.str("");
+            if(n < 0)
+                msg << "\t" << strerror(errno) << std::endl;
+            else
+                msg << "\tThe connection has been closed" << std::endl;
+            LOG0(L_DEBUG, msg.str());
+            throw std::runtime_error("Transport error");
+        }
+        ptr += n;
+        size -= n;
+    }
+}
+
+std::string UnixSocketTransport::address(unsigned int rank) const
+{
+    std::ostringstream addr;
+    addr << _path << "." << rank;
+    return addr.str();
+}
+
+/** @brief Build the address of a socket file.
+ * @param path Socket file path.
+ * @param addr Address to be filled.
+ * @return false if the address has been built, true if the path is too long.
+ */
+static bool buildAddress(const std::string path, struct sockaddr_un &addr)
+{
+    memset(&addr, 0, sizeof(struct sockaddr_un));
+    addr.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(addr.sun_path)){
+        std::ostringstream msg;
+        msg << "The socket file path \"" << path << "\" is too long."
+            << std::endl;
+        LOG(L_ERROR, msg.str());
+        return true;
+    }
+    strcpy(addr.sun_path, path.c_str());
+    return false;
+}
+
+void UnixSocketTransport::listen()
+{
+    struct sockaddr_un addr;
+    std::string path = address(rank());
+    if(buildAddress(path, addr))
+        throw std::runtime_error("Invalid socket path");
+
+    _listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(_listener < 0){
+        LOG(L_ERROR, "Failure creating the listening socket.\n");
+        std::ostringstream msg;
+        msg << "\t" << strerror(errno) << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Transport error");
+    }
+    // Remove the socket file of a previous execution
+    unlink(path.c_str());
+    if(bind(_listener, (struct sockaddr*)&addr, sizeof(addr)) ||
+       ::listen(_listener, size()))
+    {
+        std::ostringstream msg;
+        msg << "Failure listening in \"" << path << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        msg.str(""); msg << "\t" << strerror(errno) << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Transport error");
+    }
+}
+
+void UnixSocketTransport::connect(unsigned int rank)
+{
+    unsigned int i;
+    struct sockaddr_un addr;
+    std::string path = address(rank);
+    if(buildAddress(path, addr))
+        throw std::runtime_error("Invalid socket path");
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(sock < 0){
+        LOG(L_ERROR, "Failure creating the socket.\n");
+        std::ostringstream msg;
+        msg << "\t" << strerror(errno) << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Transport error");
+    }
+    // The other process may be not launched yet
+    for(i = 0; i < __TRANSPORT_TIMEOUT__; i++){
+        if(!::connect(sock, (struct sockaddr*)&addr, sizeof(addr)))
+            break;
+        sleep(1);
+    }
+    if(i == __TRANSPORT_TIMEOUT__){
+        std::ostringstream msg;
+        msg << "Failure connecting with the process " << rank
+            << " in \"" << path << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        msg.str(""); msg << "\t" << strerror(errno) << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        close(sock);
+        throw std::runtime_error("Transport error");
+    }
+    _sockets.at(rank) = sock;
+
+    // Let the other process know who we are
+    uint32_t id = this->rank();
+    send(rank, &id, sizeof(uint32_t));
+}
+
+void UnixSocketTransport::accept()
+{
+    int sock = ::accept(_listener, NULL, NULL);
+    if(sock < 0){
+        LOG(L_ERROR, "Failure accepting a connection.\n");
+        std::ostringstream msg;
+        msg << "\t" << strerror(errno) << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Transport error");
+    }
+
+    uint32_t id;
+    char *ptr = (char*)&id;
+    size_t remaining = sizeof(uint32_t);
+    while(remaining){
+        ssize_t n = ::recv(sock, ptr, remaining, 0);
+        if(n <= 0){
+            if((n < 0) && (errno == EINTR))
+                continue;
+            LOG(L_ERROR, "Failure identifying a connected process.\n");
+            close(sock);
+            throw std::runtime_error("Transport error");
+        }
+        ptr += n;
+        remaining -= n;
+    }
+    if((id <= rank()) || (id >= size()) || (_sockets.at(id) >= 0)){
+        std::ostringstream msg;
+        msg << "Unexpected connection from the process " << id
+            << "." << std::endl;
+        LOG(L_ERROR, msg.str());
+        close(sock);
+        throw std::runtime_error("Transport error");
+    }
+    _sockets.at(id) = sock;
+}
+
+}}  // namespaces
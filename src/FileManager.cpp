@@ -66,6 +66,15 @@ CalcServer::CalcServer* FileManager::load()
         throw std::runtime_error("No particles sets");
     }
 
+    // In multi-process runs each process is writing its own output files
+    if(_simulation.settings.n_ranks > 1){
+        for(auto set : _simulation.sets){
+            std::ostringstream path;
+            path << set->outputPath() << ".rank" << _simulation.settings.rank;
+            set->outputPath(path.str());
+        }
+    }
+
     // Build the calculation server
     CalcServer::CalcServer *C = new CalcServer::CalcServer(_simulation);
 
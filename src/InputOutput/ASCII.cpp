@@ -179,16 +179,9 @@ void ASCII::load()
     for(auto field : fields){
         ArrayVariable *var = (ArrayVariable*)vars->get(field);
         size_t typesize = vars->typeToBytes(var->type());
-        cl_mem mem = *(cl_mem*)var->get();
-        err_code = clEnqueueWriteBuffer(C->command_queue(),
-                                        mem,
-                                        CL_TRUE,
-                                        typesize * bounds().x,
-                                        typesize * n,
-                                        data.at(i),
-                                        0,
-                                        NULL,
-                                        NULL);
+        err_code = var->write(typesize * bounds().x,
+                              typesize * n,
+                              data.at(i));
         free(data.at(i)); data.at(i) = NULL;
         if(err_code != CL_SUCCESS){
             std::ostringstream msg;
@@ -42,6 +42,7 @@ Logger::Logger()
     : _last_row(0)
 {
     wnd = NULL;
+    pthread_mutex_init(&_retained_mutex, NULL);
     open();
     gettimeofday(&_start_time, NULL);
 }
@@ -49,6 +50,7 @@ Logger::Logger()
 Logger::~Logger()
 {
     close();
+    pthread_mutex_destroy(&_retained_mutex);
 }
 
 void Logger::initNCurses()
@@ -223,6 +225,21 @@ void Logger::writeReport(std::string input,
 
 void Logger::addMessage(TLogLevel level, std::string log, std::string func)
 {
+    pthread_mutex_lock(&_retained_mutex);
+    if(_retained.size()){
+        auto it = _retained.find(pthread_self());
+        if(it != _retained.end()){
+            logMessage message;
+            message.level = level;
+            message.log = log;
+            message.func = func;
+            it->second.push_back(message);
+            pthread_mutex_unlock(&_retained_mutex);
+            return;
+        }
+    }
+    pthread_mutex_unlock(&_retained_mutex);
+
     std::ostringstream fname;
     if (func != "")
         fname << "(" << func << "): ";
@@ -279,6 +296,33 @@ void Logger::addMessage(TLogLevel level, std::string log, std::string func)
     refreshAll();
 }
 
+void Logger::retain()
+{
+    pthread_mutex_lock(&_retained_mutex);
+    _retained[pthread_self()].clear();
+    pthread_mutex_unlock(&_retained_mutex);
+}
+
+std::vector<Logger::logMessage> Logger::retained()
+{
+    std::vector<logMessage> logs;
+    pthread_mutex_lock(&_retained_mutex);
+    auto it = _retained.find(pthread_self());
+    if(it != _retained.end()){
+        logs = it->second;
+        _retained.erase(it);
+    }
+    pthread_mutex_unlock(&_retained_mutex);
+    return logs;
+}
+
+void Logger::replay(const std::vector<logMessage> &logs)
+{
+    for(auto message : logs){
+        addMessage(message.level, message.log, message.func);
+    }
+}
+
 void Logger::printDate(TLogLevel level)
 {
     std::ostringstream msg;
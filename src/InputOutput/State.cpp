@@ -131,17 +131,23 @@ State::State()
         throw;
     }
 
-    // Look ofr the first available file place
+    // Look ofr the first available file place. In multi-process runs the
+    // files are suffixed by the process rank (see save()), such that the
+    // first process file is considered as well
     i = 0;
     std::ostringstream file_name;
     while(true){
+        file_name.str("");
+        file_name << "AQUAgpusph.save." << i << ".rank0.xml";
+        std::ifstream f_rank(file_name.str());
         file_name.str("");
         file_name << "AQUAgpusph.save." << i << ".xml";
         std::ifstream f(file_name.str());
-        if(f.is_open()){
+        if(f.is_open() || f_rank.is_open()){
             // The file already exist, look for another one
             i++;
             f.close();
+            f_rank.close();
             continue;
         }
         break;
@@ -174,6 +180,13 @@ State::~State()
 
 void State::save(ProblemSetup &sim_data, std::vector<Particles*> savers)
 {
+    // In multi-process runs each process is writing its own file
+    if(sim_data.settings.n_ranks > 1){
+        std::ostringstream file_name;
+        file_name << _output_file.substr(0, _output_file.size() - 4)
+                  << ".rank" << sim_data.settings.rank << ".xml";
+        return write(file_name.str(), sim_data, savers);
+    }
     return write(_output_file, sim_data, savers);
 }
 
@@ -351,7 +364,57 @@ void State::parseSettings(DOMElement *root,
                 LOG0(L_DEBUG, "\t\tDEFAULT\n");
                 throw std::runtime_error("Invalid device type");
             }
+            if(xmlHasAttribute(s_elem, "queues")){
+                int n_queues = std::stoi(xmlAttribute(s_elem, "queues"));
+                if(n_queues < 1){
+                    std::ostringstream msg;
+                    msg << "Invalid number of command queues, "
+                        << n_queues << std::endl;
+                    LOG(L_ERROR, msg.str());
+                    throw std::runtime_error("Invalid number of queues");
+                }
+                sim_data.settings.n_queues = n_queues;
+            }
+            if(xmlHasAttribute(s_elem, "domains")){
+                int n_domains = std::stoi(xmlAttribute(s_elem, "domains"));
+                if(n_domains < 1){
+                    std::ostringstream msg;
+                    msg << "Invalid number of domains, "
+                        << n_domains << std::endl;
+                    LOG(L_ERROR, msg.str());
+                    throw std::runtime_error("Invalid number of domains");
+                }
+                sim_data.settings.n_domains = n_domains;
+            }
+        }
+        s_nodes = elem->getElementsByTagName(xmlS("Autotune"));
+        for(XMLSize_t j=0; j<s_nodes->getLength(); j++){
+            DOMNode* s_node = s_nodes->item(j);
+            if(s_node->getNodeType() != DOMNode::ELEMENT_NODE)
+                continue;
+            DOMElement* s_elem = dynamic_cast<xercesc::DOMElement*>(s_node);
+            if(!toLowerCopy(xmlAttribute(s_elem, "value")).compare("true")){
+                sim_data.settings.autotune = true;
+            }
+            else{
+                sim_data.settings.autotune = false;
+            }
+            if(xmlHasAttribute(s_elem, "file")){
+                sim_data.settings.tuning_path = xmlAttribute(s_elem, "file");
+            }
+        }
+
+        s_nodes = elem->getElementsByTagName(xmlS("ProgramCache"));
+        for(XMLSize_t j=0; j<s_nodes->getLength(); j++){
+            DOMNode* s_node = s_nodes->item(j);
+            if(s_node->getNodeType() != DOMNode::ELEMENT_NODE)
+                continue;
+            DOMElement* s_elem = dynamic_cast<xercesc::DOMElement*>(s_node);
+            // The command line option has priority
+            if(!sim_data.settings.cache_path.compare(""))
+                sim_data.settings.cache_path = xmlAttribute(s_elem, "path");
         }
+
         s_nodes = elem->getElementsByTagName(xmlS("RootPath"));
         for(XMLSize_t j=0; j<s_nodes->getLength(); j++){
             DOMNode* s_node = s_nodes->item(j);
@@ -390,7 +453,8 @@ void State::parseVariables(DOMElement *root,
                 sim_data.variables.registerVariable(xmlAttribute(s_elem, "name"),
                                                     xmlAttribute(s_elem, "type"),
                                                     xmlAttribute(s_elem, "length"),
-                                                    "");
+                                                    "",
+                                                    xmlAttribute(s_elem, "storage"));
             }
         }
     }
@@ -543,6 +607,22 @@ void State::parseTools(DOMElement *root,
             else {
                 tool->set("once", "false");
             }
+            // Execution conditions, which are optional
+            if(xmlHasAttribute(s_elem, "every")){
+                tool->set("every", xmlAttribute(s_elem, "every"));
+            }
+            if(xmlHasAttribute(s_elem, "every_t")){
+                tool->set("every_t", xmlAttribute(s_elem, "every_t"));
+            }
+            if(xmlHasAttribute(s_elem, "if")){
+                tool->set("if", xmlAttribute(s_elem, "if"));
+            }
+            // The element-wise tools are fused with their neighbours, unless
+            // it is explicitly disabled, while the kernels should explicitly
+            // request it
+            if(xmlHasAttribute(s_elem, "fuse")){
+                tool->set("fuse", toLowerCopy(xmlAttribute(s_elem, "fuse")));
+            }
 
 
             // Check if the conditions to add the tool are fulfilled
@@ -891,6 +971,13 @@ void State::parseTools(DOMElement *root,
                     }
                     tool->set(atts[k], xmlAttribute(s_elem, atts[k]));
                 }
+                if(xmlHasAttribute(s_elem, "device")){
+                    tool->set("device",
+                              toLowerCopy(xmlAttribute(s_elem, "device")));
+                }
+                else {
+                    tool->set("device", "false");
+                }
             }
             else if(!xmlAttribute(s_elem, "type").compare("reduction")){
                 const char *atts[3] = {"in", "out", "null"};
@@ -945,6 +1032,27 @@ void State::parseTools(DOMElement *root,
                     throw std::runtime_error("Missing attribute");
                 }
                 tool->set("condition", xmlAttribute(s_elem, "condition"));
+                if(xmlHasAttribute(s_elem, "device")){
+                    tool->set("device",
+                              toLowerCopy(xmlAttribute(s_elem, "device")));
+                }
+                else {
+                    tool->set("device", "false");
+                }
+            }
+            else if(!xmlAttribute(s_elem, "type").compare("halo")){
+                const char *atts[3] = {"fields", "set", "bounds"};
+                for(unsigned int k = 0; k < 3; k++){
+                    if(!xmlHasAttribute(s_elem, atts[k])){
+                        std::ostringstream msg;
+                        msg << "Tool \"" << tool->get("name")
+                            << "\" is of type \"halo\", but \"" << atts[k]
+                            << "\" is not defined." << std::endl;
+                        LOG(L_ERROR, msg.str());
+                        throw std::runtime_error("Missing attribute");
+                    }
+                    tool->set(atts[k], xmlAttribute(s_elem, atts[k]));
+                }
             }
             else if(!xmlAttribute(s_elem, "type").compare("dummy")){
                 // Without options
@@ -1471,7 +1579,24 @@ void State::writeSettings(xercesc::DOMDocument* doc,
             break;
     }
     s_elem->setAttribute(xmlS("type"), xmlS(att.str()));
+    att.str(""); att << sim_data.settings.n_queues;
+    s_elem->setAttribute(xmlS("queues"), xmlS(att.str()));
+    att.str(""); att << sim_data.settings.n_domains;
+    s_elem->setAttribute(xmlS("domains"), xmlS(att.str()));
+    elem->appendChild(s_elem);
+
+    s_elem = doc->createElement(xmlS("Autotune"));
+    s_elem->setAttribute(xmlS("value"),
+                         xmlS(sim_data.settings.autotune ? "true" : "false"));
+    s_elem->setAttribute(xmlS("file"), xmlS(sim_data.settings.tuning_path));
     elem->appendChild(s_elem);
+
+    if(sim_data.settings.cache_path.compare("")){
+        s_elem = doc->createElement(xmlS("ProgramCache"));
+        s_elem->setAttribute(xmlS("path"),
+                             xmlS(sim_data.settings.cache_path));
+        elem->appendChild(s_elem);
+    }
 }
 
 void State::writeVariables(xercesc::DOMDocument* doc,
@@ -1501,6 +1626,10 @@ void State::writeVariables(xercesc::DOMDocument* doc,
             std::ostringstream length_txt;
             length_txt << length;
             s_elem->setAttribute(xmlS("length"), xmlS(length_txt.str()));
+            if(((ArrayVariable*)var)->storage().compare("")){
+                s_elem->setAttribute(xmlS("storage"),
+                                     xmlS(((ArrayVariable*)var)->storage()));
+            }
             continue;
         }
         // Scalar variable
@@ -276,16 +276,9 @@ void VTK::load()
     for(i = 0; i < fields.size(); i++){
         ArrayVariable *var = (ArrayVariable*)vars->get(fields.at(i));
         size_t typesize = vars->typeToBytes(var->type());
-        cl_mem mem = *(cl_mem*)var->get();
-        err_code = clEnqueueWriteBuffer(C->command_queue(),
-                                        mem,
-                                        CL_TRUE,
-                                        typesize * bounds().x,
-                                        typesize * n,
-                                        data.at(i),
-                                        0,
-                                        NULL,
-                                        NULL);
+        err_code = var->write(typesize * bounds().x,
+                              typesize * n,
+                              data.at(i));
         free(data.at(i)); data.at(i) = NULL;
         if(err_code != CL_SUCCESS){
             std::ostringstream msg;
@@ -624,17 +617,53 @@ vtkXMLUnstructuredGridWriter* VTK::create(){
 }
 
 void VTK::updatePVD(float t){
+    std::vector<std::string> files;
+    files.push_back(file());
+    updatePVD(filenamePVD(), t, files);
+
+    // In multi-process runs, the first process is additionally collecting
+    // the files of all the processes in a single PVD file, where each
+    // process is a different part
+    const ProblemSetup::sphSettings &settings = simData().settings;
+    if((settings.n_ranks < 2) || (settings.rank != 0))
+        return;
+    std::ostringstream suffix;
+    suffix << ".rank" << settings.rank;
+    std::string path = simData().sets.at(setId())->outputPath();
+    if((path.size() < suffix.str().size()) ||
+       path.compare(path.size() - suffix.str().size(),
+                    suffix.str().size(),
+                    suffix.str()))
+    {
+        return;
+    }
+    path = path.substr(0, path.size() - suffix.str().size());
+    files.clear();
+    for(unsigned int r = 0; r < settings.n_ranks; r++){
+        std::ostringstream rank_suffix;
+        rank_suffix << ".rank" << r << ".";
+        files.push_back(replaceAllCopy(file(),
+                                       suffix.str() + ".",
+                                       rank_suffix.str()));
+    }
+    updatePVD(path + ".pvd", t, files);
+}
+
+void VTK::updatePVD(const std::string fname,
+                    float t,
+                    const std::vector<std::string> files)
+{
     unsigned int n;
 
     std::ostringstream msg;
-    msg << "Writing \"" << filenamePVD() << "\" Paraview data file..." << std::endl;
+    msg << "Writing \"" << fname << "\" Paraview data file..." << std::endl;
     LOG(L_INFO, msg.str());
 
     bool should_release_doc = false;
-    DOMDocument* doc = getPVD(false);
+    DOMDocument* doc = getPVD(fname, false);
     if(!doc){
         should_release_doc = true;
-        doc = getPVD(true);
+        doc = getPVD(fname, true);
     }
     DOMElement* root = doc->getDocumentElement();
     if(!root){
@@ -660,13 +689,15 @@ void VTK::updatePVD(float t){
     DOMNode* node = nodes->item(0);
     DOMElement* elem = dynamic_cast<xercesc::DOMElement*>(node);
 
-    DOMElement *s_elem;
-    s_elem = doc->createElement(xmlS("DataSet"));
-    s_elem->setAttribute(xmlS("timestep"), xmlS(std::to_string(t)));
-    s_elem->setAttribute(xmlS("group"), xmlS(""));
-    s_elem->setAttribute(xmlS("part"), xmlS("0"));
-    s_elem->setAttribute(xmlS("file"), xmlS(file()));
-    elem->appendChild(s_elem);
+    for(unsigned int i = 0; i < files.size(); i++){
+        DOMElement *s_elem;
+        s_elem = doc->createElement(xmlS("DataSet"));
+        s_elem->setAttribute(xmlS("timestep"), xmlS(std::to_string(t)));
+        s_elem->setAttribute(xmlS("group"), xmlS(""));
+        s_elem->setAttribute(xmlS("part"), xmlS(std::to_string(i)));
+        s_elem->setAttribute(xmlS("file"), xmlS(files.at(i)));
+        elem->appendChild(s_elem);
+    }
 
     // Save the XML document to a file
     DOMImplementation* impl;
@@ -678,7 +709,6 @@ void VTK::updatePVD(float t){
         saver->getDomConfig()->setParameter(XMLUni::fgDOMWRTFormatPrettyPrint, true);
     saver->setNewLine(xmlS("\r\n"));
 
-    std::string fname = filenamePVD();
     XMLFormatTarget *target = new LocalFileFormatTarget(fname.c_str());
     // XMLFormatTarget *target = new StdOutFormatTarget();
     DOMLSOutput *output = ((DOMImplementationLS*)impl)->createLSOutput();
@@ -723,13 +753,13 @@ void VTK::updatePVD(float t){
     xmlClear();
 }
 
-DOMDocument* VTK::getPVD(bool generate)
+DOMDocument* VTK::getPVD(const std::string fname, bool generate)
 {
     DOMDocument* doc = NULL;
     FILE *dummy=NULL;
 
     // Try to open as ascii file, just to know if the file already exist
-    dummy = fopen(filenamePVD().c_str(), "r");
+    dummy = fopen(fname.c_str(), "r");
     if(!dummy){
         if(!generate){
             return NULL;
@@ -754,7 +784,6 @@ DOMDocument* VTK::getPVD(bool generate)
     parser->setDoNamespaces(false);
     parser->setDoSchema(false);
     parser->setLoadExternalDTD(false);
-    std::string fname = filenamePVD();
     parser->parse(fname.c_str());
     doc = parser->getDocument();
     parsers.push_back(parser);
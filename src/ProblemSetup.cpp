@@ -84,18 +84,29 @@ ProblemSetup::sphSettings::sphSettings()
     platform_id = 0;
     device_id = 0;
     device_type = CL_DEVICE_TYPE_ALL;
+    n_queues = 1;
+    n_domains = 1;
+    autotune = false;
+    tuning_path = "AQUAgpusph.tuning";
+    cache_path = "";
+    prewarm = false;
+    rank = 0;
+    n_ranks = 1;
+    transport_path = "/tmp/aquagpusph";
     base_path = "";
 }
 
 void ProblemSetup::sphVariables::registerVariable(std::string name,
                                                   std::string type,
                                                   std::string length,
-                                                  std::string value)
+                                                  std::string value,
+                                                  std::string storage)
 {
     names.push_back(name);
     types.push_back(type);
     lengths.push_back(length);
     values.push_back(value);
+    storages.push_back(storage);
 }
 
 void ProblemSetup::sphDefinitions::define(const std::string name,
@@ -29,15 +29,8 @@
 namespace Aqua{ namespace InputOutput{
 
 TimeManager::TimeManager(ProblemSetup& sim_data)
-    : _step(NULL)
-    , _time(NULL)
-    , _dt(NULL)
-    , _frame(NULL)
-    , _start_time(0.f)
+    : _start_time(0.f)
     , _start_frame(0)
-    , _time_max(NULL)
-    , _steps_max(NULL)
-    , _frames_max(NULL)
     , _log_time(0.f)
     , _log_fps(-1.f)
     , _log_step(0)
@@ -71,23 +64,28 @@ TimeManager::TimeManager(ProblemSetup& sim_data)
         }
     }
 
-    _time = (float *)vars->get("t")->get();
-    _dt = (float *)vars->get("dt")->get();
-    _step = (unsigned int *)vars->get("iter")->get();
-    _frame = (unsigned int *)vars->get("frame")->get();
-    _time_max = (float *)vars->get("end_t")->get();
-    _steps_max = (unsigned int *)vars->get("end_iter")->get();
-    _frames_max = (unsigned int *)vars->get("end_frame")->get();
+    // The variables are set through the Variable interface, such that the
+    // tools are notified about the changes
+    _time = vars->handle("t");
+    _dt = vars->handle("dt");
+    _step = vars->handle("iter");
+    _frame = vars->handle("frame");
+    _time_max = vars->handle("end_t");
+    _steps_max = vars->handle("end_iter");
+    _frames_max = vars->handle("end_frame");
 
     unsigned int mode = sim_data.time_opts.sim_end_mode;
     if(mode & __FRAME_MODE__) {
-        *_frames_max = sim_data.time_opts.sim_end_frame;
+        unsigned int frames_max = sim_data.time_opts.sim_end_frame;
+        _frames_max->set(&frames_max);
     }
     if(mode & __ITER_MODE__) {
-        *_steps_max = sim_data.time_opts.sim_end_step;
+        unsigned int steps_max = sim_data.time_opts.sim_end_step;
+        _steps_max->set(&steps_max);
     }
     if(mode & __TIME_MODE__) {
-        *_time_max = sim_data.time_opts.sim_end_time;
+        float time_max = sim_data.time_opts.sim_end_time;
+        _time_max->set(&time_max);
     }
 
     mode = sim_data.time_opts.output_mode;
@@ -102,17 +100,17 @@ TimeManager::TimeManager(ProblemSetup& sim_data)
         _output_fps = sim_data.time_opts.output_fps;
     }
 
-    *_step = 0;
-    *_dt = 0.f;
-    *_time = 0.f;
+    step(0);
+    dt(0.f);
+    time(0.f);
     _start_time = 0.f;
-    *_frame = 0;
+    frame(0);
 
-    if(*_time > 0.f){
-        _log_time = *_time;
-        _log_step = *_step;
-        _output_time = *_time;
-        _output_step = *_step;
+    if(time() > 0.f){
+        _log_time = time();
+        _log_step = step();
+        _output_time = time();
+        _output_step = step();
     }
 }
 
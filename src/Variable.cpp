@@ -22,6 +22,9 @@
  * (see Aqua::InpuOutput::Variable and Aqua::InpuOutput::Variables)
  */
 
+#include <algorithm>
+#include <cstring>
+
 #include <Variable.h>
 #include <AuxiliarMethods.h>
 #include <InputOutput/Logger.h>
@@ -50,11 +53,81 @@ static std::string str_val;
 static std::ostringstream pyerr;
 
 Variable::Variable(const std::string varname, const std::string vartype)
+    : _event(NULL)
+    , _device_mem(NULL)
+    , _device_version(0)
+    , _version(0)
 {
     _name = varname;
     _typename = vartype;
 }
 
+Variable::~Variable()
+{
+    if(_event) clReleaseEvent(_event);
+    _event = NULL;
+    if(_device_mem) clReleaseMemObject(_device_mem);
+    _device_mem = NULL;
+}
+
+void Variable::setEvent(cl_event event)
+{
+    cl_int err_code;
+    if(event){
+        err_code = clRetainEvent(event);
+        if(err_code != CL_SUCCESS){
+            std::ostringstream msg;
+            msg << "Failure retaining the event for the variable \""
+                << name() << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+    }
+    if(_event) clReleaseEvent(_event);
+    _event = event;
+    // The value will be overwritten when the event is completed
+    if(event) touch();
+}
+
+void Variable::setDeviceMem(cl_mem mem)
+{
+    cl_int err_code;
+    if(mem){
+        err_code = clRetainMemObject(mem);
+        if(err_code != CL_SUCCESS){
+            std::ostringstream msg;
+            msg << "Failure retaining the memory object for the variable \""
+                << name() << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+    }
+    if(_device_mem) clReleaseMemObject(_device_mem);
+    _device_mem = mem;
+    _device_version = _version;
+}
+
+void Variable::sync()
+{
+    cl_int err_code;
+    if(!_event)
+        return;
+    cl_event event = _event;
+    _event = NULL;
+    err_code = clWaitForEvents(1, &event);
+    clReleaseEvent(event);
+    if(err_code != CL_SUCCESS){
+        std::ostringstream msg;
+        msg << "Failure waiting for the variable \"" << name() << "\"."
+            << std::endl;
+        LOG(L_ERROR, msg.str());
+        Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+}
+
 template <class T>
 ScalarVariable<T>::ScalarVariable(const std::string varname,
                                   const std::string vartype)
@@ -225,6 +298,8 @@ PyObject* Vec2Variable::getPythonObject(int i0, int n)
 {
     vec2 *vv = (vec2*)get();
     npy_intp dims[] = {2};
+    // The returned array is sharing the memory, so it can be modified
+    touch();
     return PyArray_SimpleNewFromData(1, dims, PyArray_FLOAT, vv->s);
 }
 
@@ -245,6 +320,7 @@ bool Vec2Variable::setFromPythonObject(PyObject* obj, int i0, int n)
     vec2 *vv = (vec2*)get();
     void *data = array_obj->data;
     memcpy(vv->s, data, sizeof(vec2));
+    touch();
 
     return false;
 }
@@ -261,6 +337,8 @@ PyObject* Vec3Variable::getPythonObject(int i0, int n)
 {
     vec3 *vv = (vec3*)get();
     npy_intp dims[] = {3};
+    // The returned array is sharing the memory, so it can be modified
+    touch();
     return PyArray_SimpleNewFromData(1, dims, PyArray_FLOAT, vv->s);
 }
 
@@ -281,6 +359,7 @@ bool Vec3Variable::setFromPythonObject(PyObject* obj, int i0, int n)
     vec3 *vv = (vec3*)get();
     void *data = array_obj->data;
     memcpy(vv->s, data, sizeof(vec3));
+    touch();
 
     return false;
 }
@@ -298,6 +377,8 @@ PyObject* Vec4Variable::getPythonObject(int i0, int n)
 {
     vec4 *vv = (vec4*)get();
     npy_intp dims[] = {4};
+    // The returned array is sharing the memory, so it can be modified
+    touch();
     return PyArray_SimpleNewFromData(1, dims, PyArray_FLOAT, vv->s);
 }
 
@@ -318,6 +399,7 @@ bool Vec4Variable::setFromPythonObject(PyObject* obj, int i0, int n)
     vec4 *vv = (vec4*)get();
     void *data = array_obj->data;
     memcpy(vv->s, data, sizeof(vec4));
+    touch();
 
     return false;
 }
@@ -333,6 +415,8 @@ PyObject* IVec2Variable::getPythonObject(int i0, int n)
 {
     ivec2 *vv = (ivec2*)get();
     npy_intp dims[] = {2};
+    // The returned array is sharing the memory, so it can be modified
+    touch();
     return PyArray_SimpleNewFromData(1, dims, PyArray_INT, vv->s);
 }
 
@@ -353,6 +437,7 @@ bool IVec2Variable::setFromPythonObject(PyObject* obj, int i0, int n)
     ivec2 *vv = (ivec2*)get();
     void *data = array_obj->data;
     memcpy(vv->s, data, sizeof(ivec2));
+    touch();
 
     return false;
 }
@@ -369,6 +454,8 @@ PyObject* IVec3Variable::getPythonObject(int i0, int n)
 {
     ivec3 *vv = (ivec3*)get();
     npy_intp dims[] = {3};
+    // The returned array is sharing the memory, so it can be modified
+    touch();
     return PyArray_SimpleNewFromData(1, dims, PyArray_INT, vv->s);
 }
 
@@ -389,6 +476,7 @@ bool IVec3Variable::setFromPythonObject(PyObject* obj, int i0, int n)
     ivec3 *vv = (ivec3*)get();
     void *data = array_obj->data;
     memcpy(vv->s, data, sizeof(ivec3));
+    touch();
 
     return false;
 }
@@ -406,6 +494,8 @@ PyObject* IVec4Variable::getPythonObject(int i0, int n)
 {
     ivec4 *vv = (ivec4*)get();
     npy_intp dims[] = {4};
+    // The returned array is sharing the memory, so it can be modified
+    touch();
     return PyArray_SimpleNewFromData(1, dims, PyArray_INT, vv->s);
 }
 
@@ -426,6 +516,7 @@ bool IVec4Variable::setFromPythonObject(PyObject* obj, int i0, int n)
     ivec4 *vv = (ivec4*)get();
     void *data = array_obj->data;
     memcpy(vv->s, data, sizeof(ivec4));
+    touch();
 
     return false;
 }
@@ -441,6 +532,8 @@ PyObject* UIVec2Variable::getPythonObject(int i0, int n)
 {
     uivec2 *vv = (uivec2*)get();
     npy_intp dims[] = {2};
+    // The returned array is sharing the memory, so it can be modified
+    touch();
     return PyArray_SimpleNewFromData(1, dims, PyArray_UINT, vv->s);
 }
 
@@ -461,6 +554,7 @@ bool UIVec2Variable::setFromPythonObject(PyObject* obj, int i0, int n)
     uivec2 *vv = (uivec2*)get();
     void *data = array_obj->data;
     memcpy(vv->s, data, sizeof(uivec2));
+    touch();
 
     return false;
 }
@@ -477,6 +571,8 @@ PyObject* UIVec3Variable::getPythonObject(int i0, int n)
 {
     uivec3 *vv = (uivec3*)get();
     npy_intp dims[] = {3};
+    // The returned array is sharing the memory, so it can be modified
+    touch();
     return PyArray_SimpleNewFromData(1, dims, PyArray_UINT, vv->s);
 }
 
@@ -497,6 +593,7 @@ bool UIVec3Variable::setFromPythonObject(PyObject* obj, int i0, int n)
     uivec3 *vv = (uivec3*)get();
     void *data = array_obj->data;
     memcpy(vv->s, data, sizeof(uivec3));
+    touch();
 
     return false;
 }
@@ -514,6 +611,8 @@ PyObject* UIVec4Variable::getPythonObject(int i0, int n)
 {
     uivec4 *vv = (uivec4*)get();
     npy_intp dims[] = {4};
+    // The returned array is sharing the memory, so it can be modified
+    touch();
     return PyArray_SimpleNewFromData(1, dims, PyArray_UINT, vv->s);
 }
 
@@ -534,13 +633,17 @@ bool UIVec4Variable::setFromPythonObject(PyObject* obj, int i0, int n)
     uivec4 *vv = (uivec4*)get();
     void *data = array_obj->data;
     memcpy(vv->s, data, sizeof(uivec4));
+    touch();
 
     return false;
 }
 
-ArrayVariable::ArrayVariable(const std::string varname, const std::string vartype)
+ArrayVariable::ArrayVariable(const std::string varname,
+                             const std::string vartype,
+                             const std::string storage)
     : Variable(varname, vartype)
     , _value(NULL)
+    , _storage(storage)
 {
 }
 
@@ -558,6 +661,14 @@ ArrayVariable::~ArrayVariable()
 }
 
 size_t ArrayVariable::size() const
+{
+    if(!_storage.compare(""))
+        return storageSize();
+    return storageSize() / Variables::storageToBytes(type(), _storage)
+        * Variables::typeToBytes(type());
+}
+
+size_t ArrayVariable::storageSize() const
 {
     if(!_value)
         return 0;
@@ -578,6 +689,182 @@ size_t ArrayVariable::size() const
     return memsize;
 }
 
+/** @brief Convert a float precision number into a half precision one.
+ *
+ * The number is rounded to the nearest half precision number (ties to even).
+ * @param value Float precision number.
+ * @return Half precision number.
+ */
+static cl_half floatToHalf(float value)
+{
+    uint32_t x;
+    memcpy(&x, &value, sizeof(float));
+    const cl_half sign = (x >> 16) & 0x8000;
+    const uint32_t abs_x = x & 0x7fffffff;
+    if(abs_x >= 0x7f800000){
+        // Infinity or NaN
+        return sign | 0x7c00 | ((abs_x > 0x7f800000) ? 0x200 : 0);
+    }
+    if(abs_x >= 0x47800000){
+        // Overflow
+        return sign | 0x7c00;
+    }
+    if(abs_x < 0x33000000){
+        // Underflow
+        return sign;
+    }
+    uint32_t h, rem, halfway;
+    if(abs_x < 0x38800000){
+        // Subnormal half precision number
+        const uint32_t mant = (abs_x & 0x007fffff) | 0x00800000;
+        const uint32_t shift = 126 - (abs_x >> 23);
+        h = mant >> shift;
+        rem = mant & ((1u << shift) - 1);
+        halfway = 1u << (shift - 1);
+    }
+    else{
+        h = (abs_x - 0x38000000) >> 13;
+        rem = abs_x & 0x1fff;
+        halfway = 0x1000;
+    }
+    // The carry is conveniently propagated to the exponent
+    if((rem > halfway) || ((rem == halfway) && (h & 1)))
+        h++;
+    return sign | (cl_half)h;
+}
+
+/** @brief Convert a half precision number into a float precision one.
+ * @param h Half precision number.
+ * @return Float precision number.
+ */
+static float halfToFloat(cl_half h)
+{
+    const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t x;
+    if(exponent == 0x1f){
+        // Infinity or NaN
+        x = sign | 0x7f800000 | (mant << 13);
+    }
+    else if(exponent == 0){
+        if(!mant){
+            x = sign;
+        }
+        else{
+            // Subnormal half precision number, which can be normalized
+            exponent = 113;
+            while(!(mant & 0x400)){
+                mant <<= 1;
+                exponent--;
+            }
+            x = sign | (exponent << 23) | ((mant & 0x3ff) << 13);
+        }
+    }
+    else{
+        x = sign | ((exponent + 112) << 23) | (mant << 13);
+    }
+    float value;
+    memcpy(&value, &x, sizeof(float));
+    return value;
+}
+
+cl_int ArrayVariable::read(size_t offset, size_t cb, void *ptr)
+{
+    CalcServer::CalcServer *C = CalcServer::CalcServer::singleton();
+    if(!_storage.compare("")){
+        return clEnqueueReadBuffer(C->command_queue(),
+                                   _value,
+                                   CL_TRUE,
+                                   offset,
+                                   cb,
+                                   ptr,
+                                   0,
+                                   NULL,
+                                   NULL);
+    }
+
+    const size_t typesize = Variables::typeToBytes(type());
+    const size_t storesize = Variables::storageToBytes(type(), _storage);
+    const size_t n = cb / typesize;
+    std::vector<char> data(n * storesize);
+    cl_int err_code = clEnqueueReadBuffer(C->command_queue(),
+                                          _value,
+                                          CL_TRUE,
+                                          offset / typesize * storesize,
+                                          n * storesize,
+                                          data.data(),
+                                          0,
+                                          NULL,
+                                          NULL);
+    if(err_code != CL_SUCCESS)
+        return err_code;
+    if(!_storage.compare("half")){
+        const cl_half *src = (const cl_half*)data.data();
+        for(size_t i = 0; i < cb / sizeof(cl_float); i++){
+            ((cl_float*)ptr)[i] = halfToFloat(src[i]);
+        }
+        return CL_SUCCESS;
+    }
+    // Packed storage, where the missing components are set to 0. The host
+    // stride is the aligned one, i.e. 4 components for vec3
+    const unsigned int components = typesize / sizeof(cl_float);
+    const cl_float *src = (const cl_float*)data.data();
+    for(size_t i = 0; i < n; i++){
+        for(unsigned int j = 0; j < components; j++){
+            ((cl_float*)ptr)[i * components + j] = (j < 3) ? src[3 * i + j] : 0.f;
+        }
+    }
+    return CL_SUCCESS;
+}
+
+cl_int ArrayVariable::write(size_t offset, size_t cb, const void *ptr)
+{
+    CalcServer::CalcServer *C = CalcServer::CalcServer::singleton();
+    if(!_storage.compare("")){
+        return clEnqueueWriteBuffer(C->command_queue(),
+                                    _value,
+                                    CL_TRUE,
+                                    offset,
+                                    cb,
+                                    ptr,
+                                    0,
+                                    NULL,
+                                    NULL);
+    }
+
+    const size_t typesize = Variables::typeToBytes(type());
+    const size_t storesize = Variables::storageToBytes(type(), _storage);
+    const size_t n = cb / typesize;
+    std::vector<char> data(n * storesize);
+    if(!_storage.compare("half")){
+        cl_half *dst = (cl_half*)data.data();
+        for(size_t i = 0; i < cb / sizeof(cl_float); i++){
+            dst[i] = floatToHalf(((const cl_float*)ptr)[i]);
+        }
+    }
+    else{
+        // Packed storage, where just the first 3 components are kept. The
+        // host stride is the aligned one, i.e. 4 components for vec3
+        const unsigned int components = typesize / sizeof(cl_float);
+        cl_float *dst = (cl_float*)data.data();
+        for(size_t i = 0; i < n; i++){
+            for(unsigned int j = 0; j < 3; j++){
+                dst[3 * i + j] = ((const cl_float*)ptr)[i * components + j];
+            }
+        }
+    }
+    return clEnqueueWriteBuffer(C->command_queue(),
+                                _value,
+                                CL_TRUE,
+                                offset / typesize * storesize,
+                                n * storesize,
+                                data.data(),
+                                0,
+                                NULL,
+                                NULL);
+}
+
 PyObject* ArrayVariable::getPythonObject(int i0, int n)
 {
     if(i0 < 0){
@@ -664,15 +951,7 @@ PyObject* ArrayVariable::getPythonObject(int i0, int n)
     }
     _data.push_back(data);
     // Download the data
-    err_code = clEnqueueReadBuffer(C->command_queue(),
-                                   _value,
-                                   CL_TRUE,
-                                   offset * typesize,
-                                   len * typesize,
-                                   data,
-                                   0,
-                                   NULL,
-                                   NULL);
+    err_code = read(offset * typesize, len * typesize, data);
     if(err_code != CL_SUCCESS){
         pyerr.str("");
         pyerr << "Failure downloading variable \"" << name()
@@ -782,15 +1061,7 @@ bool ArrayVariable::setFromPythonObject(PyObject* obj, int i0, int n)
 
     void *data = array_obj->data;
 
-    err_code =  clEnqueueWriteBuffer(C->command_queue(),
-                                     _value,
-                                     CL_TRUE,
-                                     offset * typesize,
-                                     len * typesize,
-                                     data,
-                                     0,
-                                     NULL,
-                                     NULL);
+    err_code = write(offset * typesize, len * typesize, data);
     if(err_code != CL_SUCCESS){
         pyerr.str("");
         pyerr << "Failure uploading variable \""
@@ -813,7 +1084,6 @@ const std::string ArrayVariable::asString()
 
 const std::string ArrayVariable::asString(size_t i)
 {
-    CalcServer::CalcServer *C = CalcServer::CalcServer::singleton();
     size_t length = size() / Variables::typeToBytes(type());
     if(i > length){
         std::ostringstream msg;
@@ -832,15 +1102,9 @@ const std::string ArrayVariable::asString(size_t i)
         LOG0(L_DEBUG, msg.str());
         return NULL;
     }
-    cl_int err_code = clEnqueueReadBuffer(C->command_queue(),
-                                          _value,
-                                          CL_TRUE,
-                                          i * Variables::typeToBytes(type()),
-                                          Variables::typeToBytes(type()),
-                                          ptr,
-                                          0,
-                                          NULL,
-                                          NULL);
+    cl_int err_code = read(i * Variables::typeToBytes(type()),
+                           Variables::typeToBytes(type()),
+                           ptr);
     if(err_code != CL_SUCCESS){
         std::ostringstream msg;
         msg << "Failure downloading the variable \"" << name() << "\"" << std::endl;
@@ -982,28 +1246,54 @@ Variables::~Variables()
         delete var;
     }
     _vars.clear();
+    _names.clear();
 }
 
 void Variables::registerVariable(const std::string name,
                                  const std::string type,
                                  const std::string length,
-                                 const std::string value)
+                                 const std::string value,
+                                 const std::string storage)
 {
     // Look for an already existing variable with the same name
-    for(unsigned int i = 0; i < _vars.size(); i++){
-        if(!_vars.at(i)->name().compare(name)){
-            delete _vars.at(i);
-            _vars.erase(_vars.begin() + i);
-        }
+    Variable *old_var = NULL;
+    auto found = _names.find(name);
+    if(found != _names.end()){
+        old_var = _vars.at(found->second);
     }
 
     // Discriminate scalar vs. array
     if(type.find('*') != std::string::npos){
-        registerClMem(name, type, length);
+        registerClMem(name, type, length, storage);
     }
     else{
+        if(storage.compare("")){
+            std::ostringstream msg;
+            msg << "The scalar variable \"" << name
+                << "\" cannot have a storage precision." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Invalid storage");
+        }
         registerScalar(name, type, value);
     }
+
+    if(!old_var){
+        _names[name] = _vars.size() - 1;
+        return;
+    }
+
+    // Replace the old variable, keeping its index, such that the handles
+    // remain valid. The version is also increased, such that the tools
+    // already bound to the variable will send the new one
+    Variable *var = _vars.back();
+    _vars.pop_back();
+    var->_version = old_var->version() + 1;
+    _lazy_vars.erase(std::remove(_lazy_vars.begin(),
+                                 _lazy_vars.end(),
+                                 old_var),
+                     _lazy_vars.end());
+    delete old_var;
+    _vars.at(found->second) = var;
 }
 
 Variable* Variables::get(unsigned int index)
@@ -1016,12 +1306,20 @@ Variable* Variables::get(unsigned int index)
 
 Variable* Variables::get(const std::string name)
 {
-    for(auto var : _vars){
-        if(!name.compare(var->name())){
-            return var;
-        }
+    auto found = _names.find(name);
+    if(found == _names.end()){
+        return NULL;
+    }
+    return _vars.at(found->second);
+}
+
+VariableRef Variables::handle(const std::string name)
+{
+    auto found = _names.find(name);
+    if(found == _names.end()){
+        return VariableRef();
     }
-    return NULL;
+    return VariableRef(this, found->second);
 }
 
 size_t Variables::allocatedMemory(){
@@ -1030,7 +1328,7 @@ size_t Variables::allocatedMemory(){
         if(var->type().find('*') == std::string::npos){
             continue;
         }
-        allocated_mem += var->size();
+        allocated_mem += ((ArrayVariable*)var)->storageSize();
     }
     return allocated_mem;
 }
@@ -1062,6 +1360,16 @@ size_t Variables::typeToBytes(const std::string type)
     return n * type_size;
 }
 
+size_t Variables::storageToBytes(const std::string type,
+                                 const std::string storage)
+{
+    if(!storage.compare("half"))
+        return typeToBytes(type) / sizeof(cl_float) * sizeof(cl_half);
+    if(!storage.compare("packed"))
+        return 3 * sizeof(cl_float);
+    return typeToBytes(type);
+}
+
 unsigned int Variables::typeToN(const std::string type)
 {
     unsigned int n = 1;
@@ -1150,6 +1458,12 @@ void Variables::solve(const std::string type_name,
         throw std::runtime_error("Empty value string");
     }
 
+    // Populate the variables which have been asynchronously downloaded
+    for(auto var : _lazy_vars){
+        populate(var);
+    }
+    _lazy_vars.clear();
+
     // Ignore whether it is an array or a scalar
     std::string type = trimCopy(type_name);
     if(type.back() == '*')
@@ -1335,6 +1649,15 @@ void Variables::populate(const std::string name)
     }
 }
 
+void Variables::populateLazy(Variable* var)
+{
+    if(std::find(_lazy_vars.begin(), _lazy_vars.end(), var) ==
+       _lazy_vars.end())
+    {
+        _lazy_vars.push_back(var);
+    }
+}
+
 void Variables::populate(Variable* var)
 {
     std::ostringstream name;
@@ -1750,7 +2073,8 @@ void Variables::registerScalar(const std::string name,
 
 void Variables::registerClMem(const std::string name,
                               const std::string type_name,
-                              const std::string length)
+                              const std::string length,
+                              const std::string storage)
 {
     size_t typesize;
     unsigned int n;
@@ -1831,22 +2155,60 @@ void Variables::registerClMem(const std::string name,
         throw std::runtime_error("Invalid array variable type");
     }
 
+    // Check the storage precision
+    if(!storage.compare("half")){
+        if(type.find("vec") != 0 && type.compare("float")){
+            std::ostringstream msg;
+            msg << "\"" << name << "\" declared as \"" << type
+                << "*\", which cannot be stored in half precision"
+                << std::endl;
+            LOG(L_ERROR, msg.str());
+            LOG0(L_DEBUG, "Just float and vec arrays are allowed\n");
+            throw std::runtime_error("Invalid storage");
+        }
+        typesize = storageToBytes(type, storage);
+    }
+    else if(!storage.compare("packed")){
+        if(type.compare("vec") && type.compare("vec3")){
+            std::ostringstream msg;
+            msg << "\"" << name << "\" declared as \"" << type
+                << "*\", which cannot be packed" << std::endl;
+            LOG(L_ERROR, msg.str());
+            LOG0(L_DEBUG, "Just vec and vec3 arrays are allowed\n");
+            throw std::runtime_error("Invalid storage");
+        }
+        typesize = storageToBytes(type, storage);
+        #ifndef HAVE_3D
+            // The 2D vec are already free of padding
+            if(!type.compare("vec")){
+                registerClMem(name, type_name, length, "");
+                return;
+            }
+        #endif
+    }
+    else if(storage.compare("")){
+        std::ostringstream msg;
+        msg << "\"" << name << "\" declared with the unknown storage \""
+            << storage << "\"" << std::endl;
+        LOG(L_ERROR, msg.str());
+        LOG0(L_DEBUG, "Valid storages are:\n");
+        LOG0(L_DEBUG, "\thalf\n");
+        LOG0(L_DEBUG, "\tpacked\n");
+        throw std::runtime_error("Invalid storage");
+    }
+
     // Get the length
     n = 0;
     if(length.compare(""))
         n = (unsigned int)round(tok.solve(length));
 
     // Generate the variable
-    ArrayVariable *var = new ArrayVariable(name, trimCopy(type_name));
+    ArrayVariable *var = new ArrayVariable(name, trimCopy(type_name), storage);
     if(n > 0){
         // Allocate memory on device
         cl_int status;
         cl_mem mem;
-        mem = clCreateBuffer(C->context(),
-                             CL_MEM_READ_WRITE,
-                             n * typesize,
-                             NULL,
-                             &status);
+        mem = C->memoryPool()->allocate(n * typesize, &status);
         if(status != CL_SUCCESS) {
             LOG(L_ERROR, "Allocation failure.\n");
             Aqua::InputOutput::Logger::singleton()->printOpenCLError(status);
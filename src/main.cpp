@@ -147,6 +147,16 @@ int main(int argc, char *argv[])
         throw;
     }
 
+    // The programs have been already compiled
+    if(file_manager.problemSetup().settings.prewarm){
+        LOG(L_INFO, "Programs cache warmed up.\n");
+        delete logger; logger = NULL;
+        delete calc_server; calc_server = NULL;
+        if(Py_IsInitialized())
+            Py_Finalize();
+        return EXIT_SUCCESS;
+    }
+
     InputOutput::TimeManager t_manager(file_manager.problemSetup());
 
     LOG(L_INFO, "Start of simulation...\n");